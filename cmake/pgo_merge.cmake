@@ -0,0 +1,15 @@
+# Merge the raw Clang PGO profiles written by the pgo-train target into
+# the single default.profdata that -fprofile-instr-use consumes.
+# Invoked by the pgo-train target with -DPROFILE_DIR and -DLLVM_PROFDATA.
+file(GLOB profraw_files "${PROFILE_DIR}/*.profraw")
+if(NOT profraw_files)
+  message(FATAL_ERROR
+    "No .profraw files in ${PROFILE_DIR}; did the training runs fail?")
+endif()
+execute_process(
+  COMMAND "${LLVM_PROFDATA}" merge -output=${PROFILE_DIR}/default.profdata
+          ${profraw_files}
+  RESULT_VARIABLE merge_result)
+if(NOT merge_result EQUAL 0)
+  message(FATAL_ERROR "llvm-profdata merge failed (${merge_result})")
+endif()
@@ -325,8 +325,7 @@ if platform.is_msvc():
               # We never have strings or arrays larger than 2**31.
               '/wd4267',
               '/DNOMINMAX', '/D_CRT_SECURE_NO_WARNINGS',
-              '/D_HAS_EXCEPTIONS=0',
-              '/DNINJA_PYTHON="%s"' % options.with_python]
+              '/D_HAS_EXCEPTIONS=0']
     if platform.msvc_needs_fs():
         cflags.append('/FS')
     ldflags = ['/DEBUG', '/libpath:$builddir']
@@ -341,8 +340,7 @@ else:
               '-fno-rtti',
               '-fno-exceptions',
               '-fvisibility=hidden',
-              '-pipe',
-              '-DNINJA_PYTHON="%s"' % options.with_python]
+              '-pipe']
     if options.debug:
         cflags += ['-D_GLIBCXX_DEBUG', '-D_GLIBCXX_DEBUG_PEDANTIC']
         cflags.remove('-fno-rtti')  # Needed for above pedanticness.
@@ -388,7 +386,10 @@ else:
         cflags.append('-fno-omit-frame-pointer')
         libs.extend(['-Wl,--no-as-needed', '-lprofiler'])
 
-if platform.supports_ppoll() and not options.force_pselect:
+if options.force_pselect:
+    # Also disables the Linux epoll backend; see subprocess.h.
+    cflags.append('-DNINJA_FORCE_PSELECT')
+elif platform.supports_ppoll():
     cflags.append('-DUSE_PPOLL')
 if platform.supports_ninja_browse():
     cflags.append('-DNINJA_HAVE_BROWSE')
@@ -400,7 +401,7 @@ def shell_escape(str):
     """Escape str such that it's interpreted as a single argument by
     the shell."""
 
-    # This isn't complete, but it's just enough to make NINJA_PYTHON work.
+    # This isn't complete, but it's just enough for the flags we emit.
     if platform.is_windows():
       return str
     if '"' in str:
@@ -460,16 +461,7 @@ n.newline()
 objs = []
 
 if platform.supports_ninja_browse():
-    n.comment('browse_py.h is used to inline browse.py.')
-    n.rule('inline',
-           command='"%s"' % src('inline.sh') + ' $varname < $in > $out',
-           description='INLINE $out')
-    n.build(built('browse_py.h'), 'inline', src('browse.py'),
-            implicit=src('inline.sh'),
-            variables=[('varname', 'kBrowsePy')])
-    n.newline()
-
-    objs += cxx('browse', order_only=built('browse_py.h'))
+    objs += cxx('browse')
     n.newline()
 
 n.comment('the depfile parser and ninja lexers are generated using re2c.')
@@ -495,8 +487,10 @@ n.comment('Core source files all build into ninja library.')
 cxxvariables = []
 if platform.is_msvc():
     cxxvariables = [('pdb', 'ninja.pdb')]
-for name in ['build',
+for name in ['action_cache',
+             'build',
              'build_log',
+             'build_server',
              'clean',
              'clparser',
              'debug_flags',
@@ -507,13 +501,18 @@ for name in ['build',
              'dyndep_parser',
              'edit_distance',
              'eval_env',
+             'event_trace',
+             'file_copy',
              'graph',
              'graphviz',
              'lexer',
              'line_printer',
              'manifest_parser',
+             'mem_advice',
              'metrics',
              'parser',
+             'resource_sampler',
+             'rspfile_spool',
              'state',
              'string_piece_util',
              'util',
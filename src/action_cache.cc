@@ -0,0 +1,259 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "action_cache.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#include "file_copy.h"
+#include "string_concat.h"
+
+using namespace std;
+
+namespace {
+
+bool MakeDir(const string& path) {
+#ifdef _WIN32
+  return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+  return mkdir(path.c_str(), 0777) == 0 || errno == EEXIST;
+#endif
+}
+
+bool DirExists(const string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFDIR) != 0;
+}
+
+/// Reflink-first copy, shared with builtin copy edges.  The cache treats
+/// any failure as a miss, so the error text is dropped here.  (A
+/// hardlink would be cheaper than even a reflink, but a later rebuild
+/// of the edge would open the output O_TRUNC and corrupt the shared
+/// inode.)
+bool CopyContents(const string& from, const string& to) {
+  string err;
+  return CopyFileContents(from, to, &err);
+}
+
+void RemoveTree(const string& dir, const vector<string>& files) {
+  for (const auto & file : files)
+    remove(string_concat(dir, "/", file).c_str());
+#ifdef _WIN32
+  _rmdir(dir.c_str());
+#else
+  rmdir(dir.c_str());
+#endif
+}
+
+/// Append the names of \a dir's entries (skipping "." and "..") to
+/// \a names.  Missing or unreadable directories list as empty.
+void ListDir(const string& dir, vector<string>* names) {
+#ifdef _WIN32
+  WIN32_FIND_DATAA find_data;
+  HANDLE handle =
+      FindFirstFileA(string_concat(dir, "/*").c_str(), &find_data);
+  if (handle == INVALID_HANDLE_VALUE)
+    return;
+  do {
+    if (strcmp(find_data.cFileName, ".") != 0 &&
+        strcmp(find_data.cFileName, "..") != 0)
+      names->push_back(find_data.cFileName);
+  } while (FindNextFileA(handle, &find_data));
+  FindClose(handle);
+#else
+  DIR* handle = opendir(dir.c_str());
+  if (!handle)
+    return;
+  while (struct dirent* ent = readdir(handle)) {
+    if (strcmp(ent->d_name, ".") != 0 && strcmp(ent->d_name, "..") != 0)
+      names->push_back(ent->d_name);
+  }
+  closedir(handle);
+#endif
+}
+
+/// Delete an entry directory and every file in it.
+void RemoveEntry(const string& entry) {
+  vector<string> files;
+  ListDir(entry, &files);
+  RemoveTree(entry, files);
+}
+
+}  // anonymous namespace
+
+ActionCache::ActionCache(string dir) : dir_(move(dir)) {
+  // Failure leaves an inert cache: every Contains/Store fails quietly
+  // and the build proceeds uncached.
+  MakeDir(dir_);
+}
+
+string ActionCache::EntryDir(const Key& key) const {
+  char digest[33];
+  snprintf(digest, sizeof(digest), "%016" PRIx64 "%016" PRIx64,
+           key.command_hash, key.input_hash);
+  // Shard on the leading hex pair so no single directory grows huge.
+  return string_concat(dir_, "/", string_view(digest, 2), "/", digest);
+}
+
+bool ActionCache::Contains(const Key& key) const {
+  return DirExists(EntryDir(key));
+}
+
+bool ActionCache::Restore(const Key& key, const vector<string>& outputs,
+                          vector<string>* deps) {
+  string entry = EntryDir(key);
+  for (size_t output_index = 0; output_index < outputs.size(); ++output_index) {
+    if (!CopyContents(string_concat(entry, "/", to_string(output_index)),
+                      outputs[output_index]))
+      return false;
+  }
+
+#ifndef _WIN32
+  // Refresh the entry's LRU stamp; Trim evicts by directory mtime.
+  utimes(entry.c_str(), nullptr);
+#endif
+
+  deps->clear();
+  FILE* deps_file = fopen(string_concat(entry, "/deps").c_str(), "rb");
+  if (!deps_file)
+    return true;  // No deps were recorded for this action.
+  char line[4 << 10];
+  while (fgets(line, sizeof(line), deps_file)) {
+    size_t len = strlen(line);
+    if (len && line[len - 1] == '\n')
+      line[--len] = '\0';
+    if (len)
+      deps->push_back(string(line, len));
+  }
+  fclose(deps_file);
+  return true;
+}
+
+bool ActionCache::Store(const Key& key, const vector<string>& outputs,
+                        const vector<string>& deps) {
+  string entry = EntryDir(key);
+  string shard = entry.substr(0, entry.rfind('/'));
+  if (!MakeDir(shard))
+    return false;
+
+  // Fill a temporary directory and rename it into place, so a reader
+  // never sees a half-written entry.
+#ifdef _WIN32
+  int pid = _getpid();
+#else
+  int pid = getpid();
+#endif
+  string tmp = string_concat(entry, ".tmp", to_string(pid));
+  if (!MakeDir(tmp))
+    return false;
+  vector<string> written;
+  for (size_t output_index = 0; output_index < outputs.size(); ++output_index) {
+    string name = to_string(output_index);
+    if (!CopyContents(outputs[output_index], string_concat(tmp, "/", name))) {
+      written.push_back(name);
+      RemoveTree(tmp, written);
+      return false;
+    }
+    written.push_back(name);
+  }
+  if (!deps.empty()) {
+    FILE* deps_file = fopen(string_concat(tmp, "/deps").c_str(), "wb");
+    if (!deps_file) {
+      RemoveTree(tmp, written);
+      return false;
+    }
+    written.push_back("deps");
+    for (const auto & dep : deps)
+      fprintf(deps_file, "%s\n", dep.c_str());
+    if (fclose(deps_file) != 0) {
+      RemoveTree(tmp, written);
+      return false;
+    }
+  }
+
+  if (rename(tmp.c_str(), entry.c_str()) != 0) {
+    // Most likely a concurrent build stored the same action first;
+    // its copy is as good as ours.
+    RemoveTree(tmp, written);
+    return DirExists(entry);
+  }
+  return true;
+}
+
+void ActionCache::Trim(int64_t max_bytes) {
+  struct Entry {
+    string path;
+    int64_t last_used;
+    int64_t bytes;
+  };
+  vector<Entry> entries;
+  int64_t total = 0;
+  vector<string> shards;
+  ListDir(dir_, &shards);
+  vector<string> names;
+  vector<string> files;
+  for (const auto & shard : shards) {
+    string shard_dir = string_concat(dir_, "/", shard);
+    names.clear();
+    ListDir(shard_dir, &names);
+    for (const auto & name : names) {
+      Entry entry;
+      entry.path = string_concat(shard_dir, "/", name);
+      struct stat st;
+      if (stat(entry.path.c_str(), &st) != 0 || (st.st_mode & S_IFDIR) == 0)
+        continue;
+      entry.last_used = (int64_t)st.st_mtime;
+      entry.bytes = 0;
+      files.clear();
+      ListDir(entry.path, &files);
+      for (const auto & file : files) {
+        struct stat file_st;
+        if (stat(string_concat(entry.path, "/", file).c_str(), &file_st) == 0)
+          entry.bytes += (int64_t)file_st.st_size;
+      }
+      total += entry.bytes;
+      entries.push_back(move(entry));
+    }
+  }
+  if (total <= max_bytes)
+    return;
+
+  // Oldest first; .tmp directories abandoned by crashed builds age out
+  // with everything else.
+  sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+    return a.last_used < b.last_used;
+  });
+  for (const auto & entry : entries) {
+    if (total <= max_bytes)
+      break;
+    RemoveEntry(entry.path);
+    total -= entry.bytes;
+  }
+}
@@ -0,0 +1,87 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_ACTION_CACHE_H_
+#define NINJA_ACTION_CACHE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/// A local content-addressed cache of edge outputs (--action-cache).
+/// Actions are keyed by the hash of their full command line combined
+/// with the combined content hash of their non-order-only inputs, the
+/// same digests the build log already records; a hit restores the
+/// stored outputs (reflinked where the filesystem supports it, copied
+/// otherwise) instead of executing the command.  Entries also carry the
+/// deps the command discovered when it really ran, so a hit replays
+/// them into the deps log without a depfile.
+///
+/// Storage is one directory per action under a two-hex-digit shard,
+/// written to a temporary name and renamed into place, so concurrent
+/// builds sharing a cache directory race benignly: whoever renames
+/// first wins and the loser discards its copy.
+///
+/// The cache is relocatable and safe to share between checkouts of the
+/// same project (point every worktree's --action-cache, or the
+/// NINJA_ACTION_CACHE environment variable, at one per-machine
+/// directory): keys hash command lines and input contents with paths
+/// exactly as the manifest spells them, so as long as the generator
+/// emits checkout-relative paths, identical actions in different
+/// worktrees produce identical keys and a build in one checkout warms
+/// all the others.  Manifests with absolute paths still work, they just
+/// never share entries across checkouts.
+struct ActionCache {
+  explicit ActionCache(std::string dir);
+
+  /// Identifies an action: the build log's command hash plus the
+  /// combined content hash of the inputs it consumed.
+  struct Key {
+    uint64_t command_hash = 0;
+    uint64_t input_hash = 0;
+  };
+
+  /// Whether the cache holds an entry for \a key.
+  bool Contains(const Key& key) const;
+
+  /// Restore the entry's files over \a outputs (in the order they were
+  /// passed to Store) and fill \a deps with the recorded dependency
+  /// paths.  Returns false when the entry is absent or damaged; outputs
+  /// may then be partially written, which is fine because the caller
+  /// falls back to executing the command.
+  bool Restore(const Key& key, const std::vector<std::string>& outputs,
+               std::vector<std::string>* deps);
+
+  /// Record \a outputs and \a deps under \a key.  Best effort: returns
+  /// false (storing nothing) if any output is unreadable or the cache
+  /// directory cannot be written.
+  bool Store(const Key& key, const std::vector<std::string>& outputs,
+             const std::vector<std::string>& deps);
+
+  /// Evict least-recently-used entries until the cache fits in
+  /// \a max_bytes.  "Used" is the entry directory's mtime, which
+  /// Restore refreshes on every hit (POSIX; on Windows eviction falls
+  /// back to store order).  Entries are self-contained, so evicting one
+  /// under a concurrent reader at worst turns that reader's hit into a
+  /// miss.
+  void Trim(int64_t max_bytes);
+
+ private:
+  std::string EntryDir(const Key& key) const;
+
+  std::string dir_;
+};
+
+#endif  // NINJA_ACTION_CACHE_H_
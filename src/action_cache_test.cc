@@ -0,0 +1,161 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "action_cache.h"
+
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
+#include "test.h"
+
+namespace {
+
+void WriteTestFile(const std::string& path, const std::string& content) {
+  FILE* f = fopen(path.c_str(), "wb");
+  ASSERT_TRUE(f != nullptr);
+  fwrite(content.data(), 1, content.size(), f);
+  fclose(f);
+}
+
+std::string ReadTestFile(const std::string& path) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f)
+    return "<unreadable>";
+  char buf[256];
+  size_t len = fread(buf, 1, sizeof(buf), f);
+  fclose(f);
+  return std::string(buf, len);
+}
+
+TEST(ActionCache, StoreRestoreRoundtrip) {
+  ScopedTempDir temp_dir;
+  temp_dir.CreateAndEnter("ActionCacheTest");
+
+  WriteTestFile("out1", "alpha");
+  WriteTestFile("out2", "beta");
+
+  ActionCache cache("cache");
+  ActionCache::Key key;
+  key.command_hash = 0x1234;
+  key.input_hash = 0x5678;
+  EXPECT_FALSE(cache.Contains(key));
+
+  std::vector<std::string> outputs = { "out1", "out2" };
+  std::vector<std::string> deps = { "dep1.h", "sub/dep2.h" };
+  EXPECT_TRUE(cache.Store(key, outputs, deps));
+  EXPECT_TRUE(cache.Contains(key));
+
+  // Restoring to fresh paths reproduces contents and deps.
+  std::vector<std::string> restored_to = { "r1", "r2" };
+  std::vector<std::string> restored_deps;
+  EXPECT_TRUE(cache.Restore(key, restored_to, &restored_deps));
+  EXPECT_EQ("alpha", ReadTestFile("r1"));
+  EXPECT_EQ("beta", ReadTestFile("r2"));
+  EXPECT_EQ(deps, restored_deps);
+
+  // A different key is a miss.
+  ActionCache::Key other = key;
+  other.input_hash = 0x5679;
+  EXPECT_FALSE(cache.Contains(other));
+  EXPECT_FALSE(cache.Restore(other, restored_to, &restored_deps));
+
+  temp_dir.Cleanup();
+}
+
+TEST(ActionCache, StoreWithUnreadableOutputFails) {
+  ScopedTempDir temp_dir;
+  temp_dir.CreateAndEnter("ActionCacheTest");
+
+  ActionCache cache("cache");
+  ActionCache::Key key;
+  key.command_hash = 1;
+  key.input_hash = 2;
+  std::vector<std::string> outputs = { "does-not-exist" };
+  EXPECT_FALSE(cache.Store(key, outputs, {}));
+  EXPECT_FALSE(cache.Contains(key));
+
+  temp_dir.Cleanup();
+}
+
+TEST(ActionCache, NoDepsRecorded) {
+  ScopedTempDir temp_dir;
+  temp_dir.CreateAndEnter("ActionCacheTest");
+
+  WriteTestFile("out", "gamma");
+  ActionCache cache("cache");
+  ActionCache::Key key;
+  key.command_hash = 3;
+  key.input_hash = 4;
+  EXPECT_TRUE(cache.Store(key, { "out" }, {}));
+
+  std::vector<std::string> restored_deps = { "stale" };
+  EXPECT_TRUE(cache.Restore(key, { "out" }, &restored_deps));
+  EXPECT_EQ("gamma", ReadTestFile("out"));
+  EXPECT_TRUE(restored_deps.empty());
+
+  temp_dir.Cleanup();
+}
+
+TEST(ActionCache, TrimRespectsCap) {
+  ScopedTempDir temp_dir;
+  temp_dir.CreateAndEnter("ActionCacheTest");
+
+  WriteTestFile("out", "0123456789");
+  ActionCache cache("cache");
+  ActionCache::Key key;
+  key.command_hash = 7;
+  for (key.input_hash = 0; key.input_hash < 3; ++key.input_hash)
+    ASSERT_TRUE(cache.Store(key, { "out" }, {}));
+
+  // A generous cap keeps everything; a zero cap sweeps everything.
+  cache.Trim(1 << 20);
+  for (key.input_hash = 0; key.input_hash < 3; ++key.input_hash)
+    EXPECT_TRUE(cache.Contains(key));
+  cache.Trim(0);
+  for (key.input_hash = 0; key.input_hash < 3; ++key.input_hash)
+    EXPECT_FALSE(cache.Contains(key));
+
+  temp_dir.Cleanup();
+}
+
+#ifndef _WIN32
+TEST(ActionCache, TrimEvictsLeastRecentlyUsed) {
+  ScopedTempDir temp_dir;
+  temp_dir.CreateAndEnter("ActionCacheTest");
+
+  WriteTestFile("out", "0123456789");  // 10 bytes per entry.
+  ActionCache cache("cache");
+  ActionCache::Key old_key, fresh_key;
+  old_key.command_hash = fresh_key.command_hash = 7;
+  old_key.input_hash = 1;
+  fresh_key.input_hash = 2;
+  ASSERT_TRUE(cache.Store(old_key, { "out" }, {}));
+  ASSERT_TRUE(cache.Store(fresh_key, { "out" }, {}));
+
+  // Age the first entry well past the second.
+  struct timeval stale[2] = { { 1000000, 0 }, { 1000000, 0 } };
+  ASSERT_EQ(0, utimes("cache/00/00000000000000070000000000000001", stale));
+
+  cache.Trim(10);
+  EXPECT_FALSE(cache.Contains(old_key));
+  EXPECT_TRUE(cache.Contains(fresh_key));
+
+  temp_dir.Cleanup();
+}
+#endif  // !_WIN32
+
+}  // anonymous namespace
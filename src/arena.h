@@ -0,0 +1,155 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_ARENA_H_
+#define NINJA_ARENA_H_
+
+#include <stddef.h>
+#include <string.h>
+
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "mem_advice.h"
+
+/// A slab allocator for objects of one type with arena lifetime: objects
+/// are constructed back-to-back in large chunks and only destroyed when
+/// the arena itself is.  A graph of millions of Nodes and Edges thus lives
+/// in a few thousand contiguous allocations that traverse cache-friendly
+/// and tear down in bulk, instead of millions of individually freed heap
+/// objects.
+template <typename T>
+struct Arena final {
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  ~Arena() {
+    for (Chunk* chunk : chunks_) {
+      T* objects = reinterpret_cast<T*>(chunk->storage);
+      for (size_t i = 0; i < chunk->used; ++i)
+        objects[i].~T();
+      ::operator delete(chunk, std::align_val_t(kChunkBytes));
+    }
+  }
+
+  /// Construct a new T inside the arena.  The object stays alive until
+  /// the arena is destroyed; there is no per-object free.
+  template <typename... Args>
+  T* New(Args&&... args) {
+    Chunk* chunk = chunks_.empty() ? nullptr : chunks_.back();
+    if (chunk == nullptr || chunk->used == kObjectsPerChunk) {
+      chunk = static_cast<Chunk*>(
+          ::operator new(sizeof(Chunk), std::align_val_t(kChunkBytes)));
+      chunk->used = 0;
+      AdviseHugePages(chunk, sizeof(Chunk));
+      chunks_.push_back(chunk);
+    }
+    T* object = reinterpret_cast<T*>(chunk->storage) + chunk->used;
+    new (object) T(std::forward<Args>(args)...);
+    ++chunk->used;
+    return object;
+  }
+
+  /// Invoke \a f on every object, in allocation order.  Sweeping the
+  /// chunks directly touches only the slabs themselves, so bulk updates
+  /// (e.g. State::Reset) stay on contiguous memory.
+  template <typename F>
+  void ForEach(F&& f) {
+    for (Chunk* chunk : chunks_) {
+      T* objects = reinterpret_cast<T*>(chunk->storage);
+      for (size_t i = 0; i < chunk->used; ++i)
+        f(objects[i]);
+    }
+  }
+
+  /// Number of objects constructed so far.
+  size_t size() const {
+    if (chunks_.empty())
+      return 0;
+    return (chunks_.size() - 1) * kObjectsPerChunk + chunks_.back()->used;
+  }
+
+ private:
+  /// One transparent huge page per chunk: chunks are 2MB, allocated at
+  /// huge-page alignment and advised MADV_HUGEPAGE, so a graph of
+  /// millions of nodes costs thousands of dTLB entries to walk rather
+  /// than hundreds of thousands of 4kB ones.
+  static constexpr size_t kChunkBytes = 2 << 20;
+  /// Room reserved ahead of the objects for the chunk header and its
+  /// alignment padding.
+  static constexpr size_t kChunkSlack = 64;
+  static constexpr size_t kObjectsPerChunk =
+      (kChunkBytes - kChunkSlack) / sizeof(T) > 0
+          ? (kChunkBytes - kChunkSlack) / sizeof(T)
+          : 1;
+
+  struct Chunk {
+    size_t used;
+    alignas(T) char storage[kObjectsPerChunk * sizeof(T)];
+  };
+
+  std::vector<Chunk*> chunks_;
+};
+
+/// An interning arena for strings: bytes are appended into large contiguous
+/// blocks and handed out as string_views.  Interning the node paths of a big
+/// graph this way replaces millions of small heap allocations with a few
+/// hundred blocks, and keeps hash-probe key comparisons on warm cache lines.
+/// Every interned string is followed by a NUL byte, so view.data() is also
+/// usable as a C string.
+struct StringArena final {
+  StringArena() = default;
+  StringArena(const StringArena&) = delete;
+  StringArena& operator=(const StringArena&) = delete;
+
+  ~StringArena() {
+    for (char* block : blocks_)
+      ::operator delete(block, std::align_val_t(kBlockSize));
+  }
+
+  /// Copy |s| into the arena and return a view of the copy, valid for the
+  /// lifetime of the arena.  Strings are not deduplicated; callers that
+  /// want one copy per path (like State) must check their own index first.
+  std::string_view Intern(std::string_view s) {
+    size_t needed = s.size() + 1;  // Trailing NUL.
+    if (used_ + needed > capacity_) {
+      size_t block_size = needed > kBlockSize ? needed : kBlockSize;
+      char* block = static_cast<char*>(
+          ::operator new(block_size, std::align_val_t(kBlockSize)));
+      AdviseHugePages(block, block_size);
+      blocks_.push_back(block);
+      used_ = 0;
+      capacity_ = block_size;
+    }
+    char* out = blocks_.back() + used_;
+    memcpy(out, s.data(), s.size());
+    out[s.size()] = '\0';
+    used_ += needed;
+    return std::string_view(out, s.size());
+  }
+
+ private:
+  /// One transparent huge page per block; see Arena::kChunkBytes.
+  static constexpr size_t kBlockSize = 2 << 20;
+
+  std::vector<char*> blocks_;
+  /// Bytes used in and capacity of blocks_.back().
+  size_t used_ = 0;
+  size_t capacity_ = 0;
+};
+
+#endif  // NINJA_ARENA_H_
@@ -0,0 +1,73 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "arena.h"
+
+#include "test.h"
+
+namespace {
+
+struct Counted {
+  explicit Counted(int value) : value(value) { ++live; }
+  ~Counted() { --live; }
+  int value;
+  static int live;
+};
+
+int Counted::live = 0;
+
+TEST(Arena, ConstructAndDestroy) {
+  {
+    Arena<Counted> arena;
+    EXPECT_EQ(0u, arena.size());
+    Counted* a = arena.New(1);
+    Counted* b = arena.New(2);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(1, a->value);
+    EXPECT_EQ(2, b->value);
+    EXPECT_EQ(2u, arena.size());
+    EXPECT_EQ(2, Counted::live);
+  }
+  // Destroying the arena destroys every object it handed out.
+  EXPECT_EQ(0, Counted::live);
+}
+
+TEST(Arena, ManyChunks) {
+  // Enough objects to span several chunks; all must stay valid.
+  const int kCount = 100000;
+  Arena<Counted> arena;
+  std::vector<Counted*> objects;
+  for (int i = 0; i < kCount; ++i)
+    objects.push_back(arena.New(i));
+  EXPECT_EQ(static_cast<size_t>(kCount), arena.size());
+  for (int i = 0; i < kCount; ++i)
+    EXPECT_EQ(i, objects[i]->value);
+}
+
+TEST(StringArena, Intern) {
+  StringArena arena;
+  std::string original = "hello";
+  std::string_view interned = arena.Intern(original);
+  EXPECT_EQ("hello", interned);
+  EXPECT_NE(original.data(), interned.data());
+  // Interned strings are NUL-terminated so they work as C strings.
+  EXPECT_EQ(0, interned.data()[interned.size()]);
+
+  // A string larger than one block still interns correctly.
+  std::string big(1 << 20, 'x');
+  EXPECT_EQ(big, arena.Intern(big));
+  EXPECT_EQ("after", arena.Intern("after"));
+}
+
+}  // anonymous namespace
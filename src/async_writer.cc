@@ -0,0 +1,103 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "async_writer.h"
+
+#include <errno.h>
+#include <string.h>
+
+namespace {
+
+/// Requests the ring holds before producers block.  Each request is one
+/// log record, so this bounds memory at a few hundred KB while still
+/// riding out multi-record bursts of edge completions.
+const size_t kRingCapacity = 256;
+
+}  // anonymous namespace
+
+AsyncWriter::AsyncWriter() : thread_(&AsyncWriter::Worker, this) {}
+
+AsyncWriter::~AsyncWriter() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return queue_.empty() && !busy_; });
+    exit_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+void AsyncWriter::Write(FILE* file, std::string data, bool flush) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return queue_.size() < kRingCapacity; });
+    queue_.push_back(Request{ file, std::move(data), flush });
+  }
+  cv_.notify_one();
+}
+
+bool AsyncWriter::Drain(std::string* err) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this] { return queue_.empty() && !busy_; });
+  if (error_ == 0)
+    return true;
+  *err = strerror(error_);
+  error_ = 0;
+  return false;
+}
+
+bool AsyncWriter::failed() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return error_ != 0;
+}
+
+void AsyncWriter::Worker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    cv_.wait(lock, [this] { return exit_ || !queue_.empty(); });
+    if (exit_)
+      return;
+    Request request = std::move(queue_.front());
+    queue_.pop_front();
+    // Coalesce the burst: contiguous requests against the same file fold
+    // into a single fwrite, so a wave of edge completions costs one
+    // write (and at most one flush) instead of one per record.
+    while (!queue_.empty() && queue_.front().file == request.file) {
+      request.data += queue_.front().data;
+      request.flush |= queue_.front().flush;
+      queue_.pop_front();
+    }
+    // Going idle is the durability point: producers skip per-record
+    // flushes and rely on Drain() only returning once files are flushed.
+    if (queue_.empty())
+      request.flush = true;
+    busy_ = true;
+    // Producers blocked on a full ring can refill the slots while the
+    // write is in flight.
+    done_cv_.notify_all();
+    lock.unlock();
+    bool ok = request.data.empty() ||
+              fwrite(request.data.data(), request.data.size(), 1,
+                     request.file) == 1;
+    if (ok && request.flush)
+      ok = fflush(request.file) == 0;
+    int write_errno = ok ? 0 : (errno != 0 ? errno : EIO);
+    lock.lock();
+    busy_ = false;
+    if (write_errno != 0 && error_ == 0)
+      error_ = write_errno;
+    if (queue_.empty())
+      done_cv_.notify_all();
+  }
+}
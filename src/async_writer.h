@@ -0,0 +1,80 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_ASYNC_WRITER_H_
+#define NINJA_ASYNC_WRITER_H_
+
+#include <stdio.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/// Write-behind for the side-file appends on the build's completion path:
+/// the build and deps logs hand their formatted records to a background
+/// thread instead of paying fwrite+fflush latency inside Builder's dispatch
+/// loop.  Requests queue in a bounded ring (producers block when it fills,
+/// so an unwritable disk cannot buffer a whole build in memory) and are
+/// written strictly in order; contiguous requests for the same file are
+/// coalesced into one write, and the worker flushes whenever its queue
+/// goes idle, so Drain() is also a durability barrier.  Failures are
+/// sticky until the next Drain() barrier reports them; producers poll
+/// failed() to stop early.
+struct AsyncWriter {
+  AsyncWriter();
+  /// Drains outstanding writes, then joins the worker.
+  ~AsyncWriter();
+
+  /// Queue \a data to be appended to \a file, followed by an fflush when
+  /// \a flush is set.  Callers that only need durability by the next
+  /// Drain() can pass false: the worker flushes at idle anyway, and
+  /// skipping the per-record request lets bursts coalesce into one
+  /// flush.  Blocks while the ring is full.  The caller must keep
+  /// \a file open until the next Drain() (or destruction).
+  void Write(FILE* file, std::string data, bool flush);
+
+  /// Barrier: wait until every queued write has hit its file.  Returns
+  /// false -- with the message of the first failed write since the last
+  /// barrier -- if any of them went wrong.
+  bool Drain(std::string* err);
+
+  /// Whether a write has failed since the last Drain().
+  bool failed() const;
+
+ private:
+  struct Request {
+    FILE* file;
+    std::string data;
+    bool flush;
+  };
+
+  void Worker();
+
+  mutable std::mutex mutex_;
+  /// Signals the worker that requests (or exit_) are pending.
+  std::condition_variable cv_;
+  /// Signals producers that the ring has room or went idle.
+  std::condition_variable done_cv_;
+  std::deque<Request> queue_;
+  /// The worker is writing a request it already popped off the queue.
+  bool busy_ = false;
+  bool exit_ = false;
+  /// errno of the first failed write since the last Drain(), or 0.
+  int error_ = 0;
+  std::thread thread_;
+};
+
+#endif  // NINJA_ASYNC_WRITER_H_
@@ -14,69 +14,364 @@
 
 #include "browse.h"
 
+#include <arpa/inet.h>
+#include <ctype.h>
 #include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
 #include <unistd.h>
-#include <vector>
 
-#include "build/browse_py.h"
+#include <string>
+#include <string_view>
+
+#include "graph.h"
+#include "state.h"
 
 using namespace std;
 
-void RunBrowsePython(State* state, const char* ninja_command,
-                     const char* input_file, int argc, char* argv[]) {
-  // Fork off a Python process and have it run our code via its stdin.
-  // (Actually the Python process becomes the parent.)
-  int pipefd[2];
-  if (pipe(pipefd) < 0) {
-    perror("ninja: pipe");
+namespace {
+
+/// The single page served at "/".  It fetches /query?path=... and renders
+/// the result; the current target lives in the URL fragment so that
+/// back/forward and bookmarks work.
+const char kBrowsePage[] = R"html(<!DOCTYPE html>
+<html><head><meta charset="utf-8"><title>ninja browse</title>
+<style>
+body { font-family: sans-serif; margin: 2ex; max-width: 100ex; }
+h1 { font-size: 120%; word-break: break-all; }
+h2 { font-size: 100%; border-bottom: 1px solid #ccc; }
+tt { word-break: break-all; white-space: pre-wrap; }
+ul { margin-top: 0; padding-left: 3ex; }
+li { list-style-type: none; }
+.filelist { -webkit-columns: auto 2; -moz-columns: auto 2; columns: auto 2; }
+</style></head>
+<body>
+<form id="f"><input id="q" size="60" placeholder="target path"></form>
+<div id="out"></div>
+<script>
+function esc(s) {
+  return s.replace(/&/g, '&amp;').replace(/</g, '&lt;').replace(/>/g, '&gt;');
+}
+function link(path) {
+  return '<a href="#' + encodeURIComponent(path) + '">' + esc(path) + '</a>';
+}
+function filelist(title, files) {
+  if (!files || !files.length)
+    return '';
+  var h = '<h2>' + esc(title) + '</h2><ul class="filelist">';
+  for (var i = 0; i < files.length; i++)
+    h += '<li>' + link(files[i]) + '</li>';
+  return h + '</ul>';
+}
+async function show(path) {
+  document.getElementById('q').value = path;
+  var r = await fetch('/query?path=' + encodeURIComponent(path));
+  var d = await r.json();
+  var h = '<h1><tt>' + esc(d.path || path) + '</tt></h1>';
+  if (d.error) {
+    h += '<p>' + esc(d.error) + '</p>';
+  } else {
+    if (d.in_edge) {
+      h += '<h2>target is built using rule <tt>' + esc(d.in_edge.rule) +
+           '</tt></h2>';
+      if (d.in_edge.command)
+        h += '<p><tt>' + esc(d.in_edge.command) + '</tt></p>';
+      h += filelist('dependencies', d.in_edge.inputs);
+      h += filelist('implicit dependencies', d.in_edge.implicit_inputs);
+      h += filelist('order-only dependencies', d.in_edge.order_only_inputs);
+    } else {
+      h += '<h2>source file (no input edge)</h2>';
+    }
+    h += filelist('reverse dependencies', d.dependents);
+  }
+  document.getElementById('out').innerHTML = h;
+}
+function showhash() {
+  if (location.hash.length > 1)
+    show(decodeURIComponent(location.hash.substring(1)));
+}
+document.getElementById('f').onsubmit = function() {
+  location.hash = '#' + encodeURIComponent(document.getElementById('q').value);
+  return false;
+};
+window.onhashchange = showhash;
+showhash();
+</script></body></html>
+)html";
+
+/// Append |s| to |out| as a JSON string literal, quotes included.
+void JsonAppendString(string_view s, string* out) {
+  out->push_back('"');
+  for (char c : s) {
+    switch (c) {
+    case '"':  out->append("\\\""); break;
+    case '\\': out->append("\\\\"); break;
+    case '\n': out->append("\\n"); break;
+    case '\t': out->append("\\t"); break;
+    default:
+      if ((unsigned char)c < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        out->append(buf);
+      } else {
+        out->push_back(c);
+      }
+    }
+  }
+  out->push_back('"');
+}
+
+/// Decode %XX escapes and '+' in a query-string value.
+string UrlDecode(string_view in) {
+  string out;
+  out.reserve(in.size());
+  for (size_t i = 0; i < in.size(); ++i) {
+    if (in[i] == '%' && i + 2 < in.size() &&
+        isxdigit((unsigned char)in[i + 1]) &&
+        isxdigit((unsigned char)in[i + 2])) {
+      char hex[3] = { in[i + 1], in[i + 2], 0 };
+      out.push_back((char)strtol(hex, nullptr, 16));
+      i += 2;
+    } else if (in[i] == '+') {
+      out.push_back(' ');
+    } else {
+      out.push_back(in[i]);
+    }
+  }
+  return out;
+}
+
+/// Build the JSON description of one node: its input edge (rule, command
+/// and inputs split by dependency kind) and its dependents, read straight
+/// off the in-memory graph via the reverse-dependency (out_edges) index.
+string QueryJson(State* state, const string& path) {
+  string json;
+  Node* node = state->LookupNode(path);
+  if (!node) {
+    json.append("{\"error\":");
+    JsonAppendString("unknown target '" + path + "'", &json);
+    json.push_back('}');
+    return json;
+  }
+
+  json.append("{\"path\":");
+  JsonAppendString(node->path(), &json);
+
+  if (Edge* edge = node->in_edge()) {
+    json.append(",\"in_edge\":{\"rule\":");
+    JsonAppendString(edge->rule().name(), &json);
+    if (!edge->is_phony()) {
+      json.append(",\"command\":");
+      JsonAppendString(edge->EvaluateCommand(), &json);
+    }
+    const char* kinds[3] = { "\"inputs\":[", "\"implicit_inputs\":[",
+                             "\"order_only_inputs\":[" };
+    for (int kind = 0; kind < 3; ++kind) {
+      json.push_back(',');
+      json.append(kinds[kind]);
+      bool first = true;
+      for (size_t i = 0; i < edge->inputs_.size(); ++i) {
+        int input_kind = edge->is_order_only(i) ? 2
+                       : edge->is_implicit(i)   ? 1
+                                                : 0;
+        if (input_kind != kind)
+          continue;
+        if (!first)
+          json.push_back(',');
+        first = false;
+        JsonAppendString(edge->inputs_[i]->path(), &json);
+      }
+      json.push_back(']');
+    }
+    json.push_back('}');
+  } else {
+    json.append(",\"in_edge\":null");
+  }
+
+  json.append(",\"dependents\":[");
+  bool first = true;
+  for (Edge* edge : node->out_edges()) {
+    for (Node* output : edge->outputs_) {
+      if (!first)
+        json.push_back(',');
+      first = false;
+      JsonAppendString(output->path(), &json);
+    }
+  }
+  json.append("]}");
+  return json;
+}
+
+/// Write all of |data| to |fd|, tolerating short writes; returns false if
+/// the peer went away.
+bool WriteAll(int fd, string_view data) {
+  while (!data.empty()) {
+    ssize_t len = write(fd, data.data(), data.size());
+    if (len < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data.remove_prefix(len);
+  }
+  return true;
+}
+
+void SendResponse(int fd, const char* status, const char* content_type,
+                  string_view body) {
+  char header[256];
+  snprintf(header, sizeof(header),
+           "HTTP/1.1 %s\r\n"
+           "Content-Type: %s; charset=utf-8\r\n"
+           "Content-Length: %zu\r\n"
+           "Connection: close\r\n\r\n",
+           status, content_type, body.size());
+  if (WriteAll(fd, header))
+    WriteAll(fd, body);
+}
+
+/// Handle a single HTTP connection.  Only GET requests for "/" and
+/// "/query?path=..." exist; everything is answered from the already-loaded
+/// State, so there is no per-request subprocess or reparse.
+void ServeRequest(State* state, int fd) {
+  // Requests of interest fit comfortably in one read; anything longer
+  // than the buffer is malformed for our purposes.
+  char buf[8 << 10];
+  ssize_t len = read(fd, buf, sizeof(buf) - 1);
+  if (len <= 0)
+    return;
+  buf[len] = 0;
+
+  string_view request(buf, len);
+  if (request.substr(0, 4) != "GET ") {
+    SendResponse(fd, "405 Method Not Allowed", "text/plain",
+                 "only GET is supported\n");
+    return;
+  }
+  request.remove_prefix(4);
+  size_t end = request.find(' ');
+  if (end == string_view::npos) {
+    SendResponse(fd, "400 Bad Request", "text/plain", "bad request\n");
     return;
   }
+  string_view target = request.substr(0, end);
+
+  if (target == "/") {
+    SendResponse(fd, "200 OK", "text/html", kBrowsePage);
+  } else if (target.substr(0, 12) == "/query?path=") {
+    string path = UrlDecode(target.substr(12));
+    SendResponse(fd, "200 OK", "application/json", QueryJson(state, path));
+  } else {
+    SendResponse(fd, "404 Not Found", "text/plain", "not found\n");
+  }
+}
 
+/// Best-effort launch of the user's browser; failure is not an error.
+void OpenBrowser(const string& url) {
   pid_t pid = fork();
-  if (pid < 0) {
-    perror("ninja: fork");
+  if (pid != 0)
     return;
+  // Detach so the opener is not mistaken for a build subprocess.
+  setsid();
+#if defined(__APPLE__)
+  execlp("open", "open", url.c_str(), (char*)nullptr);
+#else
+  execlp("xdg-open", "xdg-open", url.c_str(), (char*)nullptr);
+#endif
+  _exit(127);
+}
+
+}  // anonymous namespace
+
+int RunBrowseServer(State* state, int argc, char* argv[]) {
+  const char* hostname = "127.0.0.1";
+  int port = 8000;
+  bool open_browser = true;
+  string initial_target;
+
+  for (int i = 0; i < argc; ++i) {
+    string_view arg = argv[i];
+    if ((arg == "-p" || arg == "--port") && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else if ((arg == "-a" || arg == "--hostname") && i + 1 < argc) {
+      hostname = argv[++i];
+    } else if (arg == "--no-browser") {
+      open_browser = false;
+    } else if (!arg.empty() && arg[0] == '-') {
+      fprintf(stderr,
+              "usage: ninja -t browse [-p PORT] [-a HOSTNAME] "
+              "[--no-browser] [TARGET]\n");
+      return 1;
+    } else {
+      initial_target = string(arg);
+    }
   }
 
-  if (pid > 0) {  // Parent.
-    close(pipefd[1]);
-    do {
-      if (dup2(pipefd[0], 0) < 0) {
-        perror("ninja: dup2");
-        break;
-      }
+  if (initial_target.empty() && !state->defaults_.empty())
+    initial_target = string(state->defaults_[0]->path());
 
-      std::vector<const char *> command;
-      command.push_back(NINJA_PYTHON);
-      command.push_back("-");
-      command.push_back("--ninja-command");
-      command.push_back(ninja_command);
-      command.push_back("-f");
-      command.push_back(input_file);
-      for (int i = 0; i < argc; i++) {
-          command.push_back(argv[i]);
-      }
-      command.push_back(nullptr);
-      execvp(command[0], (char**)&command[0]);
-      if (errno == ENOENT) {
-        printf("ninja: %s is required for the browse tool\n", NINJA_PYTHON);
-      } else {
-        perror("ninja: execvp");
-      }
-    } while (false);
-    _exit(1);
-  } else {  // Child.
-    close(pipefd[0]);
-
-    // Write the script file into the stdin of the Python process.
-    if(ssize_t len = write(pipefd[1], kBrowsePy, sizeof(kBrowsePy));
-       len < (ssize_t)sizeof(kBrowsePy))
-    {
-      perror("ninja: write");
+  int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (server_fd < 0) {
+    perror("ninja: socket");
+    return 1;
+  }
+  int reuse = 1;
+  setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (strcmp(hostname, "localhost") == 0)
+    hostname = "127.0.0.1";
+  if (inet_pton(AF_INET, hostname, &addr.sin_addr) != 1) {
+    fprintf(stderr, "ninja: browse: cannot resolve hostname '%s'\n", hostname);
+    close(server_fd);
+    return 1;
+  }
+  if (bind(server_fd, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+      listen(server_fd, 8) < 0) {
+    perror("ninja: bind");
+    close(server_fd);
+    return 1;
+  }
+
+  // Learn the port the kernel picked when asked for port 0.
+  socklen_t addr_len = sizeof(addr);
+  if (getsockname(server_fd, (sockaddr*)&addr, &addr_len) == 0)
+    port = ntohs(addr.sin_port);
+
+  // Clients that disconnect mid-response must not kill the server.
+  signal(SIGPIPE, SIG_IGN);
+
+  char url[256];
+  snprintf(url, sizeof(url), "http://%s:%d/", hostname, port);
+  printf("Web server running on %s, ctrl-C to abort...\n", url);
+  fflush(stdout);
+  if (open_browser) {
+    string initial_url = url;
+    if (!initial_target.empty()) {
+      initial_url.push_back('#');
+      initial_url.append(initial_target);
     }
-    close(pipefd[1]);
-    exit(0);
+    OpenBrowser(initial_url);
   }
+
+  for (;;) {
+    int fd = accept(server_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("ninja: accept");
+      break;
+    }
+    ServeRequest(state, fd);
+    close(fd);
+  }
+
+  close(server_fd);
+  return 1;
 }
@@ -17,12 +17,11 @@
 
 struct State;
 
-/// Run in "browse" mode, which execs a Python webserver.
-/// \a ninja_command is the command used to invoke ninja.
-/// \a args are the number of arguments to be passed to the Python script.
-/// \a argv are arguments to be passed to the Python script.
-/// This function does not return if it runs successfully.
-void RunBrowsePython(State* state, const char* ninja_command,
-                     const char* input_file, int argc, char* argv[]);
+/// Run in "browse" mode: serve an HTTP view of the loaded build graph
+/// until interrupted.  \a argc and \a argv are the tool's remaining
+/// arguments ([-p PORT] [-a HOSTNAME] [--no-browser] [TARGET]).
+/// Returns an exit code; in the normal case it only returns on error,
+/// since the server runs until the process is killed.
+int RunBrowseServer(State* state, int argc, char* argv[]);
 
 #endif  // NINJA_BROWSE_H_
@@ -16,9 +16,16 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
 #include <algorithm>
 
 #ifdef _WIN32
@@ -30,13 +37,21 @@
 #include <sys/termios.h>
 #endif
 
+#include "action_cache.h"
 #include "build_log.h"
 #include "clparser.h"
 #include "debug_flags.h"
 #include "depfile_parser.h"
 #include "deps_log.h"
 #include "disk_interface.h"
+#include "event_trace.h"
+#include "file_copy.h"
 #include "graph.h"
+#include "jobserver.h"
+#include "parallelism_governor.h"
+#include "persistent_worker.h"
+#include "resource_sampler.h"
+#include "rspfile_spool.h"
 #include "state.h"
 #include "subprocess.h"
 #include "util.h"
@@ -97,12 +112,19 @@ void BuildStatus::PlanHasTotalEdges(int total) {
   total_edges_ = total;
 }
 
+void BuildStatus::PlanHasPredictedWork(int64_t work_millis) {
+  predicted_total_work_millis_ = work_millis;
+}
+
 void BuildStatus::BuildEdgeStarted(const Edge* edge) {
   assert(running_edges_.find(edge) == running_edges_.end());
   int start_time = (int)(GetTimeMillis() - start_time_millis_);
   running_edges_.emplace(edge, start_time);
   ++started_edges_;
 
+  if (g_event_trace)
+    g_event_trace->EdgeStarted(edge);
+
   if (edge->use_console() || printer_.is_smart_terminal())
     PrintStatus(edge, kEdgeStarted);
 
@@ -118,14 +140,35 @@ void BuildStatus::BuildEdgeFinished(Edge* edge,
   int64_t now = GetTimeMillis();
 
   ++finished_edges_;
+  predicted_finished_work_millis_ += edge->predicted_duration();
 
   RunningEdgeMap::iterator i = running_edges_.find(edge);
   *start_time = i->second;
   *end_time = (int)(now - start_time_millis_);
   running_edges_.erase(i);
 
-  if (edge->use_console())
+  if (g_event_trace)
+    g_event_trace->EdgeFinished(edge, success);
+
+  if (edge->use_console()) {
     printer_.SetConsoleLocked(false);
+    // The console edge owned the line; whatever status was there is gone.
+    last_status_line_.clear();
+  }
+
+  // Flush a streaming edge's unterminated last line.
+  if (auto const& streamed = streamed_partial_.find(edge);
+      streamed != streamed_partial_.end()) {
+    if (!streamed->second.empty() && config_.verbosity != BuildConfig::QUIET) {
+      std::string line = streamed->second;
+      if (!printer_.supports_color())
+        line = StripAnsiEscapeCodes(line);
+      printer_.PrintOnNewLine(
+          string_concat(edge->outputs_[0]->path(), ": ", line, "\n"));
+      last_status_line_.clear();
+    }
+    streamed_partial_.erase(streamed);
+  }
 
   if (config_.verbosity == BuildConfig::QUIET)
     return;
@@ -137,7 +180,7 @@ void BuildStatus::BuildEdgeFinished(Edge* edge,
   if (!success) {
     std::string outputs;
     for (const auto & item : edge->outputs_)
-      outputs += item->path() + " ";
+      string_append(outputs, item->path(), " ");
 
     if (printer_.supports_color()) {
         printer_.PrintOnNewLine(string_concat("\x1B[31m" "FAILED: " "\x1B[0m", outputs, "\n"));
@@ -145,6 +188,7 @@ void BuildStatus::BuildEdgeFinished(Edge* edge,
         printer_.PrintOnNewLine(string_concat("FAILED: ", outputs, "\n"));
     }
     printer_.PrintOnNewLine(edge->EvaluateCommand() + "\n");
+    last_status_line_.clear();
   }
 
   if (!output.empty()) {
@@ -171,6 +215,7 @@ void BuildStatus::BuildEdgeFinished(Edge* edge,
 #endif
 
     printer_.PrintOnNewLine(final_output);
+    last_status_line_.clear();
 
 #ifdef _WIN32
     _setmode(_fileno(stdout), _O_TEXT);  // End Windows extra CR fix
@@ -178,6 +223,28 @@ void BuildStatus::BuildEdgeFinished(Edge* edge,
   }
 }
 
+void BuildStatus::BuildEdgeStreamedOutput(const Edge* edge, const char* data,
+                                          size_t len) {
+  if (config_.verbosity == BuildConfig::QUIET)
+    return;
+
+  std::string& partial = streamed_partial_[edge];
+  partial.append(data, len);
+
+  std::string_view prefix = edge->outputs_[0]->path();
+  size_t start = 0;
+  for (size_t eol = partial.find('\n'); eol != std::string::npos;
+       eol = partial.find('\n', start)) {
+    std::string line = partial.substr(start, eol + 1 - start);
+    if (!printer_.supports_color())
+      line = StripAnsiEscapeCodes(line);
+    printer_.PrintOnNewLine(string_concat(prefix, ": ", line));
+    last_status_line_.clear();
+    start = eol + 1;
+  }
+  partial.erase(0, start);
+}
+
 void BuildStatus::BuildLoadDyndeps() {
   // The DependencyScan calls EXPLAIN() to print lines explaining why
   // it considers a portion of the graph to be out of date.  Normally
@@ -188,24 +255,81 @@ void BuildStatus::BuildLoadDyndeps() {
   // line.  Start a new line so that the first explanation does not
   // append to the status line.  After the explanations are done a
   // new build status line will appear.
-  if (g_explaining)
+  if (g_explaining) {
     printer_.PrintOnNewLine("");
+    last_status_line_.clear();
+  }
 }
 
 void BuildStatus::BuildStarted() {
   overall_rate_.Restart();
   current_rate_.Restart();
+  printer_.StartFrameLimiter();
 }
 
 void BuildStatus::BuildFinished() {
+  printer_.StopFrameLimiter();
   printer_.SetConsoleLocked(false);
   printer_.PrintOnNewLine("");
 }
 
-std::string BuildStatus::FormatProgressStatus(
+void BuildStatus::AppendDecimal(int value, std::string* out) {
+  char buf[16];
+  char* p = buf + sizeof(buf);
+  unsigned int v = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+  do {
+    *--p = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+  if (value < 0)
+    *--p = '-';
+  out->append(p, buf + sizeof(buf) - p);
+}
+
+void BuildStatus::AppendFixed(double value, int precision, std::string* out) {
+  // Fixed-point with round-half-up; plenty for rates and elapsed seconds.
+  static const int64_t kPow10[] = { 1, 10, 100, 1000 };
+  int64_t scaled = (int64_t)(value * kPow10[precision] + 0.5);
+  AppendDecimal((int)(scaled / kPow10[precision]), out);
+  out->push_back('.');
+  int64_t frac = scaled % kPow10[precision];
+  for (int digit = precision - 1; digit >= 0; --digit)
+    out->push_back((char)('0' + frac / kPow10[digit] % 10));
+}
+
+double BuildStatus::EstimateRemainingSeconds() const {
+  // Scale the remaining predicted work by the build's observed pace:
+  // predicted durations come from the build log, so if they are stale
+  // by a constant factor (different machine, different load, different
+  // parallelism) the ratio cancels it out.
+  double estimate = -1;
+  int64_t now_millis = GetTimeMillis() - start_time_millis_;
+  if (predicted_finished_work_millis_ > 0) {
+    int64_t remaining_millis =
+        predicted_total_work_millis_ - predicted_finished_work_millis_;
+    estimate = remaining_millis > 0
+        ? (double)now_millis * remaining_millis /
+              predicted_finished_work_millis_ / 1000.0
+        : 0.0;
+  }
+
+  // The longest chain hanging off a running edge bounds the finish from
+  // below no matter how parallel the rest is; FindWork dispatches
+  // heaviest-first, so the critical head is always among the running
+  // edges.
+  for (const auto& running : running_edges_) {
+    double chain_seconds = (running.first->critical_path_weight() -
+                            (now_millis - running.second)) / 1000.0;
+    if (chain_seconds > estimate)
+      estimate = chain_seconds;
+  }
+  return estimate;
+}
+
+std::string_view BuildStatus::FormatProgressStatus(
     const char* progress_status_format, EdgeStatus status) const {
-  std::string out;
-  char buf[32];
+  std::string& out = progress_buffer_;
+  out.clear();
   int percent;
   for (const char* s = progress_status_format; *s != '\0'; ++s) {
     if (*s == '%') {
@@ -217,14 +341,12 @@ std::string BuildStatus::FormatProgressStatus(
 
         // Started edges.
       case 's':
-        snprintf(buf, sizeof(buf), "%d", started_edges_);
-        out += buf;
+        AppendDecimal(started_edges_, &out);
         break;
 
         // Total edges.
       case 't':
-        snprintf(buf, sizeof(buf), "%d", total_edges_);
-        out += buf;
+        AppendDecimal(total_edges_, &out);
         break;
 
         // Running edges.
@@ -233,48 +355,74 @@ std::string BuildStatus::FormatProgressStatus(
         // count the edge that just finished as a running edge
         if (status == kEdgeFinished)
           running_edges++;
-        snprintf(buf, sizeof(buf), "%d", running_edges);
-        out += buf;
+        AppendDecimal(running_edges, &out);
         break;
       }
 
         // Unstarted edges.
       case 'u':
-        snprintf(buf, sizeof(buf), "%d", total_edges_ - started_edges_);
-        out += buf;
+        AppendDecimal(total_edges_ - started_edges_, &out);
         break;
 
         // Finished edges.
       case 'f':
-        snprintf(buf, sizeof(buf), "%d", finished_edges_);
-        out += buf;
+        AppendDecimal(finished_edges_, &out);
         break;
 
         // Overall finished edges per second.
       case 'o':
         overall_rate_.UpdateRate(finished_edges_);
-        SnprintfRate(overall_rate_.rate(), buf, "%.1f");
-        out += buf;
+        if (overall_rate_.rate() == -1)
+          out.push_back('?');
+        else
+          AppendFixed(overall_rate_.rate(), 1, &out);
         break;
 
         // Current rate, average over the last '-j' jobs.
       case 'c':
         current_rate_.UpdateRate(finished_edges_);
-        SnprintfRate(current_rate_.rate(), buf, "%.1f");
-        out += buf;
+        if (current_rate_.rate() == -1)
+          out.push_back('?');
+        else
+          AppendFixed(current_rate_.rate(), 1, &out);
         break;
 
         // Percentage
       case 'p':
         percent = (100 * finished_edges_) / total_edges_;
-        snprintf(buf, sizeof(buf), "%3i%%", percent);
-        out += buf;
+        if (percent < 100)
+          out.push_back(' ');
+        if (percent < 10)
+          out.push_back(' ');
+        AppendDecimal(percent, &out);
+        out.push_back('%');
+        break;
+
+      case 'e':
+        AppendFixed(overall_rate_.Elapsed(), 3, &out);
         break;
 
-      case 'e': {
-        double elapsed = overall_rate_.Elapsed();
-        snprintf(buf, sizeof(buf), "%.3f", elapsed);
-        out += buf;
+        // Estimated seconds remaining, from build-log durations.
+      case 'E': {
+        double remaining = EstimateRemainingSeconds();
+        if (remaining < 0)
+          out.push_back('?');
+        else
+          AppendFixed(remaining, 1, &out);
+        break;
+      }
+
+        // Projected wall-clock finish time (HH:MM:SS).
+      case 'F': {
+        double remaining = EstimateRemainingSeconds();
+        if (remaining < 0) {
+          out.push_back('?');
+        } else {
+          time_t finish = time(NULL) + (time_t)(remaining + 0.5);
+          char buf[16];
+          strftime(buf, sizeof(buf), "%H:%M:%S", localtime(&finish));
+          out.append(buf);
+        }
         break;
       }
 
@@ -300,9 +448,21 @@ void BuildStatus::PrintStatus(const Edge* edge, EdgeStatus status) {
   if (to_print.empty() || force_full_command)
     to_print = edge->GetBinding("command");
 
-  to_print = FormatProgressStatus(progress_status_format_, status) + to_print;
+  status_line_.clear();
+  string_append(status_line_,
+                FormatProgressStatus(progress_status_format_, status),
+                to_print);
+
+  // On a smart terminal an elided status overprints the previous one, so
+  // re-rendering an identical line is pure flicker; skip it until other
+  // output has taken over the console line.
+  if (!force_full_command && printer_.is_smart_terminal()) {
+    if (status_line_ == last_status_line_)
+      return;
+    last_status_line_ = status_line_;
+  }
 
-  printer_.Print(to_print,
+  printer_.Print(status_line_,
                  force_full_command ? LinePrinter::FULL : LinePrinter::ELIDE);
 }
 
@@ -315,14 +475,41 @@ Plan::Plan(Builder* builder)
 void Plan::Reset() {
   command_edges_ = 0;
   wanted_edges_ = 0;
+  predicted_work_ = 0;
+  finished_predicted_work_ = 0;
   ready_.clear();
   want_.clear();
+  targets_.clear();
+  memory_in_use_ = 0;
+  running_memory_.clear();
+  memory_deferred_.clear();
 }
 
 bool Plan::AddTarget(const Node* node, std::string* err) {
+  targets_.push_back(node);
   return AddSubTarget(node, nullptr, err, nullptr);
 }
 
+void Plan::BoostTarget(const Node* target) {
+  if (!target->in_edge())
+    return;
+  // The boost flag doubles as the visited marker: an already-boosted
+  // edge has had its whole input closure boosted too.
+  std::vector<Edge*> stack;
+  stack.push_back(target->in_edge());
+  while (!stack.empty()) {
+    Edge* edge = stack.back();
+    stack.pop_back();
+    if (edge->priority_boost_)
+      continue;
+    edge->priority_boost_ = true;
+    for (Node* input : edge->inputs_) {
+      if (input->in_edge())
+        stack.push_back(input->in_edge());
+    }
+  }
+}
+
 bool Plan::AddSubTarget(const Node* node, const Node* dependent, std::string* err,
                         std::set<Edge*>* dyndep_walk) {
   Edge* edge = node->in_edge();
@@ -386,13 +573,175 @@ void Plan::EdgeWanted(const Edge* edge) {
     ++command_edges_;
 }
 
+/// The batching limit of \a edge from its "batch" binding, or 1 when the
+/// edge must run alone: the command has to be a pure $in/$out template
+/// (so concatenation is meaningful) and must not use a console, rspfile
+/// or dependency extraction, which are all inherently per-invocation.
+static int EdgeBatchLimit(Edge* edge) {
+  if (edge->is_phony() || edge->use_console())
+    return 1;
+  if (!edge->rule().command_spliceable() || edge->env_->HasBinding("command"))
+    return 1;
+  std::string limit = edge->GetBinding("batch");
+  if (limit.empty())
+    return 1;
+  if (!edge->GetBinding("deps").empty() ||
+      !edge->GetUnescapedDepfile().empty() ||
+      !edge->GetUnescapedRspfile().empty())
+    return 1;
+  int parsed = atoi(limit.c_str());
+  return parsed > 1 ? parsed : 1;
+}
+
+void Plan::CollectBatch(Edge* first, int limit, std::vector<Edge*>* batch) {
+  batch->push_back(first);
+  if (memory_budget_ > 0)
+    return;
+  std::vector<Edge*> put_back;
+  while ((int)batch->size() < limit) {
+    Edge* edge = ready_.pop();
+    if (!edge)
+      break;
+    if (&edge->rule() == &first->rule() && EdgeBatchLimit(edge) > 1)
+      batch->push_back(edge);
+    else
+      put_back.push_back(edge);
+  }
+  for (Edge* edge : put_back)
+    ready_.push(edge);
+}
+
 Edge* Plan::FindWork() {
-  if (ready_.empty())
-    return nullptr;
-  std::set<Edge*>::iterator e = ready_.begin();
-  Edge* edge = *e;
-  ready_.erase(e);
-  return edge;
+  Edge* edge = ready_.pop();
+  if (memory_budget_ <= 0)
+    return edge;
+  // In a real build (not a test driving the plan directly), also hold
+  // back annotated edges that would not fit in the memory actually
+  // available right now: the budget is static, the machine is not.
+  int64_t available = -1;
+  if (builder_)
+    available = ResourceSampler::Shared()->Get().available_memory;
+  while (edge) {
+    int64_t estimate = EdgeMemoryEstimate(edge);
+    // Always let an edge run on an otherwise idle budget, so a single
+    // estimate larger than the whole budget cannot wedge the build.
+    if (estimate == 0 || memory_in_use_ == 0 ||
+        (memory_in_use_ + estimate <= memory_budget_ &&
+         (available < 0 || estimate <= available))) {
+      if (estimate > 0) {
+        running_memory_[edge] = estimate;
+        memory_in_use_ += estimate;
+      }
+      return edge;
+    }
+    // Over budget; park it until a running edge frees some.
+    memory_deferred_.push_back(edge);
+    edge = ready_.pop();
+  }
+  return nullptr;
+}
+
+// static
+int64_t Plan::EdgeMemoryEstimate(Edge* edge) {
+  if (edge->is_phony())
+    return 0;
+  std::string value = edge->GetBinding("expected_memory");
+  if (value.empty())
+    return 0;
+  int64_t size = ParseByteSize(value);
+  // An unparsable estimate exempts the edge, as if unannotated.
+  return size < 0 ? 0 : size;
+}
+
+void Plan::PrepareQueue(BuildLog* build_log) {
+  METRIC_RECORD("prepare queue");
+  if (builder_)
+    memory_budget_ = builder_->config_.memory_budget;
+  ComputeCriticalPath(build_log);
+  // Edges already scheduled before the weights existed (and pool-delayed
+  // edges released since) were queued with equal weights; rebuild the
+  // heap around the computed ones.
+  ready_.Reorder();
+}
+
+// static
+int64_t Plan::EdgeWeightHeuristic(const Edge* edge, BuildLog* build_log) {
+  if (edge->is_phony())
+    return 0;
+  if (build_log) {
+    if (BuildLog::LogEntry* entry =
+            build_log->LookupByOutput(edge->outputs_[0]->path())) {
+      int64_t duration = entry->end_time - entry->start_time;
+      if (duration > 0)
+        return duration;
+    }
+  }
+  // No history for this edge yet: a nominal cost so that deeper chains
+  // still outweigh shallow ones.
+  return 1;
+}
+
+void Plan::ComputeCriticalPath(BuildLog* build_log) {
+  METRIC_RECORD("critical path");
+
+  // Topologically sort every edge reachable from the targets with an
+  // explicit DFS stack: producers end up before their consumers.  The
+  // scan already rejected cycles, and the seen set keeps the walk linear
+  // regardless.
+  struct Frame {
+    Edge* edge;
+    size_t next_input;
+  };
+  std::vector<Edge*> sorted;
+  std::unordered_set<const Edge*> seen;
+  std::vector<Frame> stack;
+  auto visit = [&seen, &stack](const Node* node) {
+    Edge* edge = node->in_edge();
+    if (edge && seen.insert(edge).second)
+      stack.push_back({ edge, 0 });
+  };
+  for (const Node* target : targets_)
+    visit(target);
+  while (!stack.empty()) {
+    Frame& frame = stack.back();
+    if (frame.next_input < frame.edge->inputs_.size()) {
+      visit(frame.edge->inputs_[frame.next_input++]);
+      continue;
+    }
+    sorted.push_back(frame.edge);
+    stack.pop_back();
+  }
+
+  for (Edge* edge : sorted) {
+    int64_t duration = EdgeWeightHeuristic(edge, build_log);
+    edge->set_predicted_duration(duration);
+    edge->set_critical_path_weight(duration);
+  }
+
+  // Propagate weights from consumers down to producers.  Reverse order
+  // processes every consumer before its producers, so each edge's weight
+  // is final when its producers are relaxed.
+  for (std::vector<Edge*>::reverse_iterator it = sorted.rbegin();
+       it != sorted.rend(); ++it) {
+    Edge* edge = *it;
+    for (Node* input : edge->inputs_) {
+      Edge* producer = input->in_edge();
+      if (!producer)
+        continue;
+      int64_t candidate = edge->critical_path_weight() +
+                          producer->predicted_duration();
+      if (candidate > producer->critical_path_weight())
+        producer->set_critical_path_weight(candidate);
+    }
+  }
+
+  // Snapshot the plan's total predicted work for the status line's
+  // remaining-time estimate: work already retired plus the freshly
+  // re-predicted cost of everything still wanted (running included).
+  predicted_work_ = finished_predicted_work_;
+  for (const auto& want_entry : want_)
+    if (want_entry.second != kWantNothing)
+      predicted_work_ += want_entry.first->predicted_duration();
 }
 
 void Plan::ScheduleWork(std::map<Edge*, Want>::iterator want_e) {
@@ -407,6 +756,8 @@ void Plan::ScheduleWork(std::map<Edge*, Want>::iterator want_e) {
   want_e->second = kWantToFinish;
 
   Edge* edge = want_e->first;
+  if (g_event_trace && !edge->is_phony())
+    g_event_trace->EdgeQueued(edge);
   if(Pool* pool = edge->pool();
      pool->ShouldDelayEdge())
   {
@@ -416,15 +767,34 @@ void Plan::ScheduleWork(std::map<Edge*, Want>::iterator want_e) {
   else
   {
     pool->EdgeScheduled(*edge);
-    ready_.insert(edge);
+    ready_.push(edge);
   }
 }
 
 bool Plan::EdgeFinished(Edge* edge, EdgeResult result, std::string* err) {
+  // Release the edge's memory reservation, and requeue edges that were
+  // set aside for exceeding the budget now that some has freed up.
+  if (memory_budget_ > 0) {
+    std::map<Edge*, int64_t>::iterator mem = running_memory_.find(edge);
+    if (mem != running_memory_.end()) {
+      memory_in_use_ -= mem->second;
+      running_memory_.erase(mem);
+      for (const auto & deferred : memory_deferred_)
+        ready_.push(deferred);
+      memory_deferred_.clear();
+    }
+  }
+
   std::map<Edge*, Want>::iterator e = want_.find(edge);
   assert(e != want_.end());
   bool directly_wanted = e->second != kWantNothing;
 
+  // Move the edge's predicted cost to the retired side of the
+  // predicted-work snapshot (see ComputeCriticalPath), mirroring the
+  // status code's per-edge progress accumulation.
+  if (directly_wanted)
+    finished_predicted_work_ += edge->predicted_duration();
+
   // See if this job frees up any delayed jobs.
   if (directly_wanted)
     edge->pool()->EdgeFinished(*edge);
@@ -514,7 +884,7 @@ bool Plan::CleanNode(DependencyScan* scan, Node* node, std::string* err) {
     if (std::find_if(begin, end, std::mem_fn(&Node::dirty)) == end) {
       // Recompute most_recent_input.
       Node* most_recent_input = nullptr;
-      for (std::vector<Node*>::iterator i = begin; i != end; ++i) {
+      for (Edge::Nodes::iterator i = begin; i != end; ++i) {
         if (!most_recent_input || (*i)->mtime() > most_recent_input->mtime())
           most_recent_input = *i;
       }
@@ -578,13 +948,23 @@ bool Plan::DyndepsLoaded(DependencyScan* scan, const Node* node,
 
   // Walk dyndep-discovered portion of the graph to add it to the build plan.
   std::set<Edge*> dyndep_walk;
+  bool reboosted = false;
   for (auto const& oe : dyndep_roots) {
     for (auto const& item : oe->second.implicit_inputs_) {
+      // Keep the boost invariant: newly discovered inputs of an edge in
+      // a boosted target's closure are part of that closure too.
+      if (oe->first->priority_boost_ && item->in_edge() &&
+          !item->in_edge()->priority_boost_) {
+        BoostTarget(item);
+        reboosted = true;
+      }
       if (!AddSubTarget(item, oe->first->outputs_[0], err, &dyndep_walk) &&
           !err->empty())
         return false;
     }
   }
+  if (reboosted)
+    ready_.Reorder();
 
   // Add out edges from this node that are in the plan (just as
   // Plan::NodeFinished would have without taking the dyndep code path).
@@ -674,7 +1054,20 @@ void Plan::Dump() const {
 }
 
 struct RealCommandRunner final : public CommandRunner {
-  explicit RealCommandRunner(const BuildConfig& config) : config_(config) {}
+  RealCommandRunner(const BuildConfig& config, BuildStatus* status)
+      : config_(config), status_(status) {
+    // Share one -j budget with nested make/ninja layers: join the
+    // jobserver we were started under, or start serving our own
+    // parallelism to subcommands.  (-j0 has no budget to serve.)
+    if (!jobserver_.AdoptFromEnvironment() && config_.parallelism > 1 &&
+        config_.parallelism < INT_MAX) {
+      std::string err;
+      if (!jobserver_.Setup(config_.parallelism, &err))
+        Warning("failed to set up jobserver: %s", err.c_str());
+    }
+    if (config_.max_load_average > 0.0f)
+      governor_.Enable(config_.parallelism, config_.max_load_average);
+  }
   ~RealCommandRunner() = default;
   bool CanRunMore() const override final;
   bool StartCommand(Edge* edge) override final;
@@ -683,8 +1076,25 @@ struct RealCommandRunner final : public CommandRunner {
   void Abort() override final;
 
   const BuildConfig& config_;
+  /// For interleaving live output of streaming edges; see StartCommand.
+  BuildStatus* status_;
   SubprocessSet subprocs_;
+#ifndef _WIN32
+  /// Long-lived processes for rules with a "worker_command" binding;
+  /// declared after subprocs_ so workers are torn down first.
+  PersistentWorkerPool workers_{ &subprocs_ };
+#endif
   std::map<const Subprocess*, Edge*> subproc_to_edge_;
+  /// Governs the effective -j cap while -l is in effect; replaces the
+  /// lagging load-average comparison with sub-second feedback.
+  mutable ParallelismGovernor governor_;
+  /// Running edges whose "concurrency" binding is "io"; they hold a
+  /// slot outside the governed CPU budget.
+  int io_running_ = 0;
+  mutable Jobserver jobserver_;
+  /// A jobserver token acquired by CanRunMore and not yet consumed by a
+  /// StartCommand; kept across passes where the plan had no ready edge.
+  mutable bool token_ready_ = false;
 };
 
 std::vector<Edge*> RealCommandRunner::GetActiveEdges() {
@@ -693,32 +1103,215 @@ std::vector<Edge*> RealCommandRunner::GetActiveEdges() {
   {
     edges.push_back(edge);
   }
+#ifndef _WIN32
+  std::vector<Edge*> worker_edges = workers_.GetActiveEdges();
+  edges.insert(edges.end(), worker_edges.begin(), worker_edges.end());
+#endif
   return edges;
 }
 
 void RealCommandRunner::Abort() {
+#ifndef _WIN32
+  workers_.Clear();
+#endif
   subprocs_.Clear();
 }
 
 bool RealCommandRunner::CanRunMore() const {
   std::size_t subproc_number =
       subprocs_.running_.size() + subprocs_.finished_.size();
-  return (int)subproc_number < config_.parallelism
-    && ((subprocs_.running_.empty() || config_.max_load_average <= 0.0f)
-        || GetLoadAverage() < config_.max_load_average);
+#ifndef _WIN32
+  subproc_number += workers_.in_flight();
+#endif
+  if ((int)subproc_number >= config_.parallelism)
+    return false;
+  // Under -l, cap dispatch at the governor's continuously adjusted
+  // parallelism instead of the minute-lagged load average.  IO-bound
+  // jobs widen the cap: they wait on disk, not cores.  Always let one
+  // job run.
+  if (governor_.enabled() && !subprocs_.running_.empty() &&
+      (int)subproc_number >= governor_.EffectiveParallelism() + io_running_)
+    return false;
+  // Hold a jobserver token before dispatching another job, so the whole
+  // process tree stays within one budget.
+  if (jobserver_.enabled() && !token_ready_)
+    token_ready_ = jobserver_.Acquire();
+  return !jobserver_.enabled() || token_ready_;
 }
 
 bool RealCommandRunner::StartCommand(Edge* edge) {
   std::string command = edge->EvaluateCommand();
+  // When the rspfile was spooled onto tmpfs, point the command at the
+  // spooled copy.  Only the spawned command string is rewritten -- the
+  // edge's bindings must stay untouched, since the build log hashes
+  // EvaluateCommand() and a per-run spool path would dirty every edge.
+  if (RspfileSpool* spool = RspfileSpool::Get()) {
+    const std::string& rspfile = edge->GetUnescapedRspfile();
+    if (!rspfile.empty()) {
+      std::string spooled = spool->PathFor(rspfile);
+      if (!spooled.empty()) {
+        for (size_t pos = 0;
+             (pos = command.find(rspfile, pos)) != std::string::npos;
+             pos += spooled.size())
+          command.replace(pos, rspfile.size(), spooled);
+      }
+    }
+
+    // Depfiles go the other way: point the compiler's -MF at the spool
+    // so deps extraction reads it from tmpfs and the .d file never
+    // touches the output filesystem.  Only deps=gcc qualifies (without
+    // "deps" the .d must persist for the next scan), and only when the
+    // command really names the depfile -- a compiler left to derive the
+    // location itself must keep writing where the manifest says.
+    if (!g_keep_depfile && edge->GetBinding("deps") == "gcc") {
+      if (std::string depfile = edge->GetUnescapedDepfile();
+          !depfile.empty() && command.find(depfile) != std::string::npos) {
+        std::string spooled = spool->Map(depfile);
+        for (size_t pos = 0;
+             (pos = command.find(depfile, pos)) != std::string::npos;
+             pos += spooled.size())
+          command.replace(pos, depfile.size(), spooled);
+      }
+    }
+  }
+#ifndef _WIN32
+  std::string worker_command = edge->GetBinding("worker_command");
+  if (!worker_command.empty() && !edge->use_console()) {
+    if (!workers_.Submit(worker_command, command, edge))
+      return false;
+    token_ready_ = false;
+    return true;
+  }
+#endif
   Subprocess* subproc = subprocs_.Add(command, edge->use_console());
   if (!subproc)
     return false;
+  // Rules with a "stream" binding get their output interleaved live
+  // instead of buffered until completion; a 40-minute link is no longer
+  // a silent black box and its log never accumulates in memory.  Edges
+  // whose output feeds "deps" parsing must stay buffered, and console
+  // edges already own the terminal.
+  if (status_ && !edge->use_console() &&
+      !edge->GetBinding("stream").empty() &&
+      edge->GetBinding("deps").empty()) {
+    subproc->set_output_callback([this, edge](const char* data, size_t len) {
+      status_->BuildEdgeStreamedOutput(edge, data, len);
+    });
+  }
+#ifdef __linux__
+  // Per-rule NUMA/cgroup placement: pin a rule class to a socket with
+  // "cpu_affinity", or cap it with a pre-made cgroup so a runaway edge
+  // fails alone instead of taking the machine down.
+  std::string cpu_affinity = edge->GetBinding("cpu_affinity");
+  std::string cgroup = edge->GetBinding("cgroup");
+  if (!cpu_affinity.empty() || !cgroup.empty())
+    subproc->SetPlacement(cpu_affinity, cgroup);
+#endif
   subproc_to_edge_.emplace(subproc, edge);
+  if (edge->GetBinding("concurrency") == "io")
+    ++io_running_;
+  // The job now owns the token CanRunMore acquired; it is given back in
+  // WaitForCommand when the job is reaped.
+  token_ready_ = false;
 
   return true;
 }
 
 bool RealCommandRunner::WaitForCommand(Result* result) {
+  Subprocess* subproc;
+  while ((subproc = subprocs_.NextFinished()) == nullptr) {
+#ifndef _WIN32
+    PersistentWorkerPool::Response response;
+    if (workers_.NextFinished(&response)) {
+      result->status = response.status;
+      result->output = std::move(response.output);
+      result->edge = response.edge;
+      if (jobserver_.enabled())
+        jobserver_.Release();
+      return true;
+    }
+#endif
+    bool interrupted = subprocs_.DoWork();
+    if (interrupted)
+      return false;
+  }
+
+  result->status = subproc->Finish();
+  result->output = subproc->GetOutput();
+  result->user_time_millis = subproc->user_time_millis();
+  result->system_time_millis = subproc->system_time_millis();
+  result->peak_rss_kb = subproc->peak_rss_kb();
+
+  std::map<const Subprocess*, Edge*>::iterator e = subproc_to_edge_.find(subproc);
+  result->edge = e->second;
+  subproc_to_edge_.erase(e);
+  if (result->edge->GetBinding("concurrency") == "io")
+    --io_running_;
+
+  if (jobserver_.enabled())
+    jobserver_.Release();
+
+  delete subproc;
+  return true;
+}
+
+/// Ships eligible edges to a remote execution service by prefixing their
+/// commands with BuildConfig::remote_wrapper (a rewrapper-style client
+/// that uploads inputs by digest, runs the action remotely and fetches
+/// the declared outputs); the wrapper itself is a cheap local process
+/// that blocks on the service, so hundreds may be in flight.  Edges with
+/// a true "local" binding and console edges fall back to plain local
+/// execution.
+struct RemoteCommandRunner final : public CommandRunner {
+  explicit RemoteCommandRunner(const BuildConfig& config) : config_(config) {}
+  ~RemoteCommandRunner() = default;
+  bool CanRunMore() const override final;
+  bool StartCommand(Edge* edge) override final;
+  bool WaitForCommand(Result* result) override final;
+  std::vector<Edge*> GetActiveEdges() override final;
+  void Abort() override final;
+
+  const BuildConfig& config_;
+  SubprocessSet subprocs_;
+  std::map<const Subprocess*, Edge*> subproc_to_edge_;
+};
+
+std::vector<Edge*> RemoteCommandRunner::GetActiveEdges() {
+  std::vector<Edge*> edges;
+  for (auto const& [subproc, edge] : subproc_to_edge_)
+  {
+    edges.push_back(edge);
+  }
+  return edges;
+}
+
+void RemoteCommandRunner::Abort() {
+  subprocs_.Clear();
+}
+
+bool RemoteCommandRunner::CanRunMore() const {
+  // Remote actions wait on the service, not on this machine, so the cap
+  // is the remote in-flight budget and the load average does not apply.
+  // Local-fallback edges share the cap; they are expected to be the
+  // rare console/codegen stragglers.
+  std::size_t subproc_number =
+      subprocs_.running_.size() + subprocs_.finished_.size();
+  return (int)subproc_number < config_.remote_parallelism;
+}
+
+bool RemoteCommandRunner::StartCommand(Edge* edge) {
+  std::string command = edge->EvaluateCommand();
+  if (!edge->use_console() && !edge->GetBindingBool("local"))
+    command = string_concat(config_.remote_wrapper, " ", command);
+  Subprocess* subproc = subprocs_.Add(command, edge->use_console());
+  if (!subproc)
+    return false;
+  subproc_to_edge_.emplace(subproc, edge);
+
+  return true;
+}
+
+bool RemoteCommandRunner::WaitForCommand(Result* result) {
   Subprocess* subproc;
   while ((subproc = subprocs_.NextFinished()) == nullptr) {
     bool interrupted = subprocs_.DoWork();
@@ -728,6 +1321,9 @@ bool RealCommandRunner::WaitForCommand(Result* result) {
 
   result->status = subproc->Finish();
   result->output = subproc->GetOutput();
+  result->user_time_millis = subproc->user_time_millis();
+  result->system_time_millis = subproc->system_time_millis();
+  result->peak_rss_kb = subproc->peak_rss_kb();
 
   std::map<const Subprocess*, Edge*>::iterator e = subproc_to_edge_.find(subproc);
   result->edge = e->second;
@@ -745,6 +1341,8 @@ Builder::Builder(State* state, const BuildConfig& config,
       scan_(state, build_log, deps_log, disk_interface,
             &config_.depfile_parser_options) {
   status_ = new BuildStatus(config);
+  if (!config.action_cache_dir.empty() && !config.dry_run)
+    action_cache_.reset(new ActionCache(config.action_cache_dir));
 }
 
 Builder::~Builder() {
@@ -754,6 +1352,15 @@ Builder::~Builder() {
 void Builder::Cleanup() {
   if (command_runner_.get()) {
     std::vector<Edge*> active_edges = command_runner_->GetActiveEdges();
+    // The runner only knows the lead edge of a batched invocation;
+    // clean up the other members' outputs too.
+    for (auto const& [lead, batch] : running_batches_) {
+      for (const auto & member : batch)
+      {
+        if (member != lead)
+          active_edges.push_back(member);
+      }
+    }
     command_runner_->Abort();
 
     for (const auto & item : active_edges)
@@ -769,11 +1376,11 @@ void Builder::Cleanup() {
         // mentioned in a depfile, and the command touches its depfile
         // but is interrupted before it touches its output file.)
         std::string err;
-        TimeStamp new_mtime = disk_interface_->Stat(inner->path(), &err);
+        TimeStamp new_mtime = disk_interface_->Stat(std::string(inner->path()), &err);
         if (new_mtime == -1)  // Log and ignore Stat() errors.
           Error("%s", err.c_str());
         if (!depfile.empty() || inner->mtime() != new_mtime)
-          disk_interface_->RemoveFile(inner->path());
+          disk_interface_->RemoveFile(std::string(inner->path()));
       }
       if (!depfile.empty())
         disk_interface_->RemoveFile(depfile);
@@ -822,10 +1429,423 @@ bool Builder::AlreadyUpToDate() const {
   return !plan_.more_to_do();
 }
 
+bool Builder::ScanQueuedTarget(std::string* err) {
+  METRIC_RECORD("pipelined scan");
+  Node* node = queued_targets_.front();
+  queued_targets_.pop_front();
+  if (!AddTarget(node, err))
+    return err->empty();  // An already-up-to-date target is not an error.
+  // The new subgraph's edges were admitted without critical-path
+  // weights; recompute them so dispatch order stays duration-driven.
+  plan_.PrepareQueue(scan_.build_log());
+  status_->PlanHasTotalEdges(plan_.command_edge_count());
+  status_->PlanHasPredictedWork(plan_.predicted_work());
+  return true;
+}
+
+/// Whether \a edge's outcome can be cached: console edges are
+/// interactive, and generator edges rewrite the manifest and are
+/// expected to always run.
+static bool ActionCacheEligible(const Edge* edge) {
+  return !edge->use_console() && !edge->GetBindingBool("generator");
+}
+
+bool Builder::RestoreFromActionCache(Edge* edge, bool* restored,
+                                     std::string* err) {
+  *restored = false;
+  if (!ActionCacheEligible(edge))
+    return true;
+  METRIC_RECORD("action cache lookup");
+
+  ActionCache::Key key;
+  key.command_hash =
+      BuildLog::LogEntry::HashCommand(edge->EvaluateCommand(true));
+  key.input_hash = scan_.HashInputContents(edge, nullptr);
+  if (!action_cache_->Contains(key))
+    return true;
+
+  for (const auto & item : edge->outputs_)
+    if (!disk_interface_->MakeDirs(std::string(item->path())))
+      return true;  // Let the normal dispatch path report the failure.
+  std::vector<std::string> outputs;
+  outputs.reserve(edge->outputs_.size());
+  for (const auto & item : edge->outputs_)
+    outputs.push_back(std::string(item->path()));
+  std::vector<std::string> deps_paths;
+  if (!action_cache_->Restore(key, outputs, &deps_paths)) {
+    // A damaged entry reads as a miss; the command reruns and re-stores.
+    return true;
+  }
+
+  status_->BuildEdgeStarted(edge);
+  restored_deps_.clear();
+  restored_deps_.reserve(deps_paths.size());
+  for (const auto & path : deps_paths)
+    restored_deps_.push_back(state_->GetNode(path, ~0u));
+
+  CommandRunner::Result result;
+  result.edge = edge;
+  result.status = ExitSuccess;
+  restoring_from_cache_ = true;
+  bool finished = FinishCommand(&result, err);
+  restoring_from_cache_ = false;
+  if (!finished)
+    return false;
+  *restored = true;
+  return true;
+}
+
+bool Builder::RunBuiltinCopy(Edge* edge, bool* success, std::string* err) {
+  METRIC_RECORD("builtin copy");
+  status_->BuildEdgeStarted(edge);
+
+  CommandRunner::Result result;
+  result.edge = edge;
+  result.status = ExitSuccess;
+
+  size_t explicit_ins =
+      edge->inputs_.size() - edge->implicit_deps_ - edge->order_only_deps_;
+  size_t explicit_outs = edge->outputs_.size() - edge->implicit_outs_;
+  if (explicit_ins != 1 || explicit_outs != 1) {
+    result.status = ExitFailure;
+    result.output = "builtin = copy requires exactly one explicit input "
+                    "and one explicit output";
+  } else {
+    std::string out_path(edge->outputs_[0]->path());
+    if (std::string copy_err; !disk_interface_->MakeDirs(out_path)) {
+      result.status = ExitFailure;
+      result.output = string_concat("creating directory for ", out_path);
+    } else if (!CopyFileContents(std::string(edge->inputs_[0]->path()),
+                                 out_path, &copy_err)) {
+      result.status = ExitFailure;
+      result.output = copy_err;
+    }
+  }
+
+  if (!FinishCommand(&result, err))
+    return false;
+  *success = result.success();
+  return true;
+}
+
+void Builder::StoreToActionCache(Edge* edge,
+                                 const std::vector<Node*>& deps_nodes) {
+  if (!ActionCacheEligible(edge))
+    return;
+  METRIC_RECORD("action cache store");
+
+  // The key folds the freshly discovered deps into the input hash; the
+  // next scan loads them from the deps log into inputs_, and the XOR
+  // combination in HashInputContents makes the two lists agree.
+  ActionCache::Key key;
+  key.command_hash =
+      BuildLog::LogEntry::HashCommand(edge->EvaluateCommand(true));
+  key.input_hash = scan_.HashInputContents(edge, &deps_nodes);
+  std::vector<std::string> outputs;
+  outputs.reserve(edge->outputs_.size());
+  for (const auto & item : edge->outputs_)
+    outputs.push_back(std::string(item->path()));
+  std::vector<std::string> deps;
+  deps.reserve(deps_nodes.size());
+  for (const auto & item : deps_nodes)
+    deps.push_back(std::string(item->path()));
+  // Best effort: a full disk or unwritable cache must not fail the build.
+  action_cache_->Store(key, outputs, deps);
+}
+
+/// A small worker pool running completion preprocessing: depfile reads
+/// and parses and restat stats execute here while the main thread keeps
+/// dispatching.  Only the disk interface is touched off-thread; see
+/// Builder::PreprocessCompletion.
+struct CompletionPool {
+  explicit CompletionPool(int threads) {
+    for (int i = 0; i < threads; ++i)
+      threads_.emplace_back([this]() { Run(); });
+  }
+
+  ~CompletionPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      shutdown_ = true;
+    }
+    cv_.notify_all();
+    for (std::thread& thread : threads_)
+      thread.join();
+  }
+
+  void Submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+  }
+
+ private:
+  void Run() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return shutdown_ || !tasks_.empty(); });
+        if (tasks_.empty())
+          return;
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  std::vector<std::thread> threads_;
+  bool shutdown_ = false;
+};
+
+namespace {
+
+/// A persistent "-t msvc -s" helper (msvc_helper_main-win32.cc) appends
+/// its dependency list to the command output as "<<<dep PATH" records,
+/// one per line.  Split them out of \a output; the paths were filtered
+/// and normalized by the helper while the compiler was still running, so
+/// they feed the deps log directly without a CLParser pass here.
+/// Returns false, leaving \a output untouched, if there are no records.
+bool ExtractStreamedMSVCDeps(std::string* output,
+                             std::vector<std::string>* deps) {
+  if (output->find("<<<dep ") == std::string::npos)
+    return false;
+  std::string kept;
+  kept.reserve(output->size());
+  size_t pos = 0;
+  while (pos < output->size()) {
+    size_t nl = output->find('\n', pos);
+    size_t next = nl == std::string::npos ? output->size() : nl + 1;
+    std::string_view line(output->data() + pos,
+                          (nl == std::string::npos ? output->size() : nl) -
+                              pos);
+    if (!line.empty() && line.back() == '\r')
+      line.remove_suffix(1);
+    if (line.substr(0, 7) == "<<<dep ")
+      deps->emplace_back(line.substr(7));
+    else
+      kept.append(*output, pos, next - pos);
+    pos = next;
+  }
+  output->swap(kept);
+  return true;
+}
+
+}  // namespace
+
+/// Everything one reaped command needs for its completion.  The strings
+/// are captured on the main thread at enqueue; the parse/stat results
+/// are produced by PreprocessCompletion (possibly off-thread) and
+/// consumed by FinishCommand via current_work_.
+struct Builder::CompletionWork {
+  CommandRunner::Result result;
+
+  // Captured at enqueue time so the worker never touches graph state.
+  std::string deps_type;
+  std::string deps_prefix;
+  std::string depfile;
+  std::vector<std::string> output_paths;
+
+  // Parse results.
+  bool parse_ok = true;
+  std::string parse_err;
+  bool output_filtered = false;
+  std::string filtered_output;
+  std::vector<std::string> dep_paths;
+  std::vector<uint64_t> dep_slash_bits;
+
+  // Output pre-stats, parallel to output_paths.
+  bool stat_ok = true;
+  std::string stat_err;
+  std::vector<TimeStamp> output_mtimes;
+
+  /// Completed when PreprocessCompletion has run.
+  std::future<void> done;
+};
+
+void Builder::PreprocessCompletion(CompletionWork* work) {
+  if (work->deps_type == "msvc") {
+    std::vector<std::string> streamed;
+    if (ExtractStreamedMSVCDeps(&work->result.output, &streamed)) {
+      // A persistent helper parsed the deps while the compiler ran.
+      for (auto & item : streamed) {
+        work->dep_paths.emplace_back(std::move(item));
+        work->dep_slash_bits.push_back(~0u);
+      }
+    } else {
+      CLParser parser;
+      work->parse_ok = parser.Parse(work->result.output, work->deps_prefix,
+                                    &work->filtered_output, &work->parse_err);
+      work->output_filtered = work->parse_ok;
+      if (work->parse_ok) {
+        for (const auto & item : parser.includes_) {
+          work->dep_paths.push_back(item);
+          // ~0 is assuming that with MSVC-parsed headers, it's ok to
+          // always make all backslashes; see ExtractDeps.
+          work->dep_slash_bits.push_back(~0u);
+        }
+      }
+    }
+  } else if (work->deps_type == "gcc") {
+    do {
+      if (work->depfile.empty()) {
+        work->parse_ok = false;
+        work->parse_err = "edge with deps=gcc but no depfile makes no sense";
+        break;
+      }
+      std::string content;
+      switch (disk_interface_->ReadFile(work->depfile, &content,
+                                        &work->parse_err)) {
+      case DiskInterface::Okay:
+        break;
+      case DiskInterface::NotFound:
+        work->parse_err.clear();
+        break;
+      case DiskInterface::OtherError:
+        work->parse_ok = false;
+        break;
+      }
+      if (!work->parse_ok || content.empty())
+        break;
+
+      DepfileParser deps(config_.depfile_parser_options);
+      if (!deps.Parse(&content, &work->parse_err)) {
+        work->parse_ok = false;
+        break;
+      }
+      work->dep_paths.reserve(deps.ins_.size());
+      work->dep_slash_bits.reserve(deps.ins_.size());
+      for (auto & item : deps.ins_) {
+        uint64_t slash_bits;
+        std::size_t size = item.size();
+        if (!CanonicalizePath(const_cast<char*>(item.data()), &size,
+                              &slash_bits, &work->parse_err)) {
+          work->parse_ok = false;
+          break;
+        }
+        work->dep_paths.emplace_back(item.substr(0, size));
+        work->dep_slash_bits.push_back(slash_bits);
+      }
+      if (!work->parse_ok)
+        break;
+
+      if (!g_keep_depfile && disk_interface_->RemoveFile(work->depfile) < 0) {
+        work->parse_ok = false;
+        work->parse_err =
+            string_concat("deleting depfile: ", strerror(errno), "\n");
+      }
+    } while (false);
+  }
+
+  // Pre-stat the outputs for the restat/deps-recording paths; only for
+  // successful commands, mirroring FinishCommand.
+  if (work->result.success() && !config_.dry_run) {
+    work->output_mtimes.reserve(work->output_paths.size());
+    for (const auto & path : work->output_paths) {
+      TimeStamp mtime = disk_interface_->Stat(path, &work->stat_err);
+      if (mtime == -1) {
+        work->stat_ok = false;
+        break;
+      }
+      work->output_mtimes.push_back(mtime);
+    }
+  }
+}
+
+bool Builder::ExtractDepsFromWork(CommandRunner::Result* result,
+                                  const CompletionWork& work,
+                                  std::vector<Node*>* deps_nodes,
+                                  std::string* err) {
+  if (work.output_filtered)
+    result->output = work.filtered_output;
+  if (!work.parse_ok) {
+    *err = work.parse_err;
+    return false;
+  }
+  deps_nodes->reserve(work.dep_paths.size());
+  for (size_t i = 0; i < work.dep_paths.size(); ++i)
+    deps_nodes->push_back(
+        state_->GetNode(work.dep_paths[i], work.dep_slash_bits[i]));
+  return true;
+}
+
+void Builder::EnqueueCompletion(CommandRunner::Result* result) {
+  std::unique_ptr<CompletionWork> work(new CompletionWork);
+  work->result = std::move(*result);
+
+  Edge* edge = work->result.edge;
+  work->deps_type = edge->GetBinding("deps");
+  work->deps_prefix = edge->GetBinding("msvc_deps_prefix");
+  work->depfile = edge->GetUnescapedDepfile();
+  // Resolve a spooled depfile here on the build loop thread; the pool
+  // thread then works with a plain path and never touches the spool.
+  if (RspfileSpool* spool = RspfileSpool::Get();
+      spool && !work->depfile.empty()) {
+    if (std::string spooled = spool->PathFor(work->depfile);
+        !spooled.empty())
+      work->depfile = spooled;
+  }
+  for (const auto & output : edge->outputs_)
+    work->output_paths.emplace_back(output->path());
+
+  if (completion_pool_) {
+    std::shared_ptr<std::packaged_task<void()>> task(
+        new std::packaged_task<void()>(
+            [this, raw = work.get()]() { PreprocessCompletion(raw); }));
+    work->done = task->get_future();
+    completion_pool_->Submit([task]() { (*task)(); });
+  } else {
+    PreprocessCompletion(work.get());
+  }
+  pending_completions_.push_back(std::move(work));
+}
+
+bool Builder::ProcessCompletions(int pending_commands, int* failures_allowed,
+                                 std::string* err) {
+  while (!pending_completions_.empty()) {
+    CompletionWork* front = pending_completions_.front().get();
+    // Block on the oldest only when nothing else can make progress or
+    // the queue has grown past the in-flight window; otherwise finish
+    // just the ones whose preprocessing is already done.
+    if (front->done.valid()) {
+      bool must_wait =
+          pending_commands == 0 ||
+          (int)pending_completions_.size() > config_.parallelism;
+      if (!must_wait &&
+          front->done.wait_for(std::chrono::seconds(0)) !=
+              std::future_status::ready)
+        break;
+      front->done.get();
+    }
+
+    std::unique_ptr<CompletionWork> work =
+        std::move(pending_completions_.front());
+    pending_completions_.pop_front();
+
+    current_work_ = work.get();
+    bool ok = FinishCommand(&work->result, err);
+    current_work_ = nullptr;
+    if (!ok)
+      return false;
+
+    if (!work->result.success() && *failures_allowed)
+      --*failures_allowed;
+  }
+  return true;
+}
+
 bool Builder::Build(std::string* err) {
-  assert(!AlreadyUpToDate());
+  assert(!AlreadyUpToDate() || HasQueuedTargets());
+  plan_.PrepareQueue(scan_.build_log());
 
   status_->PlanHasTotalEdges(plan_.command_edge_count());
+  status_->PlanHasPredictedWork(plan_.predicted_work());
   int pending_commands = 0;
   int failures_allowed = config_.failures_allowed;
 
@@ -833,8 +1853,21 @@ bool Builder::Build(std::string* err) {
   if (!command_runner_.get()) {
     if (config_.dry_run)
       command_runner_.reset(new DryRunCommandRunner);
+    else if (!config_.remote_wrapper.empty())
+      command_runner_.reset(new RemoteCommandRunner(config_));
     else
-      command_runner_.reset(new RealCommandRunner(config_));
+      command_runner_.reset(new RealCommandRunner(config_, status_));
+  }
+
+  // Spin up the completion pool when the disk interface tolerates
+  // concurrent reads/stats/removes (the virtual test interfaces do
+  // not); a handful of threads is plenty, the work is mostly I/O.
+  if (!completion_pool_ && !config_.dry_run && config_.parallelism > 1 &&
+      disk_interface_->SupportsParallelReads() &&
+      disk_interface_->SupportsParallelStats() &&
+      disk_interface_->SupportsParallelRemoves()) {
+    completion_pool_.reset(
+        new CompletionPool(std::min(4, config_.parallelism)));
   }
 
   // We are about to start the build process.
@@ -844,11 +1877,41 @@ bool Builder::Build(std::string* err) {
   // It is structured like this:
   // First, we attempt to start as many commands as allowed by the
   // command runner.
-  // Second, we attempt to wait for / reap the next finished command.
-  while (plan_.more_to_do()) {
+  // Second, we advance any dirty scans deferred by QueueTarget, so scan
+  // latency hides behind the commands already running.
+  // Third, we attempt to wait for / reap the next finished command.
+  while (plan_.more_to_do() || HasQueuedTargets()) {
     // See if we can start any more commands.
     if (failures_allowed && command_runner_->CanRunMore()) {
       if (Edge* edge = plan_.FindWork(); edge) {
+        // A builtin copy edge never leaves the process; dry run falls
+        // through so the command is echoed like any other.
+        if (!config_.dry_run && !edge->is_phony() &&
+            edge->GetBinding("builtin") == "copy") {
+          bool copied = false;
+          if (!RunBuiltinCopy(edge, &copied, err)) {
+            Cleanup();
+            status_->BuildFinished();
+            return false;
+          }
+          if (!copied && failures_allowed)
+            --failures_allowed;
+          continue;
+        }
+
+        // An action-cache hit restores the outputs and completes the
+        // edge in place; no command is dispatched.
+        if (action_cache_ && !edge->is_phony()) {
+          bool restored = false;
+          if (!RestoreFromActionCache(edge, &restored, err)) {
+            Cleanup();
+            status_->BuildFinished();
+            return false;
+          }
+          if (restored)
+            continue;
+        }
+
         if (!StartEdge(edge, err)) {
           Cleanup();
           status_->BuildFinished();
@@ -870,6 +1933,17 @@ bool Builder::Build(std::string* err) {
       }
     }
 
+    // Nothing dispatchable right now: scan a queued target instead of
+    // blocking, folding its dirty edges into the running plan.
+    if (HasQueuedTargets()) {
+      if (!ScanQueuedTarget(err)) {
+        Cleanup();
+        status_->BuildFinished();
+        return false;
+      }
+      continue;
+    }
+
     // See if we can reap any finished commands.
     if (pending_commands) {
       CommandRunner::Result result;
@@ -882,17 +1956,16 @@ bool Builder::Build(std::string* err) {
       }
 
       --pending_commands;
-      if (!FinishCommand(&result, err)) {
+      // Hand the result to the completion pipeline: its depfile parse
+      // and restat stats may run on the pool while we loop back to
+      // dispatching; plan and log updates happen here, in reap order.
+      EnqueueCompletion(&result);
+      if (!ProcessCompletions(pending_commands, &failures_allowed, err)) {
         Cleanup();
         status_->BuildFinished();
         return false;
       }
 
-      if (!result.success()) {
-        if (failures_allowed)
-          failures_allowed--;
-      }
-
       // We made some progress; start the main loop over.
       continue;
     }
@@ -913,6 +1986,12 @@ bool Builder::Build(std::string* err) {
   }
 
   status_->BuildFinished();
+
+  // Keep a shared cache from growing without bound; entries this build
+  // touched carry fresh LRU stamps and survive the sweep.
+  if (action_cache_ && config_.action_cache_size > 0)
+    action_cache_->Trim(config_.action_cache_size);
+
   return true;
 }
 
@@ -921,13 +2000,22 @@ bool Builder::StartEdge(Edge* edge, std::string* err) {
   if (edge->is_phony())
     return true;
 
+  // If the rule asks for batching, fold further ready edges of the same
+  // rule into this invocation; they complete together in FinishCommand.
+  if (int batch_limit = EdgeBatchLimit(edge); batch_limit > 1) {
+    std::vector<Edge*> batch;
+    plan_.CollectBatch(edge, batch_limit, &batch);
+    if (batch.size() > 1)
+      return StartBatch(edge, std::move(batch), err);
+  }
+
   status_->BuildEdgeStarted(edge);
 
   // Create directories necessary for outputs.
   // XXX: this will block; do we care?
   for (const auto & item : edge->outputs_)
   {
-    if (!disk_interface_->MakeDirs(item->path()))
+    if (!disk_interface_->MakeDirs(std::string(item->path())))
       return false;
   }
 
@@ -935,11 +2023,16 @@ bool Builder::StartEdge(Edge* edge, std::string* err) {
   // XXX: this may also block; do we care?
   if(std::string const& rspfile = edge->GetUnescapedRspfile(); ! rspfile.empty())
   {
-    if(std::string const& content = edge->GetBinding("rspfile_content");
-       ! disk_interface_->WriteFile(rspfile, content))
-    {
-      return false;
+    std::string const& content = edge->GetBinding("rspfile_content");
+    RspfileSpool* spool = RspfileSpool::Get();
+    std::string spool_err;
+    if (spool && !spool->Write(rspfile, content, &spool_err)) {
+      // A dying tmpfs should not kill the build; fall back to disk.
+      Warning("%s", spool_err.c_str());
+      spool = nullptr;
     }
+    if (!spool && !disk_interface_->WriteFile(rspfile, content))
+      return false;
   }
 
   // start command computing and run it
@@ -951,11 +2044,67 @@ bool Builder::StartEdge(Edge* edge, std::string* err) {
   return true;
 }
 
+bool Builder::StartBatch(Edge* lead, std::vector<Edge*> batch,
+                         std::string* err) {
+  for (const auto & member : batch)
+  {
+    status_->BuildEdgeStarted(member);
+    for (const auto & item : member->outputs_)
+    {
+      if (!disk_interface_->MakeDirs(std::string(item->path())))
+        return false;
+    }
+  }
+
+  // The batch pointer only lives across StartCommand, which evaluates
+  // the widened command; everything later (dirty checks, log hashing)
+  // must see each member's solo command.
+  std::vector<Edge*>& stored = running_batches_[lead];
+  stored = std::move(batch);
+  lead->batch_ = &stored;
+  bool started = command_runner_->StartCommand(lead);
+  lead->batch_ = nullptr;
+  if (!started) {
+    *err = string_concat("command '", lead->EvaluateBatchCommand(stored),
+                         "' failed.");
+    running_batches_.erase(lead);
+    return false;
+  }
+  return true;
+}
+
 bool Builder::FinishCommand(CommandRunner::Result* result, std::string* err) {
   METRIC_RECORD("FinishCommand");
 
+  if (std::map<Edge*, std::vector<Edge*>>::iterator batch_it =
+          running_batches_.find(result->edge);
+      batch_it != running_batches_.end()) {
+    // One invocation covered several edges: attribute the completion to
+    // every member as if it had run alone.  The combined output is
+    // reported once, with the lead edge.
+    std::vector<Edge*> batch = std::move(batch_it->second);
+    running_batches_.erase(batch_it);
+    for (const auto & member : batch)
+    {
+      CommandRunner::Result member_result;
+      member_result.edge = member;
+      member_result.status = result->status;
+      if (member == result->edge)
+        member_result.output = result->output;
+      if (!FinishCommand(&member_result, err))
+        return false;
+    }
+    return true;
+  }
+
   Edge* edge = result->edge;
 
+  // Preprocessed results apply only to the edge they were captured for;
+  // synthesized batch-member results redo the work inline.
+  const CompletionWork* work = current_work_;
+  if (work && work->result.edge != edge)
+    work = nullptr;
+
   // First try to extract dependencies from the result, if any.
   // This must happen first as it filters the command output (we want
   // to filter /showIncludes output, even on compile failure) and
@@ -964,10 +2113,15 @@ bool Builder::FinishCommand(CommandRunner::Result* result, std::string* err) {
   std::vector<Node*> deps_nodes;
   std::string deps_type = edge->GetBinding("deps");
   const std::string deps_prefix = edge->GetBinding("msvc_deps_prefix");
-  if (!deps_type.empty()) {
+  if (!deps_type.empty() && restoring_from_cache_) {
+    // A cache hit produces no depfile or /showIncludes output to parse;
+    // replay the deps the command discovered when it really ran.
+    deps_nodes = restored_deps_;
+  } else if (!deps_type.empty()) {
     std::string extract_err;
-    if (!ExtractDeps(result, deps_type, deps_prefix, &deps_nodes,
-                     &extract_err) &&
+    if (!(work ? ExtractDepsFromWork(result, *work, &deps_nodes, &extract_err)
+               : ExtractDeps(result, deps_type, deps_prefix, &deps_nodes,
+                             &extract_err)) &&
         result->success()) {
       if (!result->output.empty())
         result->output.append("\n");
@@ -991,10 +2145,21 @@ bool Builder::FinishCommand(CommandRunner::Result* result, std::string* err) {
   if (!config_.dry_run) {
     bool node_cleaned = false;
 
-    for (const auto & item : edge->outputs_) {
-      TimeStamp new_mtime = disk_interface_->Stat(item->path(), err);
-      if (new_mtime == -1)
-        return false;
+    if (work && !work->stat_ok) {
+      *err = work->stat_err;
+      return false;
+    }
+    for (size_t output_index = 0; output_index < edge->outputs_.size();
+         ++output_index) {
+      Node* item = edge->outputs_[output_index];
+      TimeStamp new_mtime;
+      if (work) {
+        new_mtime = work->output_mtimes[output_index];
+      } else {
+        new_mtime = disk_interface_->Stat(std::string(item->path()), err);
+        if (new_mtime == -1)
+          return false;
+      }
       if (new_mtime > output_mtime)
         output_mtime = new_mtime;
       if (item->mtime() == new_mtime && restat) {
@@ -1011,9 +2176,9 @@ bool Builder::FinishCommand(CommandRunner::Result* result, std::string* err) {
       TimeStamp restat_mtime = 0;
       // If any output was cleaned, find the most recent mtime of any
       // (existing) non-order-only input or the depfile.
-      for (std::vector<Node*>::iterator i = edge->inputs_.begin();
+      for (Edge::Nodes::iterator i = edge->inputs_.begin();
            i != edge->inputs_.end() - edge->order_only_deps_; ++i) {
-        TimeStamp input_mtime = disk_interface_->Stat((*i)->path(), err);
+        TimeStamp input_mtime = disk_interface_->Stat(std::string((*i)->path()), err);
         if (input_mtime == -1)
           return false;
         if (input_mtime > restat_mtime)
@@ -1032,6 +2197,7 @@ bool Builder::FinishCommand(CommandRunner::Result* result, std::string* err) {
       // The total number of edges in the plan may have changed as a result
       // of a restat.
       status_->PlanHasTotalEdges(plan_.command_edge_count());
+      status_->PlanHasPredictedWork(plan_.predicted_work());
 
       output_mtime = restat_mtime;
     }
@@ -1044,12 +2210,33 @@ bool Builder::FinishCommand(CommandRunner::Result* result, std::string* err) {
   if(std::string const& rspfile = edge->GetUnescapedRspfile();
      !rspfile.empty() && !g_keep_rsp)
   {
-    disk_interface_->RemoveFile(rspfile);
+    RspfileSpool* spool = RspfileSpool::Get();
+    if (spool && !spool->PathFor(rspfile).empty())
+      spool->Remove(rspfile);
+    else
+      disk_interface_->RemoveFile(rspfile);
+  }
+
+  // Retire a spooled depfile mapping; deps extraction already deleted
+  // the file itself, Remove just tidies the stragglers.
+  if (RspfileSpool* spool = RspfileSpool::Get()) {
+    if (std::string const& depfile = edge->GetUnescapedDepfile();
+        !depfile.empty() && !spool->PathFor(depfile).empty())
+      spool->Remove(depfile);
   }
 
+  if (action_cache_ && !restoring_from_cache_)
+    StoreToActionCache(edge, deps_nodes);
+
   if (scan_.build_log()) {
+    uint64_t input_hash = 0;
+    if (edge->GetBindingBool("hash_inputs"))
+      input_hash = scan_.HashInputContents(edge, &deps_nodes);
     if (!scan_.build_log()->RecordCommand(edge, start_time, end_time,
-                                          output_mtime)) {
+                                          output_mtime, input_hash,
+                                          result->user_time_millis,
+                                          result->system_time_millis,
+                                          result->peak_rss_kb)) {
       *err = string_concat("Error writing to build log: ", strerror(errno));
       return false;
     }
@@ -1057,11 +2244,16 @@ bool Builder::FinishCommand(CommandRunner::Result* result, std::string* err) {
 
   if (!deps_type.empty() && !config_.dry_run) {
     assert(!edge->outputs_.empty() && "should have been rejected by parser");
-    for(auto const& output : edge->outputs_) {
-      TimeStamp deps_mtime = disk_interface_->Stat(output->path(), err);
-      if(deps_mtime == -1)
-      {
-        return false;
+    for (size_t output_index = 0; output_index < edge->outputs_.size();
+         ++output_index) {
+      Node* output = edge->outputs_[output_index];
+      TimeStamp deps_mtime;
+      if (work) {
+        deps_mtime = work->output_mtimes[output_index];
+      } else {
+        deps_mtime = disk_interface_->Stat(std::string(output->path()), err);
+        if (deps_mtime == -1)
+          return false;
       }
 
       if( ! scan_.deps_log()->RecordDeps(output, deps_mtime, deps_nodes))
@@ -1080,6 +2272,14 @@ bool Builder::ExtractDeps(CommandRunner::Result* result,
                           std::vector<Node*>* deps_nodes,
                           std::string* err) {
   if (deps_type == "msvc") {
+    std::vector<std::string> streamed;
+    if (ExtractStreamedMSVCDeps(&result->output, &streamed)) {
+      // A persistent helper parsed the deps while the compiler ran.
+      deps_nodes->reserve(streamed.size());
+      for (const auto & item : streamed)
+        deps_nodes->push_back(state_->GetNode(item, ~0u));
+      return true;
+    }
     CLParser parser;
     std::string output;
     if (!parser.Parse(result->output, deps_prefix, &output, err))
@@ -1098,6 +2298,12 @@ bool Builder::ExtractDeps(CommandRunner::Result* result,
       *err = std::string("edge with deps=gcc but no depfile makes no sense");
       return false;
     }
+    // The command may have been rewritten to write the depfile on the
+    // spool; consume it from there.
+    if (RspfileSpool* spool = RspfileSpool::Get()) {
+      if (std::string spooled = spool->PathFor(depfile); !spooled.empty())
+        depfile = spooled;
+    }
 
     // Read depfile content.  Treat a missing depfile as empty.
     std::string content;
@@ -1170,6 +2376,7 @@ bool Builder::LoadDyndeps(Node* node, std::string* err) {
 
   // New command edges may have been added to the plan.
   status_->PlanHasTotalEdges(plan_.command_edge_count());
+  status_->PlanHasPredictedWork(plan_.predicted_work());
 
   return true;
 }
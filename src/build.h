@@ -16,6 +16,7 @@
 #define NINJA_BUILD_H_
 
 #include <cstdio>
+#include <deque>
 #include <map>
 #include <memory>
 #include <queue>
@@ -30,6 +31,7 @@
 #include "metrics.h"
 #include "util.h"  // int64_t
 
+struct ActionCache;
 struct BuildLog;
 struct BuildStatus;
 struct Builder;
@@ -48,10 +50,32 @@ struct Plan {
   /// fill in |err| with an error message if there's a problem.
   bool AddTarget(const Node* node, std::string* err);
 
+  /// Raise the dispatch priority of every edge in \a target's
+  /// transitive closure above all unboosted work, so a target the user
+  /// asked for by name is reached first even when the plan contains
+  /// broader fallout.  Dyndep loads re-boost newly discovered inputs of
+  /// boosted edges.
+  void BoostTarget(const Node* target);
+
   // Pop a ready edge off the queue of edges to build.
   // Returns nullptr if there's no work to do.
   Edge* FindWork();
 
+  /// Collect up to \a limit - 1 additional ready edges sharing \a
+  /// first's rule into \a batch (first included, first), for a single
+  /// batched invocation; non-matching popped edges are requeued.  Leaves
+  /// the batch at just \a first when a memory budget is active, since
+  /// batching would bypass FindWork's reservations.
+  void CollectBatch(Edge* first, int limit, std::vector<Edge*>* batch);
+
+  /// Compute the critical-path weight of every edge in the plan from
+  /// historical durations in \a build_log and reorder the ready queue
+  /// accordingly, so the edge heading the longest remaining chain is
+  /// always dispatched first.  Called once before the build starts;
+  /// without it every edge keeps the same weight and FindWork degrades
+  /// to creation order.
+  void PrepareQueue(BuildLog* build_log);
+
   /// Returns true if there's more work to be done.
   bool more_to_do() const { return wanted_edges_ > 0 && command_edges_ > 0; }
 
@@ -76,13 +100,30 @@ struct Plan {
   /// Number of edges with commands to run.
   int command_edge_count() const { return command_edges_; }
 
+  /// Total predicted work of the plan in milliseconds: the predicted
+  /// durations of retired edges plus those of everything still wanted.
+  /// Snapshotted by ComputeCriticalPath; feeds BuildStatus's remaining
+  /// time estimate.
+  int64_t predicted_work() const { return predicted_work_; }
+
   /// Reset state.  Clears want and ready sets.
   void Reset();
 
+  /// Cap the combined expected_memory of running edges; normally taken
+  /// from BuildConfig in PrepareQueue, settable directly by tests.
+  /// 0 means no limit.
+  void set_memory_budget(int64_t budget) { memory_budget_ = budget; }
+
   /// Update the build plan to account for modifications made to the graph
   /// by information loaded from a dyndep file.
   bool DyndepsLoaded(DependencyScan* scan, const Node* node,
                      const DyndepFile& ddf, std::string* err);
+
+  /// Estimated duration of \a edge in milliseconds: its last recorded
+  /// duration in the build log, a nominal 1 when there is no history,
+  /// and 0 for phony edges.  Also used by `-t simulate` as the virtual
+  /// runtime of each edge.
+  static int64_t EdgeWeightHeuristic(const Edge* edge, BuildLog* build_log);
 private:
   bool RefreshDyndepDependents(DependencyScan* scan, const Node* node, std::string* err);
   void UnmarkDependents(const Node* node, std::set<Node*>* dependents);
@@ -111,6 +152,16 @@ private:
   void EdgeWanted(const Edge* edge);
   bool EdgeMaybeReady(std::map<Edge*, Want>::iterator want_e, std::string* err);
 
+  /// Assign every edge reachable from the plan's targets its
+  /// critical-path weight: the edge's own estimated duration plus the
+  /// largest weight among the edges that consume its outputs.
+  void ComputeCriticalPath(BuildLog* build_log);
+
+  /// Expected peak memory of \a edge in bytes, from its expected_memory
+  /// binding; 0 when unannotated (or phony), meaning the budget ignores
+  /// the edge.
+  static int64_t EdgeMemoryEstimate(Edge* edge);
+
   /// Submits a ready edge as a candidate for execution.
   /// The edge may be delayed from running, for example if it's a member of a
   /// currently-full pool.
@@ -122,13 +173,32 @@ private:
   /// we want for the edge.
   std::map<Edge*, Want> want_;
 
-  std::set<Edge*> ready_;
+  ShardedEdgeQueue ready_;
+
+  /// Memory-aware dispatch (see BuildConfig::memory_budget): reserved
+  /// estimates of running edges, and ready edges FindWork set aside
+  /// because they did not fit; they requeue when an edge finishes.
+  int64_t memory_budget_ = 0;
+  int64_t memory_in_use_ = 0;
+  std::map<Edge*, int64_t> running_memory_;
+  std::vector<Edge*> memory_deferred_;
 
   Builder* builder_;
 
+  /// The targets passed to AddTarget, roots of the critical-path
+  /// computation.
+  std::vector<const Node*> targets_;
+
   /// Total number of edges that have commands (not phony).
   int command_edges_;
 
+  /// See predicted_work(); finished_predicted_work_ is the portion
+  /// belonging to edges that have already finished, so recomputing the
+  /// snapshot mid-build does not shrink the total under the status
+  /// code's progress accumulator.
+  int64_t predicted_work_ = 0;
+  int64_t finished_predicted_work_ = 0;
+
   /// Total remaining number of wanted edges.
   int wanted_edges_;
 };
@@ -147,6 +217,12 @@ struct CommandRunner {
     Edge* edge = nullptr;
     ExitStatus status;
     std::string output;
+    /// Resource usage of the command as reaped by the runner (CPU times
+    /// in milliseconds, peak RSS in KiB); zero when the runner has no
+    /// rusage to report.  Recorded into the build log per edge.
+    int user_time_millis = 0;
+    int system_time_millis = 0;
+    uint64_t peak_rss_kb = 0;
     bool success() const { return status == ExitSuccess; }
   };
   /// Wait for a command to complete, or return false if interrupted.
@@ -173,9 +249,36 @@ struct BuildConfig final {
   /// The maximum load average we must not exceed. A negative value
   /// means that we do not have any limit.
   double max_load_average;
+  /// When nonempty, selects the remote command runner: every eligible
+  /// edge's command is executed through this wrapper (e.g. a
+  /// rewrapper-style client that ships the action to a compile farm),
+  /// with remote_parallelism actions in flight.  Edges marked with a
+  /// true "local" binding, and console edges, keep running locally.
+  std::string remote_wrapper;
+  /// In-flight action cap for the remote runner; remote actions mostly
+  /// wait on the service, so this is far larger than local -j.
+  int remote_parallelism = 256;
+  /// Total memory budget in bytes for concurrently running edges, from
+  /// --mem-budget.  Edges declare an estimate via the expected_memory
+  /// binding; the plan refuses to dispatch an edge whose estimate
+  /// exceeds what is left of the budget.  0 means no limit.
+  int64_t memory_budget = 0;
+  /// When nonempty, the directory of the content-addressed action cache
+  /// (--action-cache): before dispatching an edge the builder probes the
+  /// cache by command hash plus input content hash, and on a hit
+  /// restores the stored outputs instead of executing.  Defaults to
+  /// $NINJA_ACTION_CACHE, making one per-machine cache shared across
+  /// checkouts a single environment variable away.
+  std::string action_cache_dir;
+  /// Size cap in bytes for the action cache (--action-cache-size):
+  /// after a successful build, least-recently-used entries are evicted
+  /// until the cache fits.  0 means never trim.
+  int64_t action_cache_size = 0;
   DepfileParserOptions depfile_parser_options;
 };
 
+struct CompletionPool;
+
 /// Builder wraps the build process: starting commands, updating status.
 struct Builder final {
   Builder(State* state, const BuildConfig& config,
@@ -192,6 +295,15 @@ struct Builder final {
   /// @return false on error.
   bool AddTarget(Node* target, std::string* err);
 
+  /// Defer \a target's dirty scan to Build(): it runs between dispatches
+  /// once the build loop is going, so the scan overlaps with commands
+  /// already running for earlier targets.  Scan errors surface from
+  /// Build() rather than here.
+  void QueueTarget(Node* target) { queued_targets_.push_back(target); }
+
+  /// Returns true if targets queued by QueueTarget still await their scan.
+  bool HasQueuedTargets() const { return !queued_targets_.empty(); }
+
   /// Returns true if the build targets are already up to date.
   bool AlreadyUpToDate() const;
 
@@ -201,10 +313,28 @@ struct Builder final {
 
   bool StartEdge(Edge* edge, std::string* err);
 
+  /// Start one command covering all edges of \a batch (lead first); see
+  /// the "batch" rule binding.  Completion is attributed per edge.
+  bool StartBatch(Edge* lead, std::vector<Edge*> batch, std::string* err);
+
   /// Update status ninja logs following a command termination.
   /// @return false if the build can not proceed further due to a fatal error.
   bool FinishCommand(CommandRunner::Result* result, std::string* err);
 
+  /// Queue a reaped \a result for completion processing.  When the disk
+  /// interface permits, its depfile read/parse and restat stats run on
+  /// the completion pool while the main loop keeps dispatching; plan
+  /// and log updates stay serialized in ProcessCompletions.
+  void EnqueueCompletion(CommandRunner::Result* result);
+
+  /// Finish queued completions in reap order: every one whose
+  /// preprocessing is already done, and — blocking — at least the
+  /// oldest when \a pending_commands is zero or the queue is full.
+  /// Decrements \a failures_allowed per failed edge.  Returns false on
+  /// a fatal error.
+  bool ProcessCompletions(int pending_commands, int* failures_allowed,
+                          std::string* err);
+
   /// Used for tests.
   void SetBuildLog(BuildLog* log) {
     scan_.set_build_log(log);
@@ -224,9 +354,73 @@ struct Builder final {
                    const std::string& deps_prefix,
                    std::vector<Node*>* deps_nodes, std::string* err);
 
+  struct CompletionWork;
+
+  /// The off-thread half of completion processing: read and parse the
+  /// depfile (or filter /showIncludes output) and pre-stat the edge's
+  /// outputs.  Touches only the disk interface and the strings captured
+  /// into \a work at enqueue time.
+  void PreprocessCompletion(CompletionWork* work);
+
+  /// Turn a preprocessed parse into deps nodes, mirroring ExtractDeps.
+  bool ExtractDepsFromWork(CommandRunner::Result* result,
+                           const CompletionWork& work,
+                           std::vector<Node*>* deps_nodes, std::string* err);
+
+  /// Scan the next queued target and fold its dirty edges into the plan.
+  /// Returns false on a scan error.
+  bool ScanQueuedTarget(std::string* err);
+
+  /// Try to complete \a edge from the action cache instead of executing
+  /// it; on a hit the outputs are restored and the edge finished in
+  /// place, with \a *restored set.  Misses and damaged entries leave
+  /// \a *restored false and the edge runs normally.  Returns false only
+  /// on a fatal completion error.
+  bool RestoreFromActionCache(Edge* edge, bool* restored, std::string* err);
+
+  /// Execute a `builtin = copy` edge in process: no shell, no cp, and a
+  /// reflink instead of a data copy where the filesystem allows one.
+  /// The edge is finished in place with a synthesized result, so a copy
+  /// failure counts against -k like a failed command; \a *success
+  /// reports which way it went.  Returns false only on a fatal
+  /// completion error.
+  bool RunBuiltinCopy(Edge* edge, bool* success, std::string* err);
+
+  /// Record the just-executed edge's outputs (and the deps it
+  /// discovered) in the action cache.  Best effort.
+  void StoreToActionCache(Edge* edge, const std::vector<Node*>& deps_nodes);
+
   DiskInterface* disk_interface_;
   DependencyScan scan_;
 
+  /// Targets whose dirty scan is deferred into Build(), in the order
+  /// they were queued.
+  std::deque<Node*> queued_targets_;
+
+  /// In-flight batched invocations, keyed by the lead edge handed to
+  /// the command runner; values hold every edge the command covers.
+  std::map<Edge*, std::vector<Edge*>> running_batches_;
+
+  /// Reaped commands whose preprocessing may still be running on the
+  /// completion pool; drained FIFO so edge-finished effects keep their
+  /// order.
+  std::deque<std::unique_ptr<CompletionWork>> pending_completions_;
+  /// Worker threads for PreprocessCompletion; null when the disk
+  /// interface does not support concurrent access (tests, dry runs).
+  std::unique_ptr<CompletionPool> completion_pool_;
+  /// Set around FinishCommand for the edge whose preprocessed results
+  /// should be consumed instead of re-doing the work inline.
+  const CompletionWork* current_work_ = nullptr;
+
+  /// The content-addressed action cache, or null when --action-cache is
+  /// not in effect.
+  std::unique_ptr<ActionCache> action_cache_;
+  /// Set around FinishCommand for an edge completed from the cache:
+  /// suppresses re-storing the entry, and restored_deps_ replaces
+  /// depfile extraction (a hit produces no depfile to parse).
+  bool restoring_from_cache_ = false;
+  std::vector<Node*> restored_deps_;
+
   // Unimplemented copy ctor and operator= ensure we don't copy the auto_ptr.
   Builder(const Builder &other);        // DO NOT IMPLEMENT
   void operator=(const Builder &other); // DO NOT IMPLEMENT
@@ -236,9 +430,15 @@ struct Builder final {
 struct BuildStatus final {
   explicit BuildStatus(const BuildConfig& config);
   void PlanHasTotalEdges(int total);
+  void PlanHasPredictedWork(int64_t work_millis);
   void BuildEdgeStarted(const Edge* edge);
   void BuildEdgeFinished(Edge* edge, bool success, const std::string& output,
                          int* start_time, int* end_time);
+  /// Print a chunk of live output from a running edge with a "stream"
+  /// binding, one prefixed line at a time; partial lines are held back
+  /// until their newline arrives (or the edge finishes).
+  void BuildEdgeStreamedOutput(const Edge* edge, const char* data,
+                               size_t len);
   void BuildLoadDyndeps();
   void BuildStarted();
   void BuildFinished();
@@ -250,15 +450,21 @@ struct BuildStatus final {
 
   /// Format the progress status string by replacing the placeholders.
   /// See the user manual for more information about the available
-  /// placeholders.
+  /// placeholders.  The returned view points into a buffer reused by the
+  /// next call, so the status path allocates nothing in steady state.
   /// @param progress_status_format The format of the progress status.
   /// @param status The status of the edge.
-  std::string FormatProgressStatus(const char* progress_status_format,
-                                   EdgeStatus status) const;
+  std::string_view FormatProgressStatus(const char* progress_status_format,
+                                        EdgeStatus status) const;
 
  private:
   void PrintStatus(const Edge* edge, EdgeStatus status);
 
+  /// Estimated seconds until the build finishes, or -1 when there is no
+  /// basis for an estimate yet.  Extrapolates from the predicted work
+  /// retired so far, floored by the longest critical path still running.
+  double EstimateRemainingSeconds() const;
+
   const BuildConfig& config_;
 
   /// Time the build started.
@@ -266,23 +472,39 @@ struct BuildStatus final {
 
   int started_edges_ = 0, finished_edges_ = 0, total_edges_ = 0;
 
+  /// Predicted milliseconds of work in the whole plan and in the edges
+  /// finished so far, in build-log time; their ratio against wall-clock
+  /// elapsed drives the remaining-time estimate.
+  int64_t predicted_total_work_millis_ = 0;
+  int64_t predicted_finished_work_millis_ = 0;
+
   /// Map of running edge to time the edge started running.
   typedef std::map<const Edge*, int> RunningEdgeMap;
   RunningEdgeMap running_edges_;
 
+  /// Trailing partial line per streaming edge, flushed when the
+  /// newline arrives or the edge finishes.
+  std::map<const Edge*, std::string> streamed_partial_;
+
   /// Prints progress output.
   LinePrinter printer_;
 
   /// The custom progress status format to use.
   const char* progress_status_format_ = nullptr;
 
-  template<size_t S>
-  void SnprintfRate(double rate, char(&buf)[S], const char* format) const {
-    if (rate == -1)
-      snprintf(buf, S, "?");
-    else
-      snprintf(buf, S, format, rate);
-  }
+  /// Locale-free formatting into the reused status buffers; snprintf's
+  /// locale lookups are measurable at thousands of status updates per
+  /// second.
+  static void AppendDecimal(int value, std::string* out);
+  static void AppendFixed(double value, int precision, std::string* out);
+
+  /// Reused by FormatProgressStatus and PrintStatus between calls.
+  mutable std::string progress_buffer_;
+  std::string status_line_;
+  /// The last line handed to the printer; on a smart terminal an
+  /// identical elided line would overprint itself, so it is skipped until
+  /// other output invalidates the console line.
+  std::string last_status_line_;
 
   struct RateInfo final {
     RateInfo() = default;
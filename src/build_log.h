@@ -24,6 +24,7 @@
 #include "timestamp.h"
 #include "util.h"  // uint64_t
 
+struct AsyncWriter;
 struct DiskInterface;
 struct Edge;
 
@@ -50,7 +51,9 @@ struct BuildLog final {
   bool OpenForWrite(const std::string& path, const BuildLogUser& user,
                     std::string* err);
   bool RecordCommand(Edge* edge, int start_time, int end_time,
-                     TimeStamp mtime = 0);
+                     TimeStamp mtime = 0, uint64_t input_hash = 0,
+                     int user_time_millis = 0, int system_time_millis = 0,
+                     uint64_t peak_rss_kb = 0);
   void Close();
 
   /// Load the on-disk log.
@@ -62,14 +65,41 @@ struct BuildLog final {
     int start_time;
     int end_time;
     TimeStamp mtime;
+    /// Combined hash of the contents of the edge's inputs when the command
+    /// ran, or 0 when it was not recorded.  Only recorded for edges in
+    /// hash_inputs mode; the dependency scan uses it to ignore inputs whose
+    /// mtimes are newer but whose contents are unchanged.
+    uint64_t input_hash = 0;
+    /// What the command actually cost, from the wait4() that reaped it:
+    /// user/system CPU in milliseconds and peak RSS in KiB.  Zero in
+    /// entries recorded by pre-v9 logs, or on platforms whose reap path
+    /// has no rusage.
+    int user_time_millis = 0;
+    int system_time_millis = 0;
+    uint64_t peak_rss_kb = 0;
+    /// Position of the entry's most recent record in the loaded log.
+    /// The log is append-ordered, so this is a recency signal for the
+    /// load-time LRU retention cap; it is never written to disk.
+    uint64_t last_record = 0;
 
     static uint64_t HashCommand(std::string_view command);
+    /// The pre-v8 hash function (MurmurHash2), kept so CommandMatches
+    /// can verify digests recorded by older logs.
+    static uint64_t LegacyHashCommand(std::string_view command);
+
+    /// Whether \a command matches the recorded digest.  Digests written
+    /// by pre-v8 logs are accepted and rehashed in place, so switching
+    /// hash functions does not dirty every edge.
+    bool CommandMatches(std::string_view command);
 
     // Used by tests.
     bool operator==(const LogEntry& o) {
       return output == o.output && command_hash == o.command_hash &&
           start_time == o.start_time && end_time == o.end_time &&
-          mtime == o.mtime;
+          mtime == o.mtime && input_hash == o.input_hash &&
+          user_time_millis == o.user_time_millis &&
+          system_time_millis == o.system_time_millis &&
+          peak_rss_kb == o.peak_rss_kb;
     }
 
     explicit LogEntry(std::string output);
@@ -78,11 +108,35 @@ struct BuildLog final {
   };
 
   /// Lookup a previously-run command by its output path.
-  LogEntry* LookupByOutput(const std::string& path);
+  LogEntry* LookupByOutput(std::string_view path);
+
+  /// Serialize an entry as a binary log record.
+  static void FormatEntry(const LogEntry& entry, std::string* out);
+
+  /// Serialize an entry as a tab-separated text line, the pre-v7 on-disk
+  /// form; `-t recompact --text` uses it to dump the log for scrapers.
+  static void FormatEntryText(const LogEntry& entry, std::string* out);
 
   /// Serialize an entry into a log file.
   bool WriteEntry(FILE* f, const LogEntry& entry);
 
+  /// Route RecordCommand's appends through \a writer instead of blocking
+  /// on fwrite+fflush; the builder attaches one for the duration of a
+  /// build and reports deferred failures at its Drain() barrier.  Pass
+  /// nullptr to go back to synchronous writes.
+  void set_async_writer(AsyncWriter* writer) { async_writer_ = writer; }
+
+  /// Configure load-time retention, applied at the end of Load():
+  /// entries whose output \a user reports dead are dropped, and when
+  /// \a max_entries is nonzero only the most recently recorded
+  /// \a max_entries entries are kept.  This bounds memory without
+  /// rewriting the file, but dropped entries only survive on disk until
+  /// the next recompaction.  Must be called before Load().
+  void set_retention(const BuildLogUser* user, size_t max_entries) {
+    retention_user_ = user;
+    max_retained_entries_ = max_entries;
+  }
+
   /// Rewrite the known log entries, throwing away old data.
   bool Recompact(const std::string& path, const BuildLogUser& user,
                  std::string* err);
@@ -94,15 +148,32 @@ struct BuildLog final {
   using Entries = std::unordered_map<std::string_view, LogEntry*>;
   const Entries& entries() const { return entries_; }
 
+  /// Drop loaded entries per set_retention()'s policy.  Load() applies
+  /// retention itself; callers that configure it only after Load() --
+  /// e.g. because IsPathDead() would race a concurrent deps log load --
+  /// invoke this directly once it is safe.
+  void ApplyRetention();
+
+  /// Forget everything Load() read, for when a speculative startup load
+  /// turns out to have read another build dir's log.
+  void DiscardLoad();
+
  private:
+  /// Load a v7+ binary log by mapping it and walking the records in
+  /// place.
+  LoadStatus LoadBinary(const std::string& path, std::string* err);
+
   /// Should be called before using log_file_. When false is returned, errno
   /// will be set.
   bool OpenForWriteIfNeeded();
 
   Entries entries_;
+  AsyncWriter* async_writer_ = nullptr;
   FILE* log_file_ = nullptr;
   std::string log_file_path_;
   bool needs_recompaction_ = false;
+  const BuildLogUser* retention_user_ = nullptr;
+  size_t max_retained_entries_ = 0;
 };
 
 #endif // NINJA_BUILD_LOG_H_
@@ -14,6 +14,7 @@
 
 #include <algorithm>
 #include <cstring>
+#include "async_writer.h"
 #include "build_log.h"
 #include "util.h"
 #include "test.h"
@@ -170,6 +171,137 @@ TEST_F(BuildLogTest, ObsoleteOldVersion) {
   ASSERT_NE(err.find("version"), std::string::npos);
 }
 
+TEST_F(BuildLogTest, InputHashWriteRead) {
+  AssertParse(&state_,
+"build out: cat in\n");
+
+  BuildLog log1;
+  std::string err;
+  EXPECT_TRUE(log1.OpenForWrite(kTestFilename, *this, &err));
+  ASSERT_EQ("", err);
+  log1.RecordCommand(state_.edges_[0], 15, 18, 0, 0xfeedfaceull);
+  log1.Close();
+
+  BuildLog log2;
+  EXPECT_TRUE(log2.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+
+  BuildLog::LogEntry* e1 = log1.LookupByOutput("out");
+  ASSERT_TRUE(e1);
+  BuildLog::LogEntry* e2 = log2.LookupByOutput("out");
+  ASSERT_TRUE(e2);
+  ASSERT_TRUE(*e1 == *e2);
+  ASSERT_EQ(0xfeedfaceull, e2->input_hash);
+}
+
+TEST_F(BuildLogTest, UsageWriteRead) {
+  AssertParse(&state_,
+"build out: cat in\n");
+
+  BuildLog log1;
+  std::string err;
+  EXPECT_TRUE(log1.OpenForWrite(kTestFilename, *this, &err));
+  ASSERT_EQ("", err);
+  log1.RecordCommand(state_.edges_[0], 15, 18, 0, 0, 1200, 300, 65536);
+  log1.Close();
+
+  BuildLog log2;
+  EXPECT_TRUE(log2.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+
+  BuildLog::LogEntry* e1 = log1.LookupByOutput("out");
+  ASSERT_TRUE(e1);
+  BuildLog::LogEntry* e2 = log2.LookupByOutput("out");
+  ASSERT_TRUE(e2);
+  ASSERT_TRUE(*e1 == *e2);
+  EXPECT_EQ(1200, e2->user_time_millis);
+  EXPECT_EQ(300, e2->system_time_millis);
+  EXPECT_EQ(65536u, e2->peak_rss_kb);
+}
+
+TEST_F(BuildLogTest, LoadBinaryV8NoUsage) {
+  // A hand-written v8 log: the 36-byte record layout without the rusage
+  // fields.  It must load with the usage zeroed.
+  FILE* f = fopen(kTestFilename, "wb");
+  ASSERT_TRUE(f != nullptr);
+  fprintf(f, "# ninja log v8\n");
+  int32_t start_time = 15, end_time = 18;
+  int64_t mtime = 0;
+  uint64_t command_hash = 0x123, input_hash = 0;
+  uint32_t output_size = 3;
+  fwrite(&start_time, 4, 1, f);
+  fwrite(&end_time, 4, 1, f);
+  fwrite(&mtime, 8, 1, f);
+  fwrite(&command_hash, 8, 1, f);
+  fwrite(&input_hash, 8, 1, f);
+  fwrite(&output_size, 4, 1, f);
+  fwrite("out", 3, 1, f);
+  fclose(f);
+
+  BuildLog log;
+  std::string err;
+  EXPECT_TRUE(log.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+
+  BuildLog::LogEntry* e = log.LookupByOutput("out");
+  ASSERT_TRUE(e);
+  EXPECT_EQ(15, e->start_time);
+  EXPECT_EQ(18, e->end_time);
+  EXPECT_EQ(0x123u, e->command_hash);
+  EXPECT_EQ(0, e->user_time_millis);
+  EXPECT_EQ(0, e->system_time_millis);
+  EXPECT_EQ(0u, e->peak_rss_kb);
+}
+
+TEST_F(BuildLogTest, AsyncWriteRead) {
+  AssertParse(&state_,
+"build out: cat mid\n"
+"build mid: cat in\n");
+
+  AsyncWriter writer;
+  BuildLog log1;
+  std::string err;
+  EXPECT_TRUE(log1.OpenForWrite(kTestFilename, *this, &err));
+  ASSERT_EQ("", err);
+  log1.set_async_writer(&writer);
+  log1.RecordCommand(state_.edges_[0], 15, 18);
+  log1.RecordCommand(state_.edges_[1], 20, 25);
+  EXPECT_TRUE(writer.Drain(&err));
+  ASSERT_EQ("", err);
+  log1.set_async_writer(nullptr);
+  log1.Close();
+
+  BuildLog log2;
+  EXPECT_TRUE(log2.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+
+  ASSERT_EQ(2u, log2.entries().size());
+  BuildLog::LogEntry* e1 = log1.LookupByOutput("out");
+  ASSERT_TRUE(e1);
+  BuildLog::LogEntry* e2 = log2.LookupByOutput("out");
+  ASSERT_TRUE(e2);
+  ASSERT_TRUE(*e1 == *e2);
+}
+
+TEST_F(BuildLogTest, NoInputHashV5) {
+  // v5 logs have no input hash field; their entries load with the hash
+  // unrecorded rather than garbage.
+  FILE* f = fopen(kTestFilename, "wb");
+  fprintf(f, "# ninja log v5\n");
+  fprintf(f, "123\t456\t456\tout\tdeadbeef\n");
+  fclose(f);
+
+  std::string err;
+  BuildLog log;
+  EXPECT_TRUE(log.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+
+  BuildLog::LogEntry* e = log.LookupByOutput("out");
+  ASSERT_TRUE(e);
+  ASSERT_EQ(0xdeadbeefull, e->command_hash);
+  ASSERT_EQ(0u, e->input_hash);
+}
+
 TEST_F(BuildLogTest, SpacesInOutputV4) {
   FILE* f = fopen(kTestFilename, "wb");
   fprintf(f, "# ninja log v4\n");
@@ -316,6 +448,98 @@ TEST_F(BuildLogTest, MultiTargetEdge) {
   ASSERT_EQ(22, e2->end_time);
 }
 
+TEST_F(BuildLogTest, TextLogMigratesToBinary) {
+  // A v6 text log still loads; opening it for write recompacts it into
+  // the binary format, which must round-trip the same entries.
+  FILE* f = fopen(kTestFilename, "wb");
+  fprintf(f, "# ninja log v6\n");
+  fprintf(f, "15\t18\t1234\tout\tdeadbeef\tfeedface\n");
+  fprintf(f, "20\t25\t5678\tout2\tbeefdead\n");
+  fclose(f);
+
+  std::string err;
+  BuildLog log;
+  EXPECT_TRUE(log.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+  EXPECT_TRUE(log.OpenForWrite(kTestFilename, *this, &err));
+  ASSERT_EQ("", err);
+  log.Close();
+
+  BuildLog log2;
+  EXPECT_TRUE(log2.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+  ASSERT_EQ(2u, log2.entries().size());
+  BuildLog::LogEntry* e = log2.LookupByOutput("out");
+  ASSERT_TRUE(e);
+  ASSERT_EQ(15, e->start_time);
+  ASSERT_EQ(18, e->end_time);
+  ASSERT_EQ(1234, e->mtime);
+  ASSERT_EQ(0xdeadbeefull, e->command_hash);
+  ASSERT_EQ(0xfeedfaceull, e->input_hash);
+  e = log2.LookupByOutput("out2");
+  ASSERT_TRUE(e);
+  ASSERT_EQ(0xbeefdeadull, e->command_hash);
+  ASSERT_EQ(0u, e->input_hash);
+}
+
+TEST_F(BuildLogTest, LegacyHashMigration) {
+  // Entries from pre-v8 logs hold MurmurHash digests; verifying the
+  // command accepts them and upgrades the entry to the current hash.
+  BuildLog::LogEntry entry("out");
+  entry.command_hash = BuildLog::LogEntry::LegacyHashCommand("cat in > out");
+  EXPECT_TRUE(entry.CommandMatches("cat in > out"));
+  EXPECT_EQ(BuildLog::LogEntry::HashCommand("cat in > out"),
+            entry.command_hash);
+  EXPECT_TRUE(entry.CommandMatches("cat in > out"));
+  EXPECT_FALSE(entry.CommandMatches("cat other > out"));
+}
+
+struct BuildLogRetentionTest : public BuildLogTest {
+  bool IsPathDead(std::string_view s) const override final {
+    return s == "dead";
+  }
+};
+
+TEST_F(BuildLogRetentionTest, LoadRetention) {
+  AssertParse(&state_,
+"build out1: cat in\n"
+"build out2: cat in\n"
+"build dead: cat in\n");
+
+  BuildLog log1;
+  std::string err;
+  EXPECT_TRUE(log1.OpenForWrite(kTestFilename, *this, &err));
+  ASSERT_EQ("", err);
+  log1.RecordCommand(state_.edges_[0], 15, 18);
+  log1.RecordCommand(state_.edges_[2], 20, 25);
+  log1.RecordCommand(state_.edges_[1], 30, 35);
+  log1.Close();
+
+  // Dead outputs are dropped at load time, without touching the file.
+  BuildLog log2;
+  log2.set_retention(this, 0);
+  EXPECT_EQ(LOAD_SUCCESS, log2.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+  ASSERT_EQ(2u, log2.entries().size());
+  EXPECT_TRUE(log2.LookupByOutput("out1"));
+  EXPECT_TRUE(log2.LookupByOutput("out2"));
+  EXPECT_FALSE(log2.LookupByOutput("dead"));
+
+  // The LRU cap keeps the most recently recorded entries.
+  BuildLog log3;
+  log3.set_retention(this, 1);
+  EXPECT_EQ(LOAD_SUCCESS, log3.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+  ASSERT_EQ(1u, log3.entries().size());
+  EXPECT_TRUE(log3.LookupByOutput("out2"));
+
+  // An unconfigured load still sees everything.
+  BuildLog log4;
+  EXPECT_EQ(LOAD_SUCCESS, log4.Load(kTestFilename, &err));
+  ASSERT_EQ("", err);
+  ASSERT_EQ(3u, log4.entries().size());
+}
+
 struct BuildLogRecompactTest : public BuildLogTest {
   bool IsPathDead(std::string_view s) const override final { return s == "out2"; }
 };
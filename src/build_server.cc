@@ -0,0 +1,177 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "build_server.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "string_concat.h"
+
+using namespace std;
+
+BuildServer::~BuildServer() {
+  StopCancelWatch();
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    unlink(path_.c_str());
+  }
+}
+
+bool BuildServer::Listen(const std::string& path, std::string* err) {
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    *err = string_concat("socket path too long: ", path);
+    return false;
+  }
+  memcpy(addr.sun_path, path.data(), path.size());
+
+  // A stale socket file from a dead server blocks bind(); a live server
+  // would accept this probe connection.
+  if (int probe = socket(AF_UNIX, SOCK_STREAM, 0); probe >= 0) {
+    bool alive = connect(probe, reinterpret_cast<struct sockaddr*>(&addr),
+                         sizeof(addr)) == 0;
+    close(probe);
+    if (alive) {
+      *err = string_concat("another server is already listening on ", path);
+      return false;
+    }
+  }
+  unlink(path.c_str());
+
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    *err = string_concat("socket: ", strerror(errno));
+    return false;
+  }
+  if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr),
+           sizeof(addr)) < 0 ||
+      listen(listen_fd_, 4) < 0) {
+    *err = string_concat("binding ", path, ": ", strerror(errno));
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+  path_ = path;
+  return true;
+}
+
+int BuildServer::Accept() {
+  for (;;) {
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd >= 0) {
+      inbuf_.clear();
+      return fd;
+    }
+    if (errno != ECONNABORTED)
+      return -1;
+  }
+}
+
+bool BuildServer::ReadRequest(int fd, std::string* request) {
+  for (;;) {
+    if (size_t eol = inbuf_.find('\n'); eol != string::npos) {
+      request->assign(inbuf_, 0, eol);
+      inbuf_.erase(0, eol + 1);
+      return true;
+    }
+    char buf[4 << 10];
+    ssize_t len = read(fd, buf, sizeof(buf));
+    if (len <= 0) {
+      if (len < 0 && errno == EINTR)
+        continue;
+      return false;
+    }
+    inbuf_.append(buf, len);
+  }
+}
+
+// static
+std::vector<std::string> BuildServer::Tokenize(const std::string& request) {
+  std::vector<std::string> words;
+  size_t pos = 0;
+  while (pos < request.size()) {
+    size_t start = request.find_first_not_of(" \t", pos);
+    if (start == string::npos)
+      break;
+    size_t end = request.find_first_of(" \t", start);
+    if (end == string::npos)
+      end = request.size();
+    words.push_back(request.substr(start, end - start));
+    pos = end;
+  }
+  return words;
+}
+
+// static
+void BuildServer::WriteLine(int fd, const std::string& line) {
+  std::string framed = line + "\n";
+  const char* p = framed.data();
+  size_t len = framed.size();
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return;  // Client went away; its loss.
+    }
+    p += n;
+    len -= n;
+  }
+}
+
+void BuildServer::StartCancelWatch() {
+  cancel_stop_ = false;
+  cancel_thread_ = std::thread([this]() {
+    while (!cancel_stop_) {
+      struct pollfd pfd = { listen_fd_, POLLIN, 0 };
+      if (poll(&pfd, 1, 50) <= 0)
+        continue;
+      int fd = accept(listen_fd_, nullptr, nullptr);
+      if (fd < 0)
+        continue;
+      // A dedicated read here, not ReadRequest(): inbuf_ belongs to the
+      // dispatch loop's client.
+      std::string request;
+      char c;
+      while (read(fd, &c, 1) == 1 && c != '\n')
+        request.push_back(c);
+      std::vector<std::string> words = Tokenize(request);
+      if (!words.empty() && words[0] == "cancel") {
+        kill(getpid(), SIGINT);
+        WriteLine(fd, "ok cancelled");
+      } else {
+        WriteLine(fd, "error busy: a build is running");
+      }
+      close(fd);
+    }
+  });
+}
+
+void BuildServer::StopCancelWatch() {
+  if (!cancel_thread_.joinable())
+    return;
+  cancel_stop_ = true;
+  cancel_thread_.join();
+}
+
+#endif  // !_WIN32
@@ -0,0 +1,79 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_BUILD_SERVER_H_
+#define NINJA_BUILD_SERVER_H_
+
+#ifndef _WIN32
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// The unix-socket IPC surface behind --serve: a resident ninja accepts
+/// requests from IDE plugins and test runners, which then stop paying
+/// process startup plus manifest parse per interaction.
+///
+/// The protocol is line-based, one request per line with
+/// whitespace-separated tokens:
+///
+///   build [targets...]   rebuild against the warm graph
+///   query <path>         describe a node (inputs, outputs, dirt)
+///   cancel               stop the build in flight
+///
+/// Console output streams back over the connection, and every request
+/// ends with a status line, "ok ..." or "error ...".  One client is
+/// served at a time; while a build runs, a watcher thread accepts new
+/// connections just long enough to honor "cancel", which stops the
+/// build through the same signal path as ctrl-c.
+struct BuildServer {
+  ~BuildServer();
+
+  /// Bind and listen on \a path, replacing a stale socket file.
+  bool Listen(const std::string& path, std::string* err);
+
+  /// Block until the next client connects; -1 on interruption.
+  int Accept();
+
+  /// Read the next newline-terminated request from \a fd into
+  /// \a request (newline stripped).  False on EOF or error.
+  bool ReadRequest(int fd, std::string* request);
+
+  /// Split \a request into whitespace-separated tokens.
+  static std::vector<std::string> Tokenize(const std::string& request);
+
+  /// Write \a line plus a trailing newline to \a fd.
+  static void WriteLine(int fd, const std::string& line);
+
+  /// While a build runs the dispatch loop cannot accept, so this thread
+  /// does: a connection whose first request is "cancel" gets the build
+  /// stopped (SIGINT to the process, the normal interruption path) and
+  /// an "ok" reply; anything else is turned away with "error busy".
+  void StartCancelWatch();
+  void StopCancelWatch();
+
+ private:
+  int listen_fd_ = -1;
+  std::string path_;
+  /// Bytes read past the last request's newline; only one client is
+  /// served at a time, so a single carry-over buffer suffices.
+  std::string inbuf_;
+  std::thread cancel_thread_;
+  std::atomic<bool> cancel_stop_{false};
+};
+
+#endif  // !_WIN32
+
+#endif  // NINJA_BUILD_SERVER_H_
@@ -0,0 +1,121 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _WIN32
+
+#include "build_server.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "test.h"
+
+namespace {
+
+struct BuildServerTest : public testing::Test {
+  virtual void SetUp() {
+    temp_dir_.CreateAndEnter("BuildServerTest");
+  }
+
+  virtual void TearDown() {
+    temp_dir_.Cleanup();
+  }
+
+  int Connect(const std::string& path) {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.data(), path.size());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+      return -1;
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr),
+                sizeof(addr)) < 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  ScopedTempDir temp_dir_;
+};
+
+}  // anonymous namespace
+
+TEST_F(BuildServerTest, Tokenize) {
+  std::vector<std::string> words =
+      BuildServer::Tokenize("build  out/foo.o\tout/bar.o ");
+  ASSERT_EQ(3u, words.size());
+  EXPECT_EQ("build", words[0]);
+  EXPECT_EQ("out/foo.o", words[1]);
+  EXPECT_EQ("out/bar.o", words[2]);
+  EXPECT_TRUE(BuildServer::Tokenize("  \t ").empty());
+}
+
+TEST_F(BuildServerTest, RequestRoundTrip) {
+  BuildServer server;
+  std::string err;
+  ASSERT_TRUE(server.Listen("serve.sock", &err));
+  ASSERT_EQ("", err);
+
+  int client = Connect("serve.sock");
+  ASSERT_GE(client, 0);
+  // Two requests in one write; the server must frame them apart.
+  BuildServer::WriteLine(client, "query out");
+  BuildServer::WriteLine(client, "cancel");
+
+  int conn = server.Accept();
+  ASSERT_GE(conn, 0);
+  std::string request;
+  ASSERT_TRUE(server.ReadRequest(conn, &request));
+  EXPECT_EQ("query out", request);
+  ASSERT_TRUE(server.ReadRequest(conn, &request));
+  EXPECT_EQ("cancel", request);
+
+  // EOF once the client hangs up.
+  close(client);
+  EXPECT_FALSE(server.ReadRequest(conn, &request));
+  close(conn);
+}
+
+TEST_F(BuildServerTest, ListenRejectsLiveServer) {
+  BuildServer server;
+  std::string err;
+  ASSERT_TRUE(server.Listen("serve.sock", &err));
+
+  BuildServer second;
+  EXPECT_FALSE(second.Listen("serve.sock", &err));
+  EXPECT_NE(std::string::npos, err.find("already listening"));
+}
+
+TEST_F(BuildServerTest, ListenReplacesStaleSocket) {
+  // A dead server that never unlinked its socket file.
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  const char kPath[] = "serve.sock";
+  memcpy(addr.sun_path, kPath, strlen(kPath));
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(0, bind(fd, reinterpret_cast<struct sockaddr*>(&addr),
+                    sizeof(addr)));
+  close(fd);  // The socket file stays behind with nobody listening.
+
+  BuildServer server;
+  std::string err;
+  EXPECT_TRUE(server.Listen("serve.sock", &err));
+  EXPECT_EQ("", err);
+}
+
+#endif  // !_WIN32
@@ -88,6 +88,74 @@ TEST_F(PlanTest, Basic) {
   ASSERT_EQ(0, edge);
 }
 
+TEST_F(PlanTest, CriticalPathPriority) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"build out: cat mid1 mid2\n"
+"build mid1: cat in1\n"
+"build mid2: cat in2\n"));
+  GetNode("mid1")->MarkDirty();
+  GetNode("mid2")->MarkDirty();
+  GetNode("out")->MarkDirty();
+
+  // mid2 was created after mid1, but its history says it takes far
+  // longer, so it heads the critical path and must be dispatched first.
+  BuildLog log;
+  log.RecordCommand(GetNode("mid1")->in_edge(), 0, 10);
+  log.RecordCommand(GetNode("mid2")->in_edge(), 0, 1000);
+  log.RecordCommand(GetNode("out")->in_edge(), 0, 10);
+
+  std::string err;
+  EXPECT_TRUE(plan_.AddTarget(GetNode("out"), &err));
+  ASSERT_EQ("", err);
+  plan_.PrepareQueue(&log);
+
+  EXPECT_EQ(1010, GetNode("mid2")->in_edge()->critical_path_weight());
+  EXPECT_EQ(20, GetNode("mid1")->in_edge()->critical_path_weight());
+
+  Edge* edge = plan_.FindWork();
+  ASSERT_TRUE(edge);
+  EXPECT_EQ("mid2", edge->outputs_[0]->path());
+  edge = plan_.FindWork();
+  ASSERT_TRUE(edge);
+  EXPECT_EQ("mid1", edge->outputs_[0]->path());
+}
+
+TEST_F(PlanTest, BoostedTargetPriority) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"build out1: cat mid1\n"
+"build mid1: cat in1\n"
+"build out2: cat in2\n"));
+  GetNode("mid1")->MarkDirty();
+  GetNode("out1")->MarkDirty();
+  GetNode("out2")->MarkDirty();
+
+  // out2's history makes it the heavier critical path, but out1 is the
+  // target the user named, so its whole closure must dispatch first.
+  BuildLog log;
+  log.RecordCommand(GetNode("mid1")->in_edge(), 0, 10);
+  log.RecordCommand(GetNode("out1")->in_edge(), 0, 10);
+  log.RecordCommand(GetNode("out2")->in_edge(), 0, 1000);
+
+  std::string err;
+  EXPECT_TRUE(plan_.AddTarget(GetNode("out1"), &err));
+  ASSERT_EQ("", err);
+  EXPECT_TRUE(plan_.AddTarget(GetNode("out2"), &err));
+  ASSERT_EQ("", err);
+  plan_.BoostTarget(GetNode("out1"));
+  plan_.PrepareQueue(&log);
+
+  EXPECT_TRUE(GetNode("mid1")->in_edge()->priority_boost_);
+  EXPECT_TRUE(GetNode("out1")->in_edge()->priority_boost_);
+  EXPECT_FALSE(GetNode("out2")->in_edge()->priority_boost_);
+
+  Edge* edge = plan_.FindWork();
+  ASSERT_TRUE(edge);
+  EXPECT_EQ("mid1", edge->outputs_[0]->path());
+  edge = plan_.FindWork();
+  ASSERT_TRUE(edge);
+  EXPECT_EQ("out2", edge->outputs_[0]->path());
+}
+
 // Test that two outputs from one rule can be handled as inputs to the next.
 TEST_F(PlanTest, DoubleOutputDirect) {
   ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
@@ -339,6 +407,49 @@ TEST_F(PlanTest, PoolsWithDepthTwo) {
   ASSERT_FALSE(plan_.FindWork());
 }
 
+TEST_F(PlanTest, MemoryBudget) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"rule link\n"
+"  command = cat $in > $out\n"
+"  expected_memory = 3G\n"
+"build out1: link in\n"
+"build out2: link in\n"
+"build out3: cat in\n"));
+  GetNode("out1")->MarkDirty();
+  GetNode("out2")->MarkDirty();
+  GetNode("out3")->MarkDirty();
+  plan_.set_memory_budget(4LL << 30);
+  std::string err;
+  EXPECT_TRUE(plan_.AddTarget(GetNode("out1"), &err));
+  EXPECT_TRUE(plan_.AddTarget(GetNode("out2"), &err));
+  EXPECT_TRUE(plan_.AddTarget(GetNode("out3"), &err));
+  ASSERT_EQ("", err);
+
+  Edge* first = plan_.FindWork();
+  ASSERT_TRUE(first);
+  ASSERT_EQ("out1", first->outputs_[0]->path());
+
+  // The second link would put 6G in flight against a 4G budget, so it
+  // is passed over; the unannotated edge still dispatches.
+  Edge* second = plan_.FindWork();
+  ASSERT_TRUE(second);
+  ASSERT_EQ("out3", second->outputs_[0]->path());
+  ASSERT_FALSE(plan_.FindWork());
+
+  // Finishing the first link frees its reservation and requeues the
+  // deferred one.
+  plan_.EdgeFinished(first, Plan::kEdgeSucceeded, &err);
+  ASSERT_EQ("", err);
+  Edge* third = plan_.FindWork();
+  ASSERT_TRUE(third);
+  ASSERT_EQ("out2", third->outputs_[0]->path());
+
+  plan_.EdgeFinished(second, Plan::kEdgeSucceeded, &err);
+  plan_.EdgeFinished(third, Plan::kEdgeSucceeded, &err);
+  ASSERT_EQ("", err);
+  ASSERT_FALSE(plan_.more_to_do());
+}
+
 TEST_F(PlanTest, PoolWithRedundantEdges) {
   ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
     "pool compile\n"
@@ -591,13 +702,14 @@ bool FakeCommandRunner::StartCommand(Edge* edge) {
       edge->rule().name() == "cat_rsp_out" ||
       edge->rule().name() == "cc" ||
       edge->rule().name() == "cp_multi_msvc" ||
+      edge->rule().name() == "cp_multi_msvc_streamed" ||
       edge->rule().name() == "cp_multi_gcc" ||
       edge->rule().name() == "touch" ||
       edge->rule().name() == "touch-interrupt" ||
       edge->rule().name() == "touch-fail-tick2") {
     for (const auto & item : edge->outputs_)
     {
-      fs_->Create(item->path(), "");
+      fs_->Create(std::string(item->path()), "");
     }
   } else if (edge->rule().name() == "true" ||
              edge->rule().name() == "fail" ||
@@ -609,9 +721,9 @@ bool FakeCommandRunner::StartCommand(Edge* edge) {
     assert(edge->outputs_.size() == 1);
     std::string content;
     std::string err;
-    if (fs_->ReadFile(edge->inputs_[0]->path(), &content, &err) ==
+    if (fs_->ReadFile(std::string(edge->inputs_[0]->path()), &content, &err) ==
         DiskInterface::Okay)
-      fs_->WriteFile(edge->outputs_[0]->path(), content);
+      fs_->WriteFile(std::string(edge->outputs_[0]->path()), content);
   } else {
     printf("unknown command\n");
     return false;
@@ -657,7 +769,18 @@ bool FakeCommandRunner::WaitForCommand(Result* result) {
     const std::string prefix = edge->GetBinding("msvc_deps_prefix");
     for(auto const& in : edge->inputs_)
     {
-      result->output += prefix + in->path() + '\n';
+      string_append(result->output, prefix, in->path(), "\n");
+    }
+  }
+
+  if (edge->rule().name() == "cp_multi_msvc_streamed") {
+    // Simulates the response of a persistent "-t msvc -s" helper: deps
+    // arrive as pre-filtered "<<<dep" records rather than /showIncludes
+    // lines.
+    result->output = "compiler chatter\n";
+    for(auto const& in : edge->inputs_)
+    {
+      string_append(result->output, "<<<dep ", in->path(), "\n");
     }
   }
 
@@ -785,6 +908,102 @@ TEST_F(BuildTest, TwoOutputs) {
   EXPECT_EQ("touch out1 out2", command_runner_.commands_ran_[0]);
 }
 
+TEST_F(BuildTest, BatchedEdges) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"rule touch\n"
+"  command = touch $out\n"
+"  batch = 4\n"
+"build out1: touch in1\n"
+"build out2: touch in2\n"
+"build out3: touch in3\n"
+"build out4: cat in1\n"));
+  fs_.Create("in3", "");
+
+  std::string err;
+  EXPECT_TRUE(builder_.AddTarget("out1", &err));
+  EXPECT_TRUE(builder_.AddTarget("out2", &err));
+  EXPECT_TRUE(builder_.AddTarget("out3", &err));
+  EXPECT_TRUE(builder_.AddTarget("out4", &err));
+  ASSERT_EQ("", err);
+  EXPECT_TRUE(builder_.Build(&err));
+  EXPECT_EQ("", err);
+
+  // The three touch edges coalesce into one invocation with their $out
+  // concatenated; the cat edge is not batchable and runs alone.
+  ASSERT_EQ(2u, command_runner_.commands_ran_.size());
+  bool saw_batch = false;
+  for (const std::string& command : command_runner_.commands_ran_) {
+    if (command.compare(0, 6, "touch ") != 0)
+      continue;
+    saw_batch = true;
+    EXPECT_NE(std::string::npos, command.find("out1"));
+    EXPECT_NE(std::string::npos, command.find("out2"));
+    EXPECT_NE(std::string::npos, command.find("out3"));
+  }
+  EXPECT_TRUE(saw_batch);
+}
+
+TEST_F(BuildTest, BatchLimitRespected) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"rule touch\n"
+"  command = touch $out\n"
+"  batch = 2\n"
+"build out1: touch in1\n"
+"build out2: touch in2\n"
+"build out3: touch in3\n"));
+  fs_.Create("in3", "");
+
+  std::string err;
+  EXPECT_TRUE(builder_.AddTarget("out1", &err));
+  EXPECT_TRUE(builder_.AddTarget("out2", &err));
+  EXPECT_TRUE(builder_.AddTarget("out3", &err));
+  ASSERT_EQ("", err);
+  EXPECT_TRUE(builder_.Build(&err));
+  EXPECT_EQ("", err);
+
+  // Three edges with a limit of two per invocation: a pair and a rest.
+  ASSERT_EQ(2u, command_runner_.commands_ran_.size());
+}
+
+TEST_F(BuildTest, QueuedTargetScannedDuringBuild) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"build out1: cat in1\n"
+"build out2: cat in2\n"));
+  fs_.Create("in1", "");
+  fs_.Create("in2", "");
+
+  // out2's dirty scan is deferred into Build(); its edge must still be
+  // folded into the plan and run.
+  std::string err;
+  EXPECT_TRUE(builder_.AddTarget("out1", &err));
+  ASSERT_EQ("", err);
+  builder_.QueueTarget(GetNode("out2"));
+  EXPECT_TRUE(builder_.HasQueuedTargets());
+  EXPECT_TRUE(builder_.Build(&err));
+  EXPECT_EQ("", err);
+  EXPECT_FALSE(builder_.HasQueuedTargets());
+  ASSERT_EQ(2u, command_runner_.commands_ran_.size());
+}
+
+TEST_F(BuildTest, QueuedTargetAlreadyUpToDate) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"build out1: cat in1\n"
+"build out2: cat in2\n"));
+  fs_.Create("in1", "");
+  fs_.Create("in2", "");
+  fs_.Create("out2", "");
+
+  // A queued target that turns out clean must not fail the build.
+  std::string err;
+  EXPECT_TRUE(builder_.AddTarget("out1", &err));
+  ASSERT_EQ("", err);
+  builder_.QueueTarget(GetNode("out2"));
+  EXPECT_TRUE(builder_.Build(&err));
+  EXPECT_EQ("", err);
+  ASSERT_EQ(1u, command_runner_.commands_ran_.size());
+  EXPECT_EQ("cat in1 > out1", command_runner_.commands_ran_[0]);
+}
+
 TEST_F(BuildTest, ImplicitOutput) {
   ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
 "rule touch\n"
@@ -1590,6 +1809,48 @@ TEST_F(BuildWithLogTest, RestatMissingInput) {
   ASSERT_EQ(restat_mtime, log_entry->mtime);
 }
 
+TEST_F(BuildWithLogTest, HashInputsUnchangedContent) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"rule hashcat\n"
+"  command = cat\n"
+"  hash_inputs = 1\n"
+"build out: hashcat in\n"));
+
+  fs_.Create("in", "content");
+
+  std::string err;
+  EXPECT_TRUE(builder_.AddTarget("out", &err));
+  ASSERT_EQ("", err);
+  EXPECT_TRUE(builder_.Build(&err));
+  ASSERT_EQ(1u, command_runner_.commands_ran_.size());
+
+  BuildLog::LogEntry* log_entry = build_log_.LookupByOutput("out");
+  ASSERT_TRUE(nullptr != log_entry);
+  ASSERT_NE(0u, log_entry->input_hash);
+
+  // Rewrite the input with identical content but a fresh mtime; the
+  // recorded input hash still matches, so the output stays clean.
+  fs_.Tick();
+  fs_.Create("in", "content");
+
+  command_runner_.commands_ran_.clear();
+  state_.Reset();
+  EXPECT_TRUE(builder_.AddTarget("out", &err));
+  ASSERT_EQ("", err);
+  EXPECT_TRUE(builder_.AlreadyUpToDate());
+
+  // Actually changing the content does rebuild.
+  fs_.Tick();
+  fs_.Create("in", "changed");
+
+  command_runner_.commands_ran_.clear();
+  state_.Reset();
+  EXPECT_TRUE(builder_.AddTarget("out", &err));
+  ASSERT_EQ("", err);
+  EXPECT_TRUE(builder_.Build(&err));
+  ASSERT_EQ(1u, command_runner_.commands_ran_.size());
+}
+
 struct BuildDryRun : public BuildWithLogTest {
   BuildDryRun() {
     config_.dry_run = true;
@@ -1865,6 +2126,15 @@ TEST_F(BuildTest, StatusFormatElapsed) {
                 BuildStatus::kEdgeStarted));
 }
 
+TEST_F(BuildTest, StatusFormatEstimatedRemaining) {
+  status_.BuildStarted();
+  // With no recorded history and nothing running or finished there is
+  // no basis for an estimate; both placeholders degrade to '?'.
+  EXPECT_EQ("[E?/F?]",
+            status_.FormatProgressStatus("[E%E/F%F]",
+                BuildStatus::kEdgeStarted));
+}
+
 TEST_F(BuildTest, StatusFormatReplacePlaceholder) {
   EXPECT_EQ("[%/s0/t0/r0/u0/f0]",
             status_.FormatProgressStatus("[%%/s%s/t%t/r%r/u%u/f%f]",
@@ -1940,6 +2210,34 @@ TEST_F(BuildWithQueryDepsLogTest, TwoOutputsDepFileMSVC) {
   EXPECT_EQ("in1", out2_deps->nodes[0]->path());
 }
 
+/// Deps handed over as "<<<dep" records by a persistent msvc helper
+/// bypass CLParser and land in the deps log directly; the records are
+/// stripped from the displayed output.
+TEST_F(BuildWithQueryDepsLogTest, TwoOutputsStreamedMSVC) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"rule cp_multi_msvc_streamed\n"
+"    command = for file in $out; do cp $in $$file; done\n"
+"    deps = msvc\n"
+"build out1 out2: cp_multi_msvc_streamed in1\n"));
+
+  std::string err;
+  EXPECT_TRUE(builder_.AddTarget("out1", &err));
+  ASSERT_EQ("", err);
+  EXPECT_TRUE(builder_.Build(&err));
+  EXPECT_EQ("", err);
+  ASSERT_EQ(1u, command_runner_.commands_ran_.size());
+
+  Node* out1_node = state_.LookupNode("out1");
+  DepsLog::Deps* out1_deps = log_.GetDeps(out1_node);
+  EXPECT_EQ(1, out1_deps->node_count);
+  EXPECT_EQ("in1", out1_deps->nodes[0]->path());
+
+  Node* out2_node = state_.LookupNode("out2");
+  DepsLog::Deps* out2_deps = log_.GetDeps(out2_node);
+  EXPECT_EQ(1, out2_deps->node_count);
+  EXPECT_EQ("in1", out2_deps->nodes[0]->path());
+}
+
 /// Test a GCC-style deps log with multiple outputs.
 TEST_F(BuildWithQueryDepsLogTest, TwoOutputsDepFileGCCOneLine) {
   ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
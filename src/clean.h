@@ -17,6 +17,7 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 #include "build.h"
 #include "dyndep.h"
@@ -81,8 +82,13 @@ struct Cleaner final {
   bool FileExists(const std::string& path);
   void Report(const std::string& path);
 
-  /// Remove the given @a path file only if it has not been already removed.
+  /// Queue the given @a path file for removal, only if it has not been
+  /// queued already.  (Dry runs report it immediately instead.)
   void Remove(const std::string& path);
+  /// Unlink everything Remove() queued -- on worker threads when the disk
+  /// interface allows it and the batch is worth it -- then report the
+  /// results.  Every entry point calls this once before its footer.
+  void FinishRemoval();
   /// @return whether the given @a path has already been removed.
   bool IsAlreadyRemoved(const std::string& path);
   /// Remove the depfile and rspfile for an Edge.
@@ -103,6 +109,11 @@ struct Cleaner final {
   DyndepLoader dyndep_loader_;
   std::set<std::string> removed_;
   std::set<Node*> cleaned_;
+  /// Paths queued by Remove() and unlinked by FinishRemoval().
+  std::vector<std::string> pending_;
+  /// How long FinishRemoval() spent unlinking, for the footer's
+  /// throughput line.
+  int64_t removal_millis_ = 0;
   int cleaned_files_count_ = 0;
   DiskInterface* disk_interface_;
   int status_ = 0;
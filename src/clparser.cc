@@ -18,24 +18,79 @@
 #include <assert.h>
 #include <string.h>
 
+#include <string_view>
+
 #include "metrics.h"
 #include "string_piece_util.h"
 
 #ifdef _WIN32
 #include "includes_normalize.h"
-#include <string_view>
 #else
 #include "util.h"
 #endif
 
+#if defined(__SSE2__) || (defined(_MSC_VER) && \
+    (defined(_M_X64) || defined(_M_IX86)))
+#include <emmintrin.h>
+#define NINJA_CLPARSER_SSE2
+#endif
+
 using namespace std;
 
 namespace {
 
-/// Return true if \a input ends with \a needle.
-bool EndsWith(const std::string& input, const std::string& needle) {
-  return (input.size() >= needle.size() &&
-          input.substr(input.size() - needle.size()) == needle);
+/// The /showIncludes prefix cl.exe prints when no localized
+/// msvc_deps_prefix is configured.
+constexpr std::string_view kDepsPrefixEnglish = "Note: including file: ";
+
+/// Return true if \a line starts with \a prefix.  A /showIncludes run
+/// tests every output line against the same 22-byte prefix, so the first
+/// 16 bytes are matched with a single vector compare where available.
+bool HasPrefix(std::string_view line, std::string_view prefix) {
+  if (line.size() < prefix.size())
+    return false;
+#ifdef NINJA_CLPARSER_SSE2
+  if (prefix.size() >= 16) {
+    __m128i line_head = _mm_loadu_si128((const __m128i*)line.data());
+    __m128i prefix_head = _mm_loadu_si128((const __m128i*)prefix.data());
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(line_head, prefix_head)) != 0xffff)
+      return false;
+    return memcmp(line.data() + 16, prefix.data() + 16,
+                  prefix.size() - 16) == 0;
+  }
+#endif
+  return memcmp(line.data(), prefix.data(), prefix.size()) == 0;
+}
+
+/// FilterShowIncludes without the std::string round trips; the returned
+/// view points into \a line.
+std::string_view FilterShowIncludesView(std::string_view line,
+                                        std::string_view prefix) {
+  if (line.size() > prefix.size() && HasPrefix(line, prefix)) {
+    line.remove_prefix(prefix.size());
+    while (!line.empty() && line.front() == ' ')
+      line.remove_prefix(1);
+    return line;
+  }
+  return {};
+}
+
+/// FilterInputFilename without copying and lowercasing the whole line:
+/// only the extension needs a case-insensitive compare.
+bool FilterInputFilenameView(std::string_view line) {
+  auto ends_with = [line](std::string_view suffix) {
+    if (line.size() < suffix.size())
+      return false;
+    const char* tail = line.data() + line.size() - suffix.size();
+    for (size_t i = 0; i < suffix.size(); ++i) {
+      if (ToLowerASCII(tail[i]) != suffix[i])
+        return false;
+    }
+    return true;
+  };
+  // TODO: other extensions, like .asm?
+  return ends_with(".c") || ends_with(".cc") || ends_with(".cxx") ||
+         ends_with(".cpp");
 }
 
 }  // anonymous namespace
@@ -43,18 +98,9 @@ bool EndsWith(const std::string& input, const std::string& needle) {
 // static
 std::string CLParser::FilterShowIncludes(const std::string& line,
                                     const std::string& deps_prefix) {
-  const std::string kDepsPrefixEnglish = "Note: including file: ";
-  const char* in = line.c_str();
-  const char* end = in + line.size();
-  const std::string& prefix = deps_prefix.empty() ? kDepsPrefixEnglish : deps_prefix;
-  if (end - in > (int)prefix.size() &&
-      memcmp(in, prefix.c_str(), (int)prefix.size()) == 0) {
-    in += prefix.size();
-    while (*in == ' ')
-      ++in;
-    return line.substr(in - line.c_str());
-  }
-  return "";
+  std::string_view prefix = deps_prefix.empty() ? kDepsPrefixEnglish
+                                                : std::string_view(deps_prefix);
+  return std::string(FilterShowIncludesView(line, prefix));
 }
 
 // static
@@ -67,12 +113,7 @@ bool CLParser::IsSystemInclude(std::string path) {
 
 // static
 bool CLParser::FilterInputFilename(std::string line) {
-  transform(line.begin(), line.end(), line.begin(), ToLowerASCII);
-  // TODO: other extensions, like .asm?
-  return EndsWith(line, ".c") ||
-      EndsWith(line, ".cc") ||
-      EndsWith(line, ".cxx") ||
-      EndsWith(line, ".cpp");
+  return FilterInputFilenameView(line);
 }
 
 // static
@@ -80,24 +121,94 @@ bool CLParser::Parse(const std::string& output, const std::string& deps_prefix,
                      std::string* filtered_output, std::string* err) {
   METRIC_RECORD("CLParser::Parse");
 
-  // Loop over all lines in the output to process them.
   assert(&output != filtered_output);
-  size_t start = 0;
+  std::string_view prefix = deps_prefix.empty() ? kDepsPrefixEnglish
+                                                : std::string_view(deps_prefix);
+  return ParseRange(output.data(), output.data() + output.size(), prefix,
+                    filtered_output, err);
+}
+
+bool CLParser::Feed(const char* data, size_t len,
+                    const std::string& deps_prefix,
+                    std::string* filtered_output, std::string* err) {
+  pending_.append(data, len);
+
+  // Find the end of the last complete line buffered so far.  A trailing
+  // '\r' is held back too: it may be the first half of a "\r\n" pair
+  // whose '\n' has not arrived yet.
+  size_t cut = 0;
+  for (size_t i = pending_.size(); i > 0; --i) {
+    char c = pending_[i - 1];
+    if (c == '\n') {
+      cut = i;
+      break;
+    }
+    if (c == '\r' && i < pending_.size()) {
+      cut = pending_[i] == '\n' ? i + 1 : i;
+      break;
+    }
+  }
+  if (cut == 0)
+    return true;
+
+  std::string_view prefix = deps_prefix.empty() ? kDepsPrefixEnglish
+                                                : std::string_view(deps_prefix);
+  if (!ParseRange(pending_.data(), pending_.data() + cut, prefix,
+                  filtered_output, err))
+    return false;
+  pending_.erase(0, cut);
+  return true;
+}
+
+bool CLParser::Finish(const std::string& deps_prefix,
+                      std::string* filtered_output, std::string* err) {
+  if (pending_.empty())
+    return true;
+  std::string tail;
+  tail.swap(pending_);
+  std::string_view prefix = deps_prefix.empty() ? kDepsPrefixEnglish
+                                                : std::string_view(deps_prefix);
+  return ParseRange(tail.data(), tail.data() + tail.size(), prefix,
+                    filtered_output, err);
+}
+
+bool CLParser::ParseRange(const char* begin, const char* end,
+                          std::string_view prefix,
+                          std::string* filtered_output, std::string* err) {
 #ifdef _WIN32
   IncludesNormalize normalizer(".");
 #endif
 
-  while (start < output.size()) {
-    size_t end = output.find_first_of("\r\n", start);
-    if (end == std::string::npos)
-      end = output.size();
-    std::string line = output.substr(start, end - start);
+  // Walk the lines with memchr, which scans for the terminators a vector
+  // register at a time; lines themselves are string_views into the
+  // output, so dropped chatter costs no copies at all and kept lines are
+  // appended straight into filtered_output.
+  const char* cursor = begin;
+  const char* output_end = end;
+  while (cursor < output_end) {
+    const char* line_end =
+        (const char*)memchr(cursor, '\n', output_end - cursor);
+    const char* next = line_end ? line_end + 1 : output_end;
+    if (!line_end)
+      line_end = output_end;
+    // cl.exe terminates lines with "\r\n"; a bare "\r" also ends the
+    // line, the way the find_first_of("\r\n") loop before this one
+    // treated it.
+    if (const char* cr =
+            (const char*)memchr(cursor, '\r', line_end - cursor)) {
+      next = cr + 1;
+      if (next < output_end && *next == '\n')
+        ++next;
+      line_end = cr;
+    }
+    std::string_view line(cursor, line_end - cursor);
+    cursor = next;
 
-    std::string include = FilterShowIncludes(line, deps_prefix);
+    std::string_view include = FilterShowIncludesView(line, prefix);
     if (!include.empty()) {
       std::string normalized;
 #ifdef _WIN32
-      if (!normalizer.Normalize(include, &normalized, err))
+      if (!normalizer.Normalize(std::string(include), &normalized, err))
         return false;
 #else
       // TODO: should this make the path relative to cwd?
@@ -108,7 +219,7 @@ bool CLParser::Parse(const std::string& output, const std::string& deps_prefix,
 #endif
       if (!IsSystemInclude(normalized))
         includes_.insert(normalized);
-    } else if (FilterInputFilename(line)) {
+    } else if (FilterInputFilenameView(line)) {
       // Drop it.
       // TODO: if we support compiling multiple output files in a single
       // cl.exe invocation, we should stash the filename.
@@ -116,12 +227,6 @@ bool CLParser::Parse(const std::string& output, const std::string& deps_prefix,
       filtered_output->append(line);
       filtered_output->append("\n");
     }
-
-    if (end < output.size() && output[end] == '\r')
-      ++end;
-    if (end < output.size() && output[end] == '\n')
-      ++end;
-    start = end;
   }
 
   return true;
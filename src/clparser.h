@@ -17,6 +17,7 @@
 
 #include <set>
 #include <string>
+#include <string_view>
 
 /// Visual Studio's cl.exe requires some massaging to work with Ninja;
 /// for example, it emits include information on stderr in a funny
@@ -45,7 +46,27 @@ struct CLParser final {
   bool Parse(const std::string& output, const std::string& deps_prefix,
              std::string* filtered_output, std::string* err);
 
+  /// Incremental variant of Parse() for callers that receive the output
+  /// a pipe chunk at a time: every complete line buffered so far is
+  /// parsed immediately and a trailing partial line is carried over to
+  /// the next call, so includes_ keeps pace with the compiler instead of
+  /// being recovered by an output-sized reparse after it exits.
+  /// Finish() parses whatever remains once the stream ends.
+  bool Feed(const char* data, size_t len, const std::string& deps_prefix,
+            std::string* filtered_output, std::string* err);
+  bool Finish(const std::string& deps_prefix, std::string* filtered_output,
+              std::string* err);
+
   std::set<std::string> includes_;
+
+ private:
+  /// The parse loop shared by Parse() and Feed(); [begin, end) must end
+  /// on a line boundary except for the final call over a stream.
+  bool ParseRange(const char* begin, const char* end, std::string_view prefix,
+                  std::string* filtered_output, std::string* err);
+
+  /// Partial trailing line carried between Feed() calls.
+  std::string pending_;
 };
 
 #endif  // NINJA_CLPARSER_H_
@@ -102,6 +102,41 @@ TEST(CLParserTest, DuplicatedHeader) {
   ASSERT_EQ(2u, parser.includes_.size());
 }
 
+TEST(CLParserTest, FeedChunked) {
+  // Feed the output one byte at a time, the way a pipe might deliver it;
+  // the result must match a whole-buffer Parse(), including the "\r\n"
+  // pairs split across chunks.
+  const std::string kInput =
+      "foo\r\n"
+      "Note: including file: foo.h\r\n"
+      "Note: including file: foo.h\r\n"
+      "bar\r\n";
+  CLParser parser;
+  std::string output;
+  std::string err;
+  for (size_t i = 0; i < kInput.size(); ++i)
+    ASSERT_TRUE(parser.Feed(kInput.data() + i, 1, "", &output, &err));
+  ASSERT_TRUE(parser.Finish("", &output, &err));
+
+  ASSERT_EQ("foo\nbar\n", output);
+  ASSERT_EQ(1u, parser.includes_.size());
+  ASSERT_EQ("foo.h", *parser.includes_.begin());
+}
+
+TEST(CLParserTest, FeedUnterminatedTail) {
+  // A final line without a terminator is held back until Finish().
+  CLParser parser;
+  std::string output;
+  std::string err;
+  const std::string kInput = "foo\r\nNote: including file: tail.h";
+  ASSERT_TRUE(parser.Feed(kInput.data(), kInput.size(), "", &output, &err));
+  ASSERT_EQ(0u, parser.includes_.size());
+  ASSERT_TRUE(parser.Finish("", &output, &err));
+  ASSERT_EQ("foo\n", output);
+  ASSERT_EQ(1u, parser.includes_.size());
+  ASSERT_EQ("tail.h", *parser.includes_.begin());
+}
+
 TEST(CLParserTest, DuplicatedHeaderPathConverted) {
   CLParser parser;
   std::string output;
@@ -30,4 +30,8 @@ extern bool g_keep_rsp;
 
 extern bool g_experimental_statcache;
 
+/// -d prefault: fault the build log, deps log and manifest mappings in
+/// up front instead of one page at a time during the first scan.
+extern bool g_prefault;
+
 #endif // NINJA_EXPLAIN_H_
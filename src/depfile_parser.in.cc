@@ -15,10 +15,94 @@
 #include "depfile_parser.h"
 #include "util.h"
 
+#include <stdint.h>
+
 #include <algorithm>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
+namespace {
+
+/// True for bytes the escape-free filename rule below consumes, i.e.
+/// [a-zA-Z0-9+,/_:.~()}{%=@\x5B\x5D!\x80-\xFF-].
+inline bool IsPlainDepfileChar(char c) {
+  unsigned char u = static_cast<unsigned char>(c);
+  if (u >= 0x80)
+    return true;
+  if ((u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') ||
+      (u >= '0' && u <= '9'))
+    return true;
+  switch (u) {
+  case '+': case ',': case '-': case '.': case '/': case ':': case '=':
+  case '_': case '~': case '(': case ')': case '{': case '}': case '%':
+  case '@': case '[': case ']': case '!':
+    return true;
+  default:
+    return false;
+  }
+}
+
+#if defined(__SSE2__)
+/// All lanes 0xff where the byte is in [lo, hi].  Bounds must be ASCII so
+/// signed compares suffice.
+inline __m128i InByteRange(__m128i v, char lo, char hi) {
+  return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                       _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), v));
+}
+#endif
+
+/// Return the end of the run of plain filename bytes starting at \a p.
+/// GCC/Clang-emitted depfiles are almost entirely such runs, so this is
+/// where Parse spends its time; the caller only enters the re2c machine
+/// for escapes and separators.  The input is NUL-terminated and NUL is
+/// not a plain byte, so the scan stops at the terminator, and the 16-byte
+/// loads are aligned and therefore never touch an unmapped page.
+char* SkipPlainDepfileChars(char* p) {
+#if defined(__SSE2__)
+  while ((reinterpret_cast<uintptr_t>(p) & 15) != 0) {
+    if (!IsPlainDepfileChar(*p))
+      return p;
+    ++p;
+  }
+  for (;;) {
+    __m128i chunk = _mm_load_si128(reinterpret_cast<const __m128i*>(p));
+    // \x80-\xFF: the sign bit is set.
+    __m128i plain = _mm_cmplt_epi8(chunk, _mm_setzero_si128());
+    // '('..':' covers ()+,-./0-9: but not '*'.
+    __m128i range = InByteRange(chunk, '(', ':');
+    range = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('*')), range);
+    plain = _mm_or_si128(plain, range);
+    // '@'..']' covers @A-Z[] but not '\\'.
+    range = InByteRange(chunk, '@', ']');
+    range = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\')), range);
+    plain = _mm_or_si128(plain, range);
+    // '_'..'{' covers _a-z{ but not '`'.
+    range = InByteRange(chunk, '_', '{');
+    range = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('`')), range);
+    plain = _mm_or_si128(plain, range);
+    plain = _mm_or_si128(plain, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('!')));
+    plain = _mm_or_si128(plain, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('%')));
+    plain = _mm_or_si128(plain, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('=')));
+    plain = _mm_or_si128(plain, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('}')));
+    plain = _mm_or_si128(plain, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('~')));
+    int mask = _mm_movemask_epi8(plain) ^ 0xffff;
+    if (mask)
+      return p + __builtin_ctz(mask);
+    p += 16;
+  }
+#else
+  while (IsPlainDepfileChar(*p))
+    ++p;
+  return p;
+#endif
+}
+
+}  // anonymous namespace
+
 DepfileParser::DepfileParser(DepfileParserOptions options)
   : options_(options)
 {
@@ -64,6 +148,19 @@ bool DepfileParser::Parse(std::string* content, std::string* err) {
       // start: beginning of the current parsed span.
       const char* start = in;
       char* yymarker = nullptr;
+
+      // Consume an escape-free span without entering the machine below;
+      // this mirrors its plain-text rule, including the shift over
+      // previously de-escaped output.
+      char* span_end = SkipPlainDepfileChars(in);
+      if (span_end != in) {
+        int len = (int)(span_end - in);
+        if (out < start)
+          memmove(out, start, len);
+        out += len;
+        in = span_end;
+        continue;
+      }
       /*!re2c
       re2c:define:YYCTYPE = "unsigned char";
       re2c:define:YYCURSOR = in;
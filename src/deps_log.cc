@@ -19,13 +19,22 @@
 #include <errno.h>
 #include <string.h>
 #ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #elif defined(_MSC_VER) && (_MSC_VER < 1900)
 typedef __int32 int32_t;
 typedef unsigned __int32 uint32_t;
 #endif
 
+#include <algorithm>
+#include <iterator>
+
+#include "async_writer.h"
+#include "debug_flags.h"
 #include "graph.h"
+#include "mem_advice.h"
 #include "metrics.h"
 #include "state.h"
 #include "util.h"
@@ -35,25 +44,87 @@ using namespace std;
 // The version is stored as 4 bytes after the signature and also serves as a
 // byte order mark. Signature and version combined are 16 bytes long.
 const char kFileSignature[] = "# ninjadeps\n";
-const int kCurrentVersion = 4;
+// v5 varint-encodes deps records and prefix-compresses path records.
+const int kCurrentVersion = 5;
+// v4 logs (fixed 4-byte fields) still load and are migrated to v5 by the
+// background recompaction.
+const int kOldestSupportedVersion = 4;
 
 // Record size is currently limited to less than the full 32 bit, due to
 // internal buffers having to have this size.
 const unsigned kMaxRecordSize = (1 << 19) - 1;
 
+// The side index maps node id to the offset of that id's latest deps
+// record, so a load can skip superseded records without decoding them.
+// Its header stores the log size it was written against; any mismatch
+// (crash, truncation recovery, concurrent writer) invalidates it.
+const char kIndexSignature[] = "# ninjadepsidx\n";
+const int kIndexVersion = 1;
+
+namespace {
+
+void PutUVarint(std::string* out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+bool GetUVarint(const char** cursor, const char* end, uint64_t* value) {
+  uint64_t result = 0;
+  for (int shift = 0; *cursor != end && shift < 64; shift += 7) {
+    unsigned char byte = **cursor;
+    ++*cursor;
+    result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Dep id deltas are signed (the lists keep their original order, which
+// rebuild comparisons depend on), so they are zigzag-mapped onto varints.
+uint64_t ZigZagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t ZigZagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+}  // anonymous namespace
+
 DepsLog::~DepsLog() {
   Close();
 }
 
 bool DepsLog::OpenForWrite(const std::string& path, std::string* err) {
-  if (needs_recompaction_) {
+  // A log in an older format has to be rewritten as the current version
+  // before this build appends to it, so the one-time migration is
+  // synchronous.
+  if (needs_migration_) {
     if (!Recompact(path, err))
       return false;
+    needs_migration_ = false;
+    needs_recompaction_ = false;
   }
 
   assert(!file_);
   file_path_ = path;  // we don't actually open the file right now, but will do
                       // so on the first write attempt
+  log_path_ = path;
+
+  // Collect dead records on a background thread while this build appends
+  // to the live log; Close() swaps the compacted file in at the next
+  // quiet point.  Recompaction is opportunistic, so a failure to start it
+  // is not an error.
+  if (needs_recompaction_)
+    StartBackgroundRecompact();
+
   return true;
 }
 
@@ -104,33 +175,29 @@ bool DepsLog::RecordDeps(Node* node, TimeStamp mtime,
     return true;
 
   // Update on-disk representation.
-  unsigned size = 4 * (1 + 2 + node_count);
-  if (size > kMaxRecordSize) {
-    errno = ERANGE;
-    return false;
-  }
-
   if (!OpenForWriteIfNeeded()) {
     return false;
   }
-  size |= 0x80000000;  // Deps record: set high bit.
-  if (fwrite(&size, 4, 1, file_) < 1)
-    return false;
-  int id = node->id();
-  if (fwrite(&id, 4, 1, file_) < 1)
-    return false;
-  uint32_t mtime_part = static_cast<uint32_t>(mtime & 0xffffffff);
-  if (fwrite(&mtime_part, 4, 1, file_) < 1)
-    return false;
-  mtime_part = static_cast<uint32_t>((mtime >> 32) & 0xffffffff);
-  if (fwrite(&mtime_part, 4, 1, file_) < 1)
-    return false;
+  std::string payload;
+  payload.reserve(12 + 2 * node_count);
+  PutUVarint(&payload, static_cast<uint64_t>(node->id()));
+  PutUVarint(&payload, static_cast<uint64_t>(mtime));
+  int prev_id = 0;
   for (int i = 0; i < node_count; ++i) {
-    id = nodes[i]->id();
-    if (fwrite(&id, 4, 1, file_) < 1)
-      return false;
+    PutUVarint(&payload, ZigZagEncode(nodes[i]->id() - prev_id));
+    prev_id = nodes[i]->id();
+  }
+  if (payload.size() > kMaxRecordSize) {
+    errno = ERANGE;
+    return false;
   }
-  if (fflush(file_) != 0)
+  unsigned size = payload.size() | 0x80000000;  // Deps record: set high bit.
+  std::string record;
+  record.reserve(4 + payload.size());
+  record.append(reinterpret_cast<const char*>(&size), 4);
+  record.append(payload);
+  uint64_t record_offset = write_offset_;
+  if (!WriteRecord(std::move(record)))
     return false;
 
   // Update in-memory representation.
@@ -138,133 +205,374 @@ bool DepsLog::RecordDeps(Node* node, TimeStamp mtime,
   for (int i = 0; i < node_count; ++i)
     deps->nodes[i] = nodes[i];
   UpdateDeps(node->id(), deps);
+  if ((int)deps_offsets_.size() <= node->id())
+    deps_offsets_.resize(node->id() + 1);
+  deps_offsets_[node->id()] = record_offset;
+  if (recompact_running_)
+    dirty_since_compact_.push_back(node->id());
+
+  return true;
+}
+
+void DepsLog::StageDeps(Node* node, TimeStamp mtime, std::vector<Node*> nodes) {
+  StagingShard& shard =
+      staging_[std::hash<std::thread::id>()(std::this_thread::get_id()) %
+               kStagingShards];
+  uint64_t sequence = staging_sequence_.fetch_add(1, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.entries.push_back(StagedDeps{ sequence, node, mtime,
+                                      std::move(nodes) });
+}
+
+bool DepsLog::FlushStagedDeps() {
+  // Grab every shard's buffer, then replay in global staging order so the
+  // log records what the finishers actually observed, shard layout aside.
+  std::vector<StagedDeps> staged;
+  for (auto & shard : staging_)
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (staged.empty()) {
+      staged.swap(shard.entries);
+    } else {
+      std::move(shard.entries.begin(), shard.entries.end(),
+                std::back_inserter(staged));
+      shard.entries.clear();
+    }
+  }
+  std::sort(staged.begin(), staged.end(),
+            [](const StagedDeps& a, const StagedDeps& b) {
+              return a.sequence < b.sequence;
+            });
 
+  for (const auto & entry : staged)
+  {
+    if (!RecordDeps(entry.node, entry.mtime, entry.nodes))
+      return false;
+  }
   return true;
 }
 
 void DepsLog::Close() {
+  // Anything still parked in the staging buffers has to make it to disk.
+  FlushStagedDeps();
+  // Callers wanting the error message Drain() the writer themselves first.
+  if (async_writer_) {
+    std::string err;
+    async_writer_->Drain(&err);
+  }
   OpenForWriteIfNeeded();  // create the file even if nothing has been recorded
   if (file_)
     fclose(file_);
   file_ = nullptr;
+  // With the live log closed this is the quiet point where a background
+  // recompaction can take its place.
+  bool swapped = FinishBackgroundRecompact();
+
+  if (log_path_.empty())
+    return;
+  // After a swap deps_offsets_ already describes the new file.  Otherwise
+  // make sure every live entry got an offset before trusting the index;
+  // if a write failed halfway the index would wrongly declare records
+  // dead.
+  bool complete = true;
+  if (!swapped) {
+    for (size_t id = 0; id < deps_.size(); ++id) {
+      if (deps_[id] &&
+          (id >= deps_offsets_.size() || deps_offsets_[id] == 0)) {
+        complete = false;
+        break;
+      }
+    }
+  }
+  if (complete)
+    WriteIndex();
+  else
+    unlink((log_path_ + ".index").c_str());
+  log_path_.clear();
 }
 
-LoadStatus DepsLog::Load(const std::string& path, State* state, std::string* err) {
+#ifndef _WIN32
+namespace {
+
+/// A read-only mapping of the deps log, released when the load returns.
+/// Node paths parsed out of it are interned into the State's path arena,
+/// so nothing points into the mapping afterwards.
+struct LogMapping {
+  char* data = nullptr;
+  size_t size = 0;
+  ~LogMapping() {
+    if (data)
+      munmap(data, size);
+  }
+};
+
+}  // anonymous namespace
+#endif  // !_WIN32
+
+LoadStatus DepsLog::Load(const std::string& path, State* state,
+                         std::string* err) {
+  const LoadStatus status = LoadRecords(path, err);
+  if (status != LOAD_ERROR)
+    ApplyLoad(state);
+  return status;
+}
+
+LoadStatus DepsLog::LoadRecords(const std::string& path, std::string* err) {
   METRIC_RECORD(".ninja_deps load");
-  char buf[kMaxRecordSize + 1];
-  FILE* f = fopen(path.c_str(), "rb");
-  if (!f) {
-    if (errno == ENOENT)
-      return LOAD_NOT_FOUND;
-    *err = strerror(errno);
-    return LOAD_ERROR;
+
+  // Bring the whole log into memory and parse it in place: a read-only
+  // mapping (one fread on Windows) replaces the per-record fread+copy
+  // loop, so loading is bounded by page-fault throughput rather than copy
+  // bandwidth.
+  std::string_view data;
+#ifndef _WIN32
+  LogMapping mapping;
+  {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      if (errno == ENOENT)
+        return LOAD_NOT_FOUND;
+      *err = strerror(errno);
+      return LOAD_ERROR;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+      *err = strerror(errno);
+      close(fd);
+      return LOAD_ERROR;
+    }
+    if (st.st_size > 0) {
+      void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map == MAP_FAILED) {
+        *err = strerror(errno);
+        close(fd);
+        return LOAD_ERROR;
+      }
+      mapping.data = static_cast<char*>(map);
+      mapping.size = static_cast<size_t>(st.st_size);
+      AdviseHugePages(mapping.data, mapping.size);
+      if (g_prefault)
+        PrefaultMapping(mapping.data, mapping.size);
+      data = std::string_view(mapping.data, mapping.size);
+    }
+    close(fd);
+  }
+#else
+  std::string contents;
+  {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+      if (errno == ENOENT)
+        return LOAD_NOT_FOUND;
+      *err = strerror(errno);
+      return LOAD_ERROR;
+    }
+    fseek(f, 0, SEEK_END);
+    long file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (file_size > 0) {
+      contents.resize(file_size);
+      if (fread(&contents[0], file_size, 1, f) < 1) {
+        *err = strerror(errno);
+        fclose(f);
+        return LOAD_ERROR;
+      }
+    }
+    fclose(f);
   }
+  data = contents;
+#endif
 
-  bool valid_header = true;
+  const size_t kSignatureSize = sizeof(kFileSignature) - 1;
+  const size_t kHeaderSize = kSignatureSize + 4;
   int version = 0;
-  if (!fgets(buf, sizeof(buf), f) || fread(&version, 4, 1, f) < 1)
-    valid_header = false;
+  bool valid_header =
+      data.size() >= kHeaderSize &&
+      memcmp(data.data(), kFileSignature, kSignatureSize) == 0;
+  if (valid_header)
+    memcpy(&version, data.data() + kSignatureSize, 4);
   // Note: For version differences, this should migrate to the new format.
   // But the v1 format could sometimes (rarely) end up with invalid data, so
   // don't migrate v1 to v3 to force a rebuild. (v2 only existed for a few days,
   // and there was no release with it, so pretend that it never happened.)
-  if (!valid_header || strcmp(buf, kFileSignature) != 0 ||
-      version != kCurrentVersion) {
+  if (!valid_header || version < kOldestSupportedVersion ||
+      version > kCurrentVersion) {
     if (version == 1)
       *err = "deps log version change; rebuilding";
     else
       *err = "bad deps log signature or version; starting over";
-    fclose(f);
     unlink(path.c_str());
     // Don't report this as a failure.  An empty deps log will cause
     // us to rebuild the outputs anyway.
     return LOAD_SUCCESS;
   }
 
+  const char* const begin = data.data();
+  const char* const end = begin + data.size();
+  const char* cursor = begin + kHeaderSize;
   long offset;
   bool read_failed = false;
   int unique_dep_record_count = 0;
   int total_dep_record_count = 0;
+  // With a valid index from the previous run, any deps record whose
+  // offset is not listed has been superseded and is skipped without
+  // being decoded.
+  std::vector<uint64_t> live_offsets;
+  bool have_index = LoadIndex(path, data.size(), &live_offsets);
+  // The most recent path record, needed to expand v5 prefix compression.
+  std::string last_path;
+  // Scratch storage for v5 delta decoding, reused across records.
+  std::vector<int> dep_ids;
   for (;;) {
-    offset = ftell(f);
+    offset = cursor - begin;
 
-    unsigned size;
-    if (fread(&size, 4, 1, f) < 1) {
-      if (!feof(f))
-        read_failed = true;
+    if (end - cursor < 4) {
+      if (cursor != end)
+        read_failed = true;  // A trailing partial size field.
       break;
     }
+    unsigned size;
+    memcpy(&size, cursor, 4);
+    cursor += 4;
     bool is_deps = (size >> 31) != 0;
     size = size & 0x7FFFFFFF;
 
-    if (size > kMaxRecordSize || fread(buf, size, 1, f) < 1) {
+    if (size > kMaxRecordSize ||
+        size > static_cast<size_t>(end - cursor)) {
       read_failed = true;
       break;
     }
+    const char* record = cursor;
+    cursor += size;
 
     if (is_deps) {
-      assert(size % 4 == 0);
-      int* deps_data = reinterpret_cast<int*>(buf);
-      int out_id = deps_data[0];
+      if (have_index &&
+          !std::binary_search(live_offsets.begin(), live_offsets.end(),
+                              static_cast<uint64_t>(offset))) {
+        total_dep_record_count++;
+        continue;
+      }
+      int out_id;
       TimeStamp mtime;
-      mtime = (TimeStamp)(((uint64_t)(unsigned int)deps_data[2] << 32) |
-                          (uint64_t)(unsigned int)deps_data[1]);
-      deps_data += 3;
-      int deps_count = (size / 4) - 3;
+      int deps_count;
+      const int* v4_ids = nullptr;
+      if (version >= 5) {
+        const char* p = record;
+        const char* pe = record + size;
+        uint64_t value;
+        if (!GetUVarint(&p, pe, &value)) {
+          read_failed = true;
+          break;
+        }
+        out_id = (int)value;
+        if (!GetUVarint(&p, pe, &value)) {
+          read_failed = true;
+          break;
+        }
+        mtime = (TimeStamp)value;
+        dep_ids.clear();
+        int prev_id = 0;
+        while (p != pe) {
+          if (!GetUVarint(&p, pe, &value)) {
+            read_failed = true;
+            break;
+          }
+          prev_id += (int)ZigZagDecode(value);
+          dep_ids.push_back(prev_id);
+        }
+        if (read_failed)
+          break;
+        deps_count = (int)dep_ids.size();
+      } else {
+        if (size < 12 || size % 4 != 0) {
+          read_failed = true;
+          break;
+        }
+        // v4 records start 4-aligned: the header is 16 bytes and every
+        // record is a multiple of 4.
+        const int* deps_data = reinterpret_cast<const int*>(record);
+        out_id = deps_data[0];
+        mtime = (TimeStamp)(((uint64_t)(unsigned int)deps_data[2] << 32) |
+                            (uint64_t)(unsigned int)deps_data[1]);
+        v4_ids = deps_data + 3;
+        deps_count = (size / 4) - 3;
+      }
 
-      Deps* deps = new Deps(mtime, deps_count);
+      std::vector<int> ids(deps_count);
       for (int i = 0; i < deps_count; ++i) {
-        assert(deps_data[i] < (int)nodes_.size());
-        assert(nodes_[deps_data[i]]);
-        deps->nodes[i] = nodes_[deps_data[i]];
+        int dep_id = v4_ids ? v4_ids[i] : dep_ids[i];
+        assert(dep_id < (int)(nodes_.size() + pending_paths_.size()));
+        ids[i] = dep_id;
       }
 
       total_dep_record_count++;
-      if (!UpdateDeps(out_id, deps))
+      // Deduplicate in place so ApplyLoad materializes each output's
+      // deps list once: as on disk, the latest record wins.
+      if ((int)pending_deps_slot_.size() <= out_id)
+        pending_deps_slot_.resize(out_id + 1, -1);
+      const int slot = pending_deps_slot_[out_id];
+      if (slot < 0) {
         ++unique_dep_record_count;
+        pending_deps_slot_[out_id] = (int)pending_deps_.size();
+        pending_deps_.push_back({ out_id, mtime, std::move(ids) });
+      } else {
+        pending_deps_[slot].mtime = mtime;
+        pending_deps_[slot].ids = std::move(ids);
+      }
+      if ((int)deps_offsets_.size() <= out_id)
+        deps_offsets_.resize(out_id + 1);
+      deps_offsets_[out_id] = offset;
     } else {
-      int path_size = size - 4;
-      assert(path_size > 0);  // CanonicalizePath() rejects empty paths.
-      // There can be up to 3 bytes of padding.
-      if (buf[path_size - 1] == '\0') --path_size;
-      if (buf[path_size - 1] == '\0') --path_size;
-      if (buf[path_size - 1] == '\0') --path_size;
-      std::string_view subpath(buf, path_size);
-      // It is not necessary to pass in a correct slash_bits here. It will
-      // either be a Node that's in the manifest (in which case it will already
-      // have a correct slash_bits that GetNode will look up), or it is an
-      // implicit dependency from a .d which does not affect the build command
-      // (and so need not have its slashes maintained).
-      Node* node = state->GetNode(subpath, 0);
-
+      std::string_view subpath;
+      if (version >= 5) {
+        const char* p = record;
+        const char* pe = record + size - 4;
+        uint64_t prefix_len;
+        if (size < 5 || !GetUVarint(&p, pe, &prefix_len) ||
+            prefix_len > last_path.size()) {
+          read_failed = true;
+          break;
+        }
+        last_path.resize(prefix_len);
+        last_path.append(p, pe - p);
+        if (last_path.empty()) {  // CanonicalizePath() rejects empty paths.
+          read_failed = true;
+          break;
+        }
+        subpath = last_path;
+      } else {
+        if (size < 8) {
+          read_failed = true;
+          break;
+        }
+        int path_size = size - 4;
+        // There can be up to 3 bytes of padding.
+        if (record[path_size - 1] == '\0') --path_size;
+        if (record[path_size - 1] == '\0') --path_size;
+        if (record[path_size - 1] == '\0') --path_size;
+        subpath = std::string_view(record, path_size);
+      }
       // Check that the expected index matches the actual index. This can only
       // happen if two ninja processes write to the same deps log concurrently.
       // (This uses unary complement to make the checksum look less like a
       // dependency record entry.)
-      unsigned checksum = *reinterpret_cast<unsigned*>(buf + size - 4);
+      unsigned checksum;
+      memcpy(&checksum, record + size - 4, 4);
       int expected_id = ~checksum;
-      int id = nodes_.size();
+      int id = (int)(nodes_.size() + pending_paths_.size());
       if (id != expected_id) {
         read_failed = true;
         break;
       }
 
-      assert(node->id() < 0);
-      node->set_id(id);
-      nodes_.push_back(node);
+      pending_paths_.emplace_back(subpath);
     }
   }
 
   if (read_failed) {
-    // An error occurred while loading; try to recover by truncating the
+    // A truncated or corrupt record; try to recover by truncating the
     // file to the last fully-read record.
-    if (ferror(f)) {
-      *err = strerror(ferror(f));
-    } else {
-      *err = "premature end of file";
-    }
-    fclose(f);
-
+    *err = "premature end of file";
     if (!Truncate(path, offset, err))
       return LOAD_ERROR;
 
@@ -274,7 +582,10 @@ LoadStatus DepsLog::Load(const std::string& path, State* state, std::string* err
     return LOAD_SUCCESS;
   }
 
-  fclose(f);
+  // An old-format log is rewritten as the current version before the next
+  // write can append to it.
+  if (version < kCurrentVersion)
+    needs_migration_ = true;
 
   // Rebuild the log if there are too many dead records.
   int kMinCompactionEntryCount = 1000;
@@ -287,6 +598,123 @@ LoadStatus DepsLog::Load(const std::string& path, State* state, std::string* err
   return LOAD_SUCCESS;
 }
 
+void DepsLog::ApplyLoad(State* state) {
+  METRIC_RECORD(".ninja_deps apply");
+
+  nodes_.reserve(nodes_.size() + pending_paths_.size());
+  for (const std::string& path : pending_paths_) {
+    // It is not necessary to pass in a correct slash_bits here. It will
+    // either be a Node that's in the manifest (in which case it will already
+    // have a correct slash_bits that GetNode will look up), or it is an
+    // implicit dependency from a .d which does not affect the build command
+    // (and so need not have its slashes maintained).
+    Node* node = state->GetNode(path, 0);
+    assert(node->id() < 0);
+    node->set_id((int)nodes_.size());
+    nodes_.push_back(node);
+  }
+
+  for (const PendingDeps& pending : pending_deps_) {
+    Deps* deps = new Deps(pending.mtime, (int)pending.ids.size());
+    for (size_t i = 0; i < pending.ids.size(); ++i)
+      deps->nodes[i] = nodes_[pending.ids[i]];
+    UpdateDeps(pending.out_id, deps);
+  }
+
+  // Swap rather than clear: a big log's pending records are tens of
+  // megabytes this process no longer needs.
+  std::vector<std::string>().swap(pending_paths_);
+  std::vector<PendingDeps>().swap(pending_deps_);
+  std::vector<int>().swap(pending_deps_slot_);
+}
+
+void DepsLog::DiscardLoad() {
+  std::vector<std::string>().swap(pending_paths_);
+  std::vector<PendingDeps>().swap(pending_deps_);
+  std::vector<int>().swap(pending_deps_slot_);
+  deps_offsets_.clear();
+  needs_recompaction_ = false;
+  needs_migration_ = false;
+}
+
+bool DepsLog::LoadIndex(const std::string& path, uint64_t log_size,
+                        std::vector<uint64_t>* offsets) {
+  std::string index_path = path + ".index";
+  FILE* f = fopen(index_path.c_str(), "rb");
+  if (!f)
+    return false;
+
+  const long kIndexHeaderSize = sizeof(kIndexSignature) - 1 + 4 + 8;
+  char signature[sizeof(kIndexSignature) - 1];
+  int version = 0;
+  uint64_t indexed_size = 0;
+  bool valid = fread(signature, sizeof(signature), 1, f) == 1 &&
+               memcmp(signature, kIndexSignature, sizeof(signature)) == 0 &&
+               fread(&version, 4, 1, f) == 1 && version == kIndexVersion &&
+               fread(&indexed_size, 8, 1, f) == 1 && indexed_size == log_size;
+  if (valid) {
+    fseek(f, 0, SEEK_END);
+    long file_size = ftell(f);
+    fseek(f, kIndexHeaderSize, SEEK_SET);
+    size_t count = (file_size - kIndexHeaderSize) / 8;
+    std::vector<uint64_t> slots(count);
+    valid = count == 0 || fread(slots.data(), 8 * count, 1, f) == 1;
+    if (valid) {
+      // Zero slots are ids that never had a deps record; the rest are
+      // sorted so the load loop can binary-search them.
+      offsets->reserve(count);
+      for (const auto & slot : slots)
+      {
+        if (slot)
+          offsets->push_back(slot);
+      }
+      std::sort(offsets->begin(), offsets->end());
+    }
+  }
+  fclose(f);
+  if (!valid) {
+    // A stale index would stay stale forever if the log is never written
+    // again, so drop it now.
+    unlink(index_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+void DepsLog::WriteIndex() {
+  std::string index_path = log_path_ + ".index";
+  // The log size in the header is what validates the index on load, so
+  // measure the file actually on disk.
+  FILE* log = fopen(log_path_.c_str(), "rb");
+  if (!log) {
+    unlink(index_path.c_str());
+    return;
+  }
+  fseek(log, 0, SEEK_END);
+  uint64_t log_size = ftell(log);
+  fclose(log);
+
+  // Write to a temporary and rename so a crash can't leave a torn index;
+  // the index is advisory, so failures just remove it.
+  std::string temp_path = index_path + ".tmp";
+  FILE* f = fopen(temp_path.c_str(), "wb");
+  if (!f)
+    return;
+  bool ok =
+      fwrite(kIndexSignature, sizeof(kIndexSignature) - 1, 1, f) == 1 &&
+      fwrite(&kIndexVersion, 4, 1, f) == 1 &&
+      fwrite(&log_size, 8, 1, f) == 1 &&
+      (deps_offsets_.empty() ||
+       fwrite(deps_offsets_.data(), 8 * deps_offsets_.size(), 1, f) == 1);
+  ok = fclose(f) == 0 && ok;
+  if (!ok) {
+    unlink(temp_path.c_str());
+    return;
+  }
+  unlink(index_path.c_str());
+  rename(temp_path.c_str(), index_path.c_str());
+}
+
 DepsLog::Deps* DepsLog::GetDeps(Node* node) {
   // Abort if the node has no id (never referenced in the deps) or if
   // there's no deps recorded for the node.
@@ -309,6 +737,40 @@ bool DepsLog::Recompact(const std::string& path, std::string* err) {
   if (!new_log.OpenForWrite(temp_path, err))
     return false;
 
+  // The liveness test walks each node's edge bindings, which dominates
+  // recompaction time and only reads the graph, so partition the scan
+  // across threads before the (order-dependent) rewrite below.
+  std::vector<unsigned char> live(deps_.size(), 0);
+  {
+    const size_t kBatch = 1024;
+    size_t threads = std::min(
+        { size_t(std::thread::hardware_concurrency()),
+          deps_.size() / kBatch, size_t(8) });
+    std::atomic<size_t> next(0);
+    auto worker = [this, &next, &live, kBatch] {
+      for (;;) {
+        size_t begin = next.fetch_add(kBatch);
+        if (begin >= deps_.size())
+          return;
+        size_t end = std::min(begin + kBatch, deps_.size());
+        for (size_t i = begin; i < end; ++i)
+          if (deps_[i] && IsDepsEntryLiveFor(nodes_[i]))
+            live[i] = 1;
+      }
+    };
+    if (threads > 1) {
+      std::vector<std::thread> pool;
+      pool.reserve(threads - 1);
+      for (size_t i = 1; i < threads; ++i)
+        pool.emplace_back(worker);
+      worker();
+      for (auto & thread : pool)
+        thread.join();
+    } else {
+      worker();
+    }
+  }
+
   // Clear all known ids so that new ones can be reassigned.  The new indices
   // will refer to the ordering in new_log, not in the current log.
   for (const auto & item : nodes_)
@@ -321,7 +783,7 @@ bool DepsLog::Recompact(const std::string& path, std::string* err) {
     Deps* deps = deps_[old_id];
     if (!deps) continue;  // If nodes_[old_id] is a leaf, it has no deps.
 
-    if (!IsDepsEntryLiveFor(nodes_[old_id]))
+    if (!live[old_id])
       continue;
 
     if (!new_log.RecordDeps(nodes_[old_id], deps->mtime,
@@ -331,11 +793,15 @@ bool DepsLog::Recompact(const std::string& path, std::string* err) {
     }
   }
 
+  // The side index belongs to the final path, not to the temporary file;
+  // our own Close() writes it once the rename below has happened.
+  new_log.log_path_.clear();
   new_log.Close();
 
   // All nodes now have ids that refer to new_log, so steal its data.
   deps_.swap(new_log.deps_);
   nodes_.swap(new_log.nodes_);
+  deps_offsets_.swap(new_log.deps_offsets_);
 
   if (unlink(path.c_str()) < 0) {
     *err = strerror(errno);
@@ -360,44 +826,212 @@ bool DepsLog::IsDepsEntryLiveFor(Node* node) {
   return node->in_edge() && !node->in_edge()->GetBinding("deps").empty();
 }
 
+void DepsLog::StartBackgroundRecompact() {
+  compact_target_ = file_path_;
+  compact_path_ = file_path_ + ".recompact";
+
+  // Don't append to a left-over file from a previous recompaction attempt
+  // that crashed somehow.
+  unlink(compact_path_.c_str());
+  compact_file_ = fopen(compact_path_.c_str(), "wb");
+  if (!compact_file_)
+    return;
+  SetCloseOnExec(fileno(compact_file_));
+  if (fwrite(kFileSignature, sizeof(kFileSignature) - 1, 1,
+             compact_file_) < 1 ||
+      fwrite(&kCurrentVersion, 4, 1, compact_file_) < 1) {
+    fclose(compact_file_);
+    compact_file_ = nullptr;
+    unlink(compact_path_.c_str());
+    return;
+  }
+
+  // The worker walks these snapshots only; the live vectors keep growing
+  // underneath it as the build records new deps.
+  compact_nodes_ = nodes_;
+  compact_deps_ = deps_;
+  recompact_running_ = true;
+  recompact_thread_ = std::thread([this] { CompactWorker(); });
+}
+
+void DepsLog::CompactWorker() {
+  METRIC_RECORD(".ninja_deps recompact");
+  for (int old_id = 0; old_id < (int)compact_deps_.size(); ++old_id) {
+    Deps* deps = compact_deps_[old_id];
+    if (!deps) continue;  // If nodes_[old_id] is a leaf, it has no deps.
+
+    if (!IsDepsEntryLiveFor(compact_nodes_[old_id]))
+      continue;
+
+    if (!EmitCompactRecord(compact_nodes_[old_id], deps)) {
+      compact_failed_ = true;
+      return;
+    }
+  }
+}
+
+int DepsLog::CompactId(Node* node) {
+  std::pair<std::unordered_map<Node*, int>::iterator, bool> insertion =
+      compact_ids_.insert(std::make_pair(node, (int)compact_ids_.size()));
+  if (!insertion.second)
+    return insertion.first->second;
+
+  std::string_view path = node->path();
+  size_t prefix_len = 0;
+  size_t max_prefix = std::min(path.size(), compact_last_path_.size());
+  while (prefix_len < max_prefix &&
+         path[prefix_len] == compact_last_path_[prefix_len])
+    ++prefix_len;
+
+  std::string payload;
+  payload.reserve(10 + path.size() - prefix_len);
+  PutUVarint(&payload, prefix_len);
+  payload.append(path.data() + prefix_len, path.size() - prefix_len);
+  unsigned checksum = ~(unsigned)insertion.first->second;
+  payload.append(reinterpret_cast<const char*>(&checksum), 4);
+  if (payload.size() > kMaxRecordSize)
+    return -1;
+  unsigned size = payload.size();
+  if (fwrite(&size, 4, 1, compact_file_) < 1 ||
+      fwrite(payload.data(), payload.size(), 1, compact_file_) < 1)
+    return -1;
+  compact_last_path_.assign(path.data(), path.size());
+  return insertion.first->second;
+}
+
+bool DepsLog::EmitCompactRecord(Node* node, const Deps* deps) {
+  // Resolve every id up front: CompactId writes the path records, and the
+  // offset remembered for the index below must be the deps record's own.
+  int out_id = CompactId(node);
+  if (out_id < 0)
+    return false;
+  std::string payload;
+  payload.reserve(12 + 2 * deps->node_count);
+  PutUVarint(&payload, static_cast<uint64_t>(out_id));
+  PutUVarint(&payload, static_cast<uint64_t>(deps->mtime));
+  int prev_id = 0;
+  for (int i = 0; i < deps->node_count; ++i) {
+    int dep_id = CompactId(deps->nodes[i]);
+    if (dep_id < 0)
+      return false;
+    PutUVarint(&payload, ZigZagEncode(dep_id - prev_id));
+    prev_id = dep_id;
+  }
+  if (payload.size() > kMaxRecordSize)
+    return false;
+
+  long record_offset = ftell(compact_file_);
+  unsigned size = payload.size() | 0x80000000;  // Deps record: set high bit.
+  if (fwrite(&size, 4, 1, compact_file_) < 1 ||
+      fwrite(payload.data(), payload.size(), 1, compact_file_) < 1)
+    return false;
+  if ((int)compact_deps_offsets_.size() <= out_id)
+    compact_deps_offsets_.resize(out_id + 1);
+  compact_deps_offsets_[out_id] = record_offset;
+  return true;
+}
+
+bool DepsLog::FinishBackgroundRecompact() {
+  if (!recompact_running_)
+    return false;
+  recompact_thread_.join();
+  recompact_running_ = false;
+  for (const auto & item : replaced_deps_)
+  {
+    delete item;
+  }
+  replaced_deps_.clear();
+
+  bool ok = !compact_failed_;
+  if (ok) {
+    // Replay what this build recorded after the snapshot was taken.  The
+    // list may repeat an output; the last record wins on load, just like
+    // in the live log.
+    for (const auto & out_id : dirty_since_compact_) {
+      Deps* deps = deps_[out_id];
+      if (!deps || !EmitCompactRecord(nodes_[out_id], deps)) {
+        ok = false;
+        break;
+      }
+    }
+  }
+  if (ok)
+    ok = fflush(compact_file_) == 0;
+  fclose(compact_file_);
+  compact_file_ = nullptr;
+  dirty_since_compact_.clear();
+  compact_ids_.clear();
+  compact_nodes_.clear();
+  compact_deps_.clear();
+
+  // Swap the side file over the live log (which Close() already closed).
+  // On failure keep the live log: it is complete, just bigger than it
+  // needs to be, and the next run will recompact it again.
+  if (ok && unlink(compact_target_.c_str()) == 0 &&
+      rename(compact_path_.c_str(), compact_target_.c_str()) == 0) {
+    needs_recompaction_ = false;
+    // The index has to describe the side file's own id numbering.
+    deps_offsets_.swap(compact_deps_offsets_);
+    compact_deps_offsets_.clear();
+    return true;
+  }
+  unlink(compact_path_.c_str());
+  compact_deps_offsets_.clear();
+  return false;
+}
+
 bool DepsLog::UpdateDeps(int out_id, Deps* deps) {
   if (out_id >= (int)deps_.size())
     deps_.resize(out_id + 1);
 
   bool delete_old = deps_[out_id] != nullptr;
-  if (delete_old)
-    delete deps_[out_id];
+  if (delete_old) {
+    // The compaction worker may still be reading the old list through its
+    // snapshot; keep it alive until the worker has been joined.
+    if (recompact_running_)
+      replaced_deps_.push_back(deps_[out_id]);
+    else
+      delete deps_[out_id];
+  }
   deps_[out_id] = deps;
   return delete_old;
 }
 
 bool DepsLog::RecordId(Node* node) {
-  int path_size = node->path().size();
-  int padding = (4 - path_size % 4) % 4;  // Pad path to 4 byte boundary.
-
-  unsigned size = path_size + padding + 4;
-  if (size > kMaxRecordSize) {
-    errno = ERANGE;
-    return false;
-  }
-
   if (!OpenForWriteIfNeeded()) {
     return false;
   }
-  if (fwrite(&size, 4, 1, file_) < 1)
-    return false;
-  if (fwrite(node->path().data(), path_size, 1, file_) < 1) {
-    assert(!node->path().empty());
-    return false;
-  }
-  if (padding && fwrite("\0\0", padding, 1, file_) < 1)
-    return false;
+  assert(!node->path().empty());
+
+  // Share the leading bytes with the previous path record; build outputs
+  // cluster by directory, so most of a path is usually redundant.  After
+  // a reopen last_path_ is empty and the first record simply stores the
+  // whole path.
+  std::string_view path = node->path();
+  size_t prefix_len = 0;
+  size_t max_prefix = std::min(path.size(), last_path_.size());
+  while (prefix_len < max_prefix && path[prefix_len] == last_path_[prefix_len])
+    ++prefix_len;
+
+  std::string payload;
+  payload.reserve(10 + path.size() - prefix_len);
+  PutUVarint(&payload, prefix_len);
+  payload.append(path.data() + prefix_len, path.size() - prefix_len);
   int id = nodes_.size();
   unsigned checksum = ~(unsigned)id;
-  if (fwrite(&checksum, 4, 1, file_) < 1)
+  payload.append(reinterpret_cast<const char*>(&checksum), 4);
+  if (payload.size() > kMaxRecordSize) {
+    errno = ERANGE;
     return false;
-  if (fflush(file_) != 0)
+  }
+  unsigned size = payload.size();
+  std::string record;
+  record.reserve(4 + payload.size());
+  record.append(reinterpret_cast<const char*>(&size), 4);
+  record.append(payload);
+  if (!WriteRecord(std::move(record)))
     return false;
+  last_path_.assign(path.data(), path.size());
 
   node->set_id(id);
   nodes_.push_back(node);
@@ -405,6 +1039,21 @@ bool DepsLog::RecordId(Node* node) {
   return true;
 }
 
+bool DepsLog::WriteRecord(std::string record) {
+  write_offset_ += record.size();
+  if (async_writer_) {
+    if (async_writer_->failed())
+      return false;
+    // Durability comes from the writer's idle flush and the Drain()
+    // barrier at the end of the build, not from flushing per record.
+    async_writer_->Write(file_, std::move(record), /*flush=*/false);
+    return true;
+  }
+  if (fwrite(record.data(), record.size(), 1, file_) < 1)
+    return false;
+  return fflush(file_) == 0;
+}
+
 bool DepsLog::OpenForWriteIfNeeded() {
   if (file_path_.empty()) {
     return true;
@@ -433,6 +1082,7 @@ bool DepsLog::OpenForWriteIfNeeded() {
   if (fflush(file_) != 0) {
     return false;
   }
+  write_offset_ = ftell(file_);
   file_path_.clear();
   return true;
 }
@@ -15,7 +15,11 @@
 #ifndef NINJA_DEPS_LOG_H_
 #define NINJA_DEPS_LOG_H_
 
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <stdio.h>
@@ -23,6 +27,7 @@
 #include "load_status.h"
 #include "timestamp.h"
 
+struct AsyncWriter;
 struct Node;
 struct State;
 
@@ -52,16 +57,18 @@ struct State;
 /// Concretely, a record is:
 ///    four bytes record length, high bit indicates record type
 ///      (but max record sizes are capped at 512kB)
-///    path records contain the string name of the path, followed by up to 3
-///      padding bytes to align on 4 byte boundaries, followed by the
+///    path records contain a varint length of the prefix shared with the
+///      previous path record, the remaining bytes of the path, and the
 ///      one's complement of the expected index of the record (to detect
 ///      concurrent writes of multiple ninja processes to the log).
-///    dependency records are an array of 4-byte integers
-///      [output path id,
-///       output path mtime (lower 4 bytes), output path mtime (upper 4 bytes),
-///       input path id, input path id...]
+///    dependency records are a varint output path id, a varint output
+///      path mtime, then the input path ids delta-encoded in list order
+///      as zigzag varints.
 ///      (The mtime is compared against the on-disk output path mtime
 ///      to verify the stored data is up-to-date.)
+/// The previous version (4) stored every field as a fixed 4-byte integer
+/// and paths uncompressed; it still loads, and is rewritten in the
+/// current format before the next build appends to it.
 /// If two records reference the same output the latter one in the file
 /// wins, allowing updates to just be appended to the file.  A separate
 /// repacking step can run occasionally to remove dead records.
@@ -75,6 +82,26 @@ struct DepsLog final {
   bool RecordDeps(Node* node, TimeStamp mtime, int node_count, Node** nodes);
   void Close();
 
+  /// Park a deps list for RecordDeps without touching any shared log
+  /// state; safe to call from any thread.  Entries land in one of a
+  /// handful of sharded buffers keyed by caller thread, so simultaneous
+  /// finishers don't contend on a single mutex.  Id assignment, the
+  /// change check and the file append all happen later, in staging
+  /// order, when the single writer calls FlushStagedDeps().
+  void StageDeps(Node* node, TimeStamp mtime, std::vector<Node*> nodes);
+
+  /// Record everything staged so far, in the order it was staged.  Must
+  /// be called from one thread at a time (stagers may keep running);
+  /// Close() flushes implicitly.  Returns false on the first failed
+  /// record, with errno set.
+  bool FlushStagedDeps();
+
+  /// Route record appends through \a writer instead of blocking on
+  /// fwrite+fflush; the builder attaches one for the duration of a build
+  /// and reports deferred failures at its Drain() barrier.  Pass nullptr
+  /// to go back to synchronous writes.
+  void set_async_writer(AsyncWriter* writer) { async_writer_ = writer; }
+
   // Reading (startup-time) interface.
   struct Deps final {
     Deps(int64_t mtime, int node_count)
@@ -85,6 +112,18 @@ struct DepsLog final {
     Node** nodes;
   };
   LoadStatus Load(const std::string& path, State* state, std::string* err);
+
+  /// The two halves of Load(), for callers that overlap the log read with
+  /// other work on the State.  LoadRecords() decodes the file into pending
+  /// path and deps records without touching the State (or any Node), so it
+  /// can run on a helper thread while the manifest is still parsing;
+  /// ApplyLoad() then materializes the pending records as Nodes, on the
+  /// thread that owns the State.  DiscardLoad() forgets the pending records
+  /// instead, for when the load turns out to have read the wrong file.
+  LoadStatus LoadRecords(const std::string& path, std::string* err);
+  void ApplyLoad(State* state);
+  void DiscardLoad();
+
   Deps* GetDeps(Node* node);
 
   /// Rewrite the known log entries, throwing away old data.
@@ -109,13 +148,119 @@ struct DepsLog final {
   // Write a node name record, assigning it an id.
   bool RecordId(Node* node);
 
+  /// Append an assembled record to the log: handed to the async writer
+  /// when one is attached, written and flushed synchronously otherwise
+  /// (errno is set on failure).
+  bool WriteRecord(std::string record);
+
   /// Should be called before using file_. When false is returned, errno will
   /// be set.
   bool OpenForWriteIfNeeded();
 
+  /// Start compacting the just-loaded entries into a side file on a
+  /// background thread while this build appends to the live log; called
+  /// from OpenForWrite() instead of a blocking Recompact().
+  void StartBackgroundRecompact();
+  /// Body of the compaction thread: writes every live snapshot entry to
+  /// the side file.
+  void CompactWorker();
+  /// Return \a node's id in the side file, writing its path record first
+  /// if it does not have one yet.  Returns -1 on write failure.
+  int CompactId(Node* node);
+  /// Append one deps record for \a node to the side file.
+  bool EmitCompactRecord(Node* node, const Deps* deps);
+  /// Join the compaction thread, re-emit entries recorded while it ran,
+  /// and swap the side file over the live log.  Any failure leaves the
+  /// live log untouched; the next run just recompacts again.  Returns
+  /// whether the swap happened.
+  bool FinishBackgroundRecompact();
+
+  /// Read the side index for \a path if it matches \a log_size, filling
+  /// \a offsets with the sorted offsets of live deps records.  A stale or
+  /// unreadable index is removed and ignored.
+  bool LoadIndex(const std::string& path, uint64_t log_size,
+                 std::vector<uint64_t>* offsets);
+  /// Atomically rewrite the side index from deps_offsets_.
+  void WriteIndex();
+
   bool needs_recompaction_ = false;
+  /// Whether the loaded log is in an older format and must be rewritten
+  /// before anything appends to it.
+  bool needs_migration_ = false;
+  AsyncWriter* async_writer_ = nullptr;
   FILE* file_ = nullptr;
   std::string file_path_;
+  /// The path of the last path record written, for prefix compression.
+  std::string last_path_;
+  /// Where the live log lives; set by OpenForWrite and cleared once
+  /// Close() has written the side index for it.
+  std::string log_path_;
+  /// Offset of the latest deps record for each id, mirrored into the
+  /// side index at Close().
+  std::vector<uint64_t> deps_offsets_;
+  /// Logical end of the live log, kept current across async appends.
+  uint64_t write_offset_ = 0;
+
+  /// Background recompaction state.  The worker thread only ever touches
+  /// the side file and the snapshot vectors below; the main thread keeps
+  /// recording to the live log and remembers what it wrote in
+  /// dirty_since_compact_ so FinishBackgroundRecompact() can replay it.
+  bool recompact_running_ = false;
+  std::thread recompact_thread_;
+  FILE* compact_file_ = nullptr;
+  /// Paths of the side file and of the live log it will replace.
+  std::string compact_path_;
+  std::string compact_target_;
+  bool compact_failed_ = false;
+  /// Snapshots of nodes_ and deps_ taken before the thread starts.
+  std::vector<Node*> compact_nodes_;
+  std::vector<Deps*> compact_deps_;
+  /// Ids in the side file's own numbering; node ids stay untouched so the
+  /// live log can keep assigning them concurrently.
+  std::unordered_map<Node*, int> compact_ids_;
+  /// The last path record written to the side file.
+  std::string compact_last_path_;
+  /// deps_offsets_ counterpart in the side file's numbering; adopted if
+  /// the swap succeeds.
+  std::vector<uint64_t> compact_deps_offsets_;
+  /// Outputs recorded to the live log while the worker ran.
+  std::vector<int> dirty_since_compact_;
+  /// Replaced deps lists the worker may still be reading; freed at join.
+  std::vector<Deps*> replaced_deps_;
+
+  /// A deps record decoded by LoadRecords, waiting for ApplyLoad to
+  /// resolve its input ids against nodes_.
+  struct PendingDeps {
+    int out_id;
+    TimeStamp mtime;
+    std::vector<int> ids;
+  };
+  /// Decoded path records in id order, pending materialization.
+  std::vector<std::string> pending_paths_;
+  /// Decoded deps records, already deduplicated so each output appears
+  /// at most once (the latest record in the file wins, as on disk).
+  std::vector<PendingDeps> pending_deps_;
+  /// Maps out_id -> slot in pending_deps_ holding its record, or -1.
+  std::vector<int> pending_deps_slot_;
+
+  /// A deps list parked by StageDeps until the next FlushStagedDeps.
+  /// The sequence number restores the global staging order across shards.
+  struct StagedDeps {
+    uint64_t sequence;
+    Node* node;
+    TimeStamp mtime;
+    std::vector<Node*> nodes;
+  };
+  /// Staging buffers, each with its own lock.  A caller thread always
+  /// uses the same shard, so with more shards than finisher threads the
+  /// locks are effectively uncontended.
+  static const int kStagingShards = 16;
+  struct StagingShard {
+    std::mutex mutex;
+    std::vector<StagedDeps> entries;
+  };
+  StagingShard staging_[kStagingShards];
+  std::atomic<uint64_t> staging_sequence_{0};
 
   /// Maps id -> Node.
   std::vector<Node*> nodes_;
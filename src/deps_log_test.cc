@@ -35,9 +35,11 @@ struct DepsLogTest : public testing::Test {
   void SetUp() override final {
     // In case a crashing test left a stale file behind.
     unlink(kTestFilename);
+    unlink((std::string(kTestFilename) + ".index").c_str());
   }
   void TearDown() override final {
     unlink(kTestFilename);
+    unlink((std::string(kTestFilename) + ".index").c_str());
   }
 };
 
@@ -91,6 +93,80 @@ TEST_F(DepsLogTest, WriteRead) {
   ASSERT_EQ("bar2.h", log_deps->nodes[1]->path());
 }
 
+// LoadRecords must stay off the State so it can run while the manifest
+// is still parsing; ApplyLoad then materializes the same picture a
+// one-shot Load builds.
+TEST_F(DepsLogTest, TwoPhaseLoad) {
+  State state1;
+  DepsLog log1;
+  std::string err;
+  EXPECT_TRUE(log1.OpenForWrite(kTestFilename, &err));
+  ASSERT_EQ("", err);
+
+  {
+    std::vector<Node*> deps;
+    deps.push_back(state1.GetNode("foo.h", 0));
+    deps.push_back(state1.GetNode("bar.h", 0));
+    log1.RecordDeps(state1.GetNode("out.o", 0), 1, deps);
+
+    // A later record for the same output supersedes the first.
+    deps.clear();
+    deps.push_back(state1.GetNode("foo.h", 0));
+    log1.RecordDeps(state1.GetNode("out.o", 0), 2, deps);
+  }
+
+  log1.Close();
+
+  State state2;
+  DepsLog log2;
+  ASSERT_EQ(LOAD_SUCCESS, log2.LoadRecords(kTestFilename, &err));
+  ASSERT_EQ("", err);
+  EXPECT_FALSE(state2.LookupNode("out.o"));
+  EXPECT_EQ(0u, log2.nodes().size());
+
+  log2.ApplyLoad(&state2);
+  Node* out = state2.LookupNode("out.o");
+  ASSERT_TRUE(out);
+  DepsLog::Deps* log_deps = log2.GetDeps(out);
+  ASSERT_TRUE(log_deps);
+  ASSERT_EQ(2, log_deps->mtime);
+  ASSERT_EQ(1, log_deps->node_count);
+  ASSERT_EQ("foo.h", log_deps->nodes[0]->path());
+}
+
+// A discarded speculative load must leave no trace in the log or the
+// State, and a subsequent one-shot Load must see a clean slate.
+TEST_F(DepsLogTest, DiscardLoad) {
+  State state1;
+  DepsLog log1;
+  std::string err;
+  EXPECT_TRUE(log1.OpenForWrite(kTestFilename, &err));
+  ASSERT_EQ("", err);
+
+  {
+    std::vector<Node*> deps;
+    deps.push_back(state1.GetNode("foo.h", 0));
+    log1.RecordDeps(state1.GetNode("out.o", 0), 1, deps);
+  }
+
+  log1.Close();
+
+  State state2;
+  DepsLog log2;
+  ASSERT_EQ(LOAD_SUCCESS, log2.LoadRecords(kTestFilename, &err));
+  ASSERT_EQ("", err);
+  log2.DiscardLoad();
+  EXPECT_FALSE(state2.LookupNode("out.o"));
+  EXPECT_EQ(0u, log2.nodes().size());
+
+  EXPECT_TRUE(log2.Load(kTestFilename, &state2, &err));
+  ASSERT_EQ("", err);
+  ASSERT_EQ(2u, log2.nodes().size());
+  DepsLog::Deps* log_deps = log2.GetDeps(state2.GetNode("out.o", 0));
+  ASSERT_TRUE(log_deps);
+  ASSERT_EQ(1, log_deps->node_count);
+}
+
 TEST_F(DepsLogTest, LotsOfDeps) {
   const int kNumDeps = 100000;  // More than 64k.
 
@@ -326,6 +402,259 @@ TEST_F(DepsLogTest, Recompact) {
   }
 }
 
+// Verify that a log that needs recompaction is compacted in the background
+// while new records keep appending, and swapped in at Close().
+TEST_F(DepsLogTest, BackgroundRecompact) {
+  const char kManifest[] =
+"rule cc\n"
+"  command = cc\n"
+"  deps = gcc\n"
+"build out.o: cc\n"
+"build other_out.o: cc\n";
+
+  // Fill the log with enough dead records to trip the recompaction
+  // heuristic on the next load.
+  int file_size;
+  {
+    State state;
+    ASSERT_NO_FATAL_FAILURE(AssertParse(&state, kManifest));
+    DepsLog log;
+    std::string err;
+    ASSERT_TRUE(log.OpenForWrite(kTestFilename, &err));
+    ASSERT_EQ("", err);
+
+    std::vector<Node*> deps;
+    for (int i = 0; i < 1200; ++i) {
+      deps.clear();
+      deps.push_back(state.GetNode(i % 2 ? "foo.h" : "bar.h", 0));
+      log.RecordDeps(state.GetNode("out.o", 0), 1, deps);
+    }
+    log.Close();
+
+    struct stat st;
+    ASSERT_EQ(0, stat(kTestFilename, &st));
+    file_size = (int)st.st_size;
+  }
+
+  // Reload the file; OpenForWrite starts the background compaction.
+  // Record a new entry while it runs, then swap the side file in at
+  // Close().
+  {
+    State state;
+    ASSERT_NO_FATAL_FAILURE(AssertParse(&state, kManifest));
+    DepsLog log;
+    std::string err;
+    ASSERT_TRUE(log.Load(kTestFilename, &state, &err));
+    ASSERT_TRUE(log.OpenForWrite(kTestFilename, &err));
+    ASSERT_EQ("", err);
+
+    std::vector<Node*> deps;
+    deps.push_back(state.GetNode("foo.h", 0));
+    deps.push_back(state.GetNode("baz.h", 0));
+    log.RecordDeps(state.GetNode("other_out.o", 0), 1, deps);
+    log.Close();
+  }
+
+  // The compacted log keeps the latest deps for both outputs and is far
+  // smaller than the one full of dead records.
+  {
+    State state;
+    ASSERT_NO_FATAL_FAILURE(AssertParse(&state, kManifest));
+    DepsLog log;
+    std::string err;
+    ASSERT_TRUE(log.Load(kTestFilename, &state, &err));
+
+    DepsLog::Deps* deps = log.GetDeps(state.GetNode("out.o", 0));
+    ASSERT_TRUE(deps);
+    ASSERT_EQ(1, deps->node_count);
+    ASSERT_EQ("foo.h", deps->nodes[0]->path());
+
+    deps = log.GetDeps(state.GetNode("other_out.o", 0));
+    ASSERT_TRUE(deps);
+    ASSERT_EQ(2, deps->node_count);
+    ASSERT_EQ("foo.h", deps->nodes[0]->path());
+    ASSERT_EQ("baz.h", deps->nodes[1]->path());
+
+    struct stat st;
+    ASSERT_EQ(0, stat(kTestFilename, &st));
+    ASSERT_LT((int)st.st_size, file_size / 4);
+  }
+}
+
+// Verify that the side index lets a load skip superseded records, and
+// that a stale index is detected, ignored and removed.
+TEST_F(DepsLogTest, DepsRecordIndex) {
+  std::string err;
+  {
+    State state;
+    DepsLog log;
+    EXPECT_TRUE(log.OpenForWrite(kTestFilename, &err));
+    ASSERT_EQ("", err);
+    std::vector<Node*> deps;
+    deps.push_back(state.GetNode("foo.h", 0));
+    log.RecordDeps(state.GetNode("out.o", 0), 1, deps);
+    deps.push_back(state.GetNode("bar.h", 0));
+    log.RecordDeps(state.GetNode("out.o", 0), 2, deps);
+    log.Close();
+  }
+
+  std::string index_path = std::string(kTestFilename) + ".index";
+  struct stat st;
+  ASSERT_EQ(0, stat(index_path.c_str(), &st));
+
+  // Load with the index present; only the latest record survives.
+  {
+    State state;
+    DepsLog log;
+    ASSERT_TRUE(log.Load(kTestFilename, &state, &err));
+    DepsLog::Deps* deps = log.GetDeps(state.GetNode("out.o", 0));
+    ASSERT_TRUE(deps);
+    ASSERT_EQ(2, deps->mtime);
+    ASSERT_EQ(2, deps->node_count);
+    ASSERT_EQ("foo.h", deps->nodes[0]->path());
+    ASSERT_EQ("bar.h", deps->nodes[1]->path());
+  }
+
+  // Corrupt the log size stored in the index header.  The stale index
+  // must be ignored and removed, and the load still sees the same deps.
+  {
+    FILE* f = fopen(index_path.c_str(), "r+b");
+    ASSERT_TRUE(f);
+    uint64_t bogus_size = 12345;
+    ASSERT_EQ(0, fseek(f, 15 + 4, SEEK_SET));  // signature + version
+    ASSERT_EQ(1u, fwrite(&bogus_size, 8, 1, f));
+    ASSERT_EQ(0, fclose(f));
+
+    State state;
+    DepsLog log;
+    ASSERT_TRUE(log.Load(kTestFilename, &state, &err));
+    DepsLog::Deps* deps = log.GetDeps(state.GetNode("out.o", 0));
+    ASSERT_TRUE(deps);
+    ASSERT_EQ(2, deps->mtime);
+    ASSERT_EQ(2, deps->node_count);
+    EXPECT_NE(0, stat(index_path.c_str(), &st));
+  }
+}
+
+// Verify that deps staged from many threads all land in the log, in a
+// usable order, once the single writer flushes them.
+TEST_F(DepsLogTest, ConcurrentStaging) {
+  const int kThreads = 8;
+  const int kRecordsPerThread = 16;
+
+  State state;
+  DepsLog log;
+  std::string err;
+  EXPECT_TRUE(log.OpenForWrite(kTestFilename, &err));
+  ASSERT_EQ("", err);
+
+  // Nodes are created up front: State::GetNode is not thread safe, and
+  // finisher threads only ever hand existing nodes to StageDeps.
+  std::vector<Node*> outs;
+  Node* dep = state.GetNode("common.h", 0);
+  for (int i = 0; i < kThreads * kRecordsPerThread; ++i)
+    outs.push_back(state.GetNode("out" + std::to_string(i) + ".o", 0));
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([t, &outs, &dep, &log] {
+      for (int i = 0; i < kRecordsPerThread; ++i) {
+        std::vector<Node*> deps;
+        deps.push_back(dep);
+        log.StageDeps(outs[t * kRecordsPerThread + i], t + 1,
+                      std::move(deps));
+      }
+    });
+  }
+  for (auto & thread : threads)
+  {
+    thread.join();
+  }
+  ASSERT_TRUE(log.FlushStagedDeps());
+  log.Close();
+
+  // Reload and verify every staged record is present.
+  State state2;
+  DepsLog log2;
+  ASSERT_TRUE(log2.Load(kTestFilename, &state2, &err));
+  for (int i = 0; i < kThreads * kRecordsPerThread; ++i) {
+    DepsLog::Deps* deps =
+        log2.GetDeps(state2.GetNode("out" + std::to_string(i) + ".o", 0));
+    ASSERT_TRUE(deps);
+    ASSERT_EQ(1, deps->node_count);
+    ASSERT_EQ("common.h", deps->nodes[0]->path());
+  }
+}
+
+// Verify that a version 4 log (fixed-width fields, padded paths) still
+// loads, and is rewritten in the current format before the next write.
+TEST_F(DepsLogTest, MigrateV4) {
+  const char kManifest[] =
+"rule cc\n"
+"  command = cc\n"
+"  deps = gcc\n"
+"build out.o: cc\n";
+
+  // Hand-write a v4 log with one deps entry.
+  {
+    FILE* f = fopen(kTestFilename, "wb");
+    ASSERT_TRUE(f);
+    ASSERT_EQ(1u, fwrite("# ninjadeps\n", 12, 1, f));
+    int version = 4;
+    ASSERT_EQ(1u, fwrite(&version, 4, 1, f));
+    const char* paths[] = { "out.o", "foo.h" };
+    for (int id = 0; id < 2; ++id) {
+      int len = strlen(paths[id]);
+      int padding = (4 - len % 4) % 4;
+      unsigned size = len + padding + 4;
+      ASSERT_EQ(1u, fwrite(&size, 4, 1, f));
+      ASSERT_EQ(1u, fwrite(paths[id], len, 1, f));
+      for (int i = 0; i < padding; ++i)
+        ASSERT_EQ(1u, fwrite("", 1, 1, f));
+      unsigned checksum = ~(unsigned)id;
+      ASSERT_EQ(1u, fwrite(&checksum, 4, 1, f));
+    }
+    unsigned size = (4 * (1 + 2 + 1)) | 0x80000000;
+    ASSERT_EQ(1u, fwrite(&size, 4, 1, f));
+    int fields[4] = { 0, 42, 0, 1 };  // out id, mtime lo/hi, dep id.
+    ASSERT_EQ(1u, fwrite(fields, sizeof(fields), 1, f));
+    ASSERT_EQ(0, fclose(f));
+  }
+
+  // Load it, then open for write, which migrates the file.
+  {
+    State state;
+    ASSERT_NO_FATAL_FAILURE(AssertParse(&state, kManifest));
+    DepsLog log;
+    std::string err;
+    ASSERT_TRUE(log.Load(kTestFilename, &state, &err));
+    DepsLog::Deps* deps = log.GetDeps(state.GetNode("out.o", 0));
+    ASSERT_TRUE(deps);
+    ASSERT_EQ(42, deps->mtime);
+    ASSERT_EQ(1, deps->node_count);
+    ASSERT_EQ("foo.h", deps->nodes[0]->path());
+
+    ASSERT_TRUE(log.OpenForWrite(kTestFilename, &err));
+    ASSERT_EQ("", err);
+    log.Close();
+  }
+
+  // The rewritten log loads as the current version with the same deps.
+  {
+    State state;
+    ASSERT_NO_FATAL_FAILURE(AssertParse(&state, kManifest));
+    DepsLog log;
+    std::string err;
+    ASSERT_TRUE(log.Load(kTestFilename, &state, &err));
+    ASSERT_EQ("", err);
+    DepsLog::Deps* deps = log.GetDeps(state.GetNode("out.o", 0));
+    ASSERT_TRUE(deps);
+    ASSERT_EQ(42, deps->mtime);
+    ASSERT_EQ(1, deps->node_count);
+    ASSERT_EQ("foo.h", deps->nodes[0]->path());
+  }
+}
+
 // Verify that invalid file headers cause a new build.
 TEST_F(DepsLogTest, InvalidHeader) {
   const char *kInvalidHeaders[] = {
@@ -28,9 +28,14 @@
 #include <windows.h>
 #include <direct.h>  // _mkdir
 #else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #endif
 
+#include "debug_flags.h"
+#include "mem_advice.h"
 #include "metrics.h"
 #include "util.h"
 #include "string_concat.h"
@@ -39,6 +44,33 @@ using namespace std;
 
 namespace {
 
+/// A LoadedFile whose contents live in an ordinary heap buffer.
+struct HeapLoadedFile final : public LoadedFile {
+  explicit HeapLoadedFile(std::string* contents) {
+    contents_.swap(*contents);
+    // std::string::data() is NUL-terminated, which gives us the trailing
+    // NUL byte the Lexer requires without growing the buffer.
+    content_ = std::string_view(contents_.data(), contents_.size());
+  }
+
+ private:
+  std::string contents_;
+};
+
+#ifndef _WIN32
+/// A LoadedFile backed by a read-only mmap of the file.
+struct MappedLoadedFile final : public LoadedFile {
+  MappedLoadedFile(void* map, size_t size) : map_(map), map_size_(size) {
+    content_ = std::string_view(static_cast<const char*>(map), size);
+  }
+  ~MappedLoadedFile() override { munmap(map_, map_size_); }
+
+ private:
+  void* map_;
+  size_t map_size_;
+};
+#endif
+
 std::string DirName(const std::string& path) {
 #ifdef _WIN32
   static const char kPathSeparators[] = "\\/";
@@ -101,14 +133,19 @@ bool StatAllFilesInDir(const std::string& dir, std::map<std::string, TimeStamp,
                        std::string* err) {
   // FindExInfoBasic is 30% faster than FindExInfoStandard.
   static bool can_use_basic_info = IsWindows7OrLater();
-  // This is not in earlier SDKs.
+  // These are not in earlier SDKs.
   const FINDEX_INFO_LEVELS kFindExInfoBasic =
       static_cast<FINDEX_INFO_LEVELS>(1);
+  const DWORD kFindFirstExLargeFetch = 2;
   FINDEX_INFO_LEVELS level =
       can_use_basic_info ? kFindExInfoBasic : FindExInfoStandard;
+  // Large fetch makes each underlying NtQueryDirectoryFile call fill a
+  // ~64KB buffer, so even big directories drain in a few kernel round
+  // trips instead of one per handful of entries.
+  DWORD flags = can_use_basic_info ? kFindFirstExLargeFetch : 0;
   WIN32_FIND_DATAA ffd;
   HANDLE find_handle = FindFirstFileExA((dir + "\\*").c_str(), level, &ffd,
-                                        FindExSearchNameMatch, nullptr, 0);
+                                        FindExSearchNameMatch, nullptr, flags);
 
   if (find_handle == INVALID_HANDLE_VALUE) {
     DWORD win_err = GetLastError();
@@ -132,6 +169,55 @@ bool StatAllFilesInDir(const std::string& dir, std::map<std::string, TimeStamp,
 }
 #endif  // _WIN32
 
+#ifndef _WIN32
+TimeStamp TimeStampFromStat(const struct stat& st) {
+  // Some users (Flatpak) set mtime to 0, this should be harmless
+  // and avoids conflicting with our return value of 0 meaning
+  // that it doesn't exist.
+  if (st.st_mtime == 0)
+    return 1;
+#if defined(_AIX)
+  return (int64_t)st.st_mtime * 1000000000LL + st.st_mtime_n;
+#elif defined(__APPLE__)
+  return ((int64_t)st.st_mtimespec.tv_sec * 1000000000LL +
+          st.st_mtimespec.tv_nsec);
+#elif defined(st_mtime) // A macro, so we're likely on modern POSIX.
+  return (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+  return (int64_t)st.st_mtime * 1000000000LL + st.st_mtimensec;
+#endif
+}
+
+bool StatAllFilesInDir(const std::string& dir,
+                       std::map<std::string, TimeStamp, std::less<>>* stamps,
+                       std::string* err) {
+  DIR* d = opendir(dir.c_str());
+  if (!d) {
+    if (errno == ENOENT || errno == ENOTDIR)
+      return true;  // Every file in a missing directory is missing.
+    *err = string_concat("opendir(", dir, "): ", strerror(errno));
+    return false;
+  }
+  int fd = dirfd(d);
+  while (struct dirent* ent = readdir(d)) {
+    // Like the Windows implementation, skip ".." (its entry would need
+    // another directory's listing to be right) but keep ".".
+    if (ent->d_name[0] == '.' && ent->d_name[1] == '.' && ent->d_name[2] == 0)
+      continue;
+    struct stat st;
+    // Relative to the open directory, so the kernel resolves only the
+    // last component instead of the whole path per entry.
+    if (fstatat(fd, ent->d_name, &st, 0) < 0) {
+      // Raced with a deletion, or a dangling symlink; treat as missing.
+      continue;
+    }
+    stamps->emplace(ent->d_name, TimeStampFromStat(st));
+  }
+  closedir(d);
+  return true;
+}
+#endif  // !_WIN32
+
 }  // namespace
 
 // DiskInterface ---------------------------------------------------------------
@@ -140,24 +226,147 @@ bool DiskInterface::MakeDirs(const std::string& path) {
   std::string dir = DirName(path);
   if (dir.empty())
     return true;  // Reached root; assume it's there.
+  // Builds ask about the same few thousand directories over and over;
+  // once a directory is known to exist, answer from memory.
+  if (known_dirs_.count(dir))
+    return true;
   std::string err;
   TimeStamp mtime = Stat(dir, &err);
   if (mtime < 0) {
     Error("%s", err.c_str());
     return false;
   }
-  if (mtime > 0)
+  if (mtime > 0) {
+    known_dirs_.insert(dir);
     return true;  // Exists already; we're done.
+  }
 
   // Directory doesn't exist.  Try creating its parent first.
   bool success = MakeDirs(dir);
   if (!success)
     return false;
-  return MakeDir(dir);
+  if (!MakeDir(dir))
+    return false;
+  known_dirs_.insert(dir);
+  return true;
+}
+
+void DiskInterface::StatMany(const std::vector<std::string>& paths,
+                             std::vector<TimeStamp>* mtimes) {
+  mtimes->resize(paths.size());
+  std::string err;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    err.clear();
+    (*mtimes)[i] = Stat(paths[i], &err);
+  }
 }
 
 // RealDiskInterface -----------------------------------------------------------
 
+RealDiskInterface::~RealDiskInterface() {
+  {
+    std::lock_guard<std::mutex> lock(stat_mutex_);
+    stat_exit_ = true;
+  }
+  stat_cv_.notify_all();
+  for (std::thread& thread : stat_threads_)
+    thread.join();
+}
+
+void RealDiskInterface::EnsureStatThreads() {
+  if (!stat_threads_.empty())
+    return;
+  // Stats are latency- rather than CPU-bound, so one worker per core
+  // minus the participating caller; capped because the kernel serializes
+  // path lookups beyond a point anyway.
+  int hardware = static_cast<int>(std::thread::hardware_concurrency());
+  size_t helpers = hardware > 1 ? static_cast<size_t>(hardware - 1) : 0;
+  if (helpers > 16)
+    helpers = 16;
+  stat_threads_.reserve(helpers);
+  for (size_t i = 0; i < helpers; ++i)
+    stat_threads_.emplace_back(&RealDiskInterface::StatWorker, this);
+}
+
+void RealDiskInterface::StatWorker() {
+  size_t generation = 0;
+  std::unique_lock<std::mutex> lock(stat_mutex_);
+  for (;;) {
+    stat_cv_.wait(lock, [this, generation] {
+      return stat_exit_ || stat_generation_ != generation;
+    });
+    if (stat_exit_)
+      return;
+    generation = stat_generation_;
+    // The batch may already be finished and retired by the time a slow
+    // worker wakes up; there is nothing left to join then.
+    const std::vector<std::string>* paths = stat_paths_;
+    std::vector<TimeStamp>* mtimes = stat_mtimes_;
+    if (!paths)
+      continue;
+    // The size is captured under the lock: once the indices run out the
+    // loop below must not touch the caller's storage again, since the
+    // caller frees it as soon as stat_active_ drops to zero.
+    size_t size = paths->size();
+    ++stat_active_;
+    lock.unlock();
+    std::string err;
+    for (;;) {
+      size_t i = stat_next_.fetch_add(1);
+      if (i >= size)
+        break;
+      err.clear();
+      (*mtimes)[i] = Stat((*paths)[i], &err);
+    }
+    lock.lock();
+    if (--stat_active_ == 0)
+      stat_done_cv_.notify_one();
+  }
+}
+
+void RealDiskInterface::StatMany(const std::vector<std::string>& paths,
+                                 std::vector<TimeStamp>* mtimes) {
+  // Fall back to the serial default when concurrent stats are unsafe
+  // (Windows stat cache enabled) or the batch is too small to be worth
+  // waking the pool.
+  if (!SupportsParallelStats() || paths.size() < 2) {
+    DiskInterface::StatMany(paths, mtimes);
+    return;
+  }
+  EnsureStatThreads();
+  if (stat_threads_.empty()) {
+    DiskInterface::StatMany(paths, mtimes);
+    return;
+  }
+
+  mtimes->resize(paths.size());
+  {
+    std::lock_guard<std::mutex> lock(stat_mutex_);
+    stat_paths_ = &paths;
+    stat_mtimes_ = mtimes;
+    stat_next_.store(0);
+    ++stat_generation_;
+  }
+  stat_cv_.notify_all();
+
+  // The calling thread races through the batch alongside the workers.
+  std::string err;
+  for (;;) {
+    size_t i = stat_next_.fetch_add(1);
+    if (i >= paths.size())
+      break;
+    err.clear();
+    (*mtimes)[i] = Stat(paths[i], &err);
+  }
+
+  // All indices are claimed; wait for the workers holding the last of
+  // them, then retire the batch so late-waking workers skip it.
+  std::unique_lock<std::mutex> lock(stat_mutex_);
+  stat_done_cv_.wait(lock, [this] { return stat_active_ == 0; });
+  stat_paths_ = nullptr;
+  stat_mtimes_ = nullptr;
+}
+
 TimeStamp RealDiskInterface::Stat(const std::string& path, std::string* err) const {
   METRIC_RECORD("node stat");
 #ifdef _WIN32
@@ -195,6 +404,30 @@ TimeStamp RealDiskInterface::Stat(const std::string& path, std::string* err) con
   DirCache::iterator di = ci->second.find(base);
   return di != ci->second.end() ? di->second : 0;
 #else
+  if (use_cache_) {
+    // Guarded by a lock instead of turning off SupportsParallelStats():
+    // cache hits barely contend, and misses serialize on a readdir that
+    // replaces hundreds of individual stats anyway.
+    std::lock_guard<std::mutex> lock(stat_cache_mutex_);
+    std::string dir = DirName(path);
+    std::string base(path.substr(dir.size() ? dir.size() + 1 : 0));
+    if (base == "..") {
+      // StatAllFilesInDir does not report any information for base = "..".
+      base = ".";
+      dir = path;
+    }
+
+    Cache::iterator ci = cache_.find(dir);
+    if (ci == cache_.end()) {
+      ci = cache_.emplace(dir, DirCache()).first;
+      if (!StatAllFilesInDir(dir.empty() ? "." : dir, &ci->second, err)) {
+        cache_.erase(ci);
+        return -1;
+      }
+    }
+    DirCache::iterator di = ci->second.find(base);
+    return di != ci->second.end() ? di->second : 0;
+  }
   struct stat st;
   if (stat(path.c_str(), &st) < 0) {
     if (errno == ENOENT || errno == ENOTDIR)
@@ -202,21 +435,7 @@ TimeStamp RealDiskInterface::Stat(const std::string& path, std::string* err) con
     *err = string_concat("stat(", path, "): ", strerror(errno));
     return -1;
   }
-  // Some users (Flatpak) set mtime to 0, this should be harmless
-  // and avoids conflicting with our return value of 0 meaning
-  // that it doesn't exist.
-  if (st.st_mtime == 0)
-    return 1;
-#if defined(_AIX)
-  return (int64_t)st.st_mtime * 1000000000LL + st.st_mtime_n;
-#elif defined(__APPLE__)
-  return ((int64_t)st.st_mtimespec.tv_sec * 1000000000LL +
-          st.st_mtimespec.tv_nsec);
-#elif defined(st_mtime) // A macro, so we're likely on modern POSIX.
-  return (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
-#else
-  return (int64_t)st.st_mtime * 1000000000LL + st.st_mtimensec;
-#endif
+  return TimeStampFromStat(st);
 #endif
 }
 
@@ -255,6 +474,17 @@ bool RealDiskInterface::MakeDir(const std::string& path) {
   return true;
 }
 
+FileReader::Status FileReader::LoadFile(const std::string& path,
+                                        std::unique_ptr<LoadedFile>* result,
+                                        std::string* err) {
+  std::string contents;
+  Status status = ReadFile(path, &contents, err);
+  if (status != Okay)
+    return status;
+  result->reset(new HeapLoadedFile(&contents));
+  return Okay;
+}
+
 FileReader::Status RealDiskInterface::ReadFile(const std::string& path,
                                                std::string* contents,
                                                std::string* err) {
@@ -265,6 +495,47 @@ FileReader::Status RealDiskInterface::ReadFile(const std::string& path,
   }
 }
 
+#ifndef _WIN32
+FileReader::Status RealDiskInterface::LoadFile(
+    const std::string& path, std::unique_ptr<LoadedFile>* result,
+    std::string* err) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    err->assign(strerror(errno));
+    return errno == ENOENT ? NotFound : OtherError;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    err->assign(strerror(errno));
+    close(fd);
+    return OtherError;
+  }
+
+  // An empty file cannot be mapped, and a file whose size is an exact
+  // multiple of the page size leaves no zero-fill byte in the mapping to
+  // serve as the NUL terminator the Lexer requires.  Fall back to a heap
+  // read for those rare cases.
+  size_t size = static_cast<size_t>(st.st_size);
+  size_t pagesize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  if (size == 0 || size % pagesize == 0) {
+    close(fd);
+    return FileReader::LoadFile(path, result, err);
+  }
+
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return FileReader::LoadFile(path, result, err);
+
+  AdviseHugePages(map, size);
+  if (g_prefault)
+    PrefaultMapping(map, size);
+  result->reset(new MappedLoadedFile(map, size));
+  return Okay;
+}
+#endif
+
 int RealDiskInterface::RemoveFile(const std::string& path) {
   if (remove(path.c_str()) < 0) {
     switch (errno) {
@@ -280,9 +551,15 @@ int RealDiskInterface::RemoveFile(const std::string& path) {
 }
 
 void RealDiskInterface::AllowStatCache(bool allow) {
-#ifdef _WIN32
+#ifndef _WIN32
+  std::lock_guard<std::mutex> lock(stat_cache_mutex_);
+#endif
   use_cache_ = allow;
-  if (!use_cache_)
+  if (!use_cache_) {
+    // The cache's keys are directories that were listed, i.e. exist;
+    // seed MakeDirs so the build skips re-statting them.
+    for (const auto & dir : cache_)
+      known_dirs_.insert(dir.first);
     cache_.clear();
-#endif
+  }
 }
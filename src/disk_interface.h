@@ -15,11 +15,32 @@
 #ifndef NINJA_DISK_INTERFACE_H_
 #define NINJA_DISK_INTERFACE_H_
 
+#include <atomic>
+#include <condition_variable>
 #include <map>
+#include <set>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include "timestamp.h"
 
+/// A file loaded into memory, either as a heap buffer or as a read-only
+/// memory mapping.  content() is guaranteed to be followed by a NUL byte
+/// at data()[size()]; the Lexer relies on that byte to detect end of input.
+struct LoadedFile {
+  virtual ~LoadedFile() = default;
+
+  /// The file contents, excluding the trailing NUL byte.
+  std::string_view content() const { return content_; }
+
+ protected:
+  std::string_view content_;
+};
+
 /// Interface for reading files from disk.  See DiskInterface for details.
 /// This base offers the minimum interface needed just to read files.
 struct FileReader {
@@ -36,6 +57,19 @@ struct FileReader {
   /// On error, return another Status and fill |err|.
   virtual Status ReadFile(const std::string& path, std::string* contents,
                           std::string* err) = 0;
+
+  /// Whether ReadFile tolerates concurrent calls from multiple threads.
+  /// Defaults to false; RealDiskInterface overrides this, which lets
+  /// callers batch independent reads (e.g. depfiles) onto worker threads.
+  virtual bool SupportsParallelReads() const { return false; }
+
+  /// Load \a path into memory, transferring ownership of the storage to the
+  /// caller.  The default implementation copies through ReadFile(); real
+  /// disk implementations may memory-map the file instead so large
+  /// manifests are never duplicated on the heap.
+  virtual Status LoadFile(const std::string& path,
+                          std::unique_ptr<LoadedFile>* result,
+                          std::string* err);
 };
 
 /// Interface for accessing the disk.
@@ -47,6 +81,21 @@ struct DiskInterface: public FileReader {
   /// other errors.
   virtual TimeStamp Stat(const std::string& path, std::string* err) const = 0;
 
+  /// Whether Stat tolerates concurrent calls from multiple threads.
+  /// Defaults to false; the dirty scan uses it to pre-stat the reachable
+  /// graph on worker threads before its serial walk.
+  virtual bool SupportsParallelStats() const { return false; }
+
+  /// stat() every path in \a paths, storing the result for paths[i] into
+  /// (*mtimes)[i] with Stat()'s encoding.  Error details are discarded
+  /// (the entry is just -1); callers wanting the message re-stat the
+  /// offending path serially.  The default implementation stats one at a
+  /// time on the calling thread; RealDiskInterface overlaps the batch on
+  /// a thread pool, which pipelines the stat latency that dominates cold
+  /// scans on high-latency filesystems.
+  virtual void StatMany(const std::vector<std::string>& paths,
+                        std::vector<TimeStamp>* mtimes);
+
   /// Create a directory, returning false on failure.
   virtual bool MakeDir(const std::string& path) = 0;
 
@@ -62,27 +111,84 @@ struct DiskInterface: public FileReader {
   ///          -1 if an error occurs.
   virtual int RemoveFile(const std::string& path) = 0;
 
+  /// Whether RemoveFile tolerates concurrent calls from multiple threads.
+  /// Defaults to false; the cleaner uses it to spread large removals
+  /// across worker threads.
+  virtual bool SupportsParallelRemoves() const { return false; }
+
   /// Create all the parent directories for path; like mkdir -p
-  /// `basename path`.
+  /// `basename path`.  Directories seen once are remembered, so in the
+  /// steady state this is a set lookup instead of a stat/mkdir chain per
+  /// output.
   bool MakeDirs(const std::string& path);
+
+  /// Forget which directories MakeDirs has seen; call after anything that
+  /// may have removed directories behind our back (e.g. a clean).
+  void ClearMakeDirsCache() { known_dirs_.clear(); }
+
+ protected:
+  /// Directories MakeDirs verified or created.
+  std::set<std::string> known_dirs_;
 };
 
 /// Implementation of DiskInterface that actually hits the disk.
 struct RealDiskInterface final : public DiskInterface {
   RealDiskInterface() = default;
-  virtual ~RealDiskInterface() = default;
+  virtual ~RealDiskInterface();
   TimeStamp Stat(const std::string& path, std::string* err) const override final;
+  void StatMany(const std::vector<std::string>& paths,
+                std::vector<TimeStamp>* mtimes) override final;
   bool MakeDir(const std::string& path) override final;
   bool WriteFile(const std::string& path, const std::string& contents) override final;
   Status ReadFile(const std::string& path, std::string* contents,
                   std::string* err) override final;
+  bool SupportsParallelReads() const override final { return true; }
+#ifdef _WIN32
+  // The per-directory stat cache is not guarded by a lock.
+  bool SupportsParallelStats() const override final { return !use_cache_; }
+#else
+  bool SupportsParallelStats() const override final { return true; }
+#endif
+#ifndef _WIN32
+  Status LoadFile(const std::string& path, std::unique_ptr<LoadedFile>* result,
+                  std::string* err) override final;
+#endif
   int RemoveFile(const std::string& path) override final;
+  bool SupportsParallelRemoves() const override final { return true; }
 
-  /// Whether stat information can be cached.  Only has an effect on Windows.
+  /// Whether stat information can be cached.  While enabled, the first
+  /// stat into a directory lists the whole directory into a per-directory
+  /// mtime map (FindFirstFile on Windows, readdir+fstatat elsewhere) and
+  /// later stats are served from it, including negative ones.
   void AllowStatCache(bool allow);
 
  private:
-#ifdef _WIN32
+  /// Start the stat pool if it is not running yet.
+  void EnsureStatThreads();
+  /// Worker loop of the stat pool: waits for a batch, then races the
+  /// other workers (and the caller) through it via stat_next_.
+  void StatWorker();
+
+  /// The stat pool.  Started lazily by the first big enough StatMany
+  /// batch and joined in the destructor; between batches the workers
+  /// block on stat_cv_.  A batch is published by pointing stat_paths_ /
+  /// stat_mtimes_ at the caller's storage and bumping stat_generation_.
+  std::vector<std::thread> stat_threads_;
+  std::mutex stat_mutex_;
+  std::condition_variable stat_cv_;
+  std::condition_variable stat_done_cv_;
+  const std::vector<std::string>* stat_paths_ = nullptr;
+  std::vector<TimeStamp>* stat_mtimes_ = nullptr;
+  size_t stat_generation_ = 0;
+  bool stat_exit_ = false;
+  /// Next unclaimed index of the current batch.
+  std::atomic<size_t> stat_next_{0};
+  /// Workers currently inside the batch (they enter and leave it while
+  /// holding stat_mutex_).  Once the caller has drained stat_next_
+  /// itself, stat_active_ == 0 means every claimed entry is done, and no
+  /// worker can touch the batch storage any more.
+  size_t stat_active_ = 0;
+
   /// Whether stat information can be cached.
   bool use_cache_ = false;
 
@@ -91,6 +197,11 @@ struct RealDiskInterface final : public DiskInterface {
   // works out, come up with a better data structure.
   typedef std::map<std::string, DirCache, std::less<>> Cache;
   mutable Cache cache_;
+#ifndef _WIN32
+  /// Guards use_cache_ and cache_ so cached stats stay safe under
+  /// StatMany's workers.  (On Windows the cache instead disables
+  /// SupportsParallelStats.)
+  mutable std::mutex stat_cache_mutex_;
 #endif
 };
 
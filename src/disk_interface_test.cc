@@ -14,6 +14,9 @@
 
 #include <assert.h>
 #include <stdio.h>
+
+#include <algorithm>
+#include <mutex>
 #ifdef _WIN32
 #include <io.h>
 #define NOMINMAX
@@ -86,6 +89,29 @@ TEST_F(DiskInterfaceTest, StatExistingFile) {
   EXPECT_EQ("", err);
 }
 
+TEST_F(DiskInterfaceTest, StatMany) {
+  std::string err;
+  ASSERT_TRUE(Touch("file1"));
+  ASSERT_TRUE(Touch("file2"));
+
+  // Large enough to wake the thread pool.
+  std::vector<std::string> paths = { "file1", "file2", "nosuchfile" };
+  for (int i = 0; i < 61; ++i)
+    paths.push_back("file1");
+  std::vector<TimeStamp> mtimes;
+  disk_.StatMany(paths, &mtimes);
+
+  ASSERT_EQ(paths.size(), mtimes.size());
+  EXPECT_EQ(disk_.Stat("file1", &err), mtimes[0]);
+  EXPECT_EQ(disk_.Stat("file2", &err), mtimes[1]);
+  EXPECT_GT(mtimes[0], 1);
+  EXPECT_GT(mtimes[1], 1);
+  EXPECT_EQ(0, mtimes[2]);
+  for (size_t i = 3; i < mtimes.size(); ++i)
+    EXPECT_EQ(mtimes[0], mtimes[i]);
+  EXPECT_EQ("", err);
+}
+
 TEST_F(DiskInterfaceTest, StatExistingDir) {
   std::string err;
   ASSERT_TRUE(disk_.MakeDir("subdir"));
@@ -167,6 +193,30 @@ TEST_F(DiskInterfaceTest, StatCache) {
   EXPECT_EQ(0, disk_.Stat("nosuchdir/nosuchfile", &err));
   EXPECT_EQ("", err);
 }
+#else
+TEST_F(DiskInterfaceTest, StatCache) {
+  std::string err;
+  ASSERT_TRUE(Touch("file1"));
+  ASSERT_TRUE(disk_.MakeDir("subdir"));
+  ASSERT_TRUE(Touch("subdir/subfile"));
+
+  disk_.AllowStatCache(true);
+  EXPECT_GT(disk_.Stat("file1", &err), 1);
+  EXPECT_GT(disk_.Stat("subdir", &err), 1);
+  EXPECT_GT(disk_.Stat("subdir/subfile", &err), 1);
+  EXPECT_EQ(disk_.Stat("subdir", &err), disk_.Stat("subdir/.", &err));
+  EXPECT_EQ(0, disk_.Stat("nosuchfile", &err));
+  EXPECT_EQ(0, disk_.Stat("nosuchdir/nosuchfile", &err));
+  EXPECT_EQ("", err);
+
+  // A directory is listed only once; a file created behind the cache's
+  // back stays invisible until the cache is dropped.
+  ASSERT_TRUE(Touch("subdir/latecomer"));
+  EXPECT_EQ(0, disk_.Stat("subdir/latecomer", &err));
+  disk_.AllowStatCache(false);
+  EXPECT_GT(disk_.Stat("subdir/latecomer", &err), 1);
+  EXPECT_EQ("", err);
+}
 #endif
 
 TEST_F(DiskInterfaceTest, ReadFile) {
@@ -206,6 +256,22 @@ TEST_F(DiskInterfaceTest, MakeDirs) {
 #endif
 }
 
+TEST_F(DiskInterfaceTest, MakeDirsMemoized) {
+  EXPECT_TRUE(disk_.MakeDirs("memo/dir/a_file"));
+  EXPECT_EQ(0, system("rmdir memo/dir"));
+
+  // The directory is remembered, so MakeDirs answers without noticing
+  // the removal...
+  EXPECT_TRUE(disk_.MakeDirs("memo/dir/a_file"));
+  std::string err;
+  EXPECT_EQ(0, disk_.Stat("memo/dir", &err));
+
+  // ...until the memo is dropped.
+  disk_.ClearMakeDirsCache();
+  EXPECT_TRUE(disk_.MakeDirs("memo/dir/a_file"));
+  EXPECT_GT(disk_.Stat("memo/dir", &err), 0);
+}
+
 TEST_F(DiskInterfaceTest, RemoveFile) {
   const char* kFileName = "file-to-remove";
   ASSERT_TRUE(Touch(kFileName));
@@ -219,7 +285,7 @@ struct StatTest : public StateTestWithBuiltinRules,
   StatTest() : scan_(&state_, nullptr, nullptr, this, nullptr) {}
 
   // DiskInterface implementation.
-  TimeStamp Stat(const std::string& path, std::string* err) const override final;
+  TimeStamp Stat(const std::string& path, std::string* err) const override;
   bool WriteFile(const std::string& path, const std::string& contents) override final {
     assert(false);
     return true;
@@ -322,4 +388,41 @@ TEST_F(StatTest, Middle) {
   ASSERT_TRUE(GetNode("out")->dirty());
 }
 
+/// Same disk as StatTest, but opted in to the parallel pre-stat the dirty
+/// scan runs before its serial walk.  Stat order is nondeterministic, so
+/// these tests check the set of paths stat'ed and the resulting dirty
+/// state rather than the sequence.
+struct ParallelStatTest : public StatTest {
+  bool SupportsParallelStats() const override { return true; }
+
+  TimeStamp Stat(const std::string& path, std::string* err) const override {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return StatTest::Stat(path, err);
+  }
+
+  mutable std::mutex stats_mutex_;
+};
+
+TEST_F(ParallelStatTest, Prestat) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"build out: cat mid1 mid2\n"
+"build mid1: cat in11 in12\n"
+"build mid2: cat in21 in22\n"));
+
+  mtimes_["in11"] = 1;
+  mtimes_["in12"] = 1;
+  mtimes_["in21"] = 1;
+  mtimes_["in22"] = 1;
+
+  EXPECT_TRUE(scan_.RecomputeDirty(GetNode("out"), nullptr));
+  // The pre-stat covers every reachable node, so the serial walk issues
+  // no further stats: one per node, in any order.
+  ASSERT_EQ(7u, stats_.size());
+  std::sort(stats_.begin(), stats_.end());
+  EXPECT_TRUE(std::unique(stats_.begin(), stats_.end()) == stats_.end());
+  EXPECT_TRUE(GetNode("out")->dirty());
+  EXPECT_TRUE(GetNode("mid1")->dirty());
+  EXPECT_FALSE(GetNode("in11")->dirty());
+}
+
 }  // namespace
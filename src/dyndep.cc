@@ -17,6 +17,11 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
 #include "debug_flags.h"
 #include "disk_interface.h"
 #include "dyndep_parser.h"
@@ -38,10 +43,83 @@ bool DyndepLoader::LoadDyndeps(Node* node, DyndepFile* ddf,
   node->set_dyndep_pending(false);
 
   // Load the dyndep information from the file.
-  EXPLAIN("loading dyndep file '%s'", node->path().c_str());
+  EXPLAIN("loading dyndep file '%s'", node->path_cstr());
   if (!LoadDyndepFile(node, ddf, err))
     return false;
 
+  return UpdateEdges(node, ddf, err);
+}
+
+bool DyndepLoader::LoadDyndeps(const std::vector<Node*>& nodes,
+                               std::string* err) const {
+  if (nodes.empty())
+    return true;
+
+  // Read every file up front, on a worker pool when there is more than
+  // one: for a wave of module-scan outputs the per-file open+read
+  // latency dominates and overlaps well across files.
+  struct Preloaded {
+    FileReader::Status status = FileReader::Okay;
+    std::unique_ptr<LoadedFile> file;
+    std::string read_err;
+  };
+  std::vector<Preloaded> files(nodes.size());
+
+  std::atomic<size_t> next_file(0);
+  auto read_files = [this, &nodes, &files, &next_file]() {
+    for (size_t i = next_file.fetch_add(1); i < nodes.size();
+         i = next_file.fetch_add(1)) {
+      Preloaded& slot = files[i];
+      slot.status = disk_interface_->LoadFile(std::string(nodes[i]->path()),
+                                              &slot.file, &slot.read_err);
+    }
+  };
+
+  size_t threads = std::min(
+      nodes.size(),
+      std::max<size_t>(1, std::thread::hardware_concurrency()));
+  if (threads > 1) {
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+      pool.emplace_back(read_files);
+    for (auto & thread : pool)
+      thread.join();
+  } else {
+    read_files();
+  }
+
+  // Parse and apply serially, in order.  Keep going past failures so a
+  // bad file does not hide the information in the rest of the wave (the
+  // cleaner relies on loading as much of the graph as it can); report
+  // the first error.
+  bool ok = true;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    Node* node = nodes[i];
+    node->set_dyndep_pending(false);
+    EXPLAIN("loading dyndep file '%s'", node->path_cstr());
+
+    std::string file_err;
+    DyndepFile ddf;
+    if (files[i].status != FileReader::Okay) {
+      file_err = string_concat("loading '", node->path(), "': ",
+                               files[i].read_err);
+    } else {
+      DyndepParser parser(state_, disk_interface_, &ddf);
+      if (parser.LoadPreloaded(std::string(node->path()),
+                               std::move(files[i].file), &file_err))
+        UpdateEdges(node, &ddf, &file_err);
+    }
+    if (!file_err.empty() && ok) {
+      *err = std::move(file_err);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool DyndepLoader::UpdateEdges(Node* node, DyndepFile* ddf,
+                               std::string* err) const {
   // Update each edge that specified this node as its dyndep binding.
   std::vector<Edge*> const& out_edges = node->out_edges();
   for (auto const& edge : out_edges) {
@@ -95,13 +173,14 @@ bool DyndepLoader::UpdateEdge(Edge* edge, Dyndeps const* dyndeps,
                         dyndeps->implicit_outputs_.begin(),
                         dyndeps->implicit_outputs_.end());
   edge->implicit_outs_ += dyndeps->implicit_outputs_.size();
+  edge->discovered_outs_ += dyndeps->implicit_outputs_.size();
 
   // Add this edge as incoming to each new output.
   for(auto const& output : dyndeps->implicit_outputs_)
   {
     if(output->in_edge() != nullptr)
     {
-      *err = "multiple rules generate " + output->path();
+      *err = string_concat("multiple rules generate ", output->path());
       return false;
     }
     output->set_in_edge(edge);
@@ -112,6 +191,7 @@ bool DyndepLoader::UpdateEdge(Edge* edge, Dyndeps const* dyndeps,
                        dyndeps->implicit_inputs_.begin(),
                        dyndeps->implicit_inputs_.end());
   edge->implicit_deps_ += dyndeps->implicit_inputs_.size();
+  edge->discovered_deps_ += dyndeps->implicit_inputs_.size();
 
   // Add this edge as outgoing from each new input.
   for(auto const& in : dyndeps->implicit_inputs_)
@@ -125,5 +205,5 @@ bool DyndepLoader::UpdateEdge(Edge* edge, Dyndeps const* dyndeps,
 bool DyndepLoader::LoadDyndepFile(Node* file, DyndepFile* ddf,
                                   std::string* err) const {
   DyndepParser parser(state_, disk_interface_, ddf);
-  return parser.Load(file->path(), err);
+  return parser.Load(std::string(file->path()), err);
 }
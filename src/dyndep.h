@@ -52,9 +52,20 @@ struct DyndepLoader {
   bool LoadDyndeps(Node* node, std::string* err) const;
   bool LoadDyndeps(Node* node, DyndepFile* ddf, std::string* err) const;
 
+  /// Load a batch of dyndep files and update the build graph.  The file
+  /// contents are read on a worker pool -- a wave of module-scan outputs
+  /// is dominated by per-file read latency -- while parsing and graph
+  /// updates stay serialized, in \a nodes order, because parsing resolves
+  /// paths against shared graph state.  Every file is attempted even
+  /// after a failure; returns false with the first error encountered.
+  bool LoadDyndeps(const std::vector<Node*>& nodes, std::string* err) const;
+
  private:
   bool LoadDyndepFile(Node* file, DyndepFile* ddf, std::string* err) const;
 
+  /// Apply one loaded dyndep file to the edges bound to \a node.
+  bool UpdateEdges(Node* node, DyndepFile* ddf, std::string* err) const;
+
   bool UpdateEdge(Edge* edge, Dyndeps const* dyndeps, std::string* err) const;
 
   State* state_;
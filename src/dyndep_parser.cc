@@ -31,7 +31,7 @@ DyndepParser::DyndepParser(State* state, FileReader* file_reader,
     , dyndep_file_(dyndep_file) {
 }
 
-bool DyndepParser::Parse(const std::string& filename, const std::string& input,
+bool DyndepParser::Parse(const std::string& filename, std::string_view input,
                          std::string* err) {
   lexer_.Start(filename, input);
 
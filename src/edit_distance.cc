@@ -14,6 +14,8 @@
 
 #include "edit_distance.h"
 
+#include <stdlib.h>
+
 #include <algorithm>
 #include <vector>
 
@@ -33,31 +35,81 @@ int EditDistance(std::string_view s1,
   // only the entries to the left, top, and top-left are needed.  The left
   // entry is in row[x-1], the top entry is what's in row[x] from the last
   // iteration, and the top-left entry is stored in previous.
+  //
+  // Spellcheck callers compare one mistyped name against millions of
+  // candidates with a small bound, so three bounded-distance refinements
+  // matter here:
+  //  - the length difference alone is a lower bound on the distance,
+  //  - a shared prefix or suffix never costs an edit and is stripped
+  //    before the table is built (build paths share long directory
+  //    prefixes, so this usually leaves only a few characters), and
+  //  - cells further than the bound from the diagonal can never be on a
+  //    within-bound edit path, so each row only evaluates the Ukkonen
+  //    band of 2*max_edit_distance+1 cells around the diagonal.
+
+  if (max_edit_distance) {
+    int length_difference = (int)s1.size() - (int)s2.size();
+    if (abs(length_difference) > max_edit_distance)
+      return max_edit_distance + 1;
+  }
+
+  size_t shortest = std::min(s1.size(), s2.size());
+  size_t common_prefix = 0;
+  while (common_prefix < shortest && s1[common_prefix] == s2[common_prefix])
+    ++common_prefix;
+  s1.remove_prefix(common_prefix);
+  s2.remove_prefix(common_prefix);
+  shortest -= common_prefix;
+  size_t common_suffix = 0;
+  while (common_suffix < shortest &&
+         s1[s1.size() - 1 - common_suffix] ==
+             s2[s2.size() - 1 - common_suffix])
+    ++common_suffix;
+  s1.remove_suffix(common_suffix);
+  s2.remove_suffix(common_suffix);
+
   int m = s1.size();
   int n = s2.size();
+  if (m == 0)
+    return n;
+  if (n == 0)
+    return m;
+
+  // An out-of-band stand-in larger than any distance the table can hold.
+  const int kInfinity = m + n + 1;
+  const int band = max_edit_distance ? max_edit_distance : kInfinity;
 
   std::vector<int> row(n + 1);
   for (int i = 1; i <= n; ++i)
     row[i] = i;
 
   for (int y = 1; y <= m; ++y) {
-    row[0] = y;
-    int best_this_row = row[0];
+    int x_begin = std::max(y - band, 1);
+    int x_end = std::min(y + band, n);
+    // The top-left neighbor of the band's first cell is always inside the
+    // previous row's band; the left neighbor only exists when the band
+    // touches column 0.
+    int previous = x_begin == 1 ? y - 1 : row[x_begin - 1];
+    int left = x_begin == 1 ? y : kInfinity;
+    int best_this_row = left;
 
-    int previous = y - 1;
-    for (int x = 1; x <= n; ++x) {
+    for (int x = x_begin; x <= x_end; ++x) {
       int old_row = row[x];
+      // The cell directly above the band's last column was outside the
+      // previous row's band, so its stored value is stale.
+      int top = x == y + band ? kInfinity : old_row;
       if (allow_replacements) {
         row[x] = std::min(previous + (s1[y - 1] == s2[x - 1] ? 0 : 1),
-                     std::min(row[x - 1], row[x]) + 1);
+                     std::min(left, top) + 1);
       }
       else {
         if (s1[y - 1] == s2[x - 1])
           row[x] = previous;
         else
-          row[x] = std::min(row[x - 1], row[x]) + 1;
+          row[x] = std::min(left, top) + 1;
       }
       previous = old_row;
+      left = row[x];
       best_this_row = std::min(best_this_row, row[x]);
     }
 
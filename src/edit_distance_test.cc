@@ -41,6 +41,25 @@ TEST(EditDistanceTest, TestAllowReplacements) {
   EXPECT_EQ(2, EditDistance("njnja", "ninja", allow_replacements));
 }
 
+TEST(EditDistanceTest, TestBounded) {
+  const bool allow_replacements = true;
+  // Lengths alone exceed the bound.
+  EXPECT_EQ(4, EditDistance("a", "aaaaaaaa", allow_replacements, 3));
+  // Long shared prefixes and suffixes cost nothing; the band only ever
+  // sees the differing middle.
+  EXPECT_EQ(1, EditDistance("out/some/long/path/obj/foo.o",
+                            "out/some/long/path/obj/fou.o",
+                            allow_replacements, 3));
+  EXPECT_EQ(2, EditDistance("out/some/long/path/obj/foo.o",
+                            "out/some/long/path/objs/fo.o",
+                            allow_replacements, 3));
+  EXPECT_EQ(4, EditDistance("out/abcdefgh/foo.o", "out/hgfedcba/foo.o",
+                            allow_replacements, 3));
+  // The banded result still matches the exact distance within the bound.
+  EXPECT_EQ(3, EditDistance("kitten", "sitting", allow_replacements, 3));
+  EXPECT_EQ(3, EditDistance("kitten", "sitting", allow_replacements, 0));
+}
+
 TEST(EditDistanceTest, TestBasics) {
   EXPECT_EQ(0, EditDistance("browser_tests", "browser_tests"));
   EXPECT_EQ(1, EditDistance("browser_test", "browser_tests"));
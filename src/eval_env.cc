@@ -17,7 +17,7 @@
 #include "eval_env.h"
 #include "string_concat.h"
 
-std::string BindingEnv::LookupVariable(const std::string& var) {
+std::string BindingEnv::LookupVariable(std::string_view var) {
   if(auto const& i = bindings_.find(var); i != bindings_.end())
   {
     return i->second;
@@ -33,6 +33,18 @@ void BindingEnv::AddBinding(const std::string& key, const std::string& val) {
   bindings_[key] = val;
 }
 
+bool BindingEnv::HasBinding(std::string_view key) const {
+  if(bindings_.find(key) != bindings_.end())
+  {
+    return true;
+  }
+  else if(parent_)
+  {
+    return parent_->HasBinding(key);
+  }
+  return false;
+}
+
 void BindingEnv::AddRule(const Rule* rule) {
   assert(LookupRuleCurrentScope(rule->name()) == nullptr);
   rules_[rule->name()] = rule;
@@ -60,9 +72,13 @@ const Rule* BindingEnv::LookupRule(const std::string& rule_name) {
 
 void Rule::AddBinding(const std::string& key, const EvalString& val) {
   bindings_[key] = val;
+  if (key == "command")
+  {
+    command_spliceable_ = val.OnlyReferencesInOut();
+  }
 }
 
-const EvalString* Rule::GetBinding(const std::string& key) const {
+const EvalString* Rule::GetBinding(std::string_view key) const {
   if(auto const& i = bindings_.find(key); i != bindings_.end())
   {
     return &i->second;
@@ -82,14 +98,23 @@ bool Rule::IsReservedBinding(const std::string& var) {
          || var == "generator"
          || var == "description"
          || var == "rspfile_content"
-         || var == "msvc_deps_prefix";
+         || var == "msvc_deps_prefix"
+         || var == "builtin"
+         || var == "expected_memory"
+         || var == "local"
+         || var == "worker_command"
+         || var == "concurrency"
+         || var == "batch"
+         || var == "stream"
+         || var == "cpu_affinity"
+         || var == "cgroup";
 }
 
 BindingEnv::RuleMap const& BindingEnv::GetRules() const {
   return rules_;
 }
 
-std::string BindingEnv::LookupWithFallback(const std::string& var,
+std::string BindingEnv::LookupWithFallback(std::string_view var,
                                       const EvalString* eval,
                                       Env* env) {
   if (auto const& i = bindings_.find(var); i != bindings_.end())
@@ -112,52 +137,77 @@ std::string BindingEnv::LookupWithFallback(const std::string& var,
 
 std::string EvalString::Evaluate(Env* env) const {
   std::string result;
-  for (auto const& [token, type] : parsed_)
+  for (const Token& token : tokens_)
   {
-    if (type == RAW)
+    if (token.type == RAW)
     {
-      result.append(token);
+      result.append(token_text(token));
     }
     else
     {
-      result.append(env->LookupVariable(token));
+      result.append(env->LookupVariable(token_text(token)));
     }
   }
   return result;
 }
 
-void EvalString::AddText(std::string_view text) {
-  // Add it to the end of an existing RAW token if possible.
-  if(parsed_.empty())
+bool EvalString::IsLiteral() const {
+  for (const Token& token : tokens_)
   {
-    parsed_.emplace_back(std::string(text), RAW);
+    if (token.type == SPECIAL)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool EvalString::OnlyReferencesInOut() const {
+  for (const Token& token : tokens_)
+  {
+    if (token.type == SPECIAL && token_text(token) != "in" &&
+        token_text(token) != "in_newline" && token_text(token) != "out")
+    {
+      return false;
+    }
   }
-  else if(auto & [token, type] = parsed_.back(); type == RAW)
+  return true;
+}
+
+void EvalString::AddText(std::string_view text) {
+  // Extend the trailing RAW token if there is one; its bytes are already
+  // at the end of text_, so appending keeps the span contiguous.
+  if (!tokens_.empty() && tokens_.back().type == RAW)
   {
-    token.append(text);
+    text_.append(text);
+    tokens_.back().len += static_cast<uint32_t>(text.size());
   }
   else
   {
-    parsed_.emplace_back(std::string(text), RAW);
+    tokens_.push_back(Token{ static_cast<uint32_t>(text_.size()),
+                             static_cast<uint32_t>(text.size()), RAW });
+    text_.append(text);
   }
 }
 
 void EvalString::AddSpecial(std::string_view text) {
-  parsed_.emplace_back(std::string(text), SPECIAL);
+  tokens_.push_back(Token{ static_cast<uint32_t>(text_.size()),
+                           static_cast<uint32_t>(text.size()), SPECIAL });
+  text_.append(text);
 }
 
 std::string EvalString::Serialize() const {
   std::string result;
   // TODO: Precalculate allocation
-  for (auto const& [token, type] : parsed_)
+  for (const Token& token : tokens_)
   {
-    if(type == SPECIAL)
+    if(token.type == SPECIAL)
     {
-        string_append(result, "[$", token, "]");
+        string_append(result, "[$", token_text(token), "]");
     }
     else
     {
-        string_append(result, "[", token, "]");
+        string_append(result, "[", token_text(token), "]");
     }
   }
   return result;
@@ -166,15 +216,15 @@ std::string EvalString::Serialize() const {
 std::string EvalString::Unparse() const {
   std::string result;
   // TODO: Precalculate allocation
-  for (auto const& [token, type] : parsed_)
+  for (const Token& token : tokens_)
   {
-    if(type == SPECIAL)
+    if(token.type == SPECIAL)
     {
-        string_append(result, "${", token, "}");
+        string_append(result, "${", token_text(token), "}");
     }
     else
     {
-        result.append(token);
+        result.append(token_text(token));
     }
   }
   return result;
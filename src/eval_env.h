@@ -15,22 +15,27 @@
 #ifndef NINJA_EVAL_ENV_H_
 #define NINJA_EVAL_ENV_H_
 
-#include <map>
 #include <string>
 #include <vector>
 
 #include <string_view>
 
+#include "flat_map.h"
+
 struct Rule;
 
 /// An interface for a scope for variable (e.g. "$foo") lookups.
 struct Env {
   virtual ~Env() = default;
-  virtual std::string LookupVariable(const std::string& var) = 0;
+  virtual std::string LookupVariable(std::string_view var) = 0;
 };
 
 /// A tokenized std::string that contains variable references.
 /// Can be evaluated relative to an Env.
+/// All fragment text lives in one owned buffer; the token list is a
+/// compact (offset, length, type) array over it, so parsing a manifest
+/// allocates two buffers per value instead of one string per fragment
+/// and Evaluate() scans contiguous memory.
 struct EvalString final {
   /// @return The evaluated string with variable expanded using value found in
   ///         environment @a env.
@@ -39,8 +44,20 @@ struct EvalString final {
   /// @return The string with variables not expanded.
   std::string Unparse() const;
 
-  void Clear() { parsed_.clear(); }
-  bool empty() const { return parsed_.empty(); }
+  void Clear() {
+    text_.clear();
+    tokens_.clear();
+  }
+  bool empty() const { return tokens_.empty(); }
+
+  /// @return true if the string contains no variable references, i.e.
+  ///         Evaluate() never consults the Env.
+  bool IsLiteral() const;
+
+  /// @return true if every variable reference is $in, $in_newline or $out.
+  ///         Such a string never consults the edge's scope chain, so it can
+  ///         be spliced from its literal pieces and the edge's path lists.
+  bool OnlyReferencesInOut() const;
 
   void AddText(std::string_view text);
   void AddSpecial(std::string_view text);
@@ -50,9 +67,28 @@ struct EvalString final {
   std::string Serialize() const;
 
 private:
+  // ManifestCache serializes the parsed form directly.
+  friend struct ManifestCache;
+  // Edge::EvaluateCommand splices pre-flattened commands token by token.
+  friend struct Edge;
+
   enum TokenType { RAW, SPECIAL };
-  typedef std::vector<std::pair<std::string, TokenType> > TokenList;
-  TokenList parsed_;
+
+  /// A fragment of text_; RAW bytes are copied through verbatim,
+  /// SPECIAL names a variable to look up.
+  struct Token {
+    uint32_t offset;
+    uint32_t len;
+    TokenType type;
+  };
+
+  std::string_view token_text(const Token& token) const {
+    return std::string_view(text_.data() + token.offset, token.len);
+  }
+
+  /// Every fragment's bytes, back to back in parse order.
+  std::string text_;
+  std::vector<Token> tokens_;
 };
 
 /// An invokable build command and associated metadata (description, etc.).
@@ -65,15 +101,22 @@ struct Rule final {
 
   static bool IsReservedBinding(const std::string& var);
 
-  const EvalString* GetBinding(const std::string& key) const;
+  const EvalString* GetBinding(std::string_view key) const;
+
+  /// True if the "command" binding only references $in/$out, so
+  /// Edge::EvaluateCommand can splice it without the recursive
+  /// environment walk.  Computed once when the binding is added.
+  bool command_spliceable() const { return command_spliceable_; }
 
  private:
   // Allow the parsers to reach into this object and fill out its fields.
   friend struct ManifestParser;
+  friend struct ManifestCache;
 
   std::string name_;
-  typedef std::map<std::string, EvalString, std::less<>> Bindings;
+  typedef FlatStringMap<EvalString> Bindings;
   Bindings bindings_;
+  bool command_spliceable_ = false;
 };
 
 /// An Env which contains a mapping of variables to values
@@ -83,27 +126,33 @@ struct BindingEnv final : public Env {
   explicit BindingEnv(BindingEnv* parent) : parent_(parent) {}
 
   virtual ~BindingEnv() = default;
-  std::string LookupVariable(const std::string& var) override final;
+  std::string LookupVariable(std::string_view var) override final;
 
   void AddRule(const Rule* rule);
   const Rule* LookupRule(const std::string& rule_name);
   const Rule* LookupRuleCurrentScope(const std::string& rule_name);
 
-  using RuleMap = std::map<std::string, const Rule*, std::less<>>;
+  using RuleMap = FlatStringMap<const Rule*>;
   RuleMap const& GetRules() const;
 
   void AddBinding(const std::string& key, const std::string& val);
 
+  /// @return true if this scope or any enclosing scope binds @a key.
+  bool HasBinding(std::string_view key) const;
+
   /// This is tricky.  Edges want lookup scope to go in this order:
   /// 1) value set on edge itself (edge_->env_)
   /// 2) value set on rule, with expansion in the edge's scope
   /// 3) value set on enclosing scope of edge (edge_->env_->parent_)
   /// This function takes as parameters the necessary info to do (2).
-  std::string LookupWithFallback(const std::string& var, const EvalString* eval,
+  std::string LookupWithFallback(std::string_view var, const EvalString* eval,
                                  Env* env);
 
 private:
-  using BindingMap = std::map<std::string, std::string, std::less<>>;
+  // ManifestCache serializes scope chains directly.
+  friend struct ManifestCache;
+
+  using BindingMap = FlatStringMap<std::string>;
 
   BindingMap bindings_;
   RuleMap rules_;
@@ -0,0 +1,194 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "event_trace.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "graph.h"
+#include "metrics.h"
+#include "state.h"
+#include "string_concat.h"
+
+using namespace std;
+
+EventTrace* g_event_trace = nullptr;
+
+namespace {
+
+/// Append \a str to \a out as a double-quoted JSON string.
+void AppendJSONString(std::string_view str, std::string* out) {
+  out->push_back('"');
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if ((unsigned char)c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out->append(buf);
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
+
+/// Start one event object, emitting the fields every event shares.
+/// The caller appends any extra fields and calls EndEvent.
+void BeginEvent(const char* phase, const char* name, int tid,
+                std::string* out) {
+  string_append(*out, ",\n{\"ph\":\"", phase, "\",\"pid\":0,\"tid\":",
+                to_string(tid), ",\"name\":");
+  AppendJSONString(name, out);
+}
+
+void AppendMicros(const char* field, int64_t value, std::string* out) {
+  string_append(*out, ",\"", field, "\":", to_string(value));
+}
+
+}  // anonymous namespace
+
+void EventTrace::RecordSpan(const char* name, int64_t start_us,
+                            int64_t end_us) {
+  spans_.push_back({ name, start_us, end_us });
+}
+
+void EventTrace::EdgeQueued(const Edge* edge) {
+  EdgeEvent& event = open_[edge];
+  event.name = edge->outputs_[0]->path();
+  event.rule = edge->rule().name();
+  event.pool = edge->pool()->name();
+  event.queued = GetTimeMicros();
+}
+
+void EventTrace::EdgeStarted(const Edge* edge) {
+  // Edges normally pass through EdgeQueued first; an edge started some
+  // other way (tests driving the status directly) just appears here.
+  EdgeEvent& event = open_[edge];
+  if (event.name.empty() && !edge->outputs_.empty())
+    event.name = edge->outputs_[0]->path();
+  event.start = GetTimeMicros();
+  if (!event.queued)
+    event.queued = event.start;
+}
+
+void EventTrace::EdgeFinished(const Edge* edge, bool success) {
+  std::map<const Edge*, EdgeEvent>::iterator i = open_.find(edge);
+  if (i == open_.end())
+    return;
+  i->second.end = GetTimeMicros();
+  i->second.success = success;
+  finished_.push_back(std::move(i->second));
+  open_.erase(i);
+}
+
+bool EventTrace::Finish(std::string* err) {
+  // Everything is expressed relative to the earliest timestamp, so the
+  // viewer's time axis starts near zero.
+  int64_t base = INT64_MAX;
+  for (const Span& span : spans_)
+    base = std::min(base, span.start);
+  for (const EdgeEvent& event : finished_)
+    base = std::min(base, event.queued);
+  if (base == INT64_MAX)
+    base = 0;
+
+  std::string out = "[\n";
+  out.append("{\"ph\":\"M\",\"pid\":0,\"tid\":0,\"name\":\"thread_name\","
+             "\"args\":{\"name\":\"main\"}}");
+
+  for (const Span& span : spans_) {
+    BeginEvent("X", span.name, 0, &out);
+    AppendMicros("ts", span.start - base, &out);
+    AppendMicros("dur", span.end - span.start, &out);
+    out.push_back('}');
+  }
+
+  // Greedily pack the running intervals into job-slot lanes: each edge
+  // takes the lowest-numbered lane free at its start time, which yields
+  // one lane per concurrently running command.
+  std::sort(finished_.begin(), finished_.end(),
+            [](const EdgeEvent& a, const EdgeEvent& b) {
+              return a.start < b.start;
+            });
+  std::vector<int64_t> lane_busy_until;
+  for (const EdgeEvent& event : finished_) {
+    size_t lane = 0;
+    while (lane < lane_busy_until.size() && lane_busy_until[lane] > event.start)
+      ++lane;
+    if (lane == lane_busy_until.size())
+      lane_busy_until.push_back(0);
+    lane_busy_until[lane] = event.end;
+
+    BeginEvent("X", event.name.c_str(), (int)(lane + 1), &out);
+    AppendMicros("ts", event.start - base, &out);
+    AppendMicros("dur", event.end - event.start, &out);
+    out.append(",\"args\":{\"rule\":");
+    AppendJSONString(event.rule, &out);
+    out.append(",\"pool\":");
+    AppendJSONString(event.pool.empty() ? "(default)" : event.pool, &out);
+    AppendMicros("queue wait (us)", event.start - event.queued, &out);
+    string_append(out, ",\"success\":", event.success ? "true" : "false",
+                  "}}");
+  }
+  for (size_t lane = 0; lane < lane_busy_until.size(); ++lane) {
+    string_append(out, ",\n{\"ph\":\"M\",\"pid\":0,\"tid\":",
+                  to_string(lane + 1),
+                  ",\"name\":\"thread_name\",\"args\":{\"name\":\"job slot ",
+                  to_string(lane), "\"}}");
+  }
+
+  // Per-pool queue depth over time, as counter tracks: +1 when an edge is
+  // queued, -1 when its command starts.
+  std::map<std::string, std::vector<std::pair<int64_t, int>>> pool_deltas;
+  for (const EdgeEvent& event : finished_) {
+    std::vector<std::pair<int64_t, int>>& deltas = pool_deltas[event.pool];
+    deltas.push_back({ event.queued, 1 });
+    deltas.push_back({ event.start, -1 });
+  }
+  for (auto& [pool, deltas] : pool_deltas) {
+    std::sort(deltas.begin(), deltas.end());
+    std::string counter =
+        pool.empty() ? std::string("queued")
+                     : string_concat("queued (", pool, ")");
+    int depth = 0;
+    for (const auto& [ts, delta] : deltas) {
+      depth += delta;
+      BeginEvent("C", counter.c_str(), 0, &out);
+      AppendMicros("ts", ts - base, &out);
+      string_append(out, ",\"args\":{\"edges\":", to_string(depth), "}}");
+    }
+  }
+
+  out.append("\n]\n");
+
+  FILE* file = fopen(path_.c_str(), "wb");
+  if (!file) {
+    *err = string_concat("opening ", path_, ": ", strerror(errno));
+    return false;
+  }
+  bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+  if (fclose(file) != 0)
+    ok = false;
+  if (!ok) {
+    *err = string_concat("writing ", path_, ": ", strerror(errno));
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,78 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_EVENT_TRACE_H_
+#define NINJA_EVENT_TRACE_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "util.h"  // For int64_t.
+
+struct Edge;
+
+/// Records a timeline of the whole run -- the load/scan/build phases and
+/// every edge's queued and running intervals -- and writes it as Chrome
+/// trace-event JSON that Perfetto and chrome://tracing open directly.
+/// Enabled with `-d trace=FILE`.  Unlike timelines reconstructed from
+/// .ninja_log, this covers the phases before the first command and the
+/// time edges spend waiting in the ready queue.
+///
+/// All recording happens on the main thread, from the plan and the build
+/// status; timestamps come from the Metrics clock (GetTimeMicros).
+struct EventTrace {
+  explicit EventTrace(std::string path) : path_(std::move(path)) {}
+
+  /// Record a completed phase span (manifest load, target scan, ...).
+  /// \a name must outlive the trace; call sites pass string literals.
+  void RecordSpan(const char* name, int64_t start_us, int64_t end_us);
+
+  /// Edge lifecycle: queued when the plan schedules it (including into a
+  /// full pool), started/finished around its command.
+  void EdgeQueued(const Edge* edge);
+  void EdgeStarted(const Edge* edge);
+  void EdgeFinished(const Edge* edge, bool success);
+
+  /// Assign job-slot lanes and write the JSON file.  Returns false and
+  /// fills \a err on I/O failure.
+  bool Finish(std::string* err);
+
+ private:
+  struct EdgeEvent {
+    std::string name;
+    std::string rule;
+    std::string pool;
+    int64_t queued = 0;
+    int64_t start = 0;
+    int64_t end = 0;
+    bool success = false;
+  };
+
+  std::string path_;
+  /// Edges queued or running, keyed by identity until they finish.
+  std::map<const Edge*, EdgeEvent> open_;
+  std::vector<EdgeEvent> finished_;
+
+  struct Span {
+    const char* name;
+    int64_t start;
+    int64_t end;
+  };
+  std::vector<Span> spans_;
+};
+
+extern EventTrace* g_event_trace;
+
+#endif  // NINJA_EVENT_TRACE_H_
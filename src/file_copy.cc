@@ -0,0 +1,168 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// copy_file_range() is only declared under _GNU_SOURCE.
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "file_copy.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+#endif
+
+#if defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+
+#include "string_concat.h"
+#include "util.h"
+
+using namespace std;
+
+#ifndef _WIN32
+namespace {
+
+/// The read/write loop of last resort, shared by every platform branch
+/// whose fast path the filesystem declined.
+bool CopyByReading(int in, int out, const string& from, const string& to,
+                   string* err) {
+  char buf[256 << 10];
+  for (;;) {
+    ssize_t len = read(in, buf, sizeof(buf));
+    if (len == 0)
+      return true;
+    if (len < 0) {
+      if (errno == EINTR)
+        continue;
+      *err = string_concat("read ", from, ": ", strerror(errno));
+      return false;
+    }
+    const char* p = buf;
+    while (len > 0) {
+      ssize_t wrote = write(out, p, len);
+      if (wrote < 0) {
+        if (errno == EINTR)
+          continue;
+        *err = string_concat("write ", to, ": ", strerror(errno));
+        return false;
+      }
+      p += wrote;
+      len -= wrote;
+    }
+  }
+}
+
+}  // anonymous namespace
+#endif  // !_WIN32
+
+bool CopyFileContents(const string& from, const string& to, string* err) {
+#ifdef _WIN32
+  // CopyFile already uses the cheapest kernel path available and
+  // carries the attributes along.
+  if (!::CopyFileA(from.c_str(), to.c_str(), /*bFailIfExists=*/FALSE)) {
+    *err = string_concat("copying ", from, " to ", to, ": ",
+                         GetLastErrorString());
+    return false;
+  }
+  return true;
+#else
+  int in = open(from.c_str(), O_RDONLY);
+  if (in < 0) {
+    *err = string_concat(from, ": ", strerror(errno));
+    return false;
+  }
+  struct stat st = {};
+  if (fstat(in, &st) < 0) {
+    *err = string_concat("stat ", from, ": ", strerror(errno));
+    close(in);
+    return false;
+  }
+
+#if defined(__APPLE__)
+  // clonefile() refuses to replace an existing target, so clear the way
+  // first; on non-APFS volumes it fails and we fall through.
+  unlink(to.c_str());
+  if (clonefile(from.c_str(), to.c_str(), 0) == 0) {
+    close(in);
+    return true;
+  }
+#endif
+
+  // The source's permission bits carry over so an installed tool or
+  // script stays executable.
+  int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 0777);
+  if (out < 0) {
+    *err = string_concat(to, ": ", strerror(errno));
+    close(in);
+    return false;
+  }
+
+  bool ok = true;
+#if defined(__linux__)
+  if (ioctl(out, FICLONE, in) == 0) {
+    // Reflinked: the blocks are shared, nothing to transfer.
+  } else if (off_t remaining = st.st_size; remaining == 0) {
+    // Nothing to transfer either way.
+  } else if (ssize_t first = copy_file_range(in, nullptr, out, nullptr,
+                                             remaining, 0);
+             first < 0) {
+    // EXDEV, EINVAL or ENOSYS: a filesystem or kernel that does not
+    // speak copy_file_range.  Nothing has been copied yet, so the
+    // plain loop can take over from the start.
+    ok = CopyByReading(in, out, from, to, err);
+  } else {
+    remaining -= first;
+    while (ok && remaining > 0) {
+      ssize_t n = copy_file_range(in, nullptr, out, nullptr, remaining, 0);
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        *err = string_concat("copying ", from, " to ", to, ": ",
+                             strerror(errno));
+        ok = false;
+      } else if (n == 0) {
+        // The source shrank underneath us; stop at what it has now.
+        break;
+      } else {
+        remaining -= n;
+      }
+    }
+  }
+#else
+  ok = CopyByReading(in, out, from, to, err);
+#endif
+
+  close(in);
+  if (close(out) < 0 && ok) {
+    *err = string_concat("close ", to, ": ", strerror(errno));
+    ok = false;
+  }
+  return ok;
+#endif  // !_WIN32
+}
@@ -0,0 +1,31 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_FILE_COPY_H_
+#define NINJA_FILE_COPY_H_
+
+#include <string>
+
+/// Copy \a from over \a to as cheaply as the filesystem allows,
+/// truncating any existing \a to and preserving the source's permission
+/// bits.  A reflink is attempted first (FICLONE on Btrfs/XFS, clonefile
+/// on APFS), so the data blocks are shared copy-on-write and the copy
+/// costs only metadata; then copy_file_range, which keeps the data in
+/// the kernel; then a plain read/write loop.  Used by `builtin = copy`
+/// edges and the action cache.  On failure \a err describes what went
+/// wrong.
+bool CopyFileContents(const std::string& from, const std::string& to,
+                      std::string* err);
+
+#endif  // NINJA_FILE_COPY_H_
@@ -0,0 +1,99 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "file_copy.h"
+
+#include <stdio.h>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include "test.h"
+
+namespace {
+
+struct FileCopyTest : public testing::Test {
+  virtual void SetUp() {
+    temp_dir_.CreateAndEnter("FileCopyTest");
+  }
+
+  virtual void TearDown() {
+    temp_dir_.Cleanup();
+  }
+
+  void WriteFile(const std::string& path, const std::string& contents) {
+    FILE* f = fopen(path.c_str(), "wb");
+    ASSERT_TRUE(f);
+    ASSERT_EQ(contents.size(), fwrite(contents.data(), 1, contents.size(), f));
+    ASSERT_EQ(0, fclose(f));
+  }
+
+  std::string ReadFile(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f)
+      return "<missing>";
+    std::string contents;
+    char buf[4 << 10];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), f)) > 0)
+      contents.append(buf, len);
+    fclose(f);
+    return contents;
+  }
+
+  ScopedTempDir temp_dir_;
+};
+
+}  // anonymous namespace
+
+TEST_F(FileCopyTest, Copies) {
+  WriteFile("in", "some contents\n");
+  std::string err;
+  ASSERT_TRUE(CopyFileContents("in", "out", &err));
+  ASSERT_EQ("", err);
+  EXPECT_EQ("some contents\n", ReadFile("out"));
+}
+
+TEST_F(FileCopyTest, TruncatesExisting) {
+  WriteFile("in", "short");
+  WriteFile("out", "something much longer than the source");
+  std::string err;
+  ASSERT_TRUE(CopyFileContents("in", "out", &err));
+  EXPECT_EQ("short", ReadFile("out"));
+}
+
+TEST_F(FileCopyTest, CopiesEmpty) {
+  WriteFile("in", "");
+  std::string err;
+  ASSERT_TRUE(CopyFileContents("in", "out", &err));
+  EXPECT_EQ("", ReadFile("out"));
+}
+
+TEST_F(FileCopyTest, MissingSource) {
+  std::string err;
+  EXPECT_FALSE(CopyFileContents("nonexistent", "out", &err));
+  EXPECT_NE("", err);
+}
+
+#ifndef _WIN32
+TEST_F(FileCopyTest, PreservesExecutableBit) {
+  WriteFile("in", "#!/bin/sh\n");
+  ASSERT_EQ(0, chmod("in", 0755));
+  std::string err;
+  ASSERT_TRUE(CopyFileContents("in", "out", &err));
+  struct stat st;
+  ASSERT_EQ(0, stat("out", &st));
+  EXPECT_NE(0u, (st.st_mode & 0111));
+}
+#endif
@@ -0,0 +1,189 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "file_watcher.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "graph.h"
+#include "state.h"
+#include "string_concat.h"
+
+using namespace std;
+
+bool FileWatcher::Supported() {
+#ifdef __linux__
+  return true;
+#else
+  return false;
+#endif
+}
+
+#ifdef __linux__
+
+namespace {
+
+/// The directory part of a canonical node path ("" for the cwd).
+std::string DirName(std::string_view path) {
+  std::string_view::size_type slash = path.rfind('/');
+  if (slash == std::string_view::npos)
+    return std::string();
+  return std::string(path.substr(0, slash));
+}
+
+}  // anonymous namespace
+
+FileWatcher::~FileWatcher() {
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool FileWatcher::WatchGraphDirs(const State* state, std::string* err) {
+  if (fd_ < 0) {
+    fd_ = inotify_init1(IN_CLOEXEC);
+    if (fd_ < 0) {
+      *err = string_concat("inotify_init: ", strerror(errno));
+      return false;
+    }
+  }
+
+  // Writes are reported when the file is closed rather than on every
+  // write(), so a compiler streaming an output does not flood the queue.
+  const uint32_t kMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                         IN_MOVED_TO | IN_MOVED_FROM | IN_ATTRIB;
+  for (const auto& [node_path, node] : state->paths_) {
+    std::string dir = DirName(node_path);
+    if (wd_by_dir_.count(dir))
+      continue;
+    int wd = inotify_add_watch(fd_, dir.empty() ? "." : dir.c_str(), kMask);
+    if (wd < 0) {
+      // A directory that does not exist yet holds only outputs that were
+      // never built; it will be picked up after the build that creates it.
+      if (errno == ENOENT)
+        continue;
+      *err = string_concat("inotify_add_watch(", dir, "): ", strerror(errno));
+      return false;
+    }
+    dir_by_wd_[wd] = dir;
+    wd_by_dir_[dir] = wd;
+  }
+  return true;
+}
+
+bool FileWatcher::ReadEvents(std::vector<std::string>* paths, bool blocking,
+                             bool* more, bool* overflow, std::string* err) {
+  *more = false;
+  struct pollfd pfd = { fd_, POLLIN, 0 };
+  // When draining a settling burst, give laggard events a moment to
+  // arrive so one save does not fan out into several rebuilds.
+  int timeout = blocking ? -1 : 50;
+  int ret;
+  do {
+    ret = poll(&pfd, 1, timeout);
+  } while (ret < 0 && errno == EINTR && blocking);
+  if (ret < 0) {
+    *err = string_concat("poll: ", strerror(errno));
+    return false;
+  }
+  if (ret == 0)
+    return true;  // Settled.
+
+  char buf[16 << 10] __attribute__((aligned(__alignof__(inotify_event))));
+  ssize_t len = read(fd_, buf, sizeof(buf));
+  if (len < 0) {
+    *err = string_concat("read(inotify): ", strerror(errno));
+    return false;
+  }
+  for (char* p = buf; p < buf + len;) {
+    const inotify_event* event = reinterpret_cast<inotify_event*>(p);
+    p += sizeof(inotify_event) + event->len;
+    if (event->mask & IN_Q_OVERFLOW) {
+      *overflow = true;
+      continue;
+    }
+    if (event->mask & IN_IGNORED) {
+      std::map<int, std::string>::iterator it = dir_by_wd_.find(event->wd);
+      if (it != dir_by_wd_.end()) {
+        wd_by_dir_.erase(it->second);
+        dir_by_wd_.erase(it);
+      }
+      continue;
+    }
+    if (event->len == 0)
+      continue;
+    std::map<int, std::string>::iterator it = dir_by_wd_.find(event->wd);
+    if (it == dir_by_wd_.end())
+      continue;
+    const std::string& dir = it->second;
+    paths->push_back(dir.empty() ? event->name
+                                 : string_concat(dir, "/", event->name));
+  }
+  *more = true;
+  return true;
+}
+
+bool FileWatcher::WaitForChanges(std::vector<std::string>* paths,
+                                 bool* overflow, std::string* err) {
+  *overflow = false;
+  bool more = false;
+  if (!ReadEvents(paths, /*blocking=*/true, &more, overflow, err))
+    return false;
+  // Drain until quiet, bounded so a busy directory cannot starve the
+  // rebuild forever.
+  for (int i = 0; i < 20 && more; ++i) {
+    if (!ReadEvents(paths, /*blocking=*/false, &more, overflow, err))
+      return false;
+  }
+  return true;
+}
+
+bool FileWatcher::DrainChanges(std::vector<std::string>* paths,
+                               bool* overflow, std::string* err) {
+  *overflow = false;
+  bool more = true;
+  for (int i = 0; i < 20 && more; ++i) {
+    if (!ReadEvents(paths, /*blocking=*/false, &more, overflow, err))
+      return false;
+  }
+  return true;
+}
+
+#else
+
+FileWatcher::~FileWatcher() {}
+
+bool FileWatcher::WatchGraphDirs(const State*, std::string* err) {
+  *err = "file watching is not supported on this platform";
+  return false;
+}
+
+bool FileWatcher::WaitForChanges(std::vector<std::string>*, bool*,
+                                 std::string* err) {
+  *err = "file watching is not supported on this platform";
+  return false;
+}
+
+bool FileWatcher::DrainChanges(std::vector<std::string>*, bool*,
+                               std::string* err) {
+  *err = "file watching is not supported on this platform";
+  return false;
+}
+
+#endif  // __linux__
@@ -0,0 +1,71 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_FILE_WATCHER_H_
+#define NINJA_FILE_WATCHER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+struct State;
+
+/// Subscribes to filesystem change notifications (inotify; Linux only so
+/// far) for the directories holding a graph's nodes, so a resident
+/// ninja can invalidate exactly the files that changed instead of
+/// re-statting the world.  The watch stays armed across builds; events
+/// our own commands generate are harmless to report, since invalidating
+/// a node only means it gets stat()ed again.
+struct FileWatcher {
+  FileWatcher() = default;
+  ~FileWatcher();
+
+  /// Whether this platform has a watcher backend at all.
+  static bool Supported();
+
+  /// Watch the parent directory of every node of \a state.  Idempotent;
+  /// call again after each build to pick up newly created directories.
+  bool WatchGraphDirs(const State* state, std::string* err);
+
+  /// Block until at least one change arrives, keep draining until the
+  /// burst settles, and return the changed paths (relative, in the same
+  /// form as node paths).  \a overflow is set when the kernel dropped
+  /// events, in which case the caller must assume anything changed.
+  bool WaitForChanges(std::vector<std::string>* paths, bool* overflow,
+                      std::string* err);
+
+  /// Like WaitForChanges(), but never blocks: collect whatever events
+  /// have already arrived and return.  Used by --serve, where the
+  /// trigger is a client request rather than a filesystem change.
+  bool DrainChanges(std::vector<std::string>* paths, bool* overflow,
+                    std::string* err);
+
+  /// Number of directories currently watched.
+  size_t watch_count() const { return dir_by_wd_.size(); }
+
+ private:
+  /// Read one buffer of events; \a blocking waits for the first one.
+  /// Appends the named paths, sets \a overflow on a queue overflow, and
+  /// reports via \a more whether the read actually produced events.
+  bool ReadEvents(std::vector<std::string>* paths, bool blocking, bool* more,
+                  bool* overflow, std::string* err);
+
+  int fd_ = -1;
+  /// Watched directory per inotify watch descriptor ("" for the cwd).
+  std::map<int, std::string> dir_by_wd_;
+  /// Directories already watched, to keep WatchGraphDirs incremental.
+  std::map<std::string, int, std::less<>> wd_by_dir_;
+};
+
+#endif  // NINJA_FILE_WATCHER_H_
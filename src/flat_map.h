@@ -0,0 +1,86 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_FLAT_MAP_H_
+#define NINJA_FLAT_MAP_H_
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// A string-keyed map stored as one sorted vector of pairs.  The binding
+/// scopes it backs hold a handful of entries but are queried on every
+/// variable expansion of every edge, where a red-black tree costs a
+/// pointer chase per comparison; a binary search over contiguous pairs
+/// stays in cache.  Lookups are transparent -- any std::string_view
+/// works as a key with no temporary std::string.
+///
+/// Iteration visits entries in key order, matching the std::map
+/// containers this replaces.  Insertion is O(n) and invalidates
+/// iterators; the parsers fill these maps once and then only read them.
+template <typename V>
+struct FlatStringMap {
+  using value_type = std::pair<std::string, V>;
+  using iterator = typename std::vector<value_type>::iterator;
+  using const_iterator = typename std::vector<value_type>::const_iterator;
+
+  iterator begin() { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+
+  size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+  void clear() { entries_.clear(); }
+
+  iterator find(std::string_view key) {
+    iterator i = LowerBound(key);
+    return i != entries_.end() && i->first == key ? i : entries_.end();
+  }
+
+  const_iterator find(std::string_view key) const {
+    const_iterator i = LowerBound(key);
+    return i != entries_.end() && i->first == key ? i : entries_.end();
+  }
+
+  /// The value bound to \a key, default-constructed and inserted first
+  /// if absent.
+  V& operator[](std::string_view key) {
+    iterator i = LowerBound(key);
+    if (i == entries_.end() || i->first != key)
+      i = entries_.insert(i, value_type(std::string(key), V()));
+    return i->second;
+  }
+
+ private:
+  iterator LowerBound(std::string_view key) {
+    return std::lower_bound(entries_.begin(), entries_.end(), key,
+                            [](const value_type& entry, std::string_view k) {
+                              return std::string_view(entry.first) < k;
+                            });
+  }
+
+  const_iterator LowerBound(std::string_view key) const {
+    return std::lower_bound(entries_.begin(), entries_.end(), key,
+                            [](const value_type& entry, std::string_view k) {
+                              return std::string_view(entry.first) < k;
+                            });
+  }
+
+  std::vector<value_type> entries_;
+};
+
+#endif  // NINJA_FLAT_MAP_H_
@@ -0,0 +1,59 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flat_map.h"
+
+#include "test.h"
+
+namespace {
+
+TEST(FlatStringMap, InsertFindAssign) {
+  FlatStringMap<int> map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.find("cflags") == map.end());
+
+  map["cflags"] = 1;
+  map["ldflags"] = 2;
+  map["ar"] = 3;
+  ASSERT_EQ(3u, map.size());
+
+  // Transparent lookup: a string_view key, no temporary std::string.
+  std::string_view key = "ldflags";
+  ASSERT_TRUE(map.find(key) != map.end());
+  EXPECT_EQ(2, map.find(key)->second);
+  EXPECT_TRUE(map.find("missing") == map.end());
+
+  // operator[] on an existing key assigns in place.
+  map["cflags"] = 4;
+  ASSERT_EQ(3u, map.size());
+  EXPECT_EQ(4, map.find("cflags")->second);
+}
+
+TEST(FlatStringMap, IteratesInKeyOrder) {
+  FlatStringMap<int> map;
+  map["rspfile"] = 0;
+  map["command"] = 1;
+  map["description"] = 2;
+
+  // Same order std::map gave the callers that iterate these maps.
+  std::vector<std::string> keys;
+  for (const auto& [key, value] : map)
+    keys.push_back(key);
+  ASSERT_EQ(3u, keys.size());
+  EXPECT_EQ("command", keys[0]);
+  EXPECT_EQ("description", keys[1]);
+  EXPECT_EQ("rspfile", keys[2]);
+}
+
+}  // namespace
@@ -16,7 +16,9 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <stdio.h>
+#include <thread>
 
 #include "build_log.h"
 #include "debug_flags.h"
@@ -29,15 +31,79 @@
 #include "util.h"
 #include "string_concat.h"
 
+int64_t Node::edge_link_revision_ = 0;
+
+void Node::RemoveOutEdge(Edge* edge) {
+  out_edges_.erase(std::remove(out_edges_.begin(), out_edges_.end(), edge),
+                   out_edges_.end());
+  ++edge_link_revision_;
+}
+
 bool Node::Stat(DiskInterface* disk_interface, std::string* err) {
-  return (mtime_ = disk_interface->Stat(path_, err)) != -1;
+  return (scan_->mtime = disk_interface->Stat(std::string(path_), err)) != -1;
 }
 
 bool DependencyScan::RecomputeDirty(Node* node, std::string* err) {
+  PrestatNodes(node);
+  dep_loader_.PrefetchDepfiles(node);
   std::vector<Node*> stack;
   return RecomputeDirty(node, &stack, err);
 }
 
+void DependencyScan::PrestatNodes(Node* node) {
+  if (!disk_interface_->SupportsParallelStats())
+    return;
+  METRIC_RECORD("dirty scan prestat");
+
+  // Collect the stats the walk is about to issue: every reachable node
+  // whose on-disk state is still unknown.  The dirty computation itself
+  // stays serial (loading deps mutates the graph and the FileReader
+  // contract is serial); only the stat() latency is overlapped, which is
+  // what dominates the scan on high-latency filesystems.
+  std::vector<Node*> to_stat;
+  std::unordered_set<const Node*> seen;
+  auto consider = [&to_stat, &seen](Node* n) {
+    if (!n->status_known() && seen.insert(n).second)
+      to_stat.push_back(n);
+  };
+  std::vector<Edge*> stack;
+  consider(node);
+  if (Edge* in_edge = node->in_edge()) {
+    if (prestat_visited_.insert(in_edge).second)
+      stack.push_back(in_edge);
+  }
+  while (!stack.empty()) {
+    Edge* edge = stack.back();
+    stack.pop_back();
+    for (Node* output : edge->outputs_)
+      consider(output);
+    if (edge->dyndep_)
+      consider(edge->dyndep_);
+    for (Node* input : edge->inputs_) {
+      consider(input);
+      if (Edge* in_edge = input->in_edge()) {
+        if (prestat_visited_.insert(in_edge).second)
+          stack.push_back(in_edge);
+      }
+    }
+  }
+  if (to_stat.empty())
+    return;
+
+  std::vector<std::string> paths;
+  paths.reserve(to_stat.size());
+  for (Node* n : to_stat)
+    paths.emplace_back(n->path());
+  std::vector<TimeStamp> mtimes;
+  disk_interface_->StatMany(paths, &mtimes);
+  for (size_t i = 0; i < to_stat.size(); ++i) {
+    // On failure the mtime stays unknown and the serial walk re-stats
+    // the node to surface the error with proper context.
+    if (mtimes[i] != -1)
+      to_stat[i]->set_mtime(mtimes[i]);
+  }
+}
+
 bool DependencyScan::RecomputeDirty(Node* node, std::vector<Node*>* stack,
                                     std::string* err) {
   Edge* edge = node->in_edge();
@@ -49,7 +115,7 @@ bool DependencyScan::RecomputeDirty(Node* node, std::vector<Node*>* stack,
     if (!node->StatIfNecessary(disk_interface_, err))
       return false;
     if (!node->exists())
-      EXPLAIN("%s has no in-edge and is missing", node->path().c_str());
+      EXPLAIN("%s has no in-edge and is missing", node->path_cstr());
     node->set_dirty(!node->exists());
     return true;
   }
@@ -116,7 +182,7 @@ bool DependencyScan::RecomputeDirty(Node* node, std::vector<Node*>* stack,
 
   // Visit all inputs; we're dirty if any of the inputs are dirty.
   Node* most_recent_input = nullptr;
-  for (std::vector<Node*>::iterator i = edge->inputs_.begin();
+  for (Edge::Nodes::iterator i = edge->inputs_.begin();
        i != edge->inputs_.end(); ++i) {
     // Visit this input.
     if (!RecomputeDirty(*i, stack, err))
@@ -132,7 +198,7 @@ bool DependencyScan::RecomputeDirty(Node* node, std::vector<Node*>* stack,
       // If a regular input is dirty (or missing), we're dirty.
       // Otherwise consider mtime.
       if ((*i)->dirty()) {
-        EXPLAIN("%s is dirty", (*i)->path().c_str());
+        EXPLAIN("%s is dirty", (*i)->path_cstr());
         dirty = true;
       } else {
         if (!most_recent_input || (*i)->mtime() > most_recent_input->mtime()) {
@@ -235,7 +301,7 @@ bool DependencyScan::RecomputeOutputDirty(const Edge* edge,
     // there are no inputs and we're missing the output.
     if (edge->inputs_.empty() && !output->exists()) {
       EXPLAIN("output %s of phony edge with no inputs doesn't exist",
-              output->path().c_str());
+              output->path_cstr());
       return true;
     }
     return false;
@@ -245,7 +311,7 @@ bool DependencyScan::RecomputeOutputDirty(const Edge* edge,
 
   // Dirty if we're missing the output.
   if (!output->exists()) {
-    EXPLAIN("output %s doesn't exist", output->path().c_str());
+    EXPLAIN("output %s doesn't exist", output->path_cstr());
     return true;
   }
 
@@ -264,11 +330,15 @@ bool DependencyScan::RecomputeOutputDirty(const Edge* edge,
       used_restat = true;
     }
 
-    if (output_mtime < most_recent_input->mtime()) {
+    // In hash_inputs mode a newer input only counts if its contents
+    // actually changed: tools that rewrite inputs bit-for-bit identical
+    // refresh mtimes without invalidating the output.
+    if (output_mtime < most_recent_input->mtime() &&
+        !RecordedInputsUnchanged(edge, output)) {
       EXPLAIN("%soutput %s older than most recent input %s "
               "(%" PRId64 " vs %" PRId64 ")",
-              used_restat ? "restat of " : "", output->path().c_str(),
-              most_recent_input->path().c_str(),
+              used_restat ? "restat of " : "", output->path_cstr(),
+              most_recent_input->path_cstr(),
               output_mtime, most_recent_input->mtime());
       return true;
     }
@@ -277,27 +347,27 @@ bool DependencyScan::RecomputeOutputDirty(const Edge* edge,
   if (build_log()) {
     bool generator = edge->GetBindingBool("generator");
     if (entry || (entry = build_log()->LookupByOutput(output->path()))) {
-      if (!generator &&
-          BuildLog::LogEntry::HashCommand(command) != entry->command_hash) {
+      if (!generator && !entry->CommandMatches(command)) {
         // May also be dirty due to the command changing since the last build.
         // But if this is a generator rule, the command changing does not make us
         // dirty.
-        EXPLAIN("command line changed for %s", output->path().c_str());
+        EXPLAIN("command line changed for %s", output->path_cstr());
         return true;
       }
-      if (most_recent_input && entry->mtime < most_recent_input->mtime()) {
+      if (most_recent_input && entry->mtime < most_recent_input->mtime() &&
+          !RecordedInputsUnchanged(edge, output)) {
         // May also be dirty due to the mtime in the log being older than the
         // mtime of the most recent input.  This can occur even when the mtime
         // on disk is newer if a previous run wrote to the output file but
         // exited with an error or was interrupted.
         EXPLAIN("recorded mtime of %s older than most recent input %s (%" PRId64 " vs %" PRId64 ")",
-                output->path().c_str(), most_recent_input->path().c_str(),
+                output->path_cstr(), most_recent_input->path_cstr(),
                 entry->mtime, most_recent_input->mtime());
         return true;
       }
     }
     if (!entry && !generator) {
-      EXPLAIN("command line not found in log for %s", output->path().c_str());
+      EXPLAIN("command line not found in log for %s", output->path_cstr());
       return true;
     }
   }
@@ -305,6 +375,56 @@ bool DependencyScan::RecomputeOutputDirty(const Edge* edge,
   return false;
 }
 
+uint64_t DependencyScan::HashInputContents(
+    const Edge* edge, const std::vector<Node*>* extra_inputs) {
+  METRIC_RECORD("hash inputs");
+  // XOR of per-file hashes makes the result insensitive to the order and
+  // duplication differences between the scan-time input list (which holds
+  // deps discovered on earlier runs) and the record-time list (manifest
+  // inputs plus the deps just extracted).
+  uint64_t hash = 0;
+  std::string contents;
+  std::string err;
+  std::unordered_set<const Node*> hashed;
+  auto add = [&](Node* input) {
+    if (!hashed.insert(input).second)
+      return;
+    std::pair<TimeStamp, uint64_t>& memo = content_hashes_[input];
+    if (memo.second == 0 || memo.first != input->mtime()) {
+      contents.clear();
+      err.clear();
+      // An unreadable input hashes as empty; it fails the mtime checks (or
+      // the build itself) on its own.
+      disk_interface_->ReadFile(std::string(input->path()), &contents, &err);
+      uint64_t file_hash = BuildLog::LogEntry::HashCommand(contents);
+      // Mix the path in so identical contents swapped between two inputs
+      // still changes the combined hash.
+      file_hash =
+          file_hash * 33 + BuildLog::LogEntry::HashCommand(input->path());
+      memo = std::make_pair(input->mtime(), file_hash);
+    }
+    hash ^= memo.second;
+  };
+  for (size_t i = 0; i < edge->inputs_.size() - edge->order_only_deps_; ++i)
+    add(edge->inputs_[i]);
+  if (extra_inputs) {
+    for (const auto & input : *extra_inputs)
+      add(input);
+  }
+  // 0 means "not recorded" in the build log.
+  return hash != 0 ? hash : 1;
+}
+
+bool DependencyScan::RecordedInputsUnchanged(const Edge* edge,
+                                             const Node* output) {
+  if (!edge->GetBindingBool("hash_inputs") || !build_log())
+    return false;
+  BuildLog::LogEntry* entry = build_log()->LookupByOutput(output->path());
+  if (!entry || entry->input_hash == 0)
+    return false;
+  return HashInputContents(edge, nullptr) == entry->input_hash;
+}
+
 bool DependencyScan::LoadDyndeps(Node* node, std::string* err) const {
   return dyndep_loader_.LoadDyndeps(node, err);
 }
@@ -329,7 +449,7 @@ struct EdgeEnv final : public Env {
 
   EdgeEnv(const Edge* const edge, const EscapeKind escape)
       : edge_(edge), escape_in_out_(escape), recursive_(false) {}
-  std::string LookupVariable(const std::string& var) override final;
+  std::string LookupVariable(std::string_view var) override final;
 
   /// Given a span of Nodes, construct a list of paths suitable for a command
   /// line.
@@ -342,7 +462,7 @@ struct EdgeEnv final : public Env {
   bool recursive_;
 };
 
-std::string EdgeEnv::LookupVariable(const std::string& var) {
+std::string EdgeEnv::LookupVariable(std::string_view var) {
   if (var == "in" || var == "in_newline") {
     int explicit_deps_count = edge_->inputs_.size() - edge_->implicit_deps_ -
       edge_->order_only_deps_;
@@ -371,7 +491,7 @@ std::string EdgeEnv::LookupVariable(const std::string& var) {
   // See notes on BindingEnv::LookupWithFallback.
   const EvalString* eval = edge_->rule_->GetBinding(var);
   if (recursive_ && eval)
-    lookups_.push_back(var);
+    lookups_.push_back(std::string(var));
 
   // In practice, variables defined on rules never use another rule variable.
   // For performance, only start checking for cycles after the first lookup.
@@ -400,7 +520,25 @@ std::string EdgeEnv::MakePathList(const Node* const* const span,
 }
 
 std::string Edge::EvaluateCommand(const bool incl_rsp_file) const {
-  std::string command = GetBinding("command");
+  if (batch_)
+    return EvaluateBatchCommand(*batch_);
+  std::string command;
+  if (rule_->command_spliceable() && !env_->HasBinding("command")) {
+    // Fast path: the rule's command only references $in/$out and nothing in
+    // scope shadows it, so splice the pre-flattened template directly instead
+    // of walking the environment chain.  EdgeEnv::LookupVariable answers
+    // $in/$in_newline/$out without consulting any scope.
+    EdgeEnv env(this, EdgeEnv::kShellEscape);
+    const EvalString* eval = rule_->GetBinding("command");
+    for (const EvalString::Token& token : eval->tokens_) {
+      if (token.type == EvalString::RAW)
+        command.append(eval->token_text(token));
+      else
+        command.append(env.LookupVariable(eval->token_text(token)));
+    }
+  } else {
+    command = GetBinding("command");
+  }
   if (incl_rsp_file) {
     std::string rspfile_content = GetBinding("rspfile_content");
     if (!rspfile_content.empty())
@@ -409,6 +547,34 @@ std::string Edge::EvaluateCommand(const bool incl_rsp_file) const {
   return command;
 }
 
+std::string Edge::EvaluateBatchCommand(const std::vector<Edge*>& batch) const {
+  // Batch assembly only accepts spliceable commands, so the template's
+  // special tokens can only be $in/$in_newline/$out; widen each one to
+  // the concatenation across the whole batch.
+  assert(rule_->command_spliceable());
+  std::string command;
+  const EvalString* eval = rule_->GetBinding("command");
+  for (const EvalString::Token& token : eval->tokens_) {
+    if (token.type == EvalString::RAW) {
+      command.append(eval->token_text(token));
+      continue;
+    }
+    const char sep = eval->token_text(token) == "in_newline" ? '\n' : ' ';
+    bool first = true;
+    for (Edge* member : batch) {
+      EdgeEnv env(member, EdgeEnv::kShellEscape);
+      std::string paths = env.LookupVariable(eval->token_text(token));
+      if (paths.empty())
+        continue;
+      if (!first)
+        command.push_back(sep);
+      first = false;
+      command.append(paths);
+    }
+  }
+  return command;
+}
+
 std::string Edge::GetBinding(const std::string& key) const {
   EdgeEnv env(this, EdgeEnv::kShellEscape);
   return env.LookupVariable(key);
@@ -442,7 +608,7 @@ void Edge::Dump(const char* prefix) const
     {
       break;
     }
-    printf("%s ", in->path().c_str());
+    printf("%s ", in->path_cstr());
   }
   printf("--%s-> ", rule_->name().c_str());
   for(auto const& out : outputs_)
@@ -451,7 +617,7 @@ void Edge::Dump(const char* prefix) const
     {
       break;
     }
-    printf("%s ", out->path().c_str());
+    printf("%s ", out->path_cstr());
   }
   if (pool_) {
     if (!pool_->name().empty()) {
@@ -480,8 +646,8 @@ bool Edge::maybe_phonycycle_diagnostic() const {
 }
 
 // static
-std::string Node::PathDecanonicalized(const std::string& path, uint64_t slash_bits) {
-  std::string result = path;
+std::string Node::PathDecanonicalized(std::string_view path, uint64_t slash_bits) {
+  std::string result(path);
 #ifdef _WIN32
   uint64_t mask = 1;
   for (char* c = &result[0]; (c = strchr(c, '/')) != nullptr;) {
@@ -496,7 +662,7 @@ std::string Node::PathDecanonicalized(const std::string& path, uint64_t slash_bi
 
 void Node::Dump(const char* prefix) const {
   printf("%s <%s 0x%p> mtime: %" PRId64 "%s, (:%s), ",
-         prefix, path().c_str(), this,
+         prefix, path_cstr(), this,
          mtime(), mtime() ? "" : " (:missing)",
          dirty() ? " dirty" : " clean");
   if (in_edge()) {
@@ -528,6 +694,63 @@ bool ImplicitDepLoader::LoadDeps(Edge* edge, std::string* err) {
   return true;
 }
 
+void ImplicitDepLoader::PrefetchDepfiles(Node* node) {
+  if (!disk_interface_->SupportsParallelReads())
+    return;
+  METRIC_RECORD("depfile prefetch");
+
+  // Collect the depfile reads the scan is about to issue: every reachable
+  // edge that has not been scanned yet and whose deps come from a depfile
+  // rather than the deps log.
+  std::vector<std::pair<Edge*, std::string>> work;
+  std::vector<Node*> stack;
+  stack.push_back(node);
+  while (!stack.empty()) {
+    Edge* edge = stack.back()->in_edge();
+    stack.pop_back();
+    if (!edge || !prefetch_visited_.insert(edge).second)
+      continue;
+    if (!edge->deps_loaded_ && edge->GetBinding("deps").empty()) {
+      std::string depfile = edge->GetUnescapedDepfile();
+      if (!depfile.empty())
+        work.emplace_back(edge, std::move(depfile));
+    }
+    for (Node* input : edge->inputs_)
+      stack.push_back(input);
+  }
+  if (work.empty())
+    return;
+
+  std::vector<PrefetchedDepfile> results(work.size());
+  std::atomic<size_t> next_item(0);
+  auto read_some = [&]() {
+    for (;;) {
+      size_t i = next_item.fetch_add(1);
+      if (i >= work.size())
+        return;
+      PrefetchedDepfile& result = results[i];
+      result.status =
+          disk_interface_->ReadFile(work[i].second, &result.content,
+                                    &result.err);
+    }
+  };
+
+  int hardware = static_cast<int>(std::thread::hardware_concurrency());
+  if (hardware < 1)
+    hardware = 1;
+  size_t helpers = std::min(work.size(), static_cast<size_t>(hardware)) - 1;
+  std::vector<std::thread> threads;
+  threads.reserve(helpers);
+  for (size_t i = 0; i < helpers; ++i)
+    threads.emplace_back(read_some);
+  read_some();
+  for (std::thread& thread : threads)
+    thread.join();
+
+  for (size_t i = 0; i < work.size(); ++i)
+    prefetched_[work[i].first] = std::move(results[i]);
+}
+
 struct matches {
   matches(std::vector<std::string_view>::iterator i) : i_(i) {}
 
@@ -541,9 +764,42 @@ struct matches {
 bool ImplicitDepLoader::LoadDepFile(Edge* edge, const std::string& path,
                                     std::string* err) {
   METRIC_RECORD("depfile load");
-  // Read depfile content.  Treat a missing depfile as empty.
+  // Stat the depfile first: deps restored from the manifest cache can be
+  // reused wholesale while its mtime is unchanged, skipping the read and
+  // the parse.  The stat also keys the deps recorded for the next run;
+  // taking it before consuming the content means a depfile rewritten
+  // mid-load keys as stale rather than fresh.
+  std::string stat_err;
+  TimeStamp depfile_mtime = disk_interface_->Stat(path, &stat_err);
+  auto cached = state_->cached_deps_.find(edge);
+  if (cached != state_->cached_deps_.end() && depfile_mtime > 0 &&
+      depfile_mtime == cached->second.depfile_mtime) {
+    Edge::Nodes::iterator implicit_dep =
+        PreallocateSpace(edge, cached->second.deps.size());
+    for (Node* dep : cached->second.deps) {
+      *implicit_dep = dep;
+      dep->AddOutEdge(edge);
+      CreatePhonyInEdge(dep);
+      ++implicit_dep;
+    }
+    return true;
+  }
+
+  // Read depfile content, preferring the result of a prefetched read.
+  // Treat a missing depfile as empty.
   std::string content;
-  switch (disk_interface_->ReadFile(path, &content, err)) {
+  DiskInterface::Status status;
+  auto prefetched = prefetched_.find(edge);
+  if (prefetched != prefetched_.end()) {
+    status = prefetched->second.status;
+    content = std::move(prefetched->second.content);
+    if (status != DiskInterface::Okay)
+      *err = std::move(prefetched->second.err);
+    prefetched_.erase(prefetched);
+  } else {
+    status = disk_interface_->ReadFile(path, &content, err);
+  }
+  switch (status) {
   case DiskInterface::Okay:
     break;
   case DiskInterface::NotFound:
@@ -593,7 +849,7 @@ bool ImplicitDepLoader::LoadDepFile(Edge* edge, const std::string& path,
   std::string_view opath{first_output->path()};
   if (opath != *primary_out) {
     EXPLAIN("expected depfile '%s' to mention '%s', got '%s'", path.c_str(),
-            first_output->path().c_str(), std::string(*primary_out).c_str());
+            first_output->path_cstr(), std::string(*primary_out).c_str());
     return false;
   }
 
@@ -608,30 +864,53 @@ bool ImplicitDepLoader::LoadDepFile(Edge* edge, const std::string& path,
   }
 
   // Preallocate space in edge->inputs_ to be filled in below.
-  std::vector<Node*>::iterator implicit_dep =
+  Edge::Nodes::iterator implicit_dep =
       PreallocateSpace(edge, depfile.ins_.size());
 
   // Add all its in-edges.
   for(auto & dep : depfile.ins_) {
-    uint64_t slash_bits;
-    size_t size = dep.size();
-    // WTF. Const cast?
-    if (!CanonicalizePath(const_cast<char*>(dep.data()), &size, &slash_bits, err))
-    {
+    Node* node;
+    if (PathMap::const_iterator memo = dep_node_memo_.find(dep);
+        memo != dep_node_memo_.end()) {
+      // Seen this exact spelling in an earlier depfile; skip the
+      // canonicalization and the paths_ lookup.
+      node = memo->second;
+    } else {
+      // Copy the spelling out before CanonicalizePath rewrites the
+      // depfile buffer in place.
+      std::string_view spelling = dep_spelling_arena_.Intern(dep);
+      uint64_t slash_bits;
+      size_t size = dep.size();
+      // WTF. Const cast?
+      if (!CanonicalizePath(const_cast<char*>(dep.data()), &size, &slash_bits, err))
+      {
+        // Only needed becasue CanonicalizePath wanting to modify the inputs...
+        dep = dep.substr(0, size);
+        return false;
+      }
       // Only needed becasue CanonicalizePath wanting to modify the inputs...
       dep = dep.substr(0, size);
-      return false;
-    }
-    // Only needed becasue CanonicalizePath wanting to modify the inputs...
-    dep = dep.substr(0, size);
 
-    Node* node = state_->GetNode(dep, slash_bits);
+      node = state_->GetNode(dep, slash_bits);
+      dep_node_memo_[spelling] = node;
+    }
     *implicit_dep = node;
     node->AddOutEdge(edge);
     CreatePhonyInEdge(node);
     ++implicit_dep;
   }
 
+  // Record the parsed deps keyed by the depfile's mtime so the manifest
+  // cache can restore them and the next run skips this load.
+  if (depfile_mtime > 0) {
+    State::CachedEdgeDeps& record = state_->cached_deps_[edge];
+    record.depfile_mtime = depfile_mtime;
+    state_->cached_deps_dirty_ = true;
+    record.deps.assign(
+        edge->inputs_.end() - edge->order_only_deps_ - depfile.ins_.size(),
+        edge->inputs_.end() - edge->order_only_deps_);
+  }
+
   return true;
 }
 
@@ -640,18 +919,18 @@ bool ImplicitDepLoader::LoadDepsFromLog(Edge* edge, std::string* err) {
   Node* output = edge->outputs_[0];
   DepsLog::Deps* deps = deps_log_ ? deps_log_->GetDeps(output) : nullptr;
   if (!deps) {
-    EXPLAIN("deps for '%s' are missing", output->path().c_str());
+    EXPLAIN("deps for '%s' are missing", output->path_cstr());
     return false;
   }
 
   // Deps are invalid if the output is newer than the deps.
   if (output->mtime() > deps->mtime) {
     EXPLAIN("stored deps info out of date for '%s' (%" PRId64 " vs %" PRId64 ")",
-            output->path().c_str(), deps->mtime, output->mtime());
+            output->path_cstr(), deps->mtime, output->mtime());
     return false;
   }
 
-  std::vector<Node*>::iterator implicit_dep =
+  Edge::Nodes::iterator implicit_dep =
       PreallocateSpace(edge, deps->node_count);
   for (int i = 0; i < deps->node_count; ++i, ++implicit_dep) {
     Node* node = deps->nodes[i];
@@ -662,11 +941,12 @@ bool ImplicitDepLoader::LoadDepsFromLog(Edge* edge, std::string* err) {
   return true;
 }
 
-std::vector<Node*>::iterator ImplicitDepLoader::PreallocateSpace(Edge* edge,
-                                                            int count) {
+Edge::Nodes::iterator ImplicitDepLoader::PreallocateSpace(Edge* edge,
+                                                          int count) {
   edge->inputs_.insert(edge->inputs_.end() - edge->order_only_deps_,
                        (size_t)count, 0);
   edge->implicit_deps_ += count;
+  edge->discovered_deps_ += count;
   return edge->inputs_.end() - edge->order_only_deps_ - count;
 }
 
@@ -15,29 +15,64 @@
 #ifndef NINJA_GRAPH_H_
 #define NINJA_GRAPH_H_
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <queue>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "arena.h"
+#include "disk_interface.h"
 #include "dyndep.h"
 #include "eval_env.h"
+#include "path_map.h"
+#include "small_vector.h"
 #include "timestamp.h"
 #include "util.h"
 
 struct BuildLog;
 struct DepfileParserOptions;
-struct DiskInterface;
 struct DepsLog;
 struct Edge;
 struct Node;
 struct Pool;
 struct State;
 
+/// The hot per-node state examined and updated by the dependency scan.
+/// Kept out of Node and slab-allocated densely in creation order by State
+/// (see State::scan_arena_), so scan sweeps and resets touch compact
+/// memory instead of pulling each Node's cold path data into cache.
+struct NodeScanState {
+  /// Possible values of mtime:
+  ///   -1: file hasn't been examined
+  ///   0:  we looked, and file doesn't exist
+  ///   >0: actual file's mtime
+  TimeStamp mtime = -1;
+
+  /// Dirty is true when the underlying file is out-of-date.
+  /// But note that Edge::outputs_ready_ is also used in judging which
+  /// edges to build.
+  bool dirty = false;
+
+  /// Whether dyndep information is expected from this node but has not
+  /// yet been loaded.
+  bool dyndep_pending = false;
+};
+
 /// Information about a node in the dependency graph: the file, whether
 /// it's dirty, mtime, etc.
 struct Node final {
-  Node(std::string path, uint64_t slash_bits)
-   : path_(std::move(path))
+  /// |path| must stay alive for the lifetime of the Node; State interns
+  /// node paths into its path arena before constructing Nodes.  |scan|
+  /// is the node's slot in State's scan-state slabs.
+  Node(std::string_view path, uint64_t slash_bits, NodeScanState* scan)
+   : path_(path)
    , slash_bits_(slash_bits)
+   , scan_(scan)
   { }
 
   /// Return false on error.
@@ -51,64 +86,89 @@ struct Node final {
 
   /// Mark as not-yet-stat()ed and not dirty.
   void ResetState() {
-    mtime_ = -1;
-    dirty_ = false;
+    scan_->mtime = -1;
+    scan_->dirty = false;
   }
 
   /// Mark the Node as already-stat()ed and missing.
   void MarkMissing() {
-    mtime_ = 0;
+    scan_->mtime = 0;
   }
 
+  /// Install an mtime obtained out of band (e.g. from a StatMany batch),
+  /// using Stat()'s encoding.
+  void set_mtime(TimeStamp mtime) { scan_->mtime = mtime; }
+
   bool exists() const {
-    return mtime_ != 0;
+    return scan_->mtime != 0;
   }
 
   bool status_known() const {
-    return mtime_ != -1;
+    return scan_->mtime != -1;
   }
 
-  const std::string& path() const { return path_; }
+  std::string_view path() const { return path_; }
+  /// |path()| as a C string; interned paths are always NUL-terminated.
+  const char* path_cstr() const { return path_.data(); }
   /// Get |path()| but use slash_bits to convert back to original slash styles.
   std::string PathDecanonicalized() const {
     return PathDecanonicalized(path_, slash_bits_);
   }
-  static std::string PathDecanonicalized(const std::string& path,
+  static std::string PathDecanonicalized(std::string_view path,
                                          uint64_t slash_bits);
   uint64_t slash_bits() const { return slash_bits_; }
 
-  TimeStamp mtime() const { return mtime_; }
+  TimeStamp mtime() const { return scan_->mtime; }
 
-  bool dirty() const { return dirty_; }
-  void set_dirty(bool dirty) { dirty_ = dirty; }
-  void MarkDirty() { dirty_ = true; }
+  bool dirty() const { return scan_->dirty; }
+  void set_dirty(bool dirty) { scan_->dirty = dirty; }
+  void MarkDirty() { scan_->dirty = true; }
 
-  bool dyndep_pending() const { return dyndep_pending_; }
-  void set_dyndep_pending(bool pending) { dyndep_pending_ = pending; }
+  bool dyndep_pending() const { return scan_->dyndep_pending; }
+  void set_dyndep_pending(bool pending) { scan_->dyndep_pending = pending; }
 
   Edge* in_edge() const { return in_edge_; }
-  void set_in_edge(Edge* edge) { in_edge_ = edge; }
+  void set_in_edge(Edge* edge) {
+    in_edge_ = edge;
+    ++edge_link_revision_;
+  }
 
   int id() const { return id_; }
   void set_id(int id) { id_ = id; }
 
+  /// Dense index of the node in creation order, assigned by State.
+  /// Scan-local side tables can be flat arrays indexed by it.
+  int graph_id() const { return graph_id_; }
+  void set_graph_id(int id) { graph_id_ = id; }
+
   const std::vector<Edge*>& out_edges() const { return out_edges_; }
-  void AddOutEdge(Edge* edge) { out_edges_.push_back(edge); }
+  void AddOutEdge(Edge* edge) {
+    out_edges_.push_back(edge);
+    ++edge_link_revision_;
+  }
+  /// Drop |edge| from out_edges(); used when the incremental manifest
+  /// reparse discards the edges of a changed file.
+  void RemoveOutEdge(Edge* edge);
+
+  /// Bumped by every in-edge/out-edge link change on any node, wherever
+  /// it happens (parse, manifest cache load, dyndep, discovered deps).
+  /// Derived views of the graph -- State's root node cache -- compare
+  /// against it instead of rescanning every edge per query.  All edge
+  /// linking happens on the manifest-loading/build thread.
+  static int64_t edge_link_revision() { return edge_link_revision_; }
 
   void Dump(const char* prefix="") const;
 
 private:
-  std::string path_;
+  /// Interned in State's path arena; see the constructor comment.
+  std::string_view path_;
 
   /// Set bits starting from lowest for backslashes that were normalized to
   /// forward slashes by CanonicalizePath. See |PathDecanonicalized|.
   uint64_t slash_bits_;
 
-  /// Possible values of mtime_:
-  ///   -1: file hasn't been examined
-  ///   0:  we looked, and file doesn't exist
-  ///   >0: actual file's mtime
-  TimeStamp mtime_ = -1;  // TODO: Use std::numeric_limits.
+  /// The node's slot in State's scan-state slabs; see NodeScanState.
+  NodeScanState* scan_;
 
   /// The Edge that produces this Node, or nullptr when there is no
   /// known edge to produce it.
@@ -120,14 +180,11 @@ private:
   /// A dense integer id for the node, assigned and used by DepsLog.
   int id_ = -1; // TODO: Use std::numeric_limits.
 
-  /// Dirty is true when the underlying file is out-of-date.
-  /// But note that Edge::outputs_ready_ is also used in judging which
-  /// edges to build.
-  bool dirty_ = false;
+  /// See graph_id().
+  int graph_id_ = -1;
 
-  /// Store whether dyndep information is expected from this node but
-  /// has not yet been loaded.
-  bool dyndep_pending_ = false;
+  /// See edge_link_revision().
+  static int64_t edge_link_revision_;
 };
 
 /// An edge in the dependency graph; links between Nodes using Rules.
@@ -148,6 +205,12 @@ struct Edge final {
   /// full contents of a response file (if applicable)
   std::string EvaluateCommand(bool incl_rsp_file = false) const;
 
+  /// Expand this edge's command with $in/$in_newline/$out concatenated
+  /// across all edges of \a batch (see the "batch" rule binding).  Only
+  /// valid for spliceable commands, i.e. ones referencing nothing but
+  /// those variables.
+  std::string EvaluateBatchCommand(const std::vector<Edge*>& batch) const;
+
   /// Returns the shell-escaped value of |key|.
   std::string GetBinding(const std::string& key) const;
   bool GetBindingBool(const std::string& key) const;
@@ -161,22 +224,62 @@ struct Edge final {
 
   void Dump(const char* prefix="") const;
 
+  /// Node lists with inline storage: the median edge has one output and
+  /// a handful of inputs, so four slots keep both lists off the heap for
+  /// most of the graph.
+  using Nodes = SmallVector<Node*, 4>;
+
   const Rule* rule_ = nullptr;
   Pool* pool_ = nullptr;
-  std::vector<Node*> inputs_;
-  std::vector<Node*> outputs_;
+  Nodes inputs_;
+  Nodes outputs_;
   Node* dyndep_ = nullptr;
   BindingEnv* env_ = nullptr;
   VisitMark mark_ = VisitNone;
+  /// Index of the manifest file that declared this edge in
+  /// State::manifest_files_, or -1 when unknown (tests, dyndep-created
+  /// edges).  Used by the incremental manifest reparse.
+  int32_t origin_file_ = -1;
   bool outputs_ready_ = false;
   bool deps_loaded_ = false;
   bool deps_missing_ = false;
+  /// While a batched invocation is being started, points at every edge
+  /// the command covers (this one first); EvaluateCommand then defers to
+  /// EvaluateBatchCommand.  Set by Builder::StartEdge only for the
+  /// duration of CommandRunner::StartCommand, null otherwise, so later
+  /// evaluations (build-log hashing, dirty checks) see the solo command.
+  const std::vector<Edge*>* batch_ = nullptr;
 
   const Rule& rule() const { return *rule_; }
   Pool* pool() const { return pool_; }
   int weight() const { return 1; }
   bool outputs_ready() const { return outputs_ready_; }
 
+  /// Estimated duration in milliseconds of the longest chain of edges
+  /// that starts with this one, computed by Plan::ComputeCriticalPath
+  /// from historical durations in the build log.  Edges on the critical
+  /// path carry the largest weight and are dispatched first.
+  int64_t critical_path_weight() const { return critical_path_weight_; }
+  void set_critical_path_weight(int64_t weight) {
+    critical_path_weight_ = weight;
+  }
+  int64_t critical_path_weight_ = -1;
+
+  /// The edge's own estimated duration in milliseconds -- the first term
+  /// of critical_path_weight_ -- kept separately so progress estimation
+  /// can account per-edge work without re-walking the graph.
+  int64_t predicted_duration() const { return predicted_duration_; }
+  void set_predicted_duration(int64_t duration) {
+    predicted_duration_ = duration;
+  }
+  int64_t predicted_duration_ = 0;
+
+  /// True for edges in the transitive closure of a target named on the
+  /// command line (see Plan::BoostTarget).  Boosted edges outrank all
+  /// unboosted ready work regardless of critical-path weight, so the
+  /// chain the user is waiting for is never starved by broad fallout.
+  bool priority_boost_ = false;
+
   // There are three types of inputs.
   // 1) explicit deps, which show up as $in on the command line;
   // 2) implicit deps, which the target depends on implicitly (e.g. C headers),
@@ -187,6 +290,12 @@ struct Edge final {
   // #2 and #3 when we need to access the various subsets.
   int implicit_deps_ = 0;
   int order_only_deps_ = 0;
+  /// How many of the implicit deps were appended by the dep loaders at
+  /// scan time (depfile, deps log or dyndep) rather than declared in the
+  /// manifest.  They sit at the end of the implicit section; the manifest
+  /// cache excludes them from the edge record so a restored graph
+  /// re-discovers its deps.
+  int discovered_deps_ = 0;
   bool is_implicit(size_t index) {
     return index >= inputs_.size() - order_only_deps_ - implicit_deps_ &&
         !is_order_only(index);
@@ -201,6 +310,9 @@ struct Edge final {
   // These are stored in outputs_ in that order, and we keep a count of
   // #2 to use when we need to access the various subsets.
   int implicit_outs_ = 0;
+  /// How many of the implicit outs were appended by the dyndep loader at
+  /// scan time; excluded from the manifest cache like discovered_deps_.
+  int discovered_outs_ = 0;
   bool is_implicit_out(size_t index) const {
     return index >= outputs_.size() - implicit_outs_;
   }
@@ -210,6 +322,103 @@ struct Edge final {
   bool maybe_phonycycle_diagnostic() const;
 };
 
+/// Orders edges by criticality: a "less" edge has a smaller critical-path
+/// weight, with pointer order as an arbitrary but stable tie-break so
+/// equally weighted edges are dispatched in creation order.
+struct EdgePriorityLess {
+  bool operator()(const Edge* a, const Edge* b) const {
+    if (a->priority_boost_ != b->priority_boost_)
+      return !a->priority_boost_;
+    if (a->critical_path_weight() != b->critical_path_weight())
+      return a->critical_path_weight() < b->critical_path_weight();
+    return a > b;
+  }
+};
+
+/// A non-owning priority queue of ready edges; top() is the edge with the
+/// largest critical path weight.
+struct EdgePriorityQueue
+    : std::priority_queue<Edge*, std::vector<Edge*>, EdgePriorityLess> {
+  void clear() { c.clear(); }
+
+  /// Restore the heap invariant after the weights of queued edges
+  /// changed (e.g. once the critical path has been computed).
+  void Reorder() { std::make_heap(c.begin(), c.end(), comp); }
+};
+
+/// Plan's ready queue, sharded for dispatch from several threads: each
+/// thread pushes to and pops from its own EdgePriorityQueue shard (keyed
+/// by thread id) and steals from the other shards when its own runs dry.
+/// With the single-threaded Builder loop only one shard is ever touched,
+/// so dispatch order is exactly that of a single priority queue; once
+/// edge completions move onto worker threads, newly-ready edges land on
+/// the finishing worker's shard and strict global priority relaxes to
+/// per-shard priority plus stealing the victim's best edge.
+struct ShardedEdgeQueue {
+  void push(Edge* edge) {
+    Shard& shard = LocalShard();
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.queue.push(edge);
+    size_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /// Pop the local shard's best edge, stealing from the first non-empty
+  /// shard when it is empty.  Returns nullptr when every shard is.
+  Edge* pop() {
+    size_t local = LocalShardIndex();
+    for (size_t i = 0; i < kShards; ++i) {
+      Shard& shard = shards_[(local + i) % kShards];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (shard.queue.empty())
+        continue;
+      Edge* edge = shard.queue.top();
+      shard.queue.pop();
+      size_.fetch_sub(1, std::memory_order_relaxed);
+      return edge;
+    }
+    return nullptr;
+  }
+
+  bool empty() const { return size() == 0; }
+  size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+  void clear() {
+    for (Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.queue.clear();
+    }
+    size_.store(0, std::memory_order_relaxed);
+  }
+
+  /// Restore every shard's heap invariant after queued edges changed
+  /// weight; see EdgePriorityQueue::Reorder.
+  void Reorder() {
+    for (Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.queue.Reorder();
+    }
+  }
+
+ private:
+  static const size_t kShards = 8;
+
+  struct Shard {
+    std::mutex mutex;
+    EdgePriorityQueue queue;
+  };
+
+  static size_t LocalShardIndex() {
+    static std::atomic<size_t> next_index{0};
+    thread_local size_t index =
+        next_index.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return index;
+  }
+  Shard& LocalShard() { return shards_[LocalShardIndex()]; }
+
+  Shard shards_[kShards];
+  std::atomic<size_t> size_{0};
+};
+
 
 /// ImplicitDepLoader loads implicit dependencies, as referenced via the
 /// "depfile" attribute in build files.
@@ -228,6 +437,13 @@ struct ImplicitDepLoader final {
   //                          or out of date).
   bool LoadDeps(Edge* edge, std::string* err);
 
+  /// Read the depfiles of every unscanned edge reachable from \a node on a
+  /// pool of worker threads, ahead of the serial dependency scan;
+  /// LoadDepFile then consumes the prefetched contents instead of issuing
+  /// its own blocking read.  A no-op unless the DiskInterface supports
+  /// parallel reads.
+  void PrefetchDepfiles(Node* node);
+
   DepsLog* deps_log() const {
     return deps_log_;
   }
@@ -243,17 +459,39 @@ struct ImplicitDepLoader final {
 
   /// Preallocate \a count spaces in the input array on \a edge, returning
   /// an iterator pointing at the first new space.
-  std::vector<Node*>::iterator PreallocateSpace(Edge* edge, int count);
+  Edge::Nodes::iterator PreallocateSpace(Edge* edge, int count);
 
   /// If we don't have a edge that generates this input already,
   /// create one; this makes us not abort if the input is missing,
   /// but instead will rebuild in that circumstance.
   void CreatePhonyInEdge(Node* node);
 
+  /// The outcome of one prefetched depfile read, keyed by edge until
+  /// LoadDepFile consumes it.
+  struct PrefetchedDepfile {
+    DiskInterface::Status status = DiskInterface::Okay;
+    std::string content;
+    std::string err;
+  };
+
   State* state_;
   DiskInterface* disk_interface_;
   DepsLog* deps_log_;
   DepfileParserOptions const* depfile_parser_options_;
+  std::unordered_map<const Edge*, PrefetchedDepfile> prefetched_;
+  std::unordered_set<const Edge*> prefetch_visited_;
+
+  /// Memo in front of State::GetNode for depfile-discovered paths, keyed
+  /// by the spelling as it appears in the depfile, before
+  /// canonicalization.  The same headers show up in thousands of
+  /// depfiles; after the first sighting each repeat costs one hash probe
+  /// instead of CanonicalizePath plus a paths_ lookup.  Sound because
+  /// CanonicalizePath is a pure string transform, so a given spelling
+  /// always lands on the same node.  Keys are interned into
+  /// dep_spelling_arena_; the transient depfile buffers they come from
+  /// do not outlive the parse.
+  PathMap dep_node_memo_;
+  StringArena dep_spelling_arena_;
 };
 
 
@@ -299,6 +537,15 @@ struct DependencyScan final {
   bool LoadDyndeps(Node* node, std::string* err) const;
   bool LoadDyndeps(Node* node, DyndepFile* ddf, std::string* err) const;
 
+  /// Combined hash of the contents of the edge's non-order-only inputs,
+  /// for edges in hash_inputs mode.  \a extra_inputs, if given, is folded
+  /// in as well; the builder passes the deps it just extracted, which are
+  /// not part of inputs_ until the next scan.  Insensitive to order and
+  /// duplicates, so the scan-time and record-time input lists agree.
+  /// Never returns 0; the build log reserves that for "not recorded".
+  uint64_t HashInputContents(const Edge* edge,
+                             const std::vector<Node*>* extra_inputs);
+
  private:
   bool RecomputeDirty(Node* node, std::vector<Node*>* stack, std::string* err);
   bool VerifyDAG(Node* node, std::vector<Node*>* stack, std::string* err);
@@ -308,10 +555,33 @@ struct DependencyScan final {
   bool RecomputeOutputDirty(const Edge* edge, const Node* most_recent_input,
                             const std::string& command, Node* output);
 
+  /// Whether \a edge is in hash_inputs mode and its inputs' contents still
+  /// hash to what the build log recorded when \a output was built, i.e. the
+  /// inputs' newer mtimes are spurious rewrites of identical content.
+  bool RecordedInputsUnchanged(const Edge* edge, const Node* output);
+
+  /// Stat every not-yet-examined node reachable from \a node on worker
+  /// threads before the serial dirty walk starts, so the walk finds the
+  /// mtimes already cached instead of issuing one blocking stat() at a
+  /// time.  Advisory: a failed stat leaves the node unexamined and the
+  /// walk re-stats it to report the error.
+  void PrestatNodes(Node* node);
+
   BuildLog* build_log_;
   DiskInterface* disk_interface_;
   ImplicitDepLoader dep_loader_;
   DyndepLoader dyndep_loader_;
+
+  /// Edges already covered by an earlier PrestatNodes walk, so scans of
+  /// multiple targets do not re-walk shared subgraphs.
+  std::unordered_set<const Edge*> prestat_visited_;
+
+  /// Content hashes already computed by HashInputContents, keyed by the
+  /// mtime they were computed at, so a header shared by many hash_inputs
+  /// consumers is read and hashed once while a file rewritten mid-run is
+  /// hashed afresh.
+  std::unordered_map<const Node*, std::pair<TimeStamp, uint64_t>>
+      content_hashes_;
 };
 
 #endif  // NINJA_GRAPH_H_
@@ -79,6 +79,36 @@ TEST_F(GraphTest, FunkyMakefilePath) {
   EXPECT_TRUE(GetNode("out.o")->dirty());
 }
 
+TEST_F(GraphTest, DepfileSpellingMemo) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"rule catdep\n"
+"  depfile = $out.d\n"
+"  command = cat $in > $out\n"
+"build out1.o: catdep foo.cc\n"
+"build out2.o: catdep bar.cc\n"));
+  fs_.Create("foo.cc", "");
+  fs_.Create("bar.cc", "");
+  fs_.Create("implicit.h", "");
+  fs_.Create("out1.o.d", "out1.o: ./foo/../implicit.h\n");
+  fs_.Create("out2.o.d", "out2.o: ./foo/../implicit.h\n");
+  fs_.Create("out1.o", "");
+  fs_.Create("out2.o", "");
+
+  std::string err;
+  EXPECT_TRUE(scan_.RecomputeDirty(GetNode("out1.o"), &err));
+  ASSERT_EQ("", err);
+  EXPECT_TRUE(scan_.RecomputeDirty(GetNode("out2.o"), &err));
+  ASSERT_EQ("", err);
+
+  // Both depfiles spell the header the same non-canonical way; the
+  // second load resolves it through the spelling memo and must land on
+  // the same canonical node, with both edges recorded as dependents.
+  Node* implicit = GetNode("implicit.h");
+  EXPECT_EQ(implicit, GetNode("out1.o")->in_edge()->inputs_[1]);
+  EXPECT_EQ(implicit, GetNode("out2.o")->in_edge()->inputs_[1]);
+  EXPECT_EQ(2u, implicit->out_edges().size());
+}
+
 TEST_F(GraphTest, ExplicitImplicit) {
   ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
 "rule catdep\n"
@@ -210,7 +240,7 @@ TEST_F(GraphTest, RootNodes) {
   std::vector<Node*> root_nodes = state_.RootNodes(&err);
   EXPECT_EQ(4u, root_nodes.size());
   for (size_t i = 0; i < root_nodes.size(); ++i) {
-    std::string name = root_nodes[i]->path();
+    std::string name(root_nodes[i]->path());
     EXPECT_EQ("out", name.substr(0, 3));
   }
 }
@@ -229,6 +259,18 @@ TEST_F(GraphTest, VarInOutPathEscaping) {
 #endif
 }
 
+// A command that only references $in/$out takes the pre-flattened splice
+// path in Edge::EvaluateCommand, but a binding in scope must still shadow it.
+TEST_F(GraphTest, EvaluateCommandShadowedByScope) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"build out1: cat in1 in2\n"
+"build out2: cat in1\n"
+"  command = overridden\n"));
+  EXPECT_TRUE(GetNode("out1")->in_edge()->rule().command_spliceable());
+  EXPECT_EQ("cat in1 in2 > out1", GetNode("out1")->in_edge()->EvaluateCommand());
+  EXPECT_EQ("overridden", GetNode("out2")->in_edge()->EvaluateCommand());
+}
+
 // Regression test for https://github.com/ninja-build/ninja/issues/380
 TEST_F(GraphTest, DepfileWithCanonicalizablePath) {
   ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
@@ -609,6 +651,66 @@ TEST_F(GraphTest, DyndepLoadOutputWithMultipleRules2) {
   EXPECT_EQ("multiple rules generate out-twice.imp", err);
 }
 
+TEST_F(GraphTest, DyndepLoadBatch) {
+  AssertParse(&state_,
+"rule r\n"
+"  command = unused\n"
+"build out1: r in1 || dd1\n"
+"  dyndep = dd1\n"
+"build out2: r in2 || dd2\n"
+"  dyndep = dd2\n"
+  );
+  fs_.Create("dd1",
+"ninja_dyndep_version = 1\n"
+"build out1: dyndep | in1imp\n"
+  );
+  fs_.Create("dd2",
+"ninja_dyndep_version = 1\n"
+"build out2: dyndep | in2imp\n"
+  );
+
+  std::string err;
+  DyndepLoader loader(&state_, &fs_);
+  EXPECT_TRUE(loader.LoadDyndeps({ GetNode("dd1"), GetNode("dd2") }, &err));
+  EXPECT_EQ("", err);
+  EXPECT_FALSE(GetNode("dd1")->dyndep_pending());
+  EXPECT_FALSE(GetNode("dd2")->dyndep_pending());
+
+  Edge* edge1 = GetNode("out1")->in_edge();
+  ASSERT_EQ(3u, edge1->inputs_.size());
+  EXPECT_EQ("in1imp", edge1->inputs_[1]->path());
+  Edge* edge2 = GetNode("out2")->in_edge();
+  ASSERT_EQ(3u, edge2->inputs_.size());
+  EXPECT_EQ("in2imp", edge2->inputs_[1]->path());
+}
+
+TEST_F(GraphTest, DyndepLoadBatchKeepsGoingPastErrors) {
+  AssertParse(&state_,
+"rule r\n"
+"  command = unused\n"
+"build out1: r in1 || dd1\n"
+"  dyndep = dd1\n"
+"build out2: r in2 || dd2\n"
+"  dyndep = dd2\n"
+  );
+  // dd1 is missing; dd2 must still be loaded, and the error reported
+  // is the first one encountered.
+  fs_.Create("dd2",
+"ninja_dyndep_version = 1\n"
+"build out2: dyndep | in2imp\n"
+  );
+
+  std::string err;
+  DyndepLoader loader(&state_, &fs_);
+  EXPECT_FALSE(loader.LoadDyndeps({ GetNode("dd1"), GetNode("dd2") }, &err));
+  EXPECT_EQ("loading 'dd1': No such file or directory", err);
+  EXPECT_FALSE(GetNode("dd2")->dyndep_pending());
+
+  Edge* edge2 = GetNode("out2")->in_edge();
+  ASSERT_EQ(3u, edge2->inputs_.size());
+  EXPECT_EQ("in2imp", edge2->inputs_[1]->path());
+}
+
 TEST_F(GraphTest, DyndepLoadMultiple) {
   AssertParse(&state_,
 "rule r\n"
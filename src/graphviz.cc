@@ -19,67 +19,102 @@
 
 #include "dyndep.h"
 #include "graph.h"
+#include "state.h"
 
 using namespace std;
 
+bool GraphViz::Visit(const Node* node) {
+  // Dyndep loading during the walk can create nodes past the initial
+  // graph size; grow the bitmap to cover them.
+  size_t id = static_cast<size_t>(node->graph_id());
+  if (id >= visited_nodes_.size())
+    visited_nodes_.resize(id + 1, false);
+  if (visited_nodes_[id])
+    return false;
+  visited_nodes_[id] = true;
+  return true;
+}
+
 void GraphViz::AddTarget(Node* node) {
-  if (visited_nodes_.find(node) != visited_nodes_.end())
-    return;
+  // An explicit stack instead of recursion: the walk is as deep as the
+  // longest dependency chain, which overflows the call stack on large
+  // graphs.  Every pushed node gets its label emitted unconditionally;
+  // the depth and count limits only stop edges from being expanded, so
+  // the output never references an unlabelled node.
+  std::vector<std::pair<Node*, int>> stack;
+  stack.emplace_back(node, 0);
+  while (!stack.empty()) {
+    auto [n, depth] = stack.back();
+    stack.pop_back();
+    if (!Visit(n))
+      continue;
 
-  std::string pathstr = node->path();
-  replace(pathstr.begin(), pathstr.end(), '\\', '/');
-  printf("\"%p\" [label=\"%s\"]\n", node, pathstr.c_str());
-  visited_nodes_.insert(node);
+    std::string pathstr(n->path());
+    replace(pathstr.begin(), pathstr.end(), '\\', '/');
+    printf("\"%p\" [label=\"%s\"]\n", n, pathstr.c_str());
+    ++emitted_nodes_;
 
-  Edge* edge = node->in_edge();
+    Edge* edge = n->in_edge();
 
-  if (!edge) {
-    // Leaf node.
-    // Draw as a rect?
-    return;
-  }
+    if (!edge) {
+      // Leaf node.
+      // Draw as a rect?
+      continue;
+    }
 
-  if (visited_edges_.find(edge) != visited_edges_.end())
-    return;
-  visited_edges_.insert(edge);
+    if (edge->mark_ == Edge::VisitDone)
+      continue;
+    edge->mark_ = Edge::VisitDone;
 
-  if (edge->dyndep_ && edge->dyndep_->dyndep_pending()) {
-    std::string err;
-    if (!dyndep_loader_.LoadDyndeps(edge->dyndep_, &err)) {
-      Warning("%s\n", err.c_str());
-    }
-  }
+    if (max_depth_ && depth >= max_depth_)
+      continue;
+    if (max_nodes_ && emitted_nodes_ >= max_nodes_)
+      continue;
 
-  if (edge->inputs_.size() == 1 && edge->outputs_.size() == 1) {
-    // Can draw simply.
-    // Note extra space before label text -- this is cosmetic and feels
-    // like a graphviz bug.
-    printf("\"%p\" -> \"%p\" [label=\" %s\"]\n",
-           edge->inputs_[0], edge->outputs_[0], edge->rule_->name().c_str());
-  } else {
-    printf("\"%p\" [label=\"%s\", shape=ellipse]\n",
-           edge, edge->rule_->name().c_str());
-    for (const auto & output : edge->outputs_)
-    {
-      printf("\"%p\" -> \"%p\"\n", edge, output);
+    if (edge->dyndep_ && edge->dyndep_->dyndep_pending()) {
+      std::string err;
+      if (!dyndep_loader_.LoadDyndeps(edge->dyndep_, &err)) {
+        Warning("%s\n", err.c_str());
+      }
     }
 
-    for(std::vector<Node*>::iterator in = edge->inputs_.begin();
-         in != edge->inputs_.end(); ++in) {
-      const char* order_only = "";
-      if (edge->is_order_only(in - edge->inputs_.begin()))
-        order_only = " style=dotted";
-      printf("\"%p\" -> \"%p\" [arrowhead=none%s]\n", (*in), edge, order_only);
+    if (edge->inputs_.size() == 1 && edge->outputs_.size() == 1) {
+      // Can draw simply.
+      // Note extra space before label text -- this is cosmetic and feels
+      // like a graphviz bug.
+      printf("\"%p\" -> \"%p\" [label=\" %s\"]\n",
+             edge->inputs_[0], edge->outputs_[0], edge->rule_->name().c_str());
+    } else {
+      printf("\"%p\" [label=\"%s\", shape=ellipse]\n",
+             edge, edge->rule_->name().c_str());
+      for (const auto & output : edge->outputs_)
+      {
+        printf("\"%p\" -> \"%p\"\n", edge, output);
+      }
+
+      for(Edge::Nodes::iterator in = edge->inputs_.begin();
+           in != edge->inputs_.end(); ++in) {
+        const char* order_only = "";
+        if (edge->is_order_only(in - edge->inputs_.begin()))
+          order_only = " style=dotted";
+        printf("\"%p\" -> \"%p\" [arrowhead=none%s]\n", (*in), edge, order_only);
+      }
     }
-  }
 
-  for (const auto & input : edge->inputs_)
-  {
-    AddTarget(input);
+    for (const auto & input : edge->inputs_)
+    {
+      stack.emplace_back(input, depth + 1);
+    }
   }
 }
 
 void GraphViz::Start() {
+  // The emitter writes a line or three per node; give stdio a big
+  // buffer so million-node graphs do not pay a write() per line.
+  setvbuf(stdout, nullptr, _IOFBF, 1 << 20);
+
+  visited_nodes_.resize(state_->paths_.size(), false);
+
   printf("digraph ninja {\n");
   printf("rankdir=\"LR\"\n");
   printf("node [fontsize=10, shape=box, height=0.25]\n");
@@ -15,26 +15,43 @@
 #ifndef NINJA_GRAPHVIZ_H_
 #define NINJA_GRAPHVIZ_H_
 
-#include <set>
+#include <vector>
 
 #include "dyndep.h"
 
 struct DiskInterface;
 struct Node;
-struct Edge;
 struct State;
 
 /// Runs the process of creating GraphViz .dot file output.
 struct GraphViz final {
   GraphViz(State* state, DiskInterface* disk_interface)
-      : dyndep_loader_(state, disk_interface) {}
+      : state_(state), dyndep_loader_(state, disk_interface) {}
   void Start();
   void AddTarget(Node* node);
   void Finish();
 
+  /// Stop expanding edges past this many hops from the targets (0 means
+  /// unlimited).  Nodes at the boundary are still labelled, so the
+  /// emitted graph stays well-formed.
+  int max_depth_ = 0;
+  /// Stop expanding edges once this many nodes have been emitted
+  /// (0 means unlimited).
+  int max_nodes_ = 0;
+
+ private:
+  /// Mark the node visited; returns false if it already was.
+  bool Visit(const Node* node);
+
+  State* state_;
   DyndepLoader dyndep_loader_;
-  std::set<Node*> visited_nodes_;
-  std::set<Edge*> visited_edges_;
+
+  /// Visited flags indexed by Node::graph_id(): a flat bitmap instead of
+  /// a node set, which dominated the tool's memory on multi-million-node
+  /// graphs.  Visited edges are tracked in Edge::mark_, which nothing
+  /// else touches during this tool's lifetime.
+  std::vector<bool> visited_nodes_;
+  int emitted_nodes_ = 0;
 };
 
 #endif  // NINJA_GRAPHVIZ_H_
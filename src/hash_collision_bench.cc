@@ -12,54 +12,263 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+// Benchmarks the hash functions and path table underlying the build log
+// and State::paths_: hashing throughput and collision rates over
+// realistic corpora of node paths and command lines, and lookup/insert
+// performance of PathMap against std::unordered_map.  A recorded path
+// set (one path per line, e.g. extracted from a real .ninja) can be
+// passed as an argument to replace the generated paths.
+
 #include "build_log.h"
 
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
 #include <algorithm>
-#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
-#include <stdlib.h>
-#include <time.h>
+#include "metrics.h"
+#include "path_map.h"
+#include "string_concat.h"
 
 using namespace std;
 
-int random(int low, int high) {
-  return int(low + (rand() / double(RAND_MAX)) * (high - low) + 0.5);
+namespace {
+
+/// Deterministic generator, so runs before and after a change hash the
+/// same corpus.
+struct Rng {
+  uint64_t state = 0x5370'6c69'6e74'6572;  // "Splinter"
+  uint32_t Next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (uint32_t)((state * 0x2545F4914F6CDD1D) >> 32);
+  }
+  int Range(int low, int high) { return low + (int)(Next() % (high - low)); }
+  template <size_t N>
+  const char* Pick(const char* const (&table)[N]) {
+    return table[Next() % N];
+  }
+};
+
+const char* const kComponents[] = {
+  "base", "net", "ui", "gpu", "media", "content", "components",
+  "third_party", "tools", "services",
+};
+const char* const kSubdirs[] = {
+  "internal", "linux", "posix", "impl", "core", "util", "api", "backend",
+};
+const char* const kWords[] = {
+  "file", "view", "buffer", "manager", "host", "client", "service",
+  "context", "render", "frame", "layout", "socket", "cache", "thread",
+  "loop", "event", "paint", "image", "codec", "parser",
+};
+
+std::string MakePath(Rng* rng, const char* root, const char* extension) {
+  std::string path = string_concat(root, rng->Pick(kComponents), "/");
+  if (rng->Range(0, 3))
+    string_append(path, rng->Pick(kSubdirs), "/");
+  int words = rng->Range(1, 4);
+  for (int i = 0; i < words; ++i)
+    string_append(path, i ? "_" : "", rng->Pick(kWords));
+  string_append(path, to_string(rng->Range(0, 100)), extension);
+  return path;
+}
+
+std::vector<std::string> GeneratePaths(Rng* rng, size_t count) {
+  std::vector<std::string> paths;
+  paths.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+    paths.push_back(MakePath(rng, "out/Release/obj/", ".o"));
+  return paths;
+}
+
+std::vector<std::string> GenerateCommands(
+    Rng* rng, const std::vector<std::string>& paths) {
+  std::vector<std::string> commands;
+  // One compile command per few objects...
+  for (size_t i = 0; i < paths.size(); i += 4) {
+    std::string source = MakePath(rng, "../../", ".cc");
+    commands.push_back(string_concat(
+        "clang++ -MMD -MF ", paths[i], ".d -O2 -fno-exceptions -fno-rtti "
+        "-std=c++17 -DNDEBUG -DUSE_AURA=", to_string(rng->Range(0, 2)),
+        " -Igen -I../.. -c ", source, " -o ", paths[i]));
+  }
+  // ...plus a few link lines of the ~100KB shape where command hashing
+  // actually shows up in profiles.
+  for (int i = 0; i < 20; ++i) {
+    std::string link = "clang++ -Wl,--gc-sections -o exe/target";
+    int objects = rng->Range(1500, 2500);
+    for (int j = 0; j < objects; ++j)
+      string_append(link, " ", paths[rng->Next() % paths.size()]);
+    commands.push_back(std::move(link));
+  }
+  return commands;
+}
+
+bool ReadPathCorpus(const char* path, std::vector<std::string>* out) {
+  FILE* file = fopen(path, "rb");
+  if (!file)
+    return false;
+  char line[4 << 10];
+  while (fgets(line, sizeof(line), file)) {
+    size_t len = strlen(line);
+    while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+      --len;
+    if (len)
+      out->push_back(std::string(line, len));
+  }
+  fclose(file);
+  return true;
+}
+
+uint64_t StdHash(std::string_view key) {
+  // The hash PathMap (State::paths_) probes with.
+  return std::hash<std::string_view>()(key);
 }
 
-void RandomCommand(char** s) {
-  int len = random(5, 100);
-  *s = new char[len];
-  for (int i = 0; i < len; ++i)
-    (*s)[i] = (char)random(32, 127);
+void BenchThroughput(const char* corpus_name,
+                     const std::vector<std::string>& corpus) {
+  size_t corpus_bytes = 0;
+  for (const std::string& entry : corpus)
+    corpus_bytes += entry.size();
+  printf("%s: %zu entries, %.1f MB\n", corpus_name, corpus.size(),
+         corpus_bytes / 1e6);
+
+  struct { const char* name; uint64_t (*hash)(std::string_view); } hashes[] = {
+    { "xxHash64 (build log)", BuildLog::LogEntry::HashCommand },
+    { "MurmurHash2 (legacy)", BuildLog::LogEntry::LegacyHashCommand },
+    { "std::hash (paths_)", StdHash },
+  };
+  for (const auto& entry : hashes) {
+    // Enough rounds to hash a few hundred MB, so the timer resolution
+    // does not matter.
+    int rounds = (int)(400 * 1000 * 1000 / corpus_bytes) + 1;
+    uint64_t guard = 0;
+    int64_t start = GetTimeMicros();
+    for (int round = 0; round < rounds; ++round) {
+      for (const std::string& item : corpus)
+        guard += entry.hash(item);
+    }
+    double seconds = (GetTimeMicros() - start) / 1e6;
+    printf("  %-22s %7.0f MB/s  (guard %08x)\n", entry.name,
+           rounds * corpus_bytes / 1e6 / seconds, (unsigned)guard);
+  }
 }
 
-int main() {
-  const int N = 20 * 1000 * 1000;
+void CountCollisions(const char* name, uint64_t (*hash)(std::string_view),
+                     const std::vector<std::string>& corpus) {
+  std::vector<std::pair<uint64_t, const std::string*>> hashes;
+  hashes.reserve(corpus.size());
+  for (const std::string& entry : corpus)
+    hashes.push_back({ hash(entry), &entry });
+  std::sort(hashes.begin(), hashes.end());
 
-  // Leak these, else 10% of the runtime is spent destroying strings.
-  char** commands = new char*[N];
-  std::pair<uint64_t, int>* hashes = new std::pair<uint64_t, int>[N];
+  int collisions = 0;
+  for (size_t i = 1; i < hashes.size(); ++i) {
+    if (hashes[i - 1].first == hashes[i].first &&
+        *hashes[i - 1].second != *hashes[i].second)
+      ++collisions;
+  }
+  printf("  %-22s %d collisions over %zu entries\n", name, collisions,
+         hashes.size());
+}
 
-  srand((int)time(nullptr));
+void BenchPathTable(const std::vector<std::string>& paths) {
+  // Lookup order shuffled away from insertion order, as scans do.
+  std::vector<const std::string*> probes;
+  probes.reserve(paths.size());
+  for (const std::string& path : paths)
+    probes.push_back(&path);
+  Rng rng;
+  for (size_t i = probes.size(); i > 1; --i)
+    std::swap(probes[i - 1], probes[rng.Next() % i]);
+  std::vector<std::string> misses;
+  misses.reserve(paths.size());
+  for (const std::string& path : paths)
+    misses.push_back(string_concat("missing/", path));
+
+  const int kLookupRounds = 20;
+  size_t guard = 0;
+
+  {
+    PathMap map;
+    int64_t start = GetTimeMicros();
+    for (const std::string& path : paths)
+      map[path] = nullptr;
+    int64_t inserted = GetTimeMicros();
+    for (int round = 0; round < kLookupRounds; ++round) {
+      for (const std::string* probe : probes)
+        guard += map.find(*probe) != map.end();
+    }
+    int64_t hits = GetTimeMicros();
+    for (int round = 0; round < kLookupRounds; ++round) {
+      for (const std::string& miss : misses)
+        guard += map.find(miss) != map.end();
+    }
+    int64_t end = GetTimeMicros();
+    printf("  %-22s insert %5.0f ns/op  hit %5.0f ns/op  miss %5.0f ns/op\n",
+           "PathMap (paths_)",
+           (inserted - start) * 1e3 / paths.size(),
+           (hits - inserted) * 1e3 / (probes.size() * kLookupRounds),
+           (end - hits) * 1e3 / (misses.size() * kLookupRounds));
+  }
 
-  for (int i = 0; i < N; ++i) {
-    RandomCommand(&commands[i]);
-    hashes[i] = std::make_pair(BuildLog::LogEntry::HashCommand(commands[i]), i);
+  {
+    std::unordered_map<std::string_view, void*> map;
+    int64_t start = GetTimeMicros();
+    for (const std::string& path : paths)
+      map[path] = nullptr;
+    int64_t inserted = GetTimeMicros();
+    for (int round = 0; round < kLookupRounds; ++round) {
+      for (const std::string* probe : probes)
+        guard += map.find(*probe) != map.end();
+    }
+    int64_t hits = GetTimeMicros();
+    for (int round = 0; round < kLookupRounds; ++round) {
+      for (const std::string& miss : misses)
+        guard += map.find(miss) != map.end();
+    }
+    int64_t end = GetTimeMicros();
+    printf("  %-22s insert %5.0f ns/op  hit %5.0f ns/op  miss %5.0f ns/op\n",
+           "std::unordered_map",
+           (inserted - start) * 1e3 / paths.size(),
+           (hits - inserted) * 1e3 / (probes.size() * kLookupRounds),
+           (end - hits) * 1e3 / (misses.size() * kLookupRounds));
   }
 
-  sort(hashes, hashes + N);
-
-  int collision_count = 0;
-  for (int i = 1; i < N; ++i) {
-    if (hashes[i - 1].first == hashes[i].first) {
-      if (strcmp(commands[hashes[i - 1].second],
-                 commands[hashes[i].second]) != 0) {
-        printf("collision!\n  string 1: '%s'\n  string 2: '%s'\n",
-               commands[hashes[i - 1].second],
-               commands[hashes[i].second]);
-        collision_count++;
-      }
+  printf("  (guard %zx)\n", guard);
+}
+
+}  // anonymous namespace
+
+int main(int argc, char* argv[]) {
+  Rng rng;
+  std::vector<std::string> paths;
+  if (argc > 1) {
+    if (!ReadPathCorpus(argv[1], &paths)) {
+      fprintf(stderr, "failed to read corpus %s: %s\n", argv[1],
+              strerror(errno));
+      return 1;
     }
+  } else {
+    paths = GeneratePaths(&rng, 200 * 1000);
   }
-  printf("\n\n%d collisions after %d runs\n", collision_count, N);
+  std::vector<std::string> commands = GenerateCommands(&rng, paths);
+
+  BenchThroughput("path corpus", paths);
+  BenchThroughput("command corpus", commands);
+
+  printf("collisions:\n");
+  CountCollisions("xxHash64 (build log)", BuildLog::LogEntry::HashCommand,
+                  commands);
+  CountCollisions("MurmurHash2 (legacy)",
+                  BuildLog::LogEntry::LegacyHashCommand, commands);
+
+  printf("path table (%zu paths):\n", paths.size());
+  BenchPathTable(paths);
 }
@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <iterator>
 #include <sstream>
+#include <unordered_map>
 
 #define NOMINMAX
 #include <windows.h>
@@ -125,6 +126,16 @@ bool IsFullPathName(std::string_view s) {
   return true;
 }
 
+/// Normalized directory results, keyed "<relative_to>\1<raw directory>".
+/// A build normalizes the same handful of SDK and toolchain include
+/// directories millions of times, so the split/abs-path/relativize math
+/// runs once per directory and every later include from it is one hash
+/// lookup plus a basename append.  Thread-local because /showIncludes
+/// output is parsed on completion-pool workers; the maps stay tiny (one
+/// entry per distinct include directory) and live for the process --
+/// which is the point for a persistent "-t msvc -s" helper.
+thread_local std::unordered_map<std::string, std::string> g_dir_memo;
+
 }  // anonymous namespace
 
 IncludesNormalize::IncludesNormalize(const std::string& relative_to) {
@@ -184,6 +195,49 @@ std::string IncludesNormalize::Relativize(
 
 bool IncludesNormalize::Normalize(const std::string& input,
                                   std::string* result, std::string* err) const {
+  if (input.size() > _MAX_PATH) {
+    *err = "path too long";
+    return false;
+  }
+
+  // Split off the final component and normalize just the directory
+  // through the memo.  Composing "dir result + / + basename" is only
+  // valid when the basename is a plain name: "." and ".." interact with
+  // the directory during canonicalization, an empty directory has
+  // nothing to look up, and a directory ending in ':' is drive-relative
+  // ("c:foo"), which GetFullPathName resolves against a per-drive cwd.
+  size_t sep = input.find_last_of("/\\");
+  if (sep != std::string::npos && sep > 0 && sep + 1 < input.size() &&
+      input[sep - 1] != ':') {
+    std::string_view basename(input.data() + sep + 1, input.size() - sep - 1);
+    if (basename != "." && basename != "..") {
+      std::string key = string_concat(relative_to_, "\1",
+                                      std::string_view(input.data(), sep));
+      auto insert = g_dir_memo.emplace(std::move(key), std::string());
+      std::string& dir_result = insert.first->second;
+      if (insert.second &&
+          !NormalizeUncached(input.substr(0, sep), &dir_result, err)) {
+        // The directory alone would not normalize (e.g. its absolute
+        // form overflows _MAX_PATH).  Fall back to the whole input so
+        // both the result and the error text match the uncached math.
+        g_dir_memo.erase(insert.first);
+        err->clear();
+        return NormalizeUncached(input, result, err);
+      }
+      if (dir_result == ".")
+        result->assign(basename);
+      else
+        *result = string_concat(dir_result, "/", basename);
+      return true;
+    }
+  }
+
+  return NormalizeUncached(input, result, err);
+}
+
+bool IncludesNormalize::NormalizeUncached(const std::string& input,
+                                          std::string* result,
+                                          std::string* err) const {
   char copy[_MAX_PATH + 1];
   size_t len = input.size();
   if (len > _MAX_PATH) {
@@ -30,10 +30,17 @@ struct IncludesNormalize final {
 
   /// Normalize by fixing slashes style, fixing redundant .. and . and makes the
   /// path |input| relative to |this->relative_to_| and store to |result|.
+  /// Results are composed from a per-thread memo of normalized directory
+  /// prefixes, since the same SDK and toolchain include directories come
+  /// up for every include of every compile.
   bool Normalize(const std::string& input, std::string* result,
                  std::string* err) const;
 
  private:
+  /// The full path math behind Normalize(), bypassing the memo.
+  bool NormalizeUncached(const std::string& input, std::string* result,
+                         std::string* err) const;
+
   std::string relative_to_;
   std::vector<std::string_view> split_relative_to_;
 };
@@ -84,6 +84,23 @@ TEST(IncludesNormalize, Case) {
   EXPECT_EQ("A/B", NormalizeAndCheckNoError("A\\./B"));
 }
 
+TEST(IncludesNormalize, MemoizedDirectory) {
+  // Paths sharing a directory hit the per-thread memo after the first
+  // normalization; the composed results must match the uncached math.
+  EXPECT_EQ("sub/foo.h", NormalizeAndCheckNoError("sub\\foo.h"));
+  EXPECT_EQ("sub/bar.h", NormalizeAndCheckNoError("sub\\bar.h"));
+  EXPECT_EQ("sub/foo.h", NormalizeAndCheckNoError("sub/foo.h"));
+  EXPECT_EQ("b", NormalizeAndCheckNoError("sub\\..\\b"));
+
+  // A different relative_to must not reuse entries memoized for ".".
+  EXPECT_EQ("../../sub/foo.h",
+            NormalizeRelativeAndCheckNoError("sub\\foo.h", "b/c"));
+
+  // Dot components as the final element bypass the memo.
+  EXPECT_EQ(".", NormalizeAndCheckNoError("sub\\.."));
+  EXPECT_EQ("sub", NormalizeAndCheckNoError("sub\\."));
+}
+
 TEST(IncludesNormalize, DifferentDrive) {
   EXPECT_EQ("stuff.h",
             NormalizeRelativeAndCheckNoError("p:\\vs08\\stuff.h", "p:\\vs08"));
@@ -0,0 +1,159 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "jobserver.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "string_concat.h"
+#include "util.h"
+
+Jobserver::~Jobserver() {
+#ifndef _WIN32
+  // An interrupted build can get here with tokens still held: Abort()
+  // kills the running subprocesses without Release()ing them.  The
+  // protocol requires writing every held token back before exiting --
+  // a parent make that survives us would otherwise lose those job slots
+  // from its shared budget for the rest of its run.
+  if (write_fd_ >= 0) {
+    for (const char token : held_tokens_) {
+      while (write(write_fd_, &token, 1) != 1 && errno == EINTR) {
+      }
+    }
+  }
+  if (read_fd_ >= 0)
+    close(read_fd_);
+  if (write_fd_ >= 0)
+    close(write_fd_);
+  if (!fifo_path_.empty())
+    unlink(fifo_path_.c_str());
+#endif
+}
+
+bool Jobserver::AdoptFromEnvironment() {
+#ifndef _WIN32
+  const char* makeflags = getenv("MAKEFLAGS");
+  if (!makeflags)
+    return false;
+  const char* auth = strstr(makeflags, "--jobserver-auth=fifo:");
+  if (!auth)
+    return false;
+  auth += strlen("--jobserver-auth=fifo:");
+  const char* end = auth;
+  while (*end && *end != ' ' && *end != '\t')
+    ++end;
+  std::string path(auth, end - auth);
+
+  // O_NONBLOCK on the read side so an empty fifo means "no token right
+  // now" rather than a stall.  The write end can only block if the fifo
+  // has no reader, and we just became one.
+  read_fd_ = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+  if (read_fd_ < 0)
+    return false;
+  write_fd_ = open(path.c_str(), O_WRONLY);
+  if (write_fd_ < 0) {
+    close(read_fd_);
+    read_fd_ = -1;
+    return false;
+  }
+  // Children join by path, not by inheriting our descriptors.
+  SetCloseOnExec(read_fd_);
+  SetCloseOnExec(write_fd_);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool Jobserver::Setup(int tokens, std::string* err) {
+#ifndef _WIN32
+  const char* tmpdir = getenv("TMPDIR");
+  std::string path =
+      string_concat(tmpdir && *tmpdir ? tmpdir : "/tmp", "/ninja-jobserver-",
+                    std::to_string(getpid()));
+  if (mkfifo(path.c_str(), 0600) != 0) {
+    *err = strerror(errno);
+    return false;
+  }
+  read_fd_ = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+  write_fd_ = read_fd_ < 0 ? -1 : open(path.c_str(), O_WRONLY);
+  if (read_fd_ < 0 || write_fd_ < 0) {
+    *err = strerror(errno);
+    if (read_fd_ >= 0)
+      close(read_fd_);
+    read_fd_ = -1;
+    unlink(path.c_str());
+    return false;
+  }
+  SetCloseOnExec(read_fd_);
+  SetCloseOnExec(write_fd_);
+  fifo_path_ = path;
+
+  // Preload tokens-1 bytes: the budget is `tokens` jobs in total, and
+  // every participant's first job runs on its implicit token.
+  for (int i = 1; i < tokens; ++i) {
+    if (write(write_fd_, "+", 1) != 1) {
+      *err = strerror(errno);
+      return false;
+    }
+  }
+
+  std::string flags = string_concat("-j", std::to_string(tokens),
+                                    " --jobserver-auth=fifo:", path);
+  if (const char* existing = getenv("MAKEFLAGS"); existing && *existing)
+    flags = string_concat(existing, " ", flags);
+  setenv("MAKEFLAGS", flags.c_str(), 1);
+  return true;
+#else
+  *err = "jobserver not supported on this platform";
+  return false;
+#endif
+}
+
+bool Jobserver::Acquire() {
+#ifndef _WIN32
+  if (!implicit_held_) {
+    implicit_held_ = true;
+    return true;
+  }
+  char token;
+  if (read(read_fd_, &token, 1) != 1)
+    return false;
+  held_tokens_.push_back(token);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void Jobserver::Release() {
+#ifndef _WIN32
+  if (!held_tokens_.empty()) {
+    char token = held_tokens_.back();
+    held_tokens_.pop_back();
+    while (write(write_fd_, &token, 1) != 1 && errno == EINTR) {
+    }
+    return;
+  }
+  implicit_held_ = false;
+#endif
+}
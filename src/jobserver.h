@@ -0,0 +1,64 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_JOBSERVER_H_
+#define NINJA_JOBSERVER_H_
+
+#include <string>
+
+/// GNU make jobserver (fifo style): one -j budget shared across a whole
+/// tree of make and ninja processes.  Every participant holds one
+/// implicit token for its first running job and takes a byte from the
+/// fifo for each additional one, writing the byte back when that job
+/// finishes.
+///
+/// As a client we adopt the fifo named by --jobserver-auth=fifo:PATH in
+/// $MAKEFLAGS; as a server we create the fifo, preload it with
+/// parallelism-1 tokens and export $MAKEFLAGS so sub-makes (and nested
+/// splinter) draw from our budget instead of assuming they own the box.
+/// POSIX only; on Windows both modes report failure and the build falls
+/// back to plain -j.
+struct Jobserver {
+  Jobserver() = default;
+  ~Jobserver();
+
+  /// Join the jobserver advertised in $MAKEFLAGS, if there is one.
+  bool AdoptFromEnvironment();
+
+  /// Create a fifo representing a budget of \a tokens jobs in total and
+  /// advertise it to subcommands through $MAKEFLAGS.
+  bool Setup(int tokens, std::string* err);
+
+  bool enabled() const { return read_fd_ >= 0; }
+
+  /// Take a token for one more running job; the first job rides the
+  /// implicit token.  Returns false when no token is available right
+  /// now (retry after a running job finishes somewhere in the tree).
+  bool Acquire();
+
+  /// Return the token of a finished job.
+  void Release();
+
+ private:
+  int read_fd_ = -1;
+  int write_fd_ = -1;
+  /// Path of the fifo when this process created (and must unlink) it.
+  std::string fifo_path_;
+  /// Bytes taken from the fifo for currently running jobs; the spec
+  /// wants the same byte written back on release.
+  std::string held_tokens_;
+  bool implicit_held_ = false;
+};
+
+#endif  // NINJA_JOBSERVER_H_
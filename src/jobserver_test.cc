@@ -0,0 +1,91 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "jobserver.h"
+
+#ifndef _WIN32
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+namespace {
+
+TEST(JobserverTest, NoEnvironment) {
+  unsetenv("MAKEFLAGS");
+  Jobserver client;
+  EXPECT_FALSE(client.AdoptFromEnvironment());
+  EXPECT_FALSE(client.enabled());
+}
+
+TEST(JobserverTest, ServeAndAdopt) {
+  unsetenv("MAKEFLAGS");
+  Jobserver server;
+  std::string err;
+  ASSERT_TRUE(server.Setup(3, &err));
+  ASSERT_EQ("", err);
+  ASSERT_TRUE(server.enabled());
+  const char* makeflags = getenv("MAKEFLAGS");
+  ASSERT_TRUE(makeflags);
+  EXPECT_TRUE(strstr(makeflags, "--jobserver-auth=fifo:"));
+
+  // A budget of 3 is the implicit job plus the two preloaded tokens.
+  EXPECT_TRUE(server.Acquire());
+  EXPECT_TRUE(server.Acquire());
+  EXPECT_TRUE(server.Acquire());
+  EXPECT_FALSE(server.Acquire());
+
+  // Releasing one job puts its token back for a client to pick up.
+  server.Release();
+  Jobserver client;
+  ASSERT_TRUE(client.AdoptFromEnvironment());
+  EXPECT_TRUE(client.Acquire());   // The client's own implicit job.
+  EXPECT_TRUE(client.Acquire());   // The token the server released.
+  EXPECT_FALSE(client.Acquire());
+  client.Release();
+  client.Release();
+
+  unsetenv("MAKEFLAGS");
+}
+
+TEST(JobserverTest, DestructorReturnsHeldTokens) {
+  unsetenv("MAKEFLAGS");
+  Jobserver server;
+  std::string err;
+  ASSERT_TRUE(server.Setup(3, &err));
+  ASSERT_EQ("", err);
+
+  {
+    // A client torn down mid-build -- an aborted run never Release()s
+    // its killed jobs -- must write its held tokens back to the fifo.
+    Jobserver client;
+    ASSERT_TRUE(client.AdoptFromEnvironment());
+    EXPECT_TRUE(client.Acquire());  // The implicit job; not a fifo token.
+    EXPECT_TRUE(client.Acquire());
+    EXPECT_TRUE(client.Acquire());
+  }
+
+  // Both preloaded tokens are back in the pool for the server's jobs.
+  EXPECT_TRUE(server.Acquire());
+  EXPECT_TRUE(server.Acquire());
+  EXPECT_TRUE(server.Acquire());
+  EXPECT_FALSE(server.Acquire());
+
+  unsetenv("MAKEFLAGS");
+}
+
+}  // anonymous namespace
+
+#endif  // !_WIN32
@@ -14,12 +14,67 @@
 
 #include "lexer.h"
 
+#include <stdint.h>
 #include <stdio.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "eval_env.h"
 #include "util.h"
 #include "string_concat.h"
 
+namespace {
+
+/// True for bytes the plain-text rule in ReadEvalString consumes, i.e.
+/// everything except "$ :\r\n|" and NUL.
+inline bool IsPlainEvalChar(char c) {
+  switch (c) {
+  case '$': case ' ': case ':': case '\r': case '\n': case '|': case '\0':
+    return false;
+  default:
+    return true;
+  }
+}
+
+/// Return the end of the maximal run of plain-text bytes starting at |p|.
+/// This is a bulk version of ReadEvalString's [^$ :\r\n|\000]+ rule, which
+/// otherwise advances byte-at-a-time through the re2c state machine; literal
+/// runs of path characters dominate manifest lexing.  The input is
+/// guaranteed NUL-terminated, and the vector loops below only ever issue
+/// aligned 16-byte loads, which cannot cross a page boundary, so reading a
+/// few bytes past the NUL is safe.
+const char* SkipPlainEvalChars(const char* p) {
+#if defined(__SSE2__)
+  while ((reinterpret_cast<uintptr_t>(p) & 15) != 0) {
+    if (!IsPlainEvalChar(*p))
+      return p;
+    ++p;
+  }
+  for (;;) {
+    __m128i chunk = _mm_load_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i stop = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('$'));
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')));
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')));
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')));
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('|')));
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(chunk, _mm_setzero_si128()));
+    int mask = _mm_movemask_epi8(stop);
+    if (mask)
+      return p + __builtin_ctz(mask);
+    p += 16;
+  }
+#else
+  while (IsPlainEvalChar(*p))
+    ++p;
+  return p;
+#endif
+}
+
+}  // anonymous namespace
+
 bool Lexer::Error(const std::string& message, std::string* err) {
   // Compute line/column.
   int line = 1;
@@ -210,6 +265,13 @@ bool Lexer::ReadEvalString(EvalString* eval, bool path, std::string* err) {
   const char* start;
   for (;;) {
     start = p;
+    // Bulk-skip the plain-text run the first rule below would otherwise
+    // consume byte-at-a-time; the state machine only handles boundaries.
+    p = SkipPlainEvalChars(p);
+    if (p != start) {
+      eval->AddText(std::string_view(start, p - start));
+      continue;
+    }
     /*!re2c
     [^$ :\r\n|\000]+ {
       eval->AddText(std::string_view(start, p - start));
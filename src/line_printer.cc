@@ -16,6 +16,7 @@
 
 #include "util.h"
 
+#include <chrono>
 #include <string_view>
 
 #include <stdio.h>
@@ -72,7 +73,22 @@ LinePrinter::LinePrinter() : have_blank_line_(true), console_locked_(false) {
 #endif
 }
 
-void LinePrinter::Print(std::string_view to_print_view, LineType type) {
+LinePrinter::~LinePrinter() {
+  StopFrameLimiter();
+}
+
+void LinePrinter::Print(std::string_view to_print, LineType type) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (frame_limiting_ && smart_terminal_ && type == ELIDE && !console_locked_) {
+    // Just update the model; the frame thread writes the terminal.
+    pending_line_ = to_print;
+    pending_dirty_ = true;
+    return;
+  }
+  PrintLocked(to_print, type);
+}
+
+void LinePrinter::PrintLocked(std::string_view to_print_view, LineType type) {
   if (console_locked_) {
     line_buffer_ = to_print_view;
     line_type_ = type;
@@ -140,6 +156,11 @@ void LinePrinter::PrintOrBuffer(const char* data, size_t size) {
 }
 
 void LinePrinter::PrintOnNewLine(std::string_view to_print) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  PrintOnNewLineLocked(to_print);
+}
+
+void LinePrinter::PrintOnNewLineLocked(std::string_view to_print) {
   if (console_locked_ && !line_buffer_.empty()) {
     output_buffer_.append(line_buffer_);
     output_buffer_.append(1, '\n');
@@ -152,23 +173,72 @@ void LinePrinter::PrintOnNewLine(std::string_view to_print) {
     PrintOrBuffer(&to_print[0], to_print.size());
   }
   have_blank_line_ = to_print.empty() || *to_print.rbegin() == '\n';
+  // Whatever status line was on the terminal is gone; repaint it on the
+  // next frame.
+  if (!pending_line_.empty())
+    pending_dirty_ = true;
 }
 
 void LinePrinter::SetConsoleLocked(bool locked) {
+  std::lock_guard<std::mutex> lock(mutex_);
   if (locked == console_locked_)
     return;
 
   if (locked)
-    PrintOnNewLine("");
+    PrintOnNewLineLocked("");
 
   console_locked_ = locked;
 
   if (!locked) {
-    PrintOnNewLine(output_buffer_);
+    PrintOnNewLineLocked(output_buffer_);
     if (!line_buffer_.empty()) {
-      Print(line_buffer_, line_type_);
+      PrintLocked(line_buffer_, line_type_);
     }
     output_buffer_.clear();
     line_buffer_.clear();
   }
 }
+
+void LinePrinter::StartFrameLimiter() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (frame_limiting_ || !smart_terminal_)
+    return;
+  frame_limiting_ = true;
+  stop_frames_ = false;
+  frame_thread_ = std::thread([this] { FrameLoop(); });
+}
+
+void LinePrinter::StopFrameLimiter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!frame_limiting_)
+      return;
+    stop_frames_ = true;
+  }
+  frame_cv_.notify_one();
+  frame_thread_.join();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  frame_limiting_ = false;
+  // Leave the terminal showing the final state, not the last frame's.
+  if (pending_dirty_ && !console_locked_) {
+    pending_dirty_ = false;
+    PrintLocked(pending_line_, ELIDE);
+  }
+}
+
+void LinePrinter::FrameLoop() {
+  // 20Hz: fast enough that the status reads as live, slow enough that
+  // terminal writes stay negligible.
+  const auto kFrameInterval = std::chrono::milliseconds(50);
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_frames_) {
+    frame_cv_.wait_for(lock, kFrameInterval);
+    if (stop_frames_)
+      break;
+    if (pending_dirty_ && !console_locked_) {
+      pending_dirty_ = false;
+      PrintLocked(pending_line_, ELIDE);
+    }
+  }
+}
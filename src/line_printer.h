@@ -15,8 +15,11 @@
 #ifndef NINJA_LINE_PRINTER_H_
 #define NINJA_LINE_PRINTER_H_
 
+#include <condition_variable>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <thread>
 
 #include <stddef.h>
 
@@ -24,6 +27,7 @@
 /// if the terminal supports it.
 struct LinePrinter final {
   LinePrinter();
+  ~LinePrinter();
 
   bool is_smart_terminal() const { return smart_terminal_; }
   void set_smart_terminal(bool smart) { smart_terminal_ = smart; }
@@ -45,6 +49,16 @@ struct LinePrinter final {
   /// console is locked will not be printed until it is unlocked.
   void SetConsoleLocked(bool locked);
 
+  /// Decouple the elided status line from its updates: between these
+  /// calls, ELIDE prints on a smart terminal only update an in-memory
+  /// line, and a 20Hz frame thread writes at most one line per frame to
+  /// the terminal.  At thousands of edges per second the tty writes
+  /// otherwise throttle the build loop.  FULL prints and PrintOnNewLine
+  /// (errors, command output) keep flushing immediately.
+  void StartFrameLimiter();
+  /// Stop the frame thread, rendering the last pending status line.
+  void StopFrameLimiter();
+
  private:
   /// Whether we can do fancy terminal control codes.
   bool smart_terminal_;
@@ -71,6 +85,22 @@ struct LinePrinter final {
   void* console_;
 #endif
 
+  /// Serializes terminal writes between the caller and the frame thread.
+  std::mutex mutex_;
+  std::condition_variable frame_cv_;
+  std::thread frame_thread_;
+  bool frame_limiting_ = false;
+  bool stop_frames_ = false;
+  /// The most recent ELIDE line, not yet on the terminal when dirty.
+  std::string pending_line_;
+  bool pending_dirty_ = false;
+
+  void FrameLoop();
+
+  /// The pre-existing printing logic; callers hold mutex_.
+  void PrintLocked(std::string_view to_print, LineType type);
+  void PrintOnNewLineLocked(std::string_view to_print);
+
   /// Print the given data to the console, or buffer it if it is locked.
   void PrintOrBuffer(const char *data, size_t size);
 };
@@ -0,0 +1,792 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "manifest_cache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "disk_interface.h"
+#include "graph.h"
+#include "manifest_parser.h"
+#include "metrics.h"
+#include "state.h"
+#include "string_concat.h"
+#include "util.h"
+#include "version.h"
+
+using namespace std;
+
+namespace {
+
+const char kFileSignature[] = "# splintermanifest\n";
+const int kCurrentVersion = 3;
+
+/// Ids with the high bit set name objects that live in static storage
+/// rather than in the serialized tables.
+const uint32_t kDefaultPoolId = 0xFFFFFFFF;
+const uint32_t kConsolePoolId = 0xFFFFFFFE;
+const uint32_t kPhonyRuleId = 0xFFFFFFFF;
+const uint32_t kNoId = 0xFFFFFFFF;
+
+}  // anonymous namespace
+
+struct ManifestCache::Writer {
+  explicit Writer(FILE* file) : file_(file) {}
+
+  void WriteU32(uint32_t value) { fwrite(&value, sizeof(value), 1, file_); }
+  void WriteU64(uint64_t value) { fwrite(&value, sizeof(value), 1, file_); }
+  void WriteS64(int64_t value) { fwrite(&value, sizeof(value), 1, file_); }
+  void WriteString(std::string_view s) {
+    WriteU32(static_cast<uint32_t>(s.size()));
+    fwrite(s.data(), 1, s.size(), file_);
+  }
+
+  FILE* file_;
+};
+
+struct ManifestCache::Reader {
+  Reader(const char* data, size_t size) : p_(data), end_(data + size) {}
+
+  bool ReadU32(uint32_t* value) { return ReadRaw(value, sizeof(*value)); }
+  bool ReadU64(uint64_t* value) { return ReadRaw(value, sizeof(*value)); }
+  bool ReadS64(int64_t* value) { return ReadRaw(value, sizeof(*value)); }
+  bool ReadString(std::string_view* s) {
+    uint32_t len;
+    if (!ReadU32(&len) || static_cast<size_t>(end_ - p_) < len)
+      return false;
+    *s = std::string_view(p_, len);
+    p_ += len;
+    return true;
+  }
+
+  bool ReadRaw(void* out, size_t size) {
+    if (static_cast<size_t>(end_ - p_) < size)
+      return false;
+    memcpy(out, p_, size);
+    p_ += size;
+    return true;
+  }
+
+  const char* p_;
+  const char* end_;
+};
+
+void ManifestCache::WriteEvalString(Writer* w, const EvalString& eval) {
+  w->WriteU32(static_cast<uint32_t>(eval.tokens_.size()));
+  for (const EvalString::Token& token : eval.tokens_) {
+    w->WriteU32(static_cast<uint32_t>(token.type));
+    w->WriteString(eval.token_text(token));
+  }
+}
+
+bool ManifestCache::ReadEvalString(Reader* r, EvalString* eval) {
+  uint32_t count;
+  if (!r->ReadU32(&count))
+    return false;
+  eval->tokens_.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t type;
+    std::string_view text;
+    if (!r->ReadU32(&type) || type > EvalString::SPECIAL ||
+        !r->ReadString(&text))
+      return false;
+    // Serialized RAW tokens are already merged, so AddText never has a
+    // trailing RAW token to extend here; both paths append one token.
+    if (type == EvalString::RAW)
+      eval->AddText(text);
+    else
+      eval->AddSpecial(text);
+  }
+  return true;
+}
+
+bool ManifestCache::Save(const std::string& path, State* state,
+                         DiskInterface* disk_interface, std::string* err) {
+  METRIC_RECORD("manifest cache save");
+
+  // Collect every object reachable from the edges.  Scopes that no edge
+  // references cannot influence a build, so they are not stored.
+  std::vector<Node*> nodes;
+  std::unordered_map<const Node*, uint32_t> node_ids;
+  nodes.reserve(state->paths_.size());
+  for (const auto& [node_path, node] : state->paths_) {
+    node_ids[node] = static_cast<uint32_t>(nodes.size());
+    nodes.push_back(node);
+  }
+
+  std::vector<Pool*> pools;
+  std::unordered_map<const Pool*, uint32_t> pool_ids;
+  for (const auto& [pool_name, pool] : state->pools_) {
+    if (pool == &State::kDefaultPool || pool == &State::kConsolePool)
+      continue;
+    pool_ids[pool] = static_cast<uint32_t>(pools.size());
+    pools.push_back(pool);
+  }
+
+  std::vector<BindingEnv*> envs;
+  std::unordered_map<const BindingEnv*, uint32_t> env_ids;
+  auto add_env = [&](BindingEnv* env) {
+    std::vector<BindingEnv*> chain;
+    for (; env && env_ids.count(env) == 0; env = env->parent_)
+      chain.push_back(env);
+    for (BindingEnv* e : chain) {
+      env_ids[e] = static_cast<uint32_t>(envs.size());
+      envs.push_back(e);
+    }
+  };
+  add_env(&state->bindings_);
+  for (Edge* edge : state->edges_)
+    add_env(edge->env_);
+  for (const State::ManifestFile& manifest_file : state->manifest_files_)
+    add_env(manifest_file.env);
+
+  std::vector<const Rule*> rules;
+  std::unordered_map<const Rule*, uint32_t> rule_ids;
+  auto add_rule = [&](const Rule* rule) {
+    if (rule == &State::kPhonyRule || rule_ids.count(rule))
+      return;
+    rule_ids[rule] = static_cast<uint32_t>(rules.size());
+    rules.push_back(rule);
+  };
+  for (BindingEnv* env : envs)
+    for (const auto& [rule_name, rule] : env->rules_)
+      add_rule(rule);
+  for (Edge* edge : state->edges_)
+    add_rule(edge->rule_);
+
+  std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (!file) {
+    *err = strerror(errno);
+    return false;
+  }
+  Writer w(file);
+
+  fwrite(kFileSignature, sizeof(kFileSignature) - 1, 1, file);
+  w.WriteU32(kCurrentVersion);
+  w.WriteString(kNinjaVersion);
+
+  // The key: every manifest file that was parsed, with its current mtime.
+  // A file modified between being read and being stat()ed here yields a
+  // cache marked fresher than it is; the same window exists for the build
+  // log's manifest-regeneration check and is considered acceptable.  The
+  // include structure (parent/subninja) and each file's scope are stored
+  // so single subninja scopes can be reparsed incrementally.
+  w.WriteU32(static_cast<uint32_t>(state->manifest_files_.size()));
+  for (const State::ManifestFile& manifest_file : state->manifest_files_) {
+    TimeStamp mtime = 0;
+    if (!manifest_file.path.empty()) {
+      std::string stat_err;
+      mtime = disk_interface->Stat(manifest_file.path, &stat_err);
+    }
+    w.WriteString(manifest_file.path);
+    w.WriteS64(mtime);
+    w.WriteU32(static_cast<uint32_t>(manifest_file.parent));
+    w.WriteU32(manifest_file.subninja ? 1 : 0);
+    w.WriteU32(manifest_file.env ? env_ids[manifest_file.env] : kNoId);
+  }
+
+  w.WriteU32(static_cast<uint32_t>(pools.size()));
+  for (Pool* pool : pools) {
+    w.WriteString(pool->name());
+    w.WriteU32(static_cast<uint32_t>(pool->depth()));
+    w.WriteU32(static_cast<uint32_t>(pool->origin_file()));
+  }
+
+  w.WriteU32(static_cast<uint32_t>(nodes.size()));
+  for (Node* node : nodes) {
+    w.WriteString(node->path());
+    w.WriteU64(node->slash_bits());
+  }
+
+  w.WriteU32(static_cast<uint32_t>(rules.size()));
+  for (const Rule* rule : rules) {
+    w.WriteString(rule->name());
+    w.WriteU32(static_cast<uint32_t>(rule->bindings_.size()));
+    for (const auto& [key, value] : rule->bindings_) {
+      w.WriteString(key);
+      WriteEvalString(&w, value);
+    }
+  }
+
+  w.WriteU32(static_cast<uint32_t>(envs.size()));
+  for (BindingEnv* env : envs) {
+    w.WriteU32(env->parent_ ? env_ids[env->parent_] : kNoId);
+    w.WriteU32(static_cast<uint32_t>(env->bindings_.size()));
+    for (const auto& [key, value] : env->bindings_) {
+      w.WriteString(key);
+      w.WriteString(value);
+    }
+    uint32_t rule_count = 0;
+    for (const auto& [rule_name, rule] : env->rules_)
+      if (rule != &State::kPhonyRule)
+        ++rule_count;
+    w.WriteU32(rule_count);
+    for (const auto& [rule_name, rule] : env->rules_)
+      if (rule != &State::kPhonyRule)
+        w.WriteU32(rule_ids[rule]);
+  }
+
+  w.WriteU32(static_cast<uint32_t>(state->edges_.size()));
+  for (Edge* edge : state->edges_) {
+    w.WriteU32(edge->rule_ == &State::kPhonyRule ? kPhonyRuleId
+                                                 : rule_ids[edge->rule_]);
+    w.WriteU32(env_ids[edge->env_]);
+    if (edge->pool_ == &State::kDefaultPool)
+      w.WriteU32(kDefaultPoolId);
+    else if (edge->pool_ == &State::kConsolePool)
+      w.WriteU32(kConsolePoolId);
+    else
+      w.WriteU32(pool_ids[edge->pool_]);
+    w.WriteU32(static_cast<uint32_t>(edge->origin_file_));
+    // Outputs and inputs appended by the dep loaders at scan time sit at
+    // the end of their implicit sections; a restored graph re-discovers
+    // them (or reuses the cached-deps records below), so only the
+    // parse-time lists are stored.
+    size_t out_count = edge->outputs_.size() - edge->discovered_outs_;
+    w.WriteU32(static_cast<uint32_t>(out_count));
+    for (size_t j = 0; j < out_count; ++j)
+      w.WriteU32(node_ids[edge->outputs_[j]]);
+    w.WriteU32(
+        static_cast<uint32_t>(edge->implicit_outs_ - edge->discovered_outs_));
+    size_t order_only_start = edge->inputs_.size() - edge->order_only_deps_;
+    size_t discovered_start = order_only_start - edge->discovered_deps_;
+    w.WriteU32(
+        static_cast<uint32_t>(edge->inputs_.size() - edge->discovered_deps_));
+    for (size_t j = 0; j < edge->inputs_.size(); ++j) {
+      if (j >= discovered_start && j < order_only_start)
+        continue;
+      w.WriteU32(node_ids[edge->inputs_[j]]);
+    }
+    w.WriteU32(
+        static_cast<uint32_t>(edge->implicit_deps_ - edge->discovered_deps_));
+    w.WriteU32(static_cast<uint32_t>(edge->order_only_deps_));
+    w.WriteU32(edge->dyndep_ ? node_ids[edge->dyndep_] : kNoId);
+  }
+
+  w.WriteU32(static_cast<uint32_t>(state->defaults_.size()));
+  for (size_t i = 0; i < state->defaults_.size(); ++i) {
+    w.WriteU32(node_ids[state->defaults_[i]]);
+    w.WriteU32(i < state->default_origins_.size()
+                   ? static_cast<uint32_t>(state->default_origins_[i])
+                   : kNoId);
+  }
+
+  // Deps discovered from depfiles, keyed per edge by the depfile's mtime
+  // at the time it was parsed.  A run that saves after building (see
+  // ninja.cc) persists them here so the next scan can skip the depfile
+  // reads; entries for edges that were not scanned this run carry forward
+  // unchanged.
+  std::unordered_map<const Edge*, uint32_t> edge_ids;
+  for (size_t i = 0; i < state->edges_.size(); ++i)
+    edge_ids[state->edges_[i]] = static_cast<uint32_t>(i);
+  uint32_t cached_deps_count = 0;
+  for (const auto& [edge, cached] : state->cached_deps_)
+    if (edge_ids.count(edge))
+      ++cached_deps_count;
+  w.WriteU32(cached_deps_count);
+  for (const auto& [edge, cached] : state->cached_deps_) {
+    auto edge_id = edge_ids.find(edge);
+    if (edge_id == edge_ids.end())
+      continue;
+    w.WriteU32(edge_id->second);
+    w.WriteS64(cached.depfile_mtime);
+    w.WriteU32(static_cast<uint32_t>(cached.deps.size()));
+    for (Node* dep : cached.deps)
+      w.WriteU32(node_ids[dep]);
+  }
+
+  if (ferror(file)) {
+    *err = strerror(errno);
+    fclose(file);
+    return false;
+  }
+  if (fclose(file) != 0) {
+    *err = strerror(errno);
+    return false;
+  }
+  if (rename(temp_path.c_str(), path.c_str()) != 0) {
+    *err = strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+LoadStatus ManifestCache::Load(const std::string& path, State* state,
+                               DiskInterface* disk_interface,
+                               std::string* err, bool* reparsed) {
+  METRIC_RECORD("manifest cache load");
+
+  std::unique_ptr<LoadedFile> file;
+  std::string read_err;
+  switch (disk_interface->LoadFile(path, &file, &read_err)) {
+  case FileReader::Okay:
+    break;
+  case FileReader::NotFound:
+    return LOAD_NOT_FOUND;
+  default:
+    *err = read_err;
+    return LOAD_ERROR;
+  }
+
+  std::string_view content = file->content();
+  Reader r(content.data(), content.size());
+
+  char signature[sizeof(kFileSignature)] = {};
+  std::string_view version_string;
+  uint32_t version;
+  if (!r.ReadRaw(signature, sizeof(kFileSignature) - 1) ||
+      memcmp(signature, kFileSignature, sizeof(kFileSignature) - 1) != 0 ||
+      !r.ReadU32(&version) || !r.ReadString(&version_string)) {
+    *err = "corrupt manifest cache";
+    return LOAD_ERROR;
+  }
+  // A cache written by another version is simply stale, not an error.
+  if (version != static_cast<uint32_t>(kCurrentVersion) ||
+      version_string != kNinjaVersion)
+    return LOAD_NOT_FOUND;
+
+  // Validate the key: every manifest file must still have the mtime it had
+  // when the cache was written.  Changed files loaded via 'subninja' only
+  // invalidate their own scope, which can be reparsed below; anything else
+  // (the root, or an included file whose bindings leak into its includer's
+  // scope) makes the whole snapshot stale.
+  uint32_t file_count;
+  if (!r.ReadU32(&file_count)) {
+    *err = "corrupt manifest cache";
+    return LOAD_ERROR;
+  }
+  std::vector<State::ManifestFile> files;
+  std::vector<uint32_t> file_env_ids;
+  std::vector<uint32_t> stale;
+  files.reserve(file_count);
+  file_env_ids.reserve(file_count);
+  for (uint32_t i = 0; i < file_count; ++i) {
+    std::string_view manifest_path;
+    int64_t recorded_mtime;
+    uint32_t parent, subninja, env_id;
+    if (!r.ReadString(&manifest_path) || !r.ReadS64(&recorded_mtime) ||
+        !r.ReadU32(&parent) || !r.ReadU32(&subninja) || !r.ReadU32(&env_id) ||
+        (parent != kNoId && parent >= i)) {
+      *err = "corrupt manifest cache";
+      return LOAD_ERROR;
+    }
+    State::ManifestFile manifest_file;
+    manifest_file.path = std::string(manifest_path);
+    manifest_file.parent = static_cast<int32_t>(parent);
+    manifest_file.subninja = subninja != 0;
+    files.push_back(std::move(manifest_file));
+    file_env_ids.push_back(env_id);
+
+    if (manifest_path.empty())
+      continue;  // Tombstone of an earlier incremental reparse.
+    std::string stat_err;
+    TimeStamp mtime = disk_interface->Stat(files[i].path, &stat_err);
+    if (mtime == 0)
+      return LOAD_NOT_FOUND;  // Deleted; a full parse reports the error.
+    if (mtime < 0 || mtime != recorded_mtime)
+      stale.push_back(i);
+  }
+
+  // Map each stale file onto the nearest enclosing subninja scope; a
+  // change to an included file affects the whole scope that included it.
+  std::vector<uint32_t> reparse;
+  for (uint32_t id : stale) {
+    int32_t scope = static_cast<int32_t>(id);
+    while (scope >= 0 && !files[scope].subninja)
+      scope = files[scope].parent;
+    if (scope < 0)
+      return LOAD_NOT_FOUND;  // Reaches the root scope: full reparse.
+    if (std::find(reparse.begin(), reparse.end(),
+                  static_cast<uint32_t>(scope)) == reparse.end())
+      reparse.push_back(static_cast<uint32_t>(scope));
+  }
+  // Drop scopes whose ancestor is also being reparsed.
+  for (size_t i = 0; i < reparse.size();) {
+    bool covered = false;
+    for (int32_t p = files[reparse[i]].parent; p >= 0; p = files[p].parent) {
+      if (std::find(reparse.begin(), reparse.end(),
+                    static_cast<uint32_t>(p)) != reparse.end()) {
+        covered = true;
+        break;
+      }
+    }
+    if (covered)
+      reparse.erase(reparse.begin() + i);
+    else
+      ++i;
+  }
+  std::sort(reparse.begin(), reparse.end());
+
+  std::vector<BindingEnv*> envs;
+  if (!LoadGraph(&r, state, &envs, err)) {
+    // The caller has to discard the partially populated State.
+    if (err->empty())
+      *err = "corrupt manifest cache";
+    return LOAD_ERROR;
+  }
+
+  for (uint32_t i = 0; i < file_count; ++i) {
+    if (file_env_ids[i] != kNoId) {
+      if (file_env_ids[i] >= envs.size()) {
+        *err = "corrupt manifest cache";
+        return LOAD_ERROR;
+      }
+      files[i].env = envs[file_env_ids[i]];
+    }
+  }
+  state->manifest_files_ = std::move(files);
+
+  // Keep the mapping alive: node paths could be made to reference it.
+  state->loaded_files_.push_back(std::move(file));
+
+  if (reparse.empty())
+    return LOAD_SUCCESS;
+
+  LoadStatus status = ReparseStale(state, disk_interface, reparse, err);
+  if (status == LOAD_SUCCESS && reparsed)
+    *reparsed = true;
+  return status;
+}
+
+LoadStatus ManifestCache::ReparseStale(State* state,
+                                       DiskInterface* disk_interface,
+                                       const std::vector<uint32_t>& reparse,
+                                       std::string* err) {
+  METRIC_RECORD("manifest cache reparse");
+  std::vector<State::ManifestFile>& files = state->manifest_files_;
+
+  // Everything the stale scopes (and the files below them) contributed is
+  // discarded, then each scope is parsed again as if its 'subninja'
+  // statement were evaluated afresh.
+  std::vector<bool> discard(files.size(), false);
+  for (size_t i = 0; i < files.size(); ++i) {
+    for (int32_t p = static_cast<int32_t>(i); p >= 0; p = files[p].parent) {
+      if (std::binary_search(reparse.begin(), reparse.end(),
+                             static_cast<uint32_t>(p))) {
+        discard[i] = true;
+        break;
+      }
+    }
+  }
+
+  size_t kept = 0;
+  for (Edge* edge : state->edges_) {
+    if (edge->origin_file_ >= 0 && discard[edge->origin_file_]) {
+      for (Node* out : edge->outputs_)
+        out->set_in_edge(nullptr);
+      for (Node* in : edge->inputs_)
+        in->RemoveOutEdge(edge);
+      state->cached_deps_.erase(edge);
+    } else {
+      state->edges_[kept++] = edge;
+    }
+  }
+  state->edges_.resize(kept);
+
+  kept = 0;
+  for (size_t i = 0; i < state->defaults_.size(); ++i) {
+    int32_t origin = state->default_origins_[i];
+    if (origin >= 0 && discard[origin])
+      continue;
+    state->defaults_[kept] = state->defaults_[i];
+    state->default_origins_[kept] = origin;
+    ++kept;
+  }
+  state->defaults_.resize(kept);
+  state->default_origins_.resize(kept);
+
+  // Pools are global, so an edge in an unchanged scope may reference a
+  // pool declared in a discarded one.  Remember the removed pools and
+  // re-point such edges at the redeclared pool afterwards.
+  std::unordered_map<const Pool*, std::string> removed_pools;
+  for (auto i = state->pools_.begin(); i != state->pools_.end();) {
+    Pool* pool = i->second;
+    if (pool->origin_file() >= 0 && discard[pool->origin_file()]) {
+      removed_pools.emplace(pool, pool->name());
+      i = state->pools_.erase(i);
+    } else {
+      ++i;
+    }
+  }
+
+  // Tombstone the discarded records; indices must stay stable.
+  struct StaleScope {
+    std::string path;
+    int32_t parent;
+  };
+  std::vector<StaleScope> scopes;
+  scopes.reserve(reparse.size());
+  for (uint32_t id : reparse)
+    scopes.push_back({ files[id].path, files[id].parent });
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (discard[i]) {
+      files[i].path.clear();
+      files[i].env = nullptr;
+    }
+  }
+
+  for (const StaleScope& scope : scopes) {
+    BindingEnv* parent_env =
+        scope.parent >= 0 ? files[scope.parent].env : nullptr;
+    if (parent_env == nullptr) {
+      // The state is already partially patched, so the caller must fall
+      // back to a full reparse on a fresh State.
+      *err = "parent scope not snapshotted";
+      return LOAD_ERROR;
+    }
+    ManifestParser parser(state, disk_interface);
+    if (!parser.LoadSubninja(scope.path, parent_env, scope.parent, err))
+      return LOAD_ERROR;
+  }
+
+  for (Edge* edge : state->edges_) {
+    auto removed = removed_pools.find(edge->pool_);
+    if (removed == removed_pools.end())
+      continue;
+    Pool* pool = state->LookupPool(removed->second);
+    if (pool == nullptr) {
+      // A full reparse on a fresh State will report the unknown pool with
+      // proper context.
+      *err = string_concat("pool '", removed->second, "' was removed");
+      return LOAD_ERROR;
+    }
+    edge->pool_ = pool;
+  }
+
+  return LOAD_SUCCESS;
+}
+
+static bool Corrupt(std::string* err) {
+  *err = "corrupt manifest cache";
+  return false;
+}
+
+bool ManifestCache::LoadGraph(Reader* r, State* state,
+                              std::vector<BindingEnv*>* envs_out,
+                              std::string* err) {
+  uint32_t pool_count;
+  if (!r->ReadU32(&pool_count))
+    return Corrupt(err);
+  std::vector<Pool*> pools;
+  pools.reserve(pool_count);
+  for (uint32_t i = 0; i < pool_count; ++i) {
+    std::string_view name;
+    uint32_t depth, origin;
+    if (!r->ReadString(&name) || !r->ReadU32(&depth) || !r->ReadU32(&origin))
+      return Corrupt(err);
+    if (state->LookupPool(name) != nullptr)
+      return Corrupt(err);
+    Pool* pool = new Pool(std::string(name), static_cast<int>(depth));
+    pool->set_origin_file(static_cast<int32_t>(origin));
+    state->AddPool(pool);
+    pools.push_back(pool);
+  }
+
+  uint32_t node_count;
+  if (!r->ReadU32(&node_count))
+    return Corrupt(err);
+  std::vector<Node*> nodes;
+  nodes.reserve(node_count);
+  state->ReserveNodes(node_count);
+  for (uint32_t i = 0; i < node_count; ++i) {
+    std::string_view node_path;
+    uint64_t slash_bits;
+    if (!r->ReadString(&node_path) || !r->ReadU64(&slash_bits))
+      return Corrupt(err);
+    Node* node =
+        state->node_arena_.New(state->path_arena_.Intern(node_path), slash_bits,
+                               state->scan_arena_.New());
+    node->set_graph_id(static_cast<int>(i));
+    state->paths_[node->path()] = node;
+    nodes.push_back(node);
+  }
+
+  uint32_t rule_count;
+  if (!r->ReadU32(&rule_count))
+    return Corrupt(err);
+  std::vector<Rule*> rules;
+  rules.reserve(rule_count);
+  for (uint32_t i = 0; i < rule_count; ++i) {
+    std::string_view name;
+    uint32_t binding_count;
+    if (!r->ReadString(&name) || !r->ReadU32(&binding_count))
+      return Corrupt(err);
+    Rule* rule = new Rule(std::string(name));
+    for (uint32_t j = 0; j < binding_count; ++j) {
+      std::string_view key;
+      EvalString value;
+      if (!r->ReadString(&key) || !ReadEvalString(r, &value))
+        return Corrupt(err);
+      rule->AddBinding(std::string(key), value);
+    }
+    rules.push_back(rule);
+  }
+
+  uint32_t env_count;
+  if (!r->ReadU32(&env_count) || env_count == 0)
+    return Corrupt(err);
+  std::vector<BindingEnv*>& envs = *envs_out;
+  envs.reserve(env_count);
+  envs.push_back(&state->bindings_);
+  for (uint32_t i = 1; i < env_count; ++i)
+    envs.push_back(new BindingEnv);
+  for (uint32_t i = 0; i < env_count; ++i) {
+    BindingEnv* env = envs[i];
+    uint32_t parent_id, binding_count, env_rule_count;
+    if (!r->ReadU32(&parent_id))
+      return Corrupt(err);
+    if (parent_id != kNoId) {
+      if (parent_id >= env_count)
+        return Corrupt(err);
+      env->parent_ = envs[parent_id];
+    }
+    if (!r->ReadU32(&binding_count))
+      return Corrupt(err);
+    for (uint32_t j = 0; j < binding_count; ++j) {
+      std::string_view key, value;
+      if (!r->ReadString(&key) || !r->ReadString(&value))
+        return Corrupt(err);
+      env->AddBinding(std::string(key), std::string(value));
+    }
+    if (!r->ReadU32(&env_rule_count))
+      return Corrupt(err);
+    for (uint32_t j = 0; j < env_rule_count; ++j) {
+      uint32_t rule_id;
+      if (!r->ReadU32(&rule_id) || rule_id >= rules.size())
+        return Corrupt(err);
+      env->AddRule(rules[rule_id]);
+    }
+  }
+
+  uint32_t edge_count;
+  if (!r->ReadU32(&edge_count))
+    return Corrupt(err);
+  state->edges_.reserve(edge_count);
+  for (uint32_t i = 0; i < edge_count; ++i) {
+    uint32_t rule_id, env_id, pool_id, origin;
+    if (!r->ReadU32(&rule_id) || !r->ReadU32(&env_id) ||
+        !r->ReadU32(&pool_id) || !r->ReadU32(&origin))
+      return Corrupt(err);
+
+    Edge* edge = state->edge_arena_.New();
+    edge->origin_file_ = static_cast<int32_t>(origin);
+    state->edges_.push_back(edge);
+
+    if (rule_id == kPhonyRuleId)
+      edge->rule_ = &State::kPhonyRule;
+    else if (rule_id < rules.size())
+      edge->rule_ = rules[rule_id];
+    else
+      return Corrupt(err);
+
+    if (env_id >= envs.size())
+      return Corrupt(err);
+    edge->env_ = envs[env_id];
+
+    if (pool_id == kDefaultPoolId)
+      edge->pool_ = &State::kDefaultPool;
+    else if (pool_id == kConsolePoolId)
+      edge->pool_ = &State::kConsolePool;
+    else if (pool_id < pools.size())
+      edge->pool_ = pools[pool_id];
+    else
+      return Corrupt(err);
+
+    uint32_t out_count, in_count, implicit_outs, implicit_deps,
+        order_only_deps, dyndep_id;
+    if (!r->ReadU32(&out_count))
+      return Corrupt(err);
+    edge->outputs_.reserve(out_count);
+    for (uint32_t j = 0; j < out_count; ++j) {
+      uint32_t node_id;
+      if (!r->ReadU32(&node_id) || node_id >= nodes.size())
+        return Corrupt(err);
+      Node* node = nodes[node_id];
+      if (node->in_edge() != nullptr)
+        return Corrupt(err);
+      node->set_in_edge(edge);
+      edge->outputs_.push_back(node);
+    }
+    if (!r->ReadU32(&implicit_outs))
+      return Corrupt(err);
+    edge->implicit_outs_ = static_cast<int>(implicit_outs);
+
+    if (!r->ReadU32(&in_count))
+      return Corrupt(err);
+    edge->inputs_.reserve(in_count);
+    for (uint32_t j = 0; j < in_count; ++j) {
+      uint32_t node_id;
+      if (!r->ReadU32(&node_id) || node_id >= nodes.size())
+        return Corrupt(err);
+      Node* node = nodes[node_id];
+      node->AddOutEdge(edge);
+      edge->inputs_.push_back(node);
+    }
+    if (!r->ReadU32(&implicit_deps) || !r->ReadU32(&order_only_deps) ||
+        !r->ReadU32(&dyndep_id))
+      return Corrupt(err);
+    edge->implicit_deps_ = static_cast<int>(implicit_deps);
+    edge->order_only_deps_ = static_cast<int>(order_only_deps);
+    if (dyndep_id != kNoId) {
+      if (dyndep_id >= nodes.size())
+        return Corrupt(err);
+      edge->dyndep_ = nodes[dyndep_id];
+      edge->dyndep_->set_dyndep_pending(true);
+    }
+  }
+
+  uint32_t default_count;
+  if (!r->ReadU32(&default_count))
+    return Corrupt(err);
+  state->defaults_.reserve(default_count);
+  state->default_origins_.reserve(default_count);
+  for (uint32_t i = 0; i < default_count; ++i) {
+    uint32_t node_id, origin;
+    if (!r->ReadU32(&node_id) || node_id >= nodes.size() ||
+        !r->ReadU32(&origin))
+      return Corrupt(err);
+    state->defaults_.push_back(nodes[node_id]);
+    state->default_origins_.push_back(static_cast<int32_t>(origin));
+  }
+
+  uint32_t cached_deps_count;
+  if (!r->ReadU32(&cached_deps_count))
+    return Corrupt(err);
+  for (uint32_t i = 0; i < cached_deps_count; ++i) {
+    uint32_t edge_id, dep_count;
+    int64_t depfile_mtime;
+    if (!r->ReadU32(&edge_id) || edge_id >= state->edges_.size() ||
+        !r->ReadS64(&depfile_mtime) || !r->ReadU32(&dep_count))
+      return Corrupt(err);
+    State::CachedEdgeDeps& cached =
+        state->cached_deps_[state->edges_[edge_id]];
+    cached.depfile_mtime = depfile_mtime;
+    cached.deps.reserve(dep_count);
+    for (uint32_t j = 0; j < dep_count; ++j) {
+      uint32_t node_id;
+      if (!r->ReadU32(&node_id) || node_id >= nodes.size())
+        return Corrupt(err);
+      cached.deps.push_back(nodes[node_id]);
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,68 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_MANIFEST_CACHE_H_
+#define NINJA_MANIFEST_CACHE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "load_status.h"
+
+struct BindingEnv;
+struct DiskInterface;
+struct EvalString;
+struct State;
+
+/// A versioned binary snapshot of a parsed State, keyed by the mtimes of
+/// every .ninja file that went into it.  On a hit the whole Lexer /
+/// ManifestParser phase is skipped and the node/edge/rule graph is
+/// deserialized directly.
+///
+/// Only data that influences a build is stored: scopes (BindingEnvs) that
+/// no edge references are unreachable at build time and are dropped.
+struct ManifestCache {
+  /// Populate \a state, which must be freshly constructed, from the cache
+  /// file at \a path.  When only files loaded via 'subninja' changed, their
+  /// scopes are reparsed into the restored graph and \a reparsed (if
+  /// non-null) is set so the caller knows to rewrite the cache.  Returns
+  /// LOAD_NOT_FOUND when there is no cache or it is too stale to patch
+  /// (the root manifest or an included file changed), LOAD_ERROR with
+  /// \a err filled for a corrupt or unreadable cache.
+  static LoadStatus Load(const std::string& path, State* state,
+                         DiskInterface* disk_interface, std::string* err,
+                         bool* reparsed = nullptr);
+
+  /// Serialize \a state to \a path.  Returns false and fills \a err on I/O
+  /// failure.
+  static bool Save(const std::string& path, State* state,
+                   DiskInterface* disk_interface, std::string* err);
+
+ private:
+  // Bounds-checked binary readers/writers, defined in manifest_cache.cc.
+  struct Reader;
+  struct Writer;
+
+  static bool LoadGraph(Reader* r, State* state,
+                        std::vector<BindingEnv*>* envs_out, std::string* err);
+  static LoadStatus ReparseStale(State* state, DiskInterface* disk_interface,
+                                 const std::vector<uint32_t>& reparse,
+                                 std::string* err);
+  static void WriteEvalString(Writer* w, const EvalString& eval);
+  static bool ReadEvalString(Reader* r, EvalString* eval);
+};
+
+#endif  // NINJA_MANIFEST_CACHE_H_
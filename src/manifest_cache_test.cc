@@ -0,0 +1,282 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "manifest_cache.h"
+
+#include "disk_interface.h"
+#include "graph.h"
+#include "manifest_parser.h"
+#include "state.h"
+#include "test.h"
+
+namespace {
+
+const char kCachePath[] = "build.ninja.cache";
+
+struct ManifestCacheTest : public testing::Test {
+  void SetUp() override {
+    // These tests do real disk accesses, so create a temporary directory.
+    temp_dir_.CreateAndEnter("manifest_cache_test");
+  }
+
+  void TearDown() override {
+    temp_dir_.Cleanup();
+  }
+
+  bool ParseAndSave(State* state, std::string* err) {
+    ManifestParser parser(state, &disk_);
+    if (!parser.Load("build.ninja", err))
+      return false;
+    return ManifestCache::Save(kCachePath, state, &disk_, err);
+  }
+
+  ScopedTempDir temp_dir_;
+  RealDiskInterface disk_;
+};
+
+TEST_F(ManifestCacheTest, RoundTrip) {
+  disk_.WriteFile("build.ninja",
+                  "pool link_pool\n"
+                  "  depth = 2\n"
+                  "rule cat\n"
+                  "  command = cat $in > $out\n"
+                  "name = outer\n"
+                  "build out1: cat in1 | in2 || in3\n"
+                  "  pool = link_pool\n"
+                  "subninja sub.ninja\n"
+                  "build all: phony out1 out2\n"
+                  "default all\n");
+  disk_.WriteFile("sub.ninja",
+                  "name = inner\n"
+                  "build out2: cat in4\n"
+                  "  description = $name\n");
+
+  State state;
+  std::string err;
+  ASSERT_TRUE(ParseAndSave(&state, &err));
+  ASSERT_EQ("", err);
+
+  State cached;
+  ASSERT_EQ(LOAD_SUCCESS,
+            ManifestCache::Load(kCachePath, &cached, &disk_, &err));
+  ASSERT_EQ("", err);
+  VerifyGraph(cached);
+
+  ASSERT_EQ(state.paths_.size(), cached.paths_.size());
+  ASSERT_EQ(state.edges_.size(), cached.edges_.size());
+  for (size_t i = 0; i < state.edges_.size(); ++i) {
+    EXPECT_EQ(state.edges_[i]->EvaluateCommand(),
+              cached.edges_[i]->EvaluateCommand());
+    EXPECT_EQ(state.edges_[i]->GetBinding("description"),
+              cached.edges_[i]->GetBinding("description"));
+  }
+
+  Node* out1 = cached.LookupNode("out1");
+  ASSERT_TRUE(out1);
+  Edge* edge = out1->in_edge();
+  ASSERT_TRUE(edge);
+  EXPECT_EQ("link_pool", edge->pool()->name());
+  EXPECT_EQ(2, edge->pool()->depth());
+  EXPECT_EQ(3u, edge->inputs_.size());
+  EXPECT_EQ(1, edge->implicit_deps_);
+  EXPECT_EQ(1, edge->order_only_deps_);
+
+  Node* all = cached.LookupNode("all");
+  ASSERT_TRUE(all);
+  ASSERT_TRUE(all->in_edge());
+  EXPECT_TRUE(all->in_edge()->is_phony());
+
+  ASSERT_EQ(1u, cached.defaults_.size());
+  EXPECT_EQ("all", cached.defaults_[0]->path());
+}
+
+TEST_F(ManifestCacheTest, CachedDepfileDeps) {
+  disk_.WriteFile("build.ninja",
+                  "rule cc\n"
+                  "  command = cc -c $in -o $out\n"
+                  "  depfile = $out.d\n"
+                  "build out1.o: cc in1.c\n");
+  disk_.WriteFile("out1.o.d", "out1.o: in1.c hdr1.h hdr2.h\n");
+
+  State state;
+  std::string err;
+  ASSERT_TRUE(ParseAndSave(&state, &err));
+  ASSERT_EQ("", err);
+
+  // Scanning reads the depfile and records its deps on the State.
+  DependencyScan scan(&state, nullptr, nullptr, &disk_, nullptr);
+  Node* out = state.LookupNode("out1.o");
+  ASSERT_TRUE(out);
+  EXPECT_TRUE(scan.RecomputeDirty(out, &err));
+  ASSERT_EQ("", err);
+  EXPECT_TRUE(state.cached_deps_dirty_);
+  ASSERT_EQ(1u, state.cached_deps_.size());
+
+  // The rewritten cache carries the deps; a fresh load restores them
+  // without growing the edge's parse-time input list.
+  ASSERT_TRUE(ManifestCache::Save(kCachePath, &state, &disk_, &err));
+  State cached;
+  ASSERT_EQ(LOAD_SUCCESS,
+            ManifestCache::Load(kCachePath, &cached, &disk_, &err));
+  ASSERT_EQ("", err);
+  VerifyGraph(cached);
+
+  Node* cached_out = cached.LookupNode("out1.o");
+  ASSERT_TRUE(cached_out);
+  Edge* edge = cached_out->in_edge();
+  ASSERT_TRUE(edge);
+  EXPECT_EQ(1u, edge->inputs_.size());
+  EXPECT_EQ(0, edge->implicit_deps_);
+  auto cached_deps = cached.cached_deps_.find(edge);
+  ASSERT_NE(cached.cached_deps_.end(), cached_deps);
+  ASSERT_EQ(2u, cached_deps->second.deps.size());
+  EXPECT_EQ("hdr1.h", cached_deps->second.deps[0]->path());
+  EXPECT_EQ("hdr2.h", cached_deps->second.deps[1]->path());
+
+  // While the depfile's mtime is unchanged a scan of the restored graph
+  // reuses the record instead of rereading the depfile.
+  DependencyScan cached_scan(&cached, nullptr, nullptr, &disk_, nullptr);
+  EXPECT_TRUE(cached_scan.RecomputeDirty(cached_out, &err));
+  ASSERT_EQ("", err);
+  EXPECT_FALSE(cached.cached_deps_dirty_);
+  EXPECT_EQ(3u, edge->inputs_.size());
+  EXPECT_EQ(2, edge->implicit_deps_);
+  EXPECT_EQ(2, edge->discovered_deps_);
+}
+
+TEST_F(ManifestCacheTest, MissingCache) {
+  State state;
+  std::string err;
+  EXPECT_EQ(LOAD_NOT_FOUND,
+            ManifestCache::Load(kCachePath, &state, &disk_, &err));
+  EXPECT_EQ("", err);
+}
+
+TEST_F(ManifestCacheTest, StaleAfterManifestChange) {
+  disk_.WriteFile("build.ninja",
+                  "rule cat\n"
+                  "  command = cat $in > $out\n"
+                  "build out1: cat in1\n");
+
+  State state;
+  std::string err;
+  ASSERT_TRUE(ParseAndSave(&state, &err));
+  ASSERT_EQ("", err);
+
+  // Any change to a recorded manifest file must invalidate the snapshot.
+  disk_.WriteFile("build.ninja",
+                  "rule cat\n"
+                  "  command = cat $in > $out\n"
+                  "build out2: cat in1\n");
+
+  State cached;
+  EXPECT_EQ(LOAD_NOT_FOUND,
+            ManifestCache::Load(kCachePath, &cached, &disk_, &err));
+  EXPECT_EQ("", err);
+}
+
+TEST_F(ManifestCacheTest, IncrementalSubninjaReparse) {
+  disk_.WriteFile("build.ninja",
+                  "rule cat\n"
+                  "  command = cat $in > $out\n"
+                  "build out1: cat in1\n"
+                  "subninja sub.ninja\n");
+  disk_.WriteFile("sub.ninja",
+                  "build out2: cat in2\n");
+
+  State state;
+  std::string err;
+  ASSERT_TRUE(ParseAndSave(&state, &err));
+  ASSERT_EQ("", err);
+
+  // Touching only the subninja must not invalidate the whole snapshot;
+  // just that scope is reparsed.
+  disk_.WriteFile("sub.ninja",
+                  "build out3: cat in2\n");
+
+  State cached;
+  bool reparsed = false;
+  ASSERT_EQ(LOAD_SUCCESS, ManifestCache::Load(kCachePath, &cached, &disk_,
+                                              &err, &reparsed));
+  ASSERT_EQ("", err);
+  EXPECT_TRUE(reparsed);
+  VerifyGraph(cached);
+
+  ASSERT_EQ(2u, cached.edges_.size());
+  Node* out1 = cached.LookupNode("out1");
+  ASSERT_TRUE(out1);
+  EXPECT_TRUE(out1->in_edge());
+  Node* out3 = cached.LookupNode("out3");
+  ASSERT_TRUE(out3);
+  ASSERT_TRUE(out3->in_edge());
+  EXPECT_EQ("cat in2 > out3", out3->in_edge()->EvaluateCommand());
+  Node* out2 = cached.LookupNode("out2");
+  ASSERT_TRUE(out2);
+  EXPECT_FALSE(out2->in_edge());
+
+  // The rewritten cache must be loadable and fresh again.
+  ASSERT_TRUE(ManifestCache::Save(kCachePath, &cached, &disk_, &err));
+  State cached2;
+  reparsed = false;
+  ASSERT_EQ(LOAD_SUCCESS, ManifestCache::Load(kCachePath, &cached2, &disk_,
+                                              &err, &reparsed));
+  EXPECT_FALSE(reparsed);
+  ASSERT_EQ(2u, cached2.edges_.size());
+}
+
+TEST_F(ManifestCacheTest, IncludeChangeIsNotIncremental) {
+  disk_.WriteFile("build.ninja",
+                  "include rules.ninja\n"
+                  "build out1: cat in1\n");
+  disk_.WriteFile("rules.ninja",
+                  "rule cat\n"
+                  "  command = cat $in > $out\n");
+
+  State state;
+  std::string err;
+  ASSERT_TRUE(ParseAndSave(&state, &err));
+  ASSERT_EQ("", err);
+
+  // Bindings from an included file leak into the including scope, so a
+  // changed include invalidates the whole snapshot.
+  disk_.WriteFile("rules.ninja",
+                  "rule cat\n"
+                  "  command = cat $in > $out 2> /dev/null\n");
+
+  State cached;
+  EXPECT_EQ(LOAD_NOT_FOUND,
+            ManifestCache::Load(kCachePath, &cached, &disk_, &err));
+  EXPECT_EQ("", err);
+}
+
+TEST_F(ManifestCacheTest, CorruptCache) {
+  disk_.WriteFile("build.ninja",
+                  "rule cat\n"
+                  "  command = cat $in > $out\n"
+                  "build out1: cat in1\n");
+
+  State state;
+  std::string err;
+  ASSERT_TRUE(ParseAndSave(&state, &err));
+  ASSERT_EQ("", err);
+
+  disk_.WriteFile(kCachePath, "garbage");
+
+  State cached;
+  EXPECT_EQ(LOAD_ERROR,
+            ManifestCache::Load(kCachePath, &cached, &disk_, &err));
+  EXPECT_NE("", err);
+}
+
+}  // anonymous namespace
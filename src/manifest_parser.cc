@@ -20,6 +20,7 @@
 #include <algorithm>
 
 #include "graph.h"
+#include "manifest_prelex.h"
 #include "state.h"
 #include "util.h"
 #include "version.h"
@@ -34,10 +35,18 @@ ManifestParser::ManifestParser(State* state, FileReader* file_reader,
   env_ = &state->bindings_;
 }
 
-bool ManifestParser::Parse(const std::string& filename, const std::string& input,
+ManifestParser::~ManifestParser() = default;
+
+bool ManifestParser::Parse(const std::string& filename, std::string_view input,
                            std::string* err) {
+  if (options_.subninja_threads_ > 1 || prefetcher_ != nullptr)
+    return ParseParallel(filename, input, err);
+
   lexer_.Start(filename, input);
 
+  if (file_index_ >= 0)
+    state_->manifest_files_[file_index_].env = env_;
+
   for (;;) {
     Lexer::Token token = lexer_.ReadToken();
     switch (token) {
@@ -95,6 +104,18 @@ bool ManifestParser::Parse(const std::string& filename, const std::string& input
 }
 
 
+bool ManifestParser::LoadSubninja(const std::string& path,
+                                  BindingEnv* parent_env, int32_t parent_file,
+                                  std::string* err) {
+  env_ = new BindingEnv(parent_env);
+  if (!Load(path, err))
+    return false;
+  State::ManifestFile& file = state_->manifest_files_[file_index_];
+  file.parent = parent_file;
+  file.subninja = true;
+  return true;
+}
+
 bool ManifestParser::ParsePool(std::string* err) {
   std::string name;
   if (!lexer_.ReadIdent(&name))
@@ -127,7 +148,9 @@ bool ManifestParser::ParsePool(std::string* err) {
   if (depth < 0)
     return lexer_.Error("expected 'depth =' line", err);
 
-  state_->AddPool(new Pool(name, depth));
+  Pool* pool = new Pool(name, depth);
+  pool->set_origin_file(file_index_);
+  state_->AddPool(pool);
   return true;
 }
 
@@ -196,7 +219,7 @@ bool ManifestParser::ParseDefault(std::string* err) {
     uint64_t slash_bits;  // Unused because this only does lookup.
     if (!CanonicalizePath(&path, &slash_bits, &path_err))
       return lexer_.Error(path_err, err);
-    if (!state_->AddDefault(path, &path_err))
+    if (!state_->AddDefault(path, &path_err, file_index_))
       return lexer_.Error(path_err, err);
 
     eval.Clear();
@@ -210,6 +233,50 @@ bool ManifestParser::ParseDefault(std::string* err) {
   return true;
 }
 
+bool ManifestParser::EdgeRestatesExisting(Edge* edge, const Edge* existing,
+                                          const std::vector<Node*>& outs,
+                                          int implicit_outs,
+                                          const std::vector<EvalString>& ins,
+                                          int implicit, int order_only,
+                                          BindingEnv* env) {
+  if (edge->rule_ != existing->rule_ || edge->pool_ != existing->pool_)
+    return false;
+  if (outs.size() != existing->outputs_.size() ||
+      implicit_outs != existing->implicit_outs_)
+    return false;
+  for (size_t i = 0; i < outs.size(); ++i) {
+    if (outs[i] != existing->outputs_[i])
+      return false;
+  }
+  if (ins.size() != existing->inputs_.size() ||
+      implicit != existing->implicit_deps_ ||
+      order_only != existing->order_only_deps_)
+    return false;
+  for (size_t i = 0; i < ins.size(); ++i) {
+    std::string path = ins[i].Evaluate(env);
+    std::string path_err;
+    uint64_t slash_bits;
+    if (!CanonicalizePath(&path, &slash_bits, &path_err))
+      return false;
+    if (path != existing->inputs_[i]->path())
+      return false;
+  }
+  // The commands must match too.  The declared outputs and inputs
+  // evaluate to the same paths as the existing edge's, so borrowing its
+  // node lists expands $in and $out exactly as this statement's own
+  // would have.
+  edge->outputs_ = existing->outputs_;
+  edge->inputs_ = existing->inputs_;
+  edge->implicit_outs_ = existing->implicit_outs_;
+  edge->implicit_deps_ = existing->implicit_deps_;
+  edge->order_only_deps_ = existing->order_only_deps_;
+  const bool same = edge->EvaluateCommand(/*incl_rsp_file=*/true) ==
+                    existing->EvaluateCommand(/*incl_rsp_file=*/true);
+  edge->outputs_.clear();
+  edge->inputs_.clear();
+  return same;
+}
+
 bool ManifestParser::ParseEdge(std::string* err) {
   std::vector<EvalString> ins, outs;
 
@@ -310,6 +377,7 @@ bool ManifestParser::ParseEdge(std::string* err) {
 
   Edge* edge = state_->AddEdge(rule);
   edge->env_ = env;
+  edge->origin_file_ = file_index_;
 
   std::string pool_name = edge->GetBinding("pool");
   if (!pool_name.empty()) {
@@ -319,6 +387,8 @@ bool ManifestParser::ParseEdge(std::string* err) {
     edge->pool_ = pool;
   }
 
+  const int declared_implicit_outs = implicit_outs;
+  std::vector<Node*> dupe_outs;
   edge->outputs_.reserve(outs.size());
   for (size_t i = 0, e = outs.size(); i != e; ++i) {
     std::string path = outs[i].Evaluate(env);
@@ -327,7 +397,13 @@ bool ManifestParser::ParseEdge(std::string* err) {
     if (!CanonicalizePath(&path, &slash_bits, &path_err))
       return lexer_.Error(path_err, err);
     if (!state_->AddOut(edge, path, slash_bits)) {
-      if (options_.dupe_edge_action_ == kDupeEdgeActionError) {
+      if (options_.dedup_edges_) {
+        // Defer the diagnostics: if the whole statement turns out to
+        // restate one existing edge, it is dropped silently below.
+        dupe_outs.push_back(state_->GetNode(path, slash_bits));
+        if (e - i <= static_cast<size_t>(implicit_outs))
+          --implicit_outs;
+      } else if (options_.dupe_edge_action_ == kDupeEdgeActionError) {
         lexer_.Error(string_concat("multiple rules generate ", path, " [-w dupbuild=err]"),
                      err);
         return false;
@@ -343,11 +419,38 @@ bool ManifestParser::ParseEdge(std::string* err) {
       }
     }
   }
+  if (!dupe_outs.empty()) {
+    const Edge* existing = dupe_outs.front()->in_edge();
+    bool restates = edge->outputs_.empty();
+    for (const Node* out : dupe_outs)
+      restates = restates && out->in_edge() == existing;
+    if (restates &&
+        EdgeRestatesExisting(edge, existing, dupe_outs, declared_implicit_outs,
+                             ins, implicit, order_only, env)) {
+      state_->edges_.pop_back();
+      return true;
+    }
+    // Not a pure restatement; diagnose as without --dedup-edges.
+    for (const Node* out : dupe_outs) {
+      if (options_.dupe_edge_action_ == kDupeEdgeActionError) {
+        return lexer_.Error(string_concat("multiple rules generate ",
+                                          out->path(), " [-w dupbuild=err]"),
+                            err);
+      }
+      if (!quiet_) {
+        Warning("multiple rules generate %s. "
+                "builds involving this target will not be correct; "
+                "continuing anyway [-w dupbuild=warn]",
+                out->path_cstr());
+      }
+    }
+  }
   if (edge->outputs_.empty()) {
     // All outputs of the edge are already created by other edges. Don't add
     // this edge.  Do this check before input nodes are connected to the edge.
+    // The Edge object itself stays behind in the arena; only the graph
+    // forgets about it.
     state_->edges_.pop_back();
-    delete edge;
     return true;
   }
   edge->implicit_outs_ = implicit_outs;
@@ -374,14 +477,14 @@ bool ManifestParser::ParseEdge(std::string* err) {
     // build graph but that has since been fixed.  Filter them out to
     // support users of those old CMake versions.
     Node* out = edge->outputs_[0];
-    std::vector<Node*>::iterator new_end =
+    Edge::Nodes::iterator new_end =
         remove(edge->inputs_.begin(), edge->inputs_.end(), out);
     if (new_end != edge->inputs_.end()) {
       edge->inputs_.erase(new_end, edge->inputs_.end());
       if (!quiet_) {
         Warning("phony target '%s' names itself as an input; "
                 "ignoring [-w phonycycle=warn]",
-                out->path().c_str());
+                out->path_cstr());
       }
     }
   }
@@ -396,7 +499,7 @@ bool ManifestParser::ParseEdge(std::string* err) {
       return false;
     edge->dyndep_ = state_->GetNode(dyndep, slash_bits);
     edge->dyndep_->set_dyndep_pending(true);
-    std::vector<Node*>::iterator dgi =
+    Edge::Nodes::iterator dgi =
       std::find(edge->inputs_.begin(), edge->inputs_.end(), edge->dyndep_);
     if (dgi == edge->inputs_.end()) {
       return lexer_.Error(string_concat("dyndep '", dyndep, "' is not an input"), err);
@@ -422,8 +525,294 @@ bool ManifestParser::ParseFileInclude(bool new_scope, std::string* err) {
   if (!subparser.Load(path, err, &lexer_))
     return false;
 
+  State::ManifestFile& child = state_->manifest_files_[subparser.file_index_];
+  child.parent = file_index_;
+  child.subninja = new_scope;
+
   if (!ExpectToken(Lexer::NEWLINE, err))
     return false;
 
   return true;
 }
+
+bool ManifestParser::ParseParallel(const std::string& filename,
+                                   std::string_view input, std::string* err) {
+  // The parser of the root file owns the worker pool; subparsers share it.
+  if (prefetcher_ == nullptr) {
+    owned_prefetcher_.reset(
+        new SubninjaPrefetcher(file_reader_, options_.subninja_threads_));
+    prefetcher_ = owned_prefetcher_.get();
+  }
+
+  // Lexing the root file enqueues every literal subninja path as it is
+  // discovered, so the workers fill their buffers while we both finish
+  // lexing and start merging.
+  PrelexedFile buffer;
+  buffer.path = filename;
+  PrelexManifest(filename, input, &buffer, prefetcher_);
+
+  bool ok = ApplyPrelexed(&buffer, err);
+
+  if (owned_prefetcher_) {
+    prefetcher_ = nullptr;
+    owned_prefetcher_.reset();  // Joins the workers.
+  }
+  return ok;
+}
+
+bool ManifestParser::ApplyPrelexed(PrelexedFile* file, std::string* err) {
+  // Child buffers own their backing storage until they are merged; the root
+  // file's storage was already handed to State by Parser::Load.
+  if (file->file)
+    state_->loaded_files_.push_back(std::move(file->file));
+
+  if (file_index_ >= 0)
+    state_->manifest_files_[file_index_].env = env_;
+
+  for (PrelexedStatement& statement : file->statements) {
+    if (!ApplyStatement(&statement, err))
+      return false;
+  }
+  return true;
+}
+
+bool ManifestParser::ApplyStatement(PrelexedStatement* s, std::string* err) {
+  switch (s->kind) {
+  case PrelexedStatement::kPool: {
+    if (state_->LookupPool(s->name) != nullptr)
+      return s->pos.Error(string_concat("duplicate pool '", s->name, "'"),
+                          err);
+    std::string depth_string = s->value.Evaluate(env_);
+    int depth = atol(depth_string.c_str());
+    if (depth < 0)
+      return s->pos.Error("invalid pool depth", err);
+    Pool* pool = new Pool(s->name, depth);
+    pool->set_origin_file(file_index_);
+    state_->AddPool(pool);
+    return true;
+  }
+
+  case PrelexedStatement::kRule:
+    if (env_->LookupRuleCurrentScope(s->name) != nullptr)
+      return s->pos.Error(string_concat("duplicate rule '", s->name, "'"),
+                          err);
+    // Rules are immutable once lexed, so merging the same buffer into
+    // several scopes can share one Rule.
+    env_->AddRule(s->rule);
+    return true;
+
+  case PrelexedStatement::kLet: {
+    std::string value = s->value.Evaluate(env_);
+    // Check ninja_required_version immediately so we can exit
+    // before encountering any syntactic surprises.
+    if (s->name == "ninja_required_version")
+      CheckNinjaVersion(value);
+    env_->AddBinding(s->name, value);
+    return true;
+  }
+
+  case PrelexedStatement::kDefault:
+    for (const EvalString& eval : s->outs) {
+      std::string path = eval.Evaluate(env_);
+      std::string path_err;
+      uint64_t slash_bits;  // Unused because this only does lookup.
+      if (!CanonicalizePath(&path, &slash_bits, &path_err))
+        return s->pos.Error(path_err, err);
+      if (!state_->AddDefault(path, &path_err, file_index_))
+        return s->pos.Error(path_err, err);
+    }
+    return true;
+
+  case PrelexedStatement::kEdge:
+    return ApplyEdge(s, err);
+
+  case PrelexedStatement::kInclude:
+    return ApplyInclude(s, err);
+
+  case PrelexedStatement::kError:
+    *err = s->error;
+    return false;
+  }
+  return false;  // not reached
+}
+
+bool ManifestParser::ApplyEdge(PrelexedStatement* s, std::string* err) {
+  const Rule* rule = env_->LookupRule(s->name);
+  if (!rule)
+    return s->pos.Error(string_concat("unknown build rule '", s->name, "'"),
+                        err);
+
+  // Bindings on edges are rare, so allocate per-edge envs only when needed.
+  BindingEnv* env = s->let_bindings.empty() ? env_ : new BindingEnv(env_);
+  for (const auto& [key, value] : s->let_bindings)
+    env->AddBinding(key, value.Evaluate(env_));
+
+  Edge* edge = state_->AddEdge(rule);
+  edge->env_ = env;
+  edge->origin_file_ = file_index_;
+
+  std::string pool_name = edge->GetBinding("pool");
+  if (!pool_name.empty()) {
+    Pool* pool = state_->LookupPool(pool_name);
+    if (pool == nullptr)
+      return s->pos.Error(string_concat("unknown pool name '", pool_name, "'"),
+                          err);
+    edge->pool_ = pool;
+  }
+
+  int implicit_outs = s->implicit_outs;
+  std::vector<Node*> dupe_outs;
+  edge->outputs_.reserve(s->outs.size());
+  for (size_t i = 0, e = s->outs.size(); i != e; ++i) {
+    std::string path = s->outs[i].Evaluate(env);
+    std::string path_err;
+    uint64_t slash_bits;
+    if (!CanonicalizePath(&path, &slash_bits, &path_err))
+      return s->pos.Error(path_err, err);
+    if (!state_->AddOut(edge, path, slash_bits)) {
+      if (options_.dedup_edges_) {
+        // Defer the diagnostics: if the whole statement turns out to
+        // restate one existing edge, it is dropped silently below.
+        dupe_outs.push_back(state_->GetNode(path, slash_bits));
+        if (e - i <= static_cast<size_t>(implicit_outs))
+          --implicit_outs;
+      } else if (options_.dupe_edge_action_ == kDupeEdgeActionError) {
+        s->pos.Error(string_concat("multiple rules generate ", path,
+                                   " [-w dupbuild=err]"),
+                     err);
+        return false;
+      } else {
+        if (!quiet_) {
+          Warning("multiple rules generate %s. "
+                  "builds involving this target will not be correct; "
+                  "continuing anyway [-w dupbuild=warn]",
+                  path.c_str());
+        }
+        if (e - i <= static_cast<size_t>(implicit_outs))
+          --implicit_outs;
+      }
+    }
+  }
+  if (!dupe_outs.empty()) {
+    const Edge* existing = dupe_outs.front()->in_edge();
+    bool restates = edge->outputs_.empty();
+    for (const Node* out : dupe_outs)
+      restates = restates && out->in_edge() == existing;
+    if (restates &&
+        EdgeRestatesExisting(edge, existing, dupe_outs, s->implicit_outs,
+                             s->ins, s->implicit_deps, s->order_only_deps,
+                             env)) {
+      state_->edges_.pop_back();
+      return true;
+    }
+    // Not a pure restatement; diagnose as without --dedup-edges.
+    for (const Node* out : dupe_outs) {
+      if (options_.dupe_edge_action_ == kDupeEdgeActionError) {
+        return s->pos.Error(string_concat("multiple rules generate ",
+                                          out->path(), " [-w dupbuild=err]"),
+                            err);
+      }
+      if (!quiet_) {
+        Warning("multiple rules generate %s. "
+                "builds involving this target will not be correct; "
+                "continuing anyway [-w dupbuild=warn]",
+                out->path_cstr());
+      }
+    }
+  }
+  if (edge->outputs_.empty()) {
+    // All outputs of the edge are already created by other edges. Don't add
+    // this edge.  Do this check before input nodes are connected to the edge.
+    // The Edge object itself stays behind in the arena; only the graph
+    // forgets about it.
+    state_->edges_.pop_back();
+    return true;
+  }
+  edge->implicit_outs_ = implicit_outs;
+
+  edge->inputs_.reserve(s->ins.size());
+  for (const EvalString& item : s->ins) {
+    std::string path = item.Evaluate(env);
+    std::string path_err;
+    uint64_t slash_bits;
+    if (!CanonicalizePath(&path, &slash_bits, &path_err))
+      return s->pos.Error(path_err, err);
+    state_->AddIn(edge, path, slash_bits);
+  }
+  edge->implicit_deps_ = s->implicit_deps;
+  edge->order_only_deps_ = s->order_only_deps;
+
+  if (options_.phony_cycle_action_ == kPhonyCycleActionWarn &&
+      edge->maybe_phonycycle_diagnostic()) {
+    // CMake 2.8.12.x and 3.0.x incorrectly write phony build statements
+    // that reference themselves.  Ninja used to tolerate these in the
+    // build graph but that has since been fixed.  Filter them out to
+    // support users of those old CMake versions.
+    Node* out = edge->outputs_[0];
+    Edge::Nodes::iterator new_end =
+        remove(edge->inputs_.begin(), edge->inputs_.end(), out);
+    if (new_end != edge->inputs_.end()) {
+      edge->inputs_.erase(new_end, edge->inputs_.end());
+      if (!quiet_) {
+        Warning("phony target '%s' names itself as an input; "
+                "ignoring [-w phonycycle=warn]",
+                out->path_cstr());
+      }
+    }
+  }
+
+  // Lookup, validate, and save any dyndep binding.  It will be used later
+  // to load generated dependency information dynamically, but it must
+  // be one of our manifest-specified inputs.
+  std::string dyndep = edge->GetUnescapedDyndep();
+  if (!dyndep.empty()) {
+    uint64_t slash_bits;
+    if (!CanonicalizePath(&dyndep, &slash_bits, err))
+      return false;
+    edge->dyndep_ = state_->GetNode(dyndep, slash_bits);
+    edge->dyndep_->set_dyndep_pending(true);
+    Edge::Nodes::iterator dgi =
+      std::find(edge->inputs_.begin(), edge->inputs_.end(), edge->dyndep_);
+    if (dgi == edge->inputs_.end()) {
+      return s->pos.Error(string_concat("dyndep '", dyndep,
+                                        "' is not an input"), err);
+    }
+  }
+
+  return true;
+}
+
+bool ManifestParser::ApplyInclude(PrelexedStatement* s, std::string* err) {
+  std::string path = s->value.Evaluate(env_);
+
+  ManifestParser subparser(state_, file_reader_, options_);
+  if (s->new_scope) {
+    subparser.env_ = new BindingEnv(env_);
+  } else {
+    subparser.env_ = env_;
+  }
+  subparser.prefetcher_ = prefetcher_;
+
+  if (s->prefetched != nullptr && s->prefetched->path == path) {
+    prefetcher_->Wait(s->prefetched);
+    if (s->prefetched->load_failed) {
+      *err = string_concat("loading '", path, "': ", s->prefetched->load_error);
+      return s->pos.Error(std::string(*err), err);
+    }
+    state_->manifest_files_.push_back({ path, file_index_, s->new_scope,
+                                        nullptr });
+    subparser.file_index_ =
+        static_cast<int32_t>(state_->manifest_files_.size()) - 1;
+    return subparser.ApplyPrelexed(s->prefetched, err);
+  }
+
+  // The path contained variable references, so we could not prefetch it;
+  // fall back to loading it here.  The subparser shares our prefetcher, so
+  // any literal subninjas below it still lex in parallel.
+  if (!subparser.Load(path, err, &s->pos))
+    return false;
+  State::ManifestFile& child = state_->manifest_files_[subparser.file_index_];
+  child.parent = file_index_;
+  child.subninja = s->new_scope;
+  return true;
+}
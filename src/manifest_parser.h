@@ -15,10 +15,18 @@
 #ifndef NINJA_MANIFEST_PARSER_H_
 #define NINJA_MANIFEST_PARSER_H_
 
+#include <memory>
+#include <vector>
+
 #include "parser.h"
 
 struct BindingEnv;
+struct Edge;
 struct EvalString;
+struct Node;
+struct PrelexedFile;
+struct PrelexedStatement;
+struct SubninjaPrefetcher;
 
 enum DupeEdgeAction {
   kDupeEdgeActionWarn,
@@ -34,12 +42,27 @@ struct ManifestParserOptions final {
   ManifestParserOptions() = default;
   DupeEdgeAction dupe_edge_action_ = kDupeEdgeActionWarn;
   PhonyCycleAction phony_cycle_action_ = kPhonyCycleActionWarn;
+  /// Number of threads used to lex subninja files in parallel; 0 or 1
+  /// keeps the classic serial parse.  Statement evaluation still happens
+  /// serially in declaration order, so scoping semantics are unchanged,
+  /// but errors diagnosed during that merge phase point at the start of
+  /// the offending statement rather than the offending token.
+  int subninja_threads_ = 0;
+  /// Silently drop a build statement that exactly restates an existing
+  /// edge -- same outputs, rule, pool, inputs and command -- instead of
+  /// applying dupe_edge_action_ to its outputs.  For generators that
+  /// emit the same edge under several phony umbrellas: warn mode already
+  /// drops such statements output by output, so this suppresses the
+  /// warnings (and the dupbuild=err failure) for the provably harmless
+  /// case.
+  bool dedup_edges_ = false;
 };
 
 /// Parses .ninja files.
 struct ManifestParser final : public Parser {
   ManifestParser(State* state, FileReader* file_reader,
                  ManifestParserOptions options = ManifestParserOptions());
+  ~ManifestParser();
 
   /// Parse a text string of input.  Used by tests.
   bool ParseTest(const std::string& input, std::string* err) {
@@ -47,9 +70,18 @@ struct ManifestParser final : public Parser {
     return Parse("input", input, err);
   }
 
+  /// Reparse a single subninja file into an already-populated State, as if
+  /// its original 'subninja' statement were evaluated again: the file gets
+  /// a fresh scope below |parent_env| and its record lists |parent_file| as
+  /// the including file.  Used by ManifestCache's incremental reload; the
+  /// caller must first have discarded everything the file's previous parse
+  /// contributed.
+  bool LoadSubninja(const std::string& path, BindingEnv* parent_env,
+                    int32_t parent_file, std::string* err);
+
 private:
   /// Parse a file, given its contents as a string.
-  bool Parse(const std::string& filename, const std::string& input,
+  bool Parse(const std::string& filename, std::string_view input,
              std::string* err);
 
   /// Parse various statement types.
@@ -62,9 +94,34 @@ private:
   /// Parse either a 'subninja' or 'include' line.
   bool ParseFileInclude(bool new_scope, std::string* err);
 
+  /// Parallel parse path: lex the whole input (and, on worker threads, any
+  /// subninja files it names) before merging into State in declaration
+  /// order.  Used when options_.subninja_threads_ > 1.
+  bool ParseParallel(const std::string& filename, std::string_view input,
+                     std::string* err);
+  bool ApplyPrelexed(PrelexedFile* file, std::string* err);
+  bool ApplyStatement(PrelexedStatement* statement, std::string* err);
+  bool ApplyEdge(PrelexedStatement* statement, std::string* err);
+  bool ApplyInclude(PrelexedStatement* statement, std::string* err);
+
+  /// Whether \a edge -- all of whose declared outputs \a outs are already
+  /// produced by \a existing -- merely restates it: the same rule, pool,
+  /// outputs, inputs and command.  Such statements are dropped without
+  /// diagnostics under options_.dedup_edges_.  \a edge must not have any
+  /// inputs attached yet; \a ins is evaluated in \a env to compare.
+  bool EdgeRestatesExisting(Edge* edge, const Edge* existing,
+                            const std::vector<Node*>& outs, int implicit_outs,
+                            const std::vector<EvalString>& ins, int implicit,
+                            int order_only, BindingEnv* env);
+
   BindingEnv* env_;
   ManifestParserOptions options_;
   bool quiet_ = false;
+
+  /// Worker pool shared by this parser and its subparsers while the
+  /// parallel path is active.  Owned by the parser of the root file.
+  SubninjaPrefetcher* prefetcher_ = nullptr;
+  std::unique_ptr<SubninjaPrefetcher> owned_prefetcher_;
 };
 
 #endif  // NINJA_MANIFEST_PARSER_H_
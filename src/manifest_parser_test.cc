@@ -57,6 +57,19 @@ TEST_F(ParserTest, Rules) {
             rule->GetBinding("command")->Serialize());
 }
 
+TEST_F(ParserTest, BuiltinRuleBinding) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(
+"rule copy\n"
+"  command = cp $in $out\n"
+"  builtin = copy\n"
+"\n"
+"build out: copy in\n"));
+
+  Edge* edge = state.GetNode("out", 0)->in_edge();
+  ASSERT_TRUE(edge);
+  EXPECT_EQ("copy", edge->GetBinding("builtin"));
+}
+
 TEST_F(ParserTest, RuleAttributes) {
   // Check that all of the allowed rule attributes are parsed ok.
   ASSERT_NO_FATAL_FAILURE(AssertParse(
@@ -368,6 +381,42 @@ TEST_F(ParserTest, DuplicateEdgeWithMultipleOutputsError) {
   EXPECT_EQ("input:5: multiple rules generate out1 [-w dupbuild=err]\n", err);
 }
 
+TEST_F(ParserTest, DedupEdgesDropsExactRestatement) {
+  const char kInput[] =
+"rule gen\n"
+"  command = generate --all\n"
+"build out1 out2: gen in1 in2\n"
+"build out1 out2: gen in1 in2\n"
+"build all: phony out1\n";
+  ManifestParserOptions parser_opts;
+  parser_opts.dedup_edges_ = true;
+  // The restatement must not trip the duplicate-output error either.
+  parser_opts.dupe_edge_action_ = kDupeEdgeActionError;
+  ManifestParser parser(&state, &fs_, parser_opts);
+  std::string err;
+  EXPECT_TRUE(parser.ParseTest(kInput, &err));
+  ASSERT_EQ("", err);
+  VerifyGraph(state);
+  // The gen edge once, plus the phony.
+  EXPECT_EQ(2u, state.edges_.size());
+}
+
+TEST_F(ParserTest, DedupEdgesStillDiagnosesRealConflicts) {
+  const char kInput[] =
+"rule cat\n"
+"  command = cat $in > $out\n"
+"build out1: cat in1\n"
+"build out1: cat in2\n"
+"build final: cat out1\n";
+  ManifestParserOptions parser_opts;
+  parser_opts.dedup_edges_ = true;
+  parser_opts.dupe_edge_action_ = kDupeEdgeActionError;
+  ManifestParser parser(&state, &fs_, parser_opts);
+  std::string err;
+  EXPECT_FALSE(parser.ParseTest(kInput, &err));
+  EXPECT_EQ("input:5: multiple rules generate out1 [-w dupbuild=err]\n", err);
+}
+
 TEST_F(ParserTest, DuplicateEdgeInIncludedFile) {
   fs_.Create("sub.ninja",
     "rule cat\n"
@@ -386,6 +435,50 @@ TEST_F(ParserTest, DuplicateEdgeInIncludedFile) {
             err);
 }
 
+TEST_F(ParserTest, ParallelSubninja) {
+  fs_.Create("sub1.ninja",
+    "var = sub1\n"
+    "build out1: cat in1\n"
+    "  name = $var\n");
+  fs_.Create("sub2.ninja",
+    "var = sub2\n"
+    "build out2: cat in2\n"
+    "  name = $var\n");
+  const char kInput[] =
+    "rule cat\n"
+    "  command = cat $in > $out\n"
+    "var = outer\n"
+    "subninja sub1.ninja\n"
+    "subninja sub2.ninja\n"
+    "build out3: cat in3\n"
+    "  name = $var\n";
+  ManifestParserOptions parser_opts;
+  parser_opts.subninja_threads_ = 4;
+  ManifestParser parser(&state, &fs_, parser_opts);
+  std::string err;
+  EXPECT_TRUE(parser.ParseTest(kInput, &err));
+  ASSERT_EQ("", err);
+  VerifyGraph(state);
+
+  ASSERT_EQ(3u, state.edges_.size());
+  // Each subninja gets its own scope; the outer scope is unaffected.
+  EXPECT_EQ("sub1", state.edges_[0]->GetBinding("name"));
+  EXPECT_EQ("sub2", state.edges_[1]->GetBinding("name"));
+  EXPECT_EQ("outer", state.edges_[2]->GetBinding("name"));
+}
+
+TEST_F(ParserTest, ParallelSubninjaMissingFile) {
+  ManifestParserOptions parser_opts;
+  parser_opts.subninja_threads_ = 4;
+  ManifestParser parser(&state, &fs_, parser_opts);
+  std::string err;
+  EXPECT_FALSE(parser.ParseTest("subninja foo.ninja\n", &err));
+  EXPECT_EQ("input:1: loading 'foo.ninja': No such file or directory\n"
+            "subninja foo.ninja\n"
+            "^ near here"
+            , err);
+}
+
 TEST_F(ParserTest, PhonySelfReferenceIgnored) {
   ASSERT_NO_FATAL_FAILURE(AssertParse(
 "build a: phony a\n"
@@ -0,0 +1,384 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "manifest_prelex.h"
+
+#include <algorithm>
+
+#include "string_concat.h"
+
+using namespace std;
+
+namespace {
+
+/// Counterpart of Parser::ExpectToken for a free-standing lexer.
+bool ExpectToken(Lexer* lexer, Lexer::Token expected, std::string* err) {
+  Lexer::Token token = lexer->ReadToken();
+  if (token != expected) {
+    std::string message = string_concat("expected ", Lexer::TokenName(expected),
+                                        ", got ", Lexer::TokenName(token),
+                                        Lexer::TokenErrorHint(expected));
+    return lexer->Error(std::move(message), err);
+  }
+  return true;
+}
+
+bool PrelexLet(Lexer* lexer, std::string* key, EvalString* value,
+               std::string* err) {
+  if (!lexer->ReadIdent(key))
+    return lexer->Error("expected variable name", err);
+  if (!ExpectToken(lexer, Lexer::EQUALS, err))
+    return false;
+  if (!lexer->ReadVarValue(value, err))
+    return false;
+  return true;
+}
+
+bool PrelexPool(Lexer* lexer, PrelexedStatement* s, std::string* err) {
+  s->kind = PrelexedStatement::kPool;
+  if (!lexer->ReadIdent(&s->name))
+    return lexer->Error("expected pool name", err);
+
+  if (!ExpectToken(lexer, Lexer::NEWLINE, err))
+    return false;
+
+  bool have_depth = false;
+  while (lexer->PeekToken(Lexer::INDENT)) {
+    std::string key;
+    EvalString value;
+    if (!PrelexLet(lexer, &key, &value, err))
+      return false;
+
+    if (key == "depth") {
+      s->value = std::move(value);
+      have_depth = true;
+    } else {
+      return lexer->Error(string_concat("unexpected variable '", key, "'"),
+                          err);
+    }
+  }
+
+  if (!have_depth)
+    return lexer->Error("expected 'depth =' line", err);
+
+  return true;
+}
+
+bool PrelexRule(Lexer* lexer, PrelexedStatement* s, std::string* err) {
+  s->kind = PrelexedStatement::kRule;
+  if (!lexer->ReadIdent(&s->name))
+    return lexer->Error("expected rule name", err);
+
+  if (!ExpectToken(lexer, Lexer::NEWLINE, err))
+    return false;
+
+  Rule* rule = new Rule(s->name);  // XXX scoped_ptr
+  s->rule = rule;
+
+  while (lexer->PeekToken(Lexer::INDENT)) {
+    std::string key;
+    EvalString value;
+    if (!PrelexLet(lexer, &key, &value, err))
+      return false;
+
+    if (Rule::IsReservedBinding(key)) {
+      rule->AddBinding(key, value);
+    } else {
+      // Die on other keyvals for now; revisit if we want to add a
+      // scope here.
+      return lexer->Error(string_concat("unexpected variable '", key, "'"),
+                          err);
+    }
+  }
+
+  const EvalString* rspfile = rule->GetBinding("rspfile");
+  const EvalString* rspfile_content = rule->GetBinding("rspfile_content");
+  if ((rspfile == nullptr || rspfile->empty()) !=
+      (rspfile_content == nullptr || rspfile_content->empty())) {
+    return lexer->Error("rspfile and rspfile_content need to be "
+                        "both specified", err);
+  }
+
+  const EvalString* command = rule->GetBinding("command");
+  if (command == nullptr || command->empty())
+    return lexer->Error("expected 'command =' line", err);
+
+  return true;
+}
+
+bool PrelexDefault(Lexer* lexer, PrelexedStatement* s, std::string* err) {
+  s->kind = PrelexedStatement::kDefault;
+  EvalString eval;
+  if (!lexer->ReadPath(&eval, err))
+    return false;
+  if (eval.empty())
+    return lexer->Error("expected target name", err);
+
+  do {
+    s->outs.push_back(std::move(eval));
+    eval.Clear();
+    if (!lexer->ReadPath(&eval, err))
+      return false;
+  } while (!eval.empty());
+
+  return ExpectToken(lexer, Lexer::NEWLINE, err);
+}
+
+bool PrelexEdge(Lexer* lexer, PrelexedStatement* s, std::string* err) {
+  s->kind = PrelexedStatement::kEdge;
+
+  {
+    EvalString out;
+    if (!lexer->ReadPath(&out, err))
+      return false;
+    while (!out.empty()) {
+      s->outs.push_back(std::move(out));
+      out.Clear();
+      if (!lexer->ReadPath(&out, err))
+        return false;
+    }
+  }
+
+  if (lexer->PeekToken(Lexer::PIPE)) {
+    for (;;) {
+      EvalString out;
+      if (!lexer->ReadPath(&out, err))
+        return false;
+      if (out.empty())
+        break;
+      s->outs.push_back(std::move(out));
+      ++s->implicit_outs;
+    }
+  }
+
+  if (s->outs.empty())
+    return lexer->Error("expected path", err);
+
+  if (!ExpectToken(lexer, Lexer::COLON, err))
+    return false;
+
+  if (!lexer->ReadIdent(&s->name))
+    return lexer->Error("expected build command name", err);
+
+  for (;;) {
+    // XXX should we require one path here?
+    EvalString in;
+    if (!lexer->ReadPath(&in, err))
+      return false;
+    if (in.empty())
+      break;
+    s->ins.push_back(std::move(in));
+  }
+
+  if (lexer->PeekToken(Lexer::PIPE)) {
+    for (;;) {
+      EvalString in;
+      if (!lexer->ReadPath(&in, err))
+        return false;
+      if (in.empty())
+        break;
+      s->ins.push_back(std::move(in));
+      ++s->implicit_deps;
+    }
+  }
+
+  if (lexer->PeekToken(Lexer::PIPE2)) {
+    for (;;) {
+      EvalString in;
+      if (!lexer->ReadPath(&in, err))
+        return false;
+      if (in.empty())
+        break;
+      s->ins.push_back(std::move(in));
+      ++s->order_only_deps;
+    }
+  }
+
+  if (!ExpectToken(lexer, Lexer::NEWLINE, err))
+    return false;
+
+  while (lexer->PeekToken(Lexer::INDENT)) {
+    std::string key;
+    EvalString value;
+    if (!PrelexLet(lexer, &key, &value, err))
+      return false;
+    s->let_bindings.emplace_back(std::move(key), std::move(value));
+  }
+
+  return true;
+}
+
+bool PrelexInclude(Lexer* lexer, bool new_scope, PrelexedStatement* s,
+                   SubninjaPrefetcher* prefetcher, std::string* err) {
+  s->kind = PrelexedStatement::kInclude;
+  s->new_scope = new_scope;
+  if (!lexer->ReadPath(&s->value, err))
+    return false;
+  if (!ExpectToken(lexer, Lexer::NEWLINE, err))
+    return false;
+
+  // If the path needs no variable expansion we already know what file it
+  // names, so its loading and lexing can start right away.
+  if (prefetcher && s->value.IsLiteral())
+    s->prefetched = prefetcher->Enqueue(s->value.Evaluate(nullptr));
+
+  return true;
+}
+
+}  // anonymous namespace
+
+void PrelexManifest(std::string_view filename, std::string_view input,
+                    PrelexedFile* out, SubninjaPrefetcher* prefetcher) {
+  Lexer lexer;
+  lexer.Start(filename, input);
+
+  for (;;) {
+    Lexer::Token token = lexer.ReadToken();
+
+    PrelexedStatement statement;
+    statement.pos = lexer;
+
+    std::string err;
+    bool ok = true;
+    switch (token) {
+    case Lexer::POOL:
+      ok = PrelexPool(&lexer, &statement, &err);
+      break;
+    case Lexer::BUILD:
+      ok = PrelexEdge(&lexer, &statement, &err);
+      break;
+    case Lexer::RULE:
+      ok = PrelexRule(&lexer, &statement, &err);
+      break;
+    case Lexer::DEFAULT:
+      ok = PrelexDefault(&lexer, &statement, &err);
+      break;
+    case Lexer::IDENT:
+      lexer.UnreadToken();
+      statement.kind = PrelexedStatement::kLet;
+      ok = PrelexLet(&lexer, &statement.name, &statement.value, &err);
+      break;
+    case Lexer::INCLUDE:
+      ok = PrelexInclude(&lexer, false, &statement, prefetcher, &err);
+      break;
+    case Lexer::SUBNINJA:
+      ok = PrelexInclude(&lexer, true, &statement, prefetcher, &err);
+      break;
+    case Lexer::ERROR:
+      ok = lexer.Error(lexer.DescribeLastError(), &err);
+      break;
+    case Lexer::TEOF:
+      return;
+    case Lexer::NEWLINE:
+      continue;
+    default:
+      ok = lexer.Error(string_concat("unexpected ", Lexer::TokenName(token)),
+                       &err);
+      break;
+    }
+
+    if (!ok) {
+      statement.kind = PrelexedStatement::kError;
+      statement.error = std::move(err);
+      out->statements.push_back(std::move(statement));
+      return;
+    }
+    out->statements.push_back(std::move(statement));
+  }
+}
+
+SubninjaPrefetcher::SubninjaPrefetcher(FileReader* file_reader, int threads)
+    : file_reader_(file_reader) {
+  // -j is effectively unbounded when given 0; cap the pool at the hardware.
+  int hardware = static_cast<int>(std::thread::hardware_concurrency());
+  if (hardware < 1)
+    hardware = 1;
+  threads = std::min(threads, hardware);
+
+  threads_.reserve(threads);
+  for (int i = 0; i < threads; ++i)
+    threads_.emplace_back([this]() { ThreadLoop(); });
+}
+
+SubninjaPrefetcher::~SubninjaPrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  work_cv_.notify_all();
+  for (std::thread& thread : threads_)
+    thread.join();
+}
+
+PrelexedFile* SubninjaPrefetcher::Enqueue(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<PrelexedFile>& slot = files_[path];
+  if (slot)
+    return slot.get();
+  slot.reset(new PrelexedFile);
+  slot->path = path;
+  queue_.push_back(slot.get());
+  work_cv_.notify_one();
+  return slot.get();
+}
+
+void SubninjaPrefetcher::Wait(PrelexedFile* file) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!file->done) {
+    // Contribute instead of blocking if there is still queued work; the
+    // file we need may not have been picked up by any worker yet.
+    if (!queue_.empty()) {
+      PrelexedFile* next = queue_.front();
+      queue_.pop_front();
+      lock.unlock();
+      ProcessFile(next);
+      lock.lock();
+      next->done = true;
+      done_cv_.notify_all();
+      continue;
+    }
+    done_cv_.wait(lock);
+  }
+}
+
+void SubninjaPrefetcher::ThreadLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    work_cv_.wait(lock, [this]() { return shutdown_ || !queue_.empty(); });
+    if (queue_.empty())
+      return;  // Shut down once the queue has drained.
+    PrelexedFile* file = queue_.front();
+    queue_.pop_front();
+    lock.unlock();
+    ProcessFile(file);
+    lock.lock();
+    file->done = true;
+    done_cv_.notify_all();
+  }
+}
+
+void SubninjaPrefetcher::ProcessFile(PrelexedFile* file) {
+  std::string err;
+  FileReader::Status status;
+  {
+    std::lock_guard<std::mutex> lock(load_mutex_);
+    status = file_reader_->LoadFile(file->path, &file->file, &err);
+  }
+  if (status != FileReader::Okay) {
+    file->load_failed = true;
+    file->load_error = std::move(err);
+    return;
+  }
+  PrelexManifest(file->path, file->file->content(), file, this);
+}
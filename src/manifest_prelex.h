@@ -0,0 +1,146 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_MANIFEST_PRELEX_H_
+#define NINJA_MANIFEST_PRELEX_H_
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "disk_interface.h"
+#include "eval_env.h"
+#include "lexer.h"
+
+struct SubninjaPrefetcher;
+
+/// A single manifest statement lexed into unevaluated form.  Lexing a
+/// statement requires no variable environment and no access to State, so it
+/// can run on a worker thread; evaluation of the stored EvalStrings happens
+/// later on the main thread, in declaration order, which preserves the
+/// scoped BindingEnv semantics of a serial parse.
+struct PrelexedStatement {
+  enum Kind {
+    kPool,
+    kRule,
+    kLet,
+    kDefault,
+    kEdge,
+    kInclude,
+    kError,
+  };
+  Kind kind;
+
+  /// Lexer snapshot taken at the start of the statement, used to attach
+  /// file/line context to errors diagnosed during the merge phase.
+  Lexer pos;
+
+  /// kPool: pool name.  kRule: rule name.  kLet: variable name.
+  /// kEdge: rule name.
+  std::string name;
+
+  /// kPool: depth.  kLet: value.  kInclude: included path.
+  EvalString value;
+
+  /// kRule: the fully lexed rule; its bindings are unevaluated EvalStrings.
+  Rule* rule = nullptr;
+
+  /// kEdge: outputs.  kDefault: target paths.
+  std::vector<EvalString> outs;
+  /// kEdge: explicit, implicit and order-only inputs, in that order.
+  std::vector<EvalString> ins;
+  int implicit_outs = 0;
+  int implicit_deps = 0;
+  int order_only_deps = 0;
+  /// kEdge: indented key = value bindings following the build line.
+  std::vector<std::pair<std::string, EvalString>> let_bindings;
+
+  /// kInclude: true for subninja (which introduces a new scope).
+  bool new_scope = false;
+  /// kInclude: the included file, already enqueued for prelexing, if the
+  /// path was a literal.  Null if the path contains variable references.
+  struct PrelexedFile* prefetched = nullptr;
+
+  /// kError: the fully formatted error message from the lexer.
+  std::string error;
+};
+
+/// The result of loading and lexing one manifest file, before any of it has
+/// been evaluated or merged into State.
+struct PrelexedFile {
+  std::string path;
+
+  /// Backing storage for the statements' string_views; moved into
+  /// State::loaded_files_ when the file is merged.
+  std::unique_ptr<LoadedFile> file;
+
+  std::vector<PrelexedStatement> statements;
+
+  /// Set if reading the file itself failed; statements is then empty.
+  bool load_failed = false;
+  std::string load_error;
+
+  /// Guarded by the owning SubninjaPrefetcher's mutex.
+  bool done = false;
+};
+
+/// A pool of worker threads that load and lex subninja files ahead of the
+/// serial merge into State.  Files are deduplicated by path, so a file
+/// included twice is lexed once and merged twice.
+struct SubninjaPrefetcher {
+  SubninjaPrefetcher(FileReader* file_reader, int threads);
+  ~SubninjaPrefetcher();
+
+  /// Schedule \a path for loading and lexing, returning its (possibly
+  /// already existing) buffer.  Safe to call from worker threads.
+  PrelexedFile* Enqueue(const std::string& path);
+
+  /// Block until \a file has finished loading and lexing.
+  void Wait(PrelexedFile* file);
+
+ private:
+  void ThreadLoop();
+  void ProcessFile(PrelexedFile* file);
+
+  FileReader* file_reader_;
+
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  std::map<std::string, std::unique_ptr<PrelexedFile>> files_;
+  std::deque<PrelexedFile*> queue_;
+  bool shutdown_ = false;
+
+  /// FileReader implementations are not required to tolerate concurrent
+  /// calls, so reads are serialized; only the lexing runs in parallel.
+  std::mutex load_mutex_;
+
+  std::vector<std::thread> threads_;
+};
+
+/// Lex \a input into \a out.  On a lex error the statement list ends with a
+/// kError statement carrying the formatted message.  If \a prefetcher is
+/// non-null, literal include/subninja paths are enqueued on it as they are
+/// discovered.
+void PrelexManifest(std::string_view filename, std::string_view input,
+                    PrelexedFile* out, SubninjaPrefetcher* prefetcher);
+
+#endif  // NINJA_MANIFEST_PRELEX_H_
@@ -0,0 +1,79 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mem_advice.h"
+
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifndef _WIN32
+size_t PageSize() {
+  static size_t pagesize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return pagesize;
+}
+
+/// Shrink [data, data+size) to the whole pages it contains; madvise
+/// rejects unaligned addresses.  Returns false if no whole page is left.
+bool TrimToPages(const void* data, size_t size, void** start, size_t* len) {
+  uintptr_t begin = reinterpret_cast<uintptr_t>(data);
+  uintptr_t end = begin + size;
+  begin = (begin + PageSize() - 1) & ~(PageSize() - 1);
+  end &= ~(PageSize() - 1);
+  if (begin >= end)
+    return false;
+  *start = reinterpret_cast<void*>(begin);
+  *len = end - begin;
+  return true;
+}
+#endif  // !_WIN32
+
+}  // anonymous namespace
+
+void AdviseHugePages(const void* data, size_t size) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  void* start;
+  size_t len;
+  if (TrimToPages(data, size, &start, &len))
+    madvise(start, len, MADV_HUGEPAGE);  // Advisory; failure is fine.
+#else
+  (void)data;
+  (void)size;
+#endif
+}
+
+void PrefaultMapping(const void* data, size_t size) {
+#ifndef _WIN32
+  void* start;
+  size_t len;
+  if (!TrimToPages(data, size, &start, &len))
+    return;
+  madvise(start, len, MADV_WILLNEED);
+  // The touch pass waits for the readahead, so callers see a warm
+  // mapping rather than a queue of in-flight faults.
+  volatile const char* p = static_cast<const char*>(start);
+  size_t checksum = 0;
+  for (size_t offset = 0; offset < len; offset += PageSize())
+    checksum += p[offset];
+  (void)checksum;
+#else
+  (void)data;
+  (void)size;
+#endif
+}
@@ -0,0 +1,38 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_MEM_ADVICE_H_
+#define NINJA_MEM_ADVICE_H_
+
+#include <stddef.h>
+
+/// Ask the kernel to back [data, data+size) with transparent huge
+/// pages (Linux MADV_HUGEPAGE).  The range is trimmed inward to page
+/// boundaries, and the call is a no-op on other platforms, on kernels
+/// without THP, and on file mappings where the kernel declines.  The
+/// graph arenas advise their chunks this way: a multi-million node
+/// graph then occupies thousands of dTLB entries instead of hundreds
+/// of thousands, which RecomputeDirty profiles show as the next wall
+/// after allocation itself.
+void AdviseHugePages(const void* data, size_t size);
+
+/// Fault every page of [data, data+size) in now: readahead is kicked
+/// off for the whole range (MADV_WILLNEED) and each page is touched
+/// synchronously.  For a file-backed mapping on a cold or NFS-backed
+/// page cache this replaces one round trip per 4kB page during the
+/// first scan with a single streaming read up front.  Keyed by
+/// `-d prefault`; see g_prefault in debug_flags.h.
+void PrefaultMapping(const void* data, size_t size);
+
+#endif  // NINJA_MEM_ADVICE_H_
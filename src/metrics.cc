@@ -20,12 +20,24 @@
 
 #ifndef _WIN32
 #include <sys/time.h>
+#include <unistd.h>
 #else
 #define NOMINMAX
 #include <windows.h>
 #endif
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
 #include <algorithm>
+#include <mutex>
+#include <vector>
 
 #include "util.h"
 
@@ -73,6 +85,129 @@ int64_t TimerToMicros(int64_t dt) {
 }
 #endif
 
+/// Raw timestamp source for ScopedMetric.  Where the hardware exposes a
+/// constant-rate cycle counter we read it directly -- a fraction of the cost
+/// of a gettimeofday/QueryPerformanceCounter call, which matters for probes
+/// on hot paths like node lookup -- and convert ticks to microseconds once,
+/// in Sync().
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#define NINJA_METRICS_RAW_TSC
+inline int64_t MetricTicks() {
+  return (int64_t)__rdtsc();
+}
+#elif defined(__aarch64__)
+#define NINJA_METRICS_RAW_TSC
+inline int64_t MetricTicks() {
+  uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return (int64_t)ticks;
+}
+#else
+inline int64_t MetricTicks() {
+  return HighResTimer();
+}
+#endif
+
+#ifdef NINJA_METRICS_RAW_TSC
+/// Wall-clock/tick anchor captured at startup; the tick rate is derived at
+/// Sync() time from how far both have advanced since.
+struct TickAnchor {
+  TickAnchor() : base_ticks(MetricTicks()), base_micros(HighResTimer()) {}
+  int64_t base_ticks;
+  int64_t base_micros;
+};
+TickAnchor g_tick_anchor;
+
+double TicksPerMicro() {
+  static double ticks_per_micro = 0.0;
+  if (ticks_per_micro != 0.0)
+    return ticks_per_micro;
+  // The longer the window since startup, the better the estimate; pad out
+  // unrealistically short ones (e.g. a report after an immediate error).
+  int64_t elapsed = TimerToMicros(HighResTimer() - g_tick_anchor.base_micros);
+  while (elapsed < 10 * 1000) {
+#ifndef _WIN32
+    usleep(10 * 1000);
+#else
+    Sleep(10);
+#endif
+    elapsed = TimerToMicros(HighResTimer() - g_tick_anchor.base_micros);
+  }
+  ticks_per_micro =
+      (double)(MetricTicks() - g_tick_anchor.base_ticks) / (double)elapsed;
+  return ticks_per_micro;
+}
+
+int64_t MetricTicksToMicros(int64_t ticks) {
+  return (int64_t)((double)ticks / TicksPerMicro());
+}
+#else
+int64_t MetricTicksToMicros(int64_t ticks) {
+  return TimerToMicros(ticks);
+}
+#endif
+
+/// One metric's counters within a single thread's arena.
+struct MetricSlot {
+  int count = 0;
+  int64_t ticks = 0;
+};
+
+struct ThreadArena;
+
+/// All live arenas plus the folded-in counters of exited threads.
+/// Leaked via NeverDestroyed-style accessor so thread-exit flushes stay
+/// safe regardless of static destruction order.
+struct ArenaRegistry {
+  std::mutex mutex;
+  std::vector<ThreadArena*> arenas;
+  std::vector<MetricSlot> retired;
+};
+
+ArenaRegistry& Registry() {
+  static ArenaRegistry* registry = new ArenaRegistry;
+  return *registry;
+}
+
+/// Per-thread counter storage, indexed by Metric::id.  Registered with the
+/// registry on first use; on thread exit the counters are folded into the
+/// retired totals so short-lived worker threads are not lost.
+struct ThreadArena {
+  ~ThreadArena() {
+    ArenaRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (registry.retired.size() < slots.size())
+      registry.retired.resize(slots.size());
+    for (size_t i = 0; i < slots.size(); ++i) {
+      registry.retired[i].count += slots[i].count;
+      registry.retired[i].ticks += slots[i].ticks;
+    }
+    registry.arenas.erase(
+        std::find(registry.arenas.begin(), registry.arenas.end(), this));
+  }
+
+  MetricSlot* Slot(int id) {
+    if ((size_t)id >= slots.size()) {
+      // Growth reallocates the slot array, which Sync() may be walking;
+      // registered per-slot increments stay unlocked, growth does not.
+      ArenaRegistry& registry = Registry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      if (!registered) {
+        registry.arenas.push_back(this);
+        registered = true;
+      }
+      slots.resize(id + 1);
+    }
+    return &slots[id];
+  }
+
+  std::vector<MetricSlot> slots;
+  bool registered = false;
+};
+
+thread_local ThreadArena t_arena;
+
 }  // anonymous namespace
 
 
@@ -80,26 +215,51 @@ ScopedMetric::ScopedMetric(Metric* metric) {
   metric_ = metric;
   if (!metric_)
     return;
-  start_ = HighResTimer();
+  start_ = MetricTicks();
 }
 ScopedMetric::~ScopedMetric() {
   if (!metric_)
     return;
-  metric_->count++;
-  int64_t dt = TimerToMicros(HighResTimer() - start_);
-  metric_->sum += dt;
+  MetricSlot* slot = t_arena.Slot(metric_->id);
+  slot->count++;
+  slot->ticks += MetricTicks() - start_;
 }
 
 Metric* Metrics::NewMetric(const std::string& name) {
   Metric* metric = new Metric;
   metric->name = name;
+  metric->id = (int)metrics_.size();
   metric->count = 0;
   metric->sum = 0;
   metrics_.push_back(metric);
   return metric;
 }
 
+void Metrics::Sync() {
+  ArenaRegistry& registry = Registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (Metric* metric : metrics_) {
+    size_t id = (size_t)metric->id;
+    int count = 0;
+    int64_t ticks = 0;
+    if (id < registry.retired.size()) {
+      count += registry.retired[id].count;
+      ticks += registry.retired[id].ticks;
+    }
+    for (const ThreadArena* arena : registry.arenas) {
+      if (id < arena->slots.size()) {
+        count += arena->slots[id].count;
+        ticks += arena->slots[id].ticks;
+      }
+    }
+    metric->count = count;
+    metric->sum = MetricTicksToMicros(ticks);
+  }
+}
+
 void Metrics::Report() {
+  Sync();
+
   size_t width = 0;
   for (const auto & metric : metrics_)
   {
@@ -125,3 +285,6 @@ int64_t GetTimeMillis() {
   return TimerToMicros(HighResTimer()) / 1000;
 }
 
+int64_t GetTimeMicros() {
+  return TimerToMicros(HighResTimer());
+}
@@ -26,9 +26,13 @@
 /// A single metrics we're tracking, like "depfile load time".
 struct Metric final {
   std::string name;
-  /// Number of times we've hit the code path.
+  /// Index of this metric's slot in the per-thread arenas.
+  int id;
+  /// Number of times we've hit the code path.  Only current after
+  /// Metrics::Sync() has folded the per-thread counters in.
   int count;
-  /// Total time (in micros) we've spent on the code path.
+  /// Total time (in micros) we've spent on the code path.  As with count,
+  /// current after Metrics::Sync().
   int64_t sum;
 };
 
@@ -41,18 +45,30 @@ struct ScopedMetric final {
 
 private:
   Metric* metric_;
-  /// Timestamp when the measurement started.
-  /// Value is platform-dependent.
+  /// Raw timestamp (TSC ticks where available) when the measurement
+  /// started.  Value is platform-dependent.
   int64_t start_;
 };
 
 /// The singleton that stores metrics and prints the report.
+///
+/// Counters are accumulated in per-thread arenas — a probe is one raw
+/// timestamp read and two thread-local additions, with no shared-cacheline
+/// traffic — and folded into the Metric objects by Sync().
 struct Metrics final {
   Metric* NewMetric(const std::string& name);
 
+  /// Fold the per-thread counters into the Metric objects, converting raw
+  /// ticks to microseconds.  Idempotent; call before reading count/sum.
+  void Sync();
+
   /// Print a summary report to stdout.
   void Report();
 
+  /// All metrics recorded so far, for consumers that format their own
+  /// report (e.g. the startup benchmark's JSON output).  Sync() first.
+  const std::vector<Metric*>& metrics() const { return metrics_; }
+
 private:
   std::vector<Metric*> metrics_;
 };
@@ -61,6 +77,9 @@ private:
 /// Epoch varies between platforms; only useful for measuring elapsed time.
 int64_t GetTimeMillis();
 
+/// Same clock as GetTimeMillis(), in microseconds.
+int64_t GetTimeMicros();
+
 /// A simple stopwatch which returns the time
 /// in seconds since Restart() was called.
 struct Stopwatch final {
@@ -81,10 +100,15 @@ struct Stopwatch final {
 
 /// The primary interface to metrics.  Use METRIC_RECORD("foobar") at the top
 /// of a function to get timing stats recorded for each call of the function.
+/// Building with -DNINJA_NO_METRICS compiles every probe away entirely.
+#ifdef NINJA_NO_METRICS
+#define METRIC_RECORD(name)
+#else
 #define METRIC_RECORD(name)                                             \
   static Metric* metrics_h_metric =                                     \
       g_metrics ? g_metrics->NewMetric(name) : nullptr;                    \
   ScopedMetric metrics_h_scoped(metrics_h_metric);
+#endif
 
 extern Metrics* g_metrics;
 
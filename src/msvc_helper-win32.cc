@@ -17,6 +17,7 @@
 #define NOMINMAX
 #include <windows.h>
 
+#include "clparser.h"
 #include "util.h"
 
 using namespace std;
@@ -41,6 +42,12 @@ std::string EscapeForDepfile(const std::string& path) {
 }
 
 int CLWrapper::Run(const std::string& command, std::string* output) {
+  return RunStreamed(command, std::string(), nullptr, output, nullptr);
+}
+
+int CLWrapper::RunStreamed(const std::string& command,
+                           const std::string& deps_prefix, CLParser* parser,
+                           std::string* output, std::string* err) {
   SECURITY_ATTRIBUTES security_attributes = {};
   security_attributes.nLength = sizeof(SECURITY_ATTRIBUTES);
   security_attributes.bInheritHandle = TRUE;
@@ -80,7 +87,10 @@ int CLWrapper::Run(const std::string& command, std::string* output) {
     Win32Fatal("CloseHandle");
   }
 
-  // Read all output of the subprocess.
+  // Read all output of the subprocess.  With a parser, every complete
+  // /showIncludes line is filtered the moment it arrives, so no parsing
+  // work is left when the process exits.
+  bool parse_failed = false;
   DWORD read_len = 1;
   while (read_len) {
     char buf[64 << 10];
@@ -89,7 +99,17 @@ int CLWrapper::Run(const std::string& command, std::string* output) {
         GetLastError() != ERROR_BROKEN_PIPE) {
       Win32Fatal("ReadFile");
     }
-    output->append(buf, read_len);
+    if (!parser) {
+      output->append(buf, read_len);
+    } else if (!parse_failed &&
+               !parser->Feed(buf, read_len, deps_prefix, output, err)) {
+      // Keep draining the pipe so the process can exit normally.
+      parse_failed = true;
+    }
+  }
+  if (parser && !parse_failed &&
+      !parser->Finish(deps_prefix, output, err)) {
+    parse_failed = true;
   }
 
   // Wait for it to exit and grab its exit code.
@@ -98,6 +118,8 @@ int CLWrapper::Run(const std::string& command, std::string* output) {
   DWORD exit_code = 0;
   if (!GetExitCodeProcess(process_info.hProcess, &exit_code))
     Win32Fatal("GetExitCodeProcess");
+  if (parse_failed && exit_code == 0)
+    exit_code = 1;
 
   if (!CloseHandle(stdout_read) ||
       !CloseHandle(process_info.hProcess) ||
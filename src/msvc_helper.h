@@ -14,6 +14,8 @@
 
 #include <string>
 
+struct CLParser;
+
 std::string EscapeForDepfile(const std::string& path);
 
 /// Wraps a synchronous execution of a CL subprocess.
@@ -28,5 +30,14 @@ struct CLWrapper final {
   /// Crashes (calls Fatal()) on error.
   int Run(const std::string& command, std::string* output);
 
+  /// Like Run(), but feed the output through \a parser as it crosses the
+  /// pipe, so the dependency list is complete the moment the process
+  /// exits instead of after an output-sized reparse.  Non-deps output
+  /// accumulates in \a output.  A parse failure is reported through
+  /// \a err; the process is still drained and a failing exit code
+  /// returned.
+  int RunStreamed(const std::string& command, const std::string& deps_prefix,
+                  CLParser* parser, std::string* output, std::string* err);
+
   void* env_block_ = nullptr;
 };
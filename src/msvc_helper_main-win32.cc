@@ -36,6 +36,8 @@ void Usage() {
 "  -e ENVFILE load environment block from ENVFILE as environment\n"
 "  -o FILE    write output dependency information to FILE.d\n"
 "  -p STRING  localized prefix of msvc's /showIncludes output\n"
+"  -s         serve compiles over stdin/stdout until EOF, one command\n"
+"             line per request (persistent helper)\n"
          );
 }
 
@@ -78,11 +80,59 @@ void WriteDepFileOrDie(const char* object_path, const CLParser& parse) {
   fclose(depfile);
 }
 
+/// Persistent helper mode: serve one compile per request line on stdin,
+/// so the per-edge process creation of the one-shot wrapper is paid once
+/// per build.  The framing matches PersistentWorkerPool
+/// (persistent_worker.h): a request is the full cl.exe command line
+/// terminated by '\n', and the response is the filtered compiler output,
+/// one "<<<dep PATH" record per dependency, then a "<<<done N" trailer
+/// carrying the exit code.  The records are already filtered and
+/// normalized -- streamed out of the pipe while cl.exe was still running
+/// -- so the build can feed them straight to the deps log instead of
+/// re-parsing captured output (see Builder::ExtractDeps).
+int ServeRequests(CLWrapper* cl, const std::string& deps_prefix) {
+  // Requests and responses are byte streams; keep the C runtime from
+  // translating line endings in either direction.
+  _setmode(_fileno(stdin), _O_BINARY);
+  _setmode(_fileno(stdout), _O_BINARY);
+
+  std::string command;
+  int c;
+  while ((c = getchar()) != EOF) {
+    if (c != '\n') {
+      command.push_back((char)c);
+      continue;
+    }
+    if (!command.empty() && command.back() == '\r')
+      command.pop_back();
+
+    CLParser parser;
+    std::string output;
+    std::string err;
+    int exit_code = cl->RunStreamed(command, deps_prefix, &parser, &output,
+                                    &err);
+    if (!err.empty())
+      string_append(output, err, "\n");
+    if (!output.empty() && output.back() != '\n')
+      output.push_back('\n');
+    fwrite(output.data(), 1, output.size(), stdout);
+    if (err.empty()) {
+      for (const auto & header : parser.includes_)
+        printf("<<<dep %s\n", header.c_str());
+    }
+    printf("<<<done %d\n", exit_code);
+    fflush(stdout);
+    command.clear();
+  }
+  return 0;
+}
+
 }  // anonymous namespace
 
 int MSVCHelperMain(int argc, char** argv) {
   const char* output_filename = nullptr;
   const char* envfile = nullptr;
+  bool server = false;
 
   const option kLongOptions[] = {
     { "help", no_argument, nullptr, 'h' },
@@ -90,7 +140,7 @@ int MSVCHelperMain(int argc, char** argv) {
   };
   int opt;
   std::string deps_prefix;
-  while ((opt = getopt_long(argc, argv, "e:o:p:h", kLongOptions, nullptr)) != -1) {
+  while ((opt = getopt_long(argc, argv, "e:o:p:sh", kLongOptions, nullptr)) != -1) {
     switch (opt) {
       case 'e':
         envfile = optarg;
@@ -101,6 +151,9 @@ int MSVCHelperMain(int argc, char** argv) {
       case 'p':
         deps_prefix = optarg;
         break;
+      case 's':
+        server = true;
+        break;
       case 'h':
       default:
         Usage();
@@ -116,6 +169,13 @@ int MSVCHelperMain(int argc, char** argv) {
     PushPathIntoEnvironment(env);
   }
 
+  CLWrapper cl;
+  if (!env.empty())
+    cl.SetEnvBlock((void*)env.data());
+
+  if (server)
+    return ServeRequests(&cl, deps_prefix);
+
   char* command = GetCommandLineA();
   command = strstr(command, " -- ");
   if (!command) {
@@ -123,18 +183,19 @@ int MSVCHelperMain(int argc, char** argv) {
   }
   command += 4;
 
-  CLWrapper cl;
-  if (!env.empty())
-    cl.SetEnvBlock((void*)env.data());
   std::string output;
-  int exit_code = cl.Run(command, &output);
-
+  int exit_code;
   if (output_filename) {
+    // Stream the output through the parser while cl.exe runs; the
+    // depfile is ready to write the moment it exits.
     CLParser parser;
     std::string err;
-    if (!parser.Parse(output, deps_prefix, &output, &err))
+    exit_code = cl.RunStreamed(command, deps_prefix, &parser, &output, &err);
+    if (!err.empty())
       Fatal("%s\n", err.c_str());
     WriteDepFileOrDie(output_filename, parser);
+  } else {
+    exit_code = cl.Run(command, &output);
   }
 
   if (output.empty())
@@ -0,0 +1,139 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mtime_journal.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "disk_interface.h"
+#include "graph.h"
+#include "metrics.h"
+#include "state.h"
+
+using namespace std;
+
+namespace {
+
+const char kFileSignature[] = "# splintermtimes\n";
+const uint32_t kCurrentVersion = 1;
+
+}  // anonymous namespace
+
+bool MtimeJournal::Load(const std::string& path, State* state,
+                        DiskInterface* disk_interface, std::string* err) {
+  METRIC_RECORD("mtime journal load");
+
+  std::unique_ptr<LoadedFile> file;
+  std::string read_err;
+  switch (disk_interface->LoadFile(path, &file, &read_err)) {
+  case FileReader::Okay:
+    break;
+  case FileReader::NotFound:
+    return true;  // Nothing recorded yet; every node stays unknown.
+  default:
+    *err = read_err;
+    return false;
+  }
+
+  std::string_view content = file->content();
+  const char* p = content.data();
+  const char* end = p + content.size();
+  auto read_raw = [&p, end](void* out, size_t size) {
+    if (static_cast<size_t>(end - p) < size)
+      return false;
+    memcpy(out, p, size);
+    p += size;
+    return true;
+  };
+
+  char signature[sizeof(kFileSignature)] = {};
+  uint32_t version, count;
+  if (!read_raw(signature, sizeof(kFileSignature) - 1) ||
+      memcmp(signature, kFileSignature, sizeof(kFileSignature) - 1) != 0 ||
+      !read_raw(&version, sizeof(version)) || !read_raw(&count, sizeof(count))) {
+    *err = "corrupt mtime journal";
+    return false;
+  }
+  if (version != kCurrentVersion)
+    return true;  // Written by another version; just stale.
+
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t len;
+    int64_t mtime;
+    if (!read_raw(&len, sizeof(len)) || static_cast<size_t>(end - p) < len) {
+      *err = "corrupt mtime journal";
+      return false;
+    }
+    std::string_view node_path(p, len);
+    p += len;
+    if (!read_raw(&mtime, sizeof(mtime))) {
+      *err = "corrupt mtime journal";
+      return false;
+    }
+    // Paths that no longer name a node (the manifest changed) are
+    // silently dropped; nodes without a record are stat()ed as usual.
+    if (Node* node = state->LookupNode(node_path))
+      node->set_mtime(mtime);
+  }
+  return true;
+}
+
+bool MtimeJournal::Save(const std::string& path, const State* state,
+                        std::string* err) {
+  METRIC_RECORD("mtime journal save");
+
+  std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (!file) {
+    *err = strerror(errno);
+    return false;
+  }
+
+  uint32_t count = 0;
+  for (const auto& [node_path, node] : state->paths_) {
+    if (node->status_known())
+      ++count;
+  }
+
+  fwrite(kFileSignature, sizeof(kFileSignature) - 1, 1, file);
+  fwrite(&kCurrentVersion, sizeof(kCurrentVersion), 1, file);
+  fwrite(&count, sizeof(count), 1, file);
+  for (const auto& [node_path, node] : state->paths_) {
+    if (!node->status_known())
+      continue;
+    uint32_t len = static_cast<uint32_t>(node_path.size());
+    int64_t mtime = node->mtime();
+    fwrite(&len, sizeof(len), 1, file);
+    fwrite(node_path.data(), 1, len, file);
+    fwrite(&mtime, sizeof(mtime), 1, file);
+  }
+
+  if (ferror(file)) {
+    *err = strerror(errno);
+    fclose(file);
+    return false;
+  }
+  if (fclose(file) != 0) {
+    *err = strerror(errno);
+    return false;
+  }
+  if (rename(temp_path.c_str(), path.c_str()) != 0) {
+    *err = strerror(errno);
+    return false;
+  }
+  return true;
+}
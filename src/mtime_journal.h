@@ -0,0 +1,46 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_MTIME_JOURNAL_H_
+#define NINJA_MTIME_JOURNAL_H_
+
+#include <string>
+
+struct DiskInterface;
+struct State;
+
+/// A side file (.ninja_mtimes, next to .ninja_log and .ninja_deps)
+/// recording the mtime of every node whose on-disk state was observed
+/// during a build.  Loading it marks those nodes as already stat()ed, so
+/// the next dirty scan skips the stat storm a cold page cache would
+/// otherwise pay.
+///
+/// Trusting recorded mtimes is only sound when something outside ninja
+/// (a filesystem watcher) deletes or rewrites the journal whenever a
+/// recorded file changes; the journal is therefore loaded only behind
+/// the opt-in --trust-mtimes flag.
+struct MtimeJournal {
+  /// Install the recorded mtimes on the matching nodes of \a state.
+  /// Nodes without a record keep their unknown status and get stat()ed
+  /// as usual.  A missing journal is not an error; a corrupt one returns
+  /// false with \a err filled.
+  static bool Load(const std::string& path, State* state,
+                   DiskInterface* disk_interface, std::string* err);
+
+  /// Write the mtimes of every status-known node of \a state to \a path.
+  static bool Save(const std::string& path, const State* state,
+                   std::string* err);
+};
+
+#endif  // NINJA_MTIME_JOURNAL_H_
@@ -0,0 +1,66 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mtime_journal.h"
+
+#include "graph.h"
+#include "state.h"
+#include "test.h"
+
+namespace {
+
+struct MtimeJournalTest : public StateTestWithBuiltinRules {
+  void SetUp() override {
+    temp_dir_.CreateAndEnter("Ninja-MtimeJournalTest");
+  }
+  void TearDown() override {
+    temp_dir_.Cleanup();
+  }
+
+  ScopedTempDir temp_dir_;
+  RealDiskInterface disk_;
+};
+
+TEST_F(MtimeJournalTest, RoundTrip) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"build out: cat in1 in2\n"));
+  GetNode("in1")->set_mtime(100);
+  GetNode("in2")->set_mtime(0);  // Observed missing.
+
+  std::string err;
+  EXPECT_TRUE(MtimeJournal::Save(".ninja_mtimes", &state_, &err));
+  EXPECT_EQ("", err);
+
+  // A fresh state with a node the journal does not know and without one
+  // it does: the former stays unknown, the latter is dropped.
+  State restored;
+  AddCatRule(&restored);
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&restored,
+"build out: cat in1 extra\n"));
+  EXPECT_TRUE(MtimeJournal::Load(".ninja_mtimes", &restored, &disk_, &err));
+  EXPECT_EQ("", err);
+
+  EXPECT_TRUE(restored.LookupNode("in1")->status_known());
+  EXPECT_EQ(100, restored.LookupNode("in1")->mtime());
+  EXPECT_FALSE(restored.LookupNode("out")->status_known());
+  EXPECT_FALSE(restored.LookupNode("extra")->status_known());
+}
+
+TEST_F(MtimeJournalTest, MissingJournal) {
+  std::string err;
+  EXPECT_TRUE(MtimeJournal::Load("nosuchjournal", &state_, &disk_, &err));
+  EXPECT_EQ("", err);
+}
+
+}  // namespace
@@ -18,6 +18,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <cstdlib>
+#include <algorithm>
+#include <queue>
+#include <thread>
+#include <unordered_set>
 
 #ifdef _WIN32
 #include "getopt.h"
@@ -35,14 +39,24 @@
 #include "browse.h"
 #include "build.h"
 #include "build_log.h"
+#include "build_server.h"
 #include "deps_log.h"
+#include "async_writer.h"
 #include "clean.h"
 #include "debug_flags.h"
 #include "disk_interface.h"
+#include "event_trace.h"
 #include "graph.h"
 #include "graphviz.h"
+#include "file_watcher.h"
+#include "line_printer.h"
+#include "manifest_cache.h"
+#include "mtime_journal.h"
 #include "manifest_parser.h"
 #include "metrics.h"
+#include "rspfile_spool.h"
+#include "spawn_broker.h"
+#include "stat_prefetcher.h"
 #include "state.h"
 #include "util.h"
 #include "version.h"
@@ -78,6 +92,29 @@ struct Options final {
 
   /// Whether phony cycles should warn or print an error.
   bool phony_cycle_should_err;
+
+  /// Whether to read and write a binary snapshot of the parsed manifest.
+  bool use_manifest_cache;
+
+  /// Whether to splice pass-through phony edges out of the graph before
+  /// building.
+  bool collapse_phony;
+
+  /// Whether to merge command-and-input-identical edges into one
+  /// scheduled execution before building.
+  bool dedup_edges;
+
+  /// Whether to trust the mtimes journaled at the end of the last build
+  /// instead of re-statting.
+  bool trust_mtimes;
+
+  /// Whether to stay resident after building and rebuild on filesystem
+  /// changes.
+  bool watch;
+
+  /// Unix socket path to serve build/query/cancel requests on (--serve),
+  /// or null.  Implies staying resident with the graph warm.
+  const char* serve_socket;
 };
 
 /// The Ninja main() loads up a series of data structures; various tools need
@@ -128,16 +165,62 @@ struct NinjaMain final : public BuildLogUser {
   int ToolCompilationDatabase(const Options* options, int argc, char* argv[]);
   int ToolRecompact(const Options* options, int argc, char* argv[]);
   int ToolRestat(const Options* options, int argc, char* argv[]);
+  int ToolSimulate(const Options* options, int argc, char* argv[]);
   int ToolUrtle(const Options* options, int argc, char** argv);
   int ToolRules(const Options* options, int argc, char* argv[]);
 
-  /// Open the build log.
+  /// Open the build log.  With \a load_only the log is loaded but not
+  /// opened for writing, for tools that rewrite it themselves.  With
+  /// \a defer_retention the retention pass that consults the State stays
+  /// pending; the caller runs build_log_.ApplyRetention() once no other
+  /// thread is mutating the State.
   /// @return LOAD_ERROR on error.
-  bool OpenBuildLog(bool recompact_only = false);
+  bool OpenBuildLog(bool load_only = false, bool defer_retention = false);
+
+  /// The write half of OpenBuildLog(): recompact if the load flagged it,
+  /// then open for appending.  Recompaction consults the State through
+  /// IsPathDead(), so OpenLogs() runs this only after its loader threads
+  /// have joined.
+  bool OpenBuildLogForWrite();
 
-  /// Open the deps log: load it, then open for writing.
+  /// Open the deps log: load it, then open for writing.  \a load_only as
+  /// for OpenBuildLog().
   /// @return LOAD_ERROR on error.
-  bool OpenDepsLog(bool recompact_only = false);
+  bool OpenDepsLog(bool load_only = false);
+
+  /// The write half of OpenDepsLog(), split out so a speculative startup
+  /// load can defer it until the loaded records have been applied.
+  bool OpenDepsLogForWrite();
+
+  /// Open whichever logs the invocation declared a need for; when both
+  /// are wanted the two loads run concurrently.
+  bool OpenLogs(bool need_build_log, bool need_deps_log);
+
+  /// Start loading both logs from \a build_dir on background threads,
+  /// before the manifest parse has run.  Neither load touches the State:
+  /// the build log parses into its own entry table with retention still
+  /// unconfigured, and the deps log stops at LoadRecords().  \a build_dir
+  /// is a pre-parse guess at the builddir binding; FinishLogLoads()
+  /// checks it against the parsed value before trusting the results.
+  void StartLogLoads(const std::string& build_dir);
+
+  /// Join the loads StartLogLoads() kicked off, apply the deps records
+  /// to the now-parsed State, run build log retention, and open both
+  /// logs for writing.  Falls back to a serial OpenLogs() when no loads
+  /// were started or the build dir guess missed.
+  /// @return false on error.
+  bool FinishLogLoads(bool need_build_log, bool need_deps_log);
+
+  /// Install node mtimes recorded by the last build's journal; errors
+  /// degrade to a warning and a normal stat.  Only used with
+  /// --trust-mtimes.
+  void LoadMtimeJournal();
+
+  /// Record the observed node mtimes for the next run's journal load.
+  void SaveMtimeJournal();
+
+  /// Path of the mtime journal inside the build directory.
+  std::string MtimeJournalPath() const;
 
   /// Ensure the build directory exists, creating it if necessary.
   /// @return false on error.
@@ -152,6 +235,17 @@ struct NinjaMain final : public BuildLogUser {
   /// @return an exit code.
   int RunBuild(int argc, char** argv);
 
+  /// Stay resident, rebuilding whenever the file watcher reports a
+  /// change.  Returns an exit code, or -1 when a manifest file changed
+  /// on disk and the caller must reload everything.
+  int RunWatch(int argc, char** argv);
+
+  /// Stay resident and serve build/query/cancel requests over the
+  /// --serve unix socket against the warm graph.  Returns an exit code,
+  /// or -1 when a manifest file changed on disk and the caller must
+  /// reload everything.
+  int RunServe(const Options& options);
+
   /// Dump the output requested by '-d stats'.
   void DumpMetrics();
 
@@ -174,6 +268,25 @@ struct NinjaMain final : public BuildLogUser {
       Error("%s", err.c_str());  // Log and ignore Stat() errors.
     return mtime == 0;
   }
+
+  ~NinjaMain() {
+    // An early exit path (e.g. a discarded manifest cache restarting the
+    // cycle) can destroy us with the speculative loaders still running.
+    if (build_log_load_thread_.joinable())
+      build_log_load_thread_.join();
+    if (deps_log_load_thread_.joinable())
+      deps_log_load_thread_.join();
+  }
+
+  /// Speculative startup log loads; see StartLogLoads().
+  bool log_loads_started_ = false;
+  std::string log_load_build_dir_;
+  std::thread build_log_load_thread_;
+  std::thread deps_log_load_thread_;
+  LoadStatus build_log_load_status_ = LOAD_NOT_FOUND;
+  LoadStatus deps_log_load_status_ = LOAD_NOT_FOUND;
+  std::string build_log_load_err_;
+  std::string deps_log_load_err_;
 };
 
 /// Subtools, accessible via "-t foo".
@@ -197,8 +310,21 @@ struct Tool final {
     RUN_AFTER_LOGS,
   } when;
 
+  /// True for tools that only read the loaded graph.  Read-only tools are
+  /// latency-sensitive (editor integrations call them constantly), so the
+  /// manifest cache is used for them whenever one exists, without requiring
+  /// --manifest-cache, and is never rewritten on their behalf.
+  bool read_only;
+
   /// Implementation of the tool.
   NinjaMain::ToolFunc func;
+
+  /// Which logs a RUN_AFTER_LOGS tool actually reads.  Loading is
+  /// demand-driven: OpenLogs() runs only the loaders the invocation
+  /// declared a need for, so e.g. "-t deps" never parses the build log.
+  /// The build path needs both, hence the defaults.
+  bool needs_build_log = true;
+  bool needs_deps_log = true;
 };
 
 /// Print usage information.
@@ -223,7 +349,35 @@ void Usage(const BuildConfig& config) {
 "  -d MODE  enable debugging (use '-d list' to list modes)\n"
 "  -t TOOL  run a subtool (use '-t list' to list subtools)\n"
 "    terminates toplevel options; further flags are passed to the tool\n"
-"  -w FLAG  adjust warnings (use '-w list' to list warnings)\n",
+"  -w FLAG  adjust warnings (use '-w list' to list warnings)\n"
+"\n"
+"  --manifest-cache  keep a binary snapshot of the parsed manifest next to\n"
+"    the build file and load it instead of reparsing when unchanged\n"
+"  --collapse-phony  splice pass-through phony aliases out of the graph\n"
+"    before building, so the scan and the plan skip them\n"
+"  --dedup-edges  merge edges with identical commands and inputs into one\n"
+"    scheduled execution, leaving the duplicates as phony aliases\n"
+"  --trust-mtimes  trust the mtimes journaled at the end of the last build\n"
+"    instead of re-statting; only sound when a file watcher invalidates\n"
+"    the journal (deletes .ninja_mtimes) on any change\n"
+"  --watch  stay resident after building and rebuild whenever a watched\n"
+"    input changes (Linux/inotify only)\n"
+"  --serve SOCKET  stay resident and serve build/query/cancel requests\n"
+"    over the unix socket SOCKET against the warm graph, so editor\n"
+"    integrations skip process startup and manifest parsing\n"
+"  --mem-budget SIZE  do not dispatch an edge whose expected_memory\n"
+"    binding would push the running total over SIZE (e.g. '16G')\n"
+"  --remote-wrapper CMD  run each edge's command through CMD (a remote\n"
+"    execution client); edges with a 'local' binding and console edges\n"
+"    still run locally\n"
+"  --remote-jobs N  in-flight action cap for --remote-wrapper\n"
+"    [default=256]\n"
+"  --action-cache DIR  cache command outputs in DIR keyed by command and\n"
+"    input contents; an edge whose action is cached has its outputs\n"
+"    restored instead of running the command.  The cache is safe to\n"
+"    share between checkouts; $NINJA_ACTION_CACHE supplies the default\n"
+"  --action-cache-size SIZE  evict least-recently-used action cache\n"
+"    entries after each build to keep the cache under SIZE (e.g. '20G')\n",
           kNinjaVersion, config.parallelism);
 }
 
@@ -342,6 +496,39 @@ bool NinjaMain::CollectTargetsFromArgs(int argc, char* argv[],
 }
 
 int NinjaMain::ToolGraph(const Options* options, int argc, char* argv[]) {
+  // The graph tool uses getopt, and expects argv[0] to contain the name of
+  // the tool, i.e. "graph".
+  argc++;
+  argv--;
+
+  int max_depth = 0;
+  int max_nodes = 0;
+
+  optind = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, const_cast<char*>("d:n:h"))) != -1) {
+    switch (opt) {
+    case 'd':
+      max_depth = atoi(optarg);
+      break;
+    case 'n':
+      max_nodes = atoi(optarg);
+      break;
+    case 'h':
+    default:
+      printf("usage: ninja -t graph [options] [targets]\n"
+             "\n"
+             "options:\n"
+             "  -d DEPTH  only draw nodes within DEPTH hops of the targets\n"
+             "  -n COUNT  stop drawing after about COUNT nodes\n"
+             "  -h        print this message\n"
+             );
+      return 1;
+    }
+  }
+  argv += optind;
+  argc -= optind;
+
   std::vector<Node*> nodes;
   std::string err;
   if (!CollectTargetsFromArgs(argc, argv, &nodes, &err)) {
@@ -350,6 +537,8 @@ int NinjaMain::ToolGraph(const Options* options, int argc, char* argv[]) {
   }
 
   GraphViz graph(&state_, &disk_interface_);
+  graph.max_depth_ = max_depth;
+  graph.max_nodes_ = max_nodes;
   graph.Start();
   for (const auto & node : nodes)
   {
@@ -361,6 +550,35 @@ int NinjaMain::ToolGraph(const Options* options, int argc, char* argv[]) {
 }
 
 int NinjaMain::ToolQuery(const Options* options, int argc, char* argv[]) {
+  // The query tool uses getopt, and expects argv[0] to contain the name of
+  // the tool, i.e. "query".
+  argc++;
+  argv--;
+
+  bool transitive = false;
+
+  optind = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, const_cast<char*>("th"))) != -1) {
+    switch (opt) {
+    case 't':
+      transitive = true;
+      break;
+    case 'h':
+    default:
+      printf("usage: ninja -t query [options] target [targets]\n"
+             "\n"
+             "options:\n"
+             "  -t     also list the transitive dependents of the target,\n"
+             "         i.e. everything that rebuilds when it changes\n"
+             "  -h     print this message\n"
+             );
+      return 1;
+    }
+  }
+  argv += optind;
+  argc -= optind;
+
   if (argc == 0) {
     Error("expected a target to query");
     return 1;
@@ -376,7 +594,7 @@ int NinjaMain::ToolQuery(const Options* options, int argc, char* argv[]) {
       return 1;
     }
 
-    printf("%s:\n", node->path().c_str());
+    printf("%s:\n", node->path_cstr());
     if (Edge* edge = node->in_edge()) {
       if (edge->dyndep_ && edge->dyndep_->dyndep_pending()) {
         if (!dyndep_loader.LoadDyndeps(edge->dyndep_, &err)) {
@@ -390,7 +608,7 @@ int NinjaMain::ToolQuery(const Options* options, int argc, char* argv[]) {
           label = "| ";
         else if (edge->is_order_only(in))
           label = "|| ";
-        printf("    %s%s\n", label, edge->inputs_[in]->path().c_str());
+        printf("    %s%s\n", label, edge->inputs_[in]->path_cstr());
       }
     }
     printf("  outputs:\n");
@@ -398,7 +616,35 @@ int NinjaMain::ToolQuery(const Options* options, int argc, char* argv[]) {
     {
       for (const auto & out : edge->outputs_)
       {
-        printf("    %s\n", out->path().c_str());
+        printf("    %s\n", out->path_cstr());
+      }
+    }
+    if (transitive) {
+      // Walk the out-edge index breadth-first to collect everything that
+      // rebuilds when this node changes.  The graph holds the reverse
+      // dependencies already, so even header-style fan-outs over a large
+      // graph stay linear in the number of dependents.
+      std::vector<Node*> dependents;
+      std::unordered_set<const Node*> seen;
+      std::vector<const Node*> frontier(1, node);
+      while (!frontier.empty()) {
+        const Node* n = frontier.back();
+        frontier.pop_back();
+        for (const auto & edge : n->out_edges()) {
+          for (const auto & out : edge->outputs_) {
+            if (seen.insert(out).second) {
+              dependents.push_back(out);
+              frontier.push_back(out);
+            }
+          }
+        }
+      }
+      std::sort(dependents.begin(), dependents.end(),
+                [](const Node* a, const Node* b) { return a->path() < b->path(); });
+      printf("  dependents:\n");
+      for (const auto & out : dependents)
+      {
+        printf("    %s\n", out->path_cstr());
       }
     }
   }
@@ -406,10 +652,8 @@ int NinjaMain::ToolQuery(const Options* options, int argc, char* argv[]) {
 }
 
 #if defined(NINJA_HAVE_BROWSE)
-int NinjaMain::ToolBrowse(const Options* options, int argc, char* argv[]) {
-  RunBrowsePython(&state_, ninja_command_, options->input_file, argc, argv);
-  // If we get here, the browse failed.
-  return 1;
+int NinjaMain::ToolBrowse(const Options*, int argc, char* argv[]) {
+  return RunBrowseServer(&state_, argc, argv);
 }
 #else
 int NinjaMain::ToolBrowse(const Options*, int, char**) {
@@ -428,77 +672,124 @@ int NinjaMain::ToolMSVC(const Options* options, int argc, char* argv[]) {
 }
 #endif
 
-int ToolTargetsList(const std::vector<Node*>& nodes, int depth, int indent) {
+/// The enumeration tools (targets, compdb) can emit hundreds of megabytes
+/// on large graphs; per-entry printf through line-buffered stdio dominates
+/// their runtime.  They instead accumulate output in a reused chunk buffer
+/// that is flushed with fwrite once it passes this size, so memory stays
+/// bounded no matter how large the result is.
+const size_t kToolOutputChunk = 256 << 10;
+
+void FlushToolOutput(std::string* buf) {
+  fwrite(buf->data(), 1, buf->size(), stdout);
+  buf->clear();  // Keeps the capacity for the next chunk.
+}
+
+template <typename Nodes>
+void ToolTargetsList(const Nodes& nodes, int depth, int indent,
+                     std::string* buf) {
   for (const auto & node : nodes)
   {
     for (int i = 0; i < indent; ++i)
     {
-      printf("  ");
+      buf->append("  ");
     }
-    const char* target = node->path().c_str();
+    buf->append(node->path());
     if (node->in_edge())
     {
-      printf("%s: %s\n", target, node->in_edge()->rule_->name().c_str());
+      string_append(*buf, ": ", node->in_edge()->rule_->name(), "\n");
       if (depth > 1 || depth <= 0)
       {
-        ToolTargetsList(node->in_edge()->inputs_, depth - 1, indent + 1);
+        ToolTargetsList(node->in_edge()->inputs_, depth - 1, indent + 1, buf);
       }
     }
     else
     {
-      printf("%s\n", target);
+      buf->push_back('\n');
+    }
+    if (buf->size() >= kToolOutputChunk)
+    {
+      FlushToolOutput(buf);
     }
   }
+}
+
+template <typename Nodes>
+int ToolTargetsList(const Nodes& nodes, int depth, int indent) {
+  std::string buf;
+  buf.reserve(kToolOutputChunk + 1024);
+  ToolTargetsList(nodes, depth, indent, &buf);
+  FlushToolOutput(&buf);
   return 0;
 }
 
 int ToolTargetsSourceList(State* state) {
+  std::string buf;
+  buf.reserve(kToolOutputChunk + 1024);
   for (const auto & edge : state->edges_)
   {
     for (const auto & input : edge->inputs_)
     {
       if (!input->in_edge())
       {
-        printf("%s\n", input->path().c_str());
+        string_append(buf, input->path(), "\n");
+        if (buf.size() >= kToolOutputChunk)
+        {
+          FlushToolOutput(&buf);
+        }
       }
     }
   }
+  FlushToolOutput(&buf);
   return 0;
 }
 
 int ToolTargetsList(State* state, const std::string& rule_name) {
-  std::set<std::string> rules;
-
-  // Gather the outputs.
+  // Gather the outputs.  The paths live in the State, so collecting views
+  // and sorting them is much cheaper than a set of copied strings.
+  std::vector<std::string_view> outputs;
   for (const auto & edge : state->edges_)
   {
     if (edge->rule_->name() == rule_name)
     {
       for (const auto & out_node : edge->outputs_)
       {
-        rules.insert(out_node->path());
+        outputs.push_back(out_node->path());
       }
     }
   }
+  std::sort(outputs.begin(), outputs.end());
+  outputs.erase(std::unique(outputs.begin(), outputs.end()), outputs.end());
 
   // Print them.
-  for (const auto & rule : rules) {
-    printf("%s\n", rule.c_str());
+  std::string buf;
+  buf.reserve(kToolOutputChunk + 1024);
+  for (const auto & output : outputs) {
+    string_append(buf, output, "\n");
+    if (buf.size() >= kToolOutputChunk)
+    {
+      FlushToolOutput(&buf);
+    }
   }
+  FlushToolOutput(&buf);
 
   return 0;
 }
 
 int ToolTargetsList(State* state) {
+  std::string buf;
+  buf.reserve(kToolOutputChunk + 1024);
   for (const auto & edge : state->edges_)
   {
     for (const auto & out_node : edge->outputs_)
     {
-      printf("%s: %s\n",
-             out_node->path().c_str(),
-             edge->rule_->name().c_str());
+      string_append(buf, out_node->path(), ": ", edge->rule_->name(), "\n");
+      if (buf.size() >= kToolOutputChunk)
+      {
+        FlushToolOutput(&buf);
+      }
     }
   }
+  FlushToolOutput(&buf);
   return 0;
 }
 
@@ -525,19 +816,19 @@ int NinjaMain::ToolDeps(const Options* options, int argc, char** argv) {
   {
     DepsLog::Deps* deps = deps_log_.GetDeps(node);
     if (!deps) {
-      printf("%s: deps not found\n", (node)->path().c_str());
+      printf("%s: deps not found\n", (node)->path_cstr());
       continue;
     }
 
     std::string err;
-    TimeStamp mtime = disk_interface.Stat(node->path(), &err);
+    TimeStamp mtime = disk_interface.Stat(std::string(node->path()), &err);
     if (mtime == -1)
       Error("%s", err.c_str());  // Log and ignore Stat() errors;
     printf("%s: #deps %d, deps mtime %" PRId64 " (%s)\n",
-           node->path().c_str(), deps->node_count, deps->mtime,
+           node->path_cstr(), deps->node_count, deps->mtime,
            (!mtime || mtime > deps->mtime ? "STALE":"VALID"));
     for (int i = 0; i < deps->node_count; ++i)
-      printf("    %s\n", deps->nodes[i]->path().c_str());
+      printf("    %s\n", deps->nodes[i]->path_cstr());
     printf("\n");
   }
 
@@ -747,12 +1038,11 @@ int NinjaMain::ToolCleanDead(const Options* options, int argc, char* argv[]) {
   return cleaner.CleanDead(build_log_.entries());
 }
 
-void EncodeJSONString(const char *str) {
-  while (*str) {
-    if (*str == '"' || *str == '\\')
-      putchar('\\');
-    putchar(*str);
-    str++;
+void EncodeJSONString(std::string_view str, std::string* out) {
+  for (char c : str) {
+    if (c == '"' || c == '\\')
+      out->push_back('\\');
+    out->push_back(c);
   }
 }
 
@@ -785,17 +1075,17 @@ std::string EvaluateCommandWithRspfile(const Edge* edge,
   return command;
 }
 
-void printCompdb(const char* const directory, const Edge* const edge,
-                 const EvaluateCommandMode eval_mode) {
-  printf("\n  {\n    \"directory\": \"");
-  EncodeJSONString(directory);
-  printf("\",\n    \"command\": \"");
-  EncodeJSONString(EvaluateCommandWithRspfile(edge, eval_mode).c_str());
-  printf("\",\n    \"file\": \"");
-  EncodeJSONString(edge->inputs_[0]->path().c_str());
-  printf("\",\n    \"output\": \"");
-  EncodeJSONString(edge->outputs_[0]->path().c_str());
-  printf("\"\n  }");
+void AppendCompdbEntry(const char* const directory, const Edge* const edge,
+                       const EvaluateCommandMode eval_mode, std::string* out) {
+  out->append("\n  {\n    \"directory\": \"");
+  EncodeJSONString(directory, out);
+  out->append("\",\n    \"command\": \"");
+  EncodeJSONString(EvaluateCommandWithRspfile(edge, eval_mode), out);
+  out->append("\",\n    \"file\": \"");
+  EncodeJSONString(edge->inputs_[0]->path(), out);
+  out->append("\",\n    \"output\": \"");
+  EncodeJSONString(edge->outputs_[0]->path(), out);
+  out->append("\"\n  }");
 }
 
 int NinjaMain::ToolCompilationDatabase(const Options* options, int argc,
@@ -843,33 +1133,43 @@ int NinjaMain::ToolCompilationDatabase(const Options* options, int argc,
     return 1;
   }
 
-  putchar('[');
+  std::string buf;
+  buf.reserve(kToolOutputChunk + (64 << 10));
+  buf.push_back('[');
   for (const auto & edge : state_.edges_)
   {
     if (edge->inputs_.empty())
     {
       continue;
     }
-    if (argc == 0) {
-      if (!first) {
-        putchar(',');
-      }
-      printCompdb(&cwd[0], edge, eval_mode);
-      first = false;
-    } else {
+    if (argc != 0) {
+      // Test the rule filter before evaluating the command; on a filtered
+      // run (`-t compdb cxx`) most edges are rejected by this name compare
+      // alone.
+      bool matched = false;
       for (int i = 0; i != argc; ++i) {
         if (edge->rule_->name() == argv[i]) {
-          if (!first) {
-            putchar(',');
-          }
-          printCompdb(&cwd[0], edge, eval_mode);
-          first = false;
+          matched = true;
+          break;
         }
       }
+      if (!matched) {
+        continue;
+      }
+    }
+    if (!first) {
+      buf.push_back(',');
+    }
+    AppendCompdbEntry(&cwd[0], edge, eval_mode, &buf);
+    first = false;
+    if (buf.size() >= kToolOutputChunk)
+    {
+      FlushToolOutput(&buf);
     }
   }
 
-  puts("\n]");
+  buf.append("\n]\n");
+  FlushToolOutput(&buf);
   return 0;
 }
 
@@ -877,10 +1177,193 @@ int NinjaMain::ToolRecompact(const Options* options, int argc, char* argv[]) {
   if (!EnsureBuildDirExists())
     return 1;
 
-  if (OpenBuildLog(/*recompact_only=*/true) == LOAD_ERROR ||
-      OpenDepsLog(/*recompact_only=*/true) == LOAD_ERROR)
+  if (argc > 0 && strcmp(argv[0], "--text") == 0) {
+    // Dump the binary build log in the pre-v7 tab-separated text form for
+    // tools that scrape it.  The on-disk log is left untouched.
+    std::string log_path = ".ninja_log";
+    if (!build_dir_.empty())
+      log_path = string_concat(build_dir_, "/", log_path);
+    std::string err;
+    if (build_log_.Load(log_path, &err) == LOAD_ERROR) {
+      Error("loading build log %s: %s", log_path.c_str(), err.c_str());
+      return 1;
+    }
+    printf("# ninja log v6\n");
+    std::string line;
+    for (const auto & entry : build_log_.entries())
+    {
+      BuildLog::FormatEntryText(*entry.second, &line);
+      fwrite(line.data(), line.size(), 1, stdout);
+    }
+    return 0;
+  }
+
+  if (!OpenBuildLog(/*load_only=*/true) || !OpenDepsLog(/*load_only=*/true))
+    return 1;
+
+  std::string build_log_path = ".ninja_log";
+  std::string deps_log_path = ".ninja_deps";
+  if (!build_dir_.empty()) {
+    build_log_path = string_concat(build_dir_, "/", build_log_path);
+    deps_log_path = string_concat(build_dir_, "/", deps_log_path);
+  }
+
+  // A log that was never written loads as not-found and has nothing to
+  // rewrite.
+  std::string err;
+  bool have_build_log = disk_interface_.Stat(build_log_path, &err) > 0;
+  bool have_deps_log = disk_interface_.Stat(deps_log_path, &err) > 0;
+
+  LinePrinter printer;
+
+  // The two logs are independent files, so rewrite them concurrently:
+  // the build log on a helper thread (its liveness test only reads the
+  // graph and stats dead candidates) while this thread rewrites the
+  // deps log.
+  bool build_log_ok = true;
+  std::string build_log_err;
+  std::thread build_log_thread;
+  if (have_build_log) {
+    printer.Print("recompacting .ninja_log...", LinePrinter::ELIDE);
+    build_log_thread = std::thread([this, &build_log_path, &build_log_ok,
+                                    &build_log_err] {
+      build_log_ok = build_log_.Recompact(build_log_path, *this,
+                                          &build_log_err);
+    });
+  }
+
+  bool deps_log_ok = true;
+  if (have_deps_log) {
+    printer.Print("recompacting .ninja_deps...", LinePrinter::ELIDE);
+    if (!deps_log_.Recompact(deps_log_path, &err)) {
+      deps_log_ok = false;
+      Error("failed recompaction: %s", err.c_str());
+    }
+  }
+
+  if (build_log_thread.joinable())
+    build_log_thread.join();
+  if (!build_log_ok)
+    Error("failed recompaction: %s", build_log_err.c_str());
+  if (!build_log_ok || !deps_log_ok)
+    return 1;
+
+  size_t live_deps = 0;
+  for (const auto & deps : deps_log_.deps())
+    live_deps += deps != nullptr;
+  printer.Print(string_concat("recompacted ",
+                              std::to_string(build_log_.entries().size()),
+                              " log entries, ", std::to_string(live_deps),
+                              " deps entries"),
+                LinePrinter::FULL);
+  return 0;
+}
+
+int NinjaMain::ToolSimulate(const Options* options, int argc, char* argv[]) {
+  std::vector<Node*> targets;
+  std::string err;
+  if (!CollectTargetsFromArgs(argc, argv, &targets, &err)) {
+    Error("%s", err.c_str());
     return 1;
+  }
+
+  // Pretend every edge reachable from the targets is dirty, as a clean
+  // build would see it; durations come from the build log, so nothing
+  // is stat()ed and nothing runs.
+  std::vector<Edge*> to_visit;
+  std::unordered_set<Edge*> edges;
+  auto visit = [&to_visit, &edges](Node* node) {
+    Edge* in_edge = node->in_edge();
+    if (in_edge && edges.insert(in_edge).second)
+      to_visit.push_back(in_edge);
+  };
+  for (Node* target : targets)
+    visit(target);
+  while (!to_visit.empty()) {
+    Edge* edge = to_visit.back();
+    to_visit.pop_back();
+    for (Node* output : edge->outputs_)
+      output->MarkDirty();
+    for (Node* input : edge->inputs_)
+      visit(input);
+  }
+
+  // Replay the real scheduling machinery -- Plan's ready queue,
+  // critical-path ordering and pool admission -- against a virtual
+  // clock, with each edge taking its last logged duration.
+  Plan plan;
+  for (Node* target : targets) {
+    if (!plan.AddTarget(target, &err) && !err.empty()) {
+      Error("%s", err.c_str());
+      return 1;
+    }
+  }
+  if (!plan.more_to_do()) {
+    printf("ninja: nothing to simulate.\n");
+    return 0;
+  }
+  plan.PrepareQueue(&build_log_);
 
+  int64_t critical_path_ms = 0;
+  for (Edge* edge : edges)
+    critical_path_ms = std::max(critical_path_ms, edge->critical_path_weight());
+
+  struct Event {
+    int64_t finish_ms;
+    Edge* edge;
+  };
+  auto later = [](const Event& a, const Event& b) {
+    return a.finish_ms > b.finish_ms;
+  };
+  std::priority_queue<Event, std::vector<Event>, decltype(later)>
+      running(later);
+  int64_t clock_ms = 0;
+  int64_t busy_core_ms = 0;
+  int64_t command_edges = 0;
+  // Virtual time spent with exactly N commands in flight.
+  std::map<size_t, int64_t> concurrency;
+
+  while (plan.more_to_do()) {
+    Edge* edge;
+    while ((int)running.size() < config_.parallelism &&
+           (edge = plan.FindWork())) {
+      if (edge->is_phony()) {
+        if (!plan.EdgeFinished(edge, Plan::kEdgeSucceeded, &err)) {
+          Error("%s", err.c_str());
+          return 1;
+        }
+        continue;
+      }
+      ++command_edges;
+      running.push(
+          { clock_ms + Plan::EdgeWeightHeuristic(edge, &build_log_), edge });
+    }
+    if (running.empty())
+      break;
+
+    Event event = running.top();
+    running.pop();
+    size_t in_flight = running.size() + 1;
+    concurrency[in_flight] += event.finish_ms - clock_ms;
+    busy_core_ms += (event.finish_ms - clock_ms) * (int64_t)in_flight;
+    clock_ms = event.finish_ms;
+    if (!plan.EdgeFinished(event.edge, Plan::kEdgeSucceeded, &err)) {
+      Error("%s", err.c_str());
+      return 1;
+    }
+  }
+
+  printf("simulated %d edges at -j%d (durations from the build log)\n",
+         (int)command_edges, config_.parallelism);
+  printf("makespan: %.1fs  critical path: %.1fs  utilization: %.1f%%\n",
+         clock_ms / 1000.0, critical_path_ms / 1000.0,
+         clock_ms ? 100.0 * busy_core_ms / (clock_ms * config_.parallelism)
+                  : 0.0);
+  printf("concurrency  time        of makespan\n");
+  for (auto const& [in_flight, time_ms] : concurrency) {
+    printf("%11zu  %8.1fs  %5.1f%%\n", in_flight, time_ms / 1000.0,
+           100.0 * time_ms / clock_ms);
+  }
   return 0;
 }
 
@@ -973,36 +1456,42 @@ int NinjaMain::ToolUrtle(const Options* options, int argc, char** argv) {
 const Tool* ChooseTool(const std::string& tool_name) {
   static const Tool kTools[] = {
     { "browse", "browse dependency graph in a web browser",
-      Tool::RUN_AFTER_LOAD, &NinjaMain::ToolBrowse },
+      Tool::RUN_AFTER_LOAD, true, &NinjaMain::ToolBrowse },
 #if defined(_MSC_VER)
     { "msvc", "build helper for MSVC cl.exe (EXPERIMENTAL)",
-      Tool::RUN_AFTER_FLAGS, &NinjaMain::ToolMSVC },
+      Tool::RUN_AFTER_FLAGS, false, &NinjaMain::ToolMSVC },
 #endif
     { "clean", "clean built files",
-      Tool::RUN_AFTER_LOAD, &NinjaMain::ToolClean },
+      Tool::RUN_AFTER_LOAD, false, &NinjaMain::ToolClean },
     { "commands", "list all commands required to rebuild given targets",
-      Tool::RUN_AFTER_LOAD, &NinjaMain::ToolCommands },
+      Tool::RUN_AFTER_LOAD, true, &NinjaMain::ToolCommands },
     { "deps", "show dependencies stored in the deps log",
-      Tool::RUN_AFTER_LOGS, &NinjaMain::ToolDeps },
+      Tool::RUN_AFTER_LOGS, true, &NinjaMain::ToolDeps,
+      /*needs_build_log=*/false, /*needs_deps_log=*/true },
     { "graph", "output graphviz dot file for targets",
-      Tool::RUN_AFTER_LOAD, &NinjaMain::ToolGraph },
+      Tool::RUN_AFTER_LOAD, true, &NinjaMain::ToolGraph },
     { "query", "show inputs/outputs for a path",
-      Tool::RUN_AFTER_LOGS, &NinjaMain::ToolQuery },
+      Tool::RUN_AFTER_LOGS, true, &NinjaMain::ToolQuery,
+      /*needs_build_log=*/false, /*needs_deps_log=*/false },
     { "targets",  "list targets by their rule or depth in the DAG",
-      Tool::RUN_AFTER_LOAD, &NinjaMain::ToolTargets },
+      Tool::RUN_AFTER_LOAD, true, &NinjaMain::ToolTargets },
     { "compdb",  "dump JSON compilation database to stdout",
-      Tool::RUN_AFTER_LOAD, &NinjaMain::ToolCompilationDatabase },
+      Tool::RUN_AFTER_LOAD, true, &NinjaMain::ToolCompilationDatabase },
     { "recompact",  "recompacts ninja-internal data structures",
-      Tool::RUN_AFTER_LOAD, &NinjaMain::ToolRecompact },
+      Tool::RUN_AFTER_LOAD, false, &NinjaMain::ToolRecompact },
     { "restat",  "restats all outputs in the build log",
-      Tool::RUN_AFTER_FLAGS, &NinjaMain::ToolRestat },
+      Tool::RUN_AFTER_FLAGS, false, &NinjaMain::ToolRestat },
     { "rules",  "list all rules",
-      Tool::RUN_AFTER_LOAD, &NinjaMain::ToolRules },
+      Tool::RUN_AFTER_LOAD, true, &NinjaMain::ToolRules },
+    { "simulate",  "replay a clean build of the targets against a virtual clock using logged durations",
+      Tool::RUN_AFTER_LOGS, true, &NinjaMain::ToolSimulate,
+      /*needs_build_log=*/true, /*needs_deps_log=*/false },
     { "cleandead",  "clean built files that are no longer produced by the manifest",
-      Tool::RUN_AFTER_LOGS, &NinjaMain::ToolCleanDead },
+      Tool::RUN_AFTER_LOGS, false, &NinjaMain::ToolCleanDead,
+      /*needs_build_log=*/true, /*needs_deps_log=*/false },
     { "urtle", nullptr,
-      Tool::RUN_AFTER_FLAGS, &NinjaMain::ToolUrtle },
-    { nullptr, nullptr, Tool::RUN_AFTER_FLAGS, nullptr }
+      Tool::RUN_AFTER_FLAGS, false, &NinjaMain::ToolUrtle },
+    { nullptr, nullptr, Tool::RUN_AFTER_FLAGS, false, nullptr }
   };
 
   if (tool_name == "list") {
@@ -1041,9 +1530,10 @@ bool DebugEnable(const std::string& name) {
 "  explain      explain what caused a command to execute\n"
 "  keepdepfile  don't delete depfiles after they're read by ninja\n"
 "  keeprsp      don't delete @response files on success\n"
-#ifdef _WIN32
 "  nostatcache  don't batch stat() calls per directory and cache them\n"
-#endif
+"  prefault     fault the build/deps logs and manifest in up front; helps\n"
+"               cold or network-backed page caches\n"
+"  trace=FILE   write a Chrome trace-event timeline of the run to FILE\n"
 "multiple modes can be enabled via -d FOO -d BAR\n");
     return false;
   } else if (name == "stats") {
@@ -1058,14 +1548,24 @@ bool DebugEnable(const std::string& name) {
   } else if (name == "keeprsp") {
     g_keep_rsp = true;
     return true;
+  } else if (name.compare(0, 6, "trace=") == 0) {
+    if (name.size() == 6) {
+      Error("expected -d trace=FILE");
+      return false;
+    }
+    g_event_trace = new EventTrace(name.substr(6));
+    return true;
   } else if (name == "nostatcache") {
     g_experimental_statcache = false;
     return true;
+  } else if (name == "prefault") {
+    g_prefault = true;
+    return true;
   } else {
     const char* suggestion =
         SpellcheckString(name.c_str(),
                          "stats", "explain", "keepdepfile", "keeprsp",
-                         "nostatcache", nullptr);
+                         "nostatcache", "prefault", "trace", nullptr);
     if (suggestion) {
       Error("unknown debug setting '%s', did you mean '%s'?",
             name.c_str(), suggestion);
@@ -1115,11 +1615,29 @@ bool WarningEnable(const std::string& name, Options* options) {
   }
 }
 
-bool NinjaMain::OpenBuildLog(bool recompact_only) {
+/// The optional recency cap on loaded build log entries; see
+/// BuildLog::set_retention().
+static size_t BuildLogRetentionCap() {
+  if (const char* cap = getenv("NINJA_BUILD_LOG_MAX_ENTRIES"))
+    return strtoul(cap, nullptr, 10);
+  return 0;
+}
+
+bool NinjaMain::OpenBuildLog(bool load_only, bool defer_retention) {
   std::string log_path = ".ninja_log";
   if (!build_dir_.empty())
     log_path = string_concat(build_dir_, "/", log_path);
 
+  // Keep the in-memory log bounded on long-lived trees: entries whose
+  // outputs are no longer part of the build are dropped at load time, and
+  // NINJA_BUILD_LOG_MAX_ENTRIES optionally caps the rest by recency.
+  // Configuring retention after Load() keeps it pending for the caller:
+  // IsPathDead() reads the State, which a concurrent deps log load is
+  // busy mutating.
+  size_t max_log_entries = BuildLogRetentionCap();
+  if (!defer_retention)
+    build_log_.set_retention(this, max_log_entries);
+
   std::string err;
   const LoadStatus status = build_log_.Load(log_path, &err);
   if (status == LOAD_ERROR) {
@@ -1132,16 +1650,21 @@ bool NinjaMain::OpenBuildLog(bool recompact_only) {
     err.clear();
   }
 
-  if (recompact_only) {
-    if (status == LOAD_NOT_FOUND) {
-      return true;
-    }
-    bool success = build_log_.Recompact(log_path, *this, &err);
-    if (!success)
-      Error("failed recompaction: %s", err.c_str());
-    return success;
-  }
+  if (defer_retention)
+    build_log_.set_retention(this, max_log_entries);
+
+  if (load_only)
+    return true;
 
+  return OpenBuildLogForWrite();
+}
+
+bool NinjaMain::OpenBuildLogForWrite() {
+  std::string log_path = ".ninja_log";
+  if (!build_dir_.empty())
+    log_path = string_concat(build_dir_, "/", log_path);
+
+  std::string err;
   if (!config_.dry_run) {
     if (!build_log_.OpenForWrite(log_path, *this, &err)) {
       Error("opening build log: %s", err.c_str());
@@ -1152,9 +1675,30 @@ bool NinjaMain::OpenBuildLog(bool recompact_only) {
   return true;
 }
 
+std::string NinjaMain::MtimeJournalPath() const {
+  std::string path = ".ninja_mtimes";
+  if (!build_dir_.empty())
+    path = string_concat(build_dir_, "/", path);
+  return path;
+}
+
+void NinjaMain::LoadMtimeJournal() {
+  std::string err;
+  if (!MtimeJournal::Load(MtimeJournalPath(), &state_, &disk_interface_,
+                          &err)) {
+    Warning("loading mtime journal: %s", err.c_str());
+  }
+}
+
+void NinjaMain::SaveMtimeJournal() {
+  std::string err;
+  if (!MtimeJournal::Save(MtimeJournalPath(), &state_, &err))
+    Warning("writing mtime journal: %s", err.c_str());
+}
+
 /// Open the deps log: load it, then open for writing.
 /// @return false on error.
-bool NinjaMain::OpenDepsLog(bool recompact_only) {
+bool NinjaMain::OpenDepsLog(bool load_only) {
   std::string path = ".ninja_deps";
   if (!build_dir_.empty())
     path = string_concat(build_dir_, "/", path);
@@ -1171,16 +1715,18 @@ bool NinjaMain::OpenDepsLog(bool recompact_only) {
     err.clear();
   }
 
-  if (recompact_only) {
-    if (status == LOAD_NOT_FOUND) {
-      return true;
-    }
-    bool success = deps_log_.Recompact(path, &err);
-    if (!success)
-      Error("failed recompaction: %s", err.c_str());
-    return success;
-  }
+  if (load_only)
+    return true;
 
+  return OpenDepsLogForWrite();
+}
+
+bool NinjaMain::OpenDepsLogForWrite() {
+  std::string path = ".ninja_deps";
+  if (!build_dir_.empty())
+    path = string_concat(build_dir_, "/", path);
+
+  std::string err;
   if (!config_.dry_run) {
     if (!deps_log_.OpenForWrite(path, &err)) {
       Error("opening deps log: %s", err.c_str());
@@ -1191,6 +1737,102 @@ bool NinjaMain::OpenDepsLog(bool recompact_only) {
   return true;
 }
 
+bool NinjaMain::OpenLogs(bool need_build_log, bool need_deps_log) {
+  if (need_build_log && need_deps_log) {
+    // The two loads share nothing: the build log parses into its own
+    // entry table while the deps log materializes nodes in the State,
+    // so the build log rides a helper thread for free.  Retention is
+    // the one point of contact -- IsPathDead() reads the State, both
+    // directly and through recompaction -- so retention and the write
+    // half are held back until both loads have joined.
+    bool build_log_ok = false;
+    std::thread build_log_thread([this, &build_log_ok]() {
+      build_log_ok =
+          OpenBuildLog(/*load_only=*/true, /*defer_retention=*/true);
+    });
+    const bool deps_log_ok = OpenDepsLog();
+    build_log_thread.join();
+    if (!build_log_ok || !deps_log_ok)
+      return false;
+    build_log_.ApplyRetention();
+    return OpenBuildLogForWrite();
+  }
+  if (need_build_log)
+    return OpenBuildLog();
+  if (need_deps_log)
+    return OpenDepsLog();
+  return true;
+}
+
+void NinjaMain::StartLogLoads(const std::string& build_dir) {
+  std::string build_log_path = ".ninja_log";
+  std::string deps_log_path = ".ninja_deps";
+  if (!build_dir.empty()) {
+    build_log_path = string_concat(build_dir, "/", build_log_path);
+    deps_log_path = string_concat(build_dir, "/", deps_log_path);
+  }
+  log_loads_started_ = true;
+  log_load_build_dir_ = build_dir;
+  // The paths are captured by value: build_dir_ is still unset and will
+  // be written by EnsureBuildDirExists() while these threads run.
+  build_log_load_thread_ = std::thread([this, build_log_path]() {
+    build_log_load_status_ =
+        build_log_.Load(build_log_path, &build_log_load_err_);
+  });
+  deps_log_load_thread_ = std::thread([this, deps_log_path]() {
+    deps_log_load_status_ =
+        deps_log_.LoadRecords(deps_log_path, &deps_log_load_err_);
+  });
+}
+
+bool NinjaMain::FinishLogLoads(bool need_build_log, bool need_deps_log) {
+  if (!log_loads_started_)
+    return OpenLogs(need_build_log, need_deps_log);
+
+  build_log_load_thread_.join();
+  deps_log_load_thread_.join();
+  log_loads_started_ = false;
+
+  if (log_load_build_dir_ != build_dir_) {
+    // The manifest bound builddir somewhere the pre-parse scan could not
+    // see; drop the speculative loads and read the right files.
+    build_log_.DiscardLoad();
+    deps_log_.DiscardLoad();
+    return OpenLogs(need_build_log, need_deps_log);
+  }
+
+  // Report exactly as the serial loaders would have.
+  if (build_log_load_status_ == LOAD_ERROR) {
+    std::string log_path = ".ninja_log";
+    if (!build_dir_.empty())
+      log_path = string_concat(build_dir_, "/", log_path);
+    Error("loading build log %s: %s", log_path.c_str(),
+          build_log_load_err_.c_str());
+    return false;
+  }
+  if (!build_log_load_err_.empty())
+    Warning("%s", build_log_load_err_.c_str());
+  if (deps_log_load_status_ == LOAD_ERROR) {
+    std::string path = ".ninja_deps";
+    if (!build_dir_.empty())
+      path = string_concat(build_dir_, "/", path);
+    Error("loading deps log %s: %s", path.c_str(),
+          deps_log_load_err_.c_str());
+    return false;
+  }
+  if (!deps_log_load_err_.empty())
+    Warning("%s", deps_log_load_err_.c_str());
+
+  // The loads stayed off the State; now that the parse is done it is
+  // ours again.  Materialize the deps records first so retention's
+  // IsPathDead() sees the same graph a serial load would have.
+  deps_log_.ApplyLoad(&state_);
+  build_log_.set_retention(this, BuildLogRetentionCap());
+  build_log_.ApplyRetention();
+
+  return OpenBuildLogForWrite() && OpenDepsLogForWrite();
+}
+
 void NinjaMain::DumpMetrics() {
   g_metrics->Report();
 
@@ -1215,6 +1857,7 @@ bool NinjaMain::EnsureBuildDirExists() {
 
 int NinjaMain::RunBuild(int argc, char** argv) {
   std::string err;
+  int64_t scan_start_us = g_event_trace ? GetTimeMicros() : 0;
   std::vector<Node*> targets;
   if (!CollectTargetsFromArgs(argc, argv, &targets, &err)) {
     Error("%s", err.c_str());
@@ -1224,7 +1867,25 @@ int NinjaMain::RunBuild(int argc, char** argv) {
   disk_interface_.AllowStatCache(g_experimental_statcache);
 
   Builder builder(&state_, config_, &build_log_, &deps_log_, &disk_interface_);
+
+  // When the user named targets on the command line, dispatch their
+  // closures ahead of everything else the plan picks up (queued-target
+  // fallout, dyndep growth); with only default targets there is nothing
+  // to prefer.
+  if (argc > 0) {
+    for (size_t i = 0; i < targets.size(); ++i)
+      builder.plan_.BoostTarget(targets[i]);
+  }
+
   for (size_t i = 0; i < targets.size(); ++i) {
+    // Once a scanned target has produced work, defer the remaining
+    // scans into Build(), where they run between dispatches and so
+    // overlap with the commands already started.  Until then scan
+    // eagerly, which keeps the no-work case detected up front.
+    if (!builder.AlreadyUpToDate()) {
+      builder.QueueTarget(targets[i]);
+      continue;
+    }
     if (!builder.AddTarget(targets[i], &err)) {
       if (!err.empty()) {
         Error("%s", err.c_str());
@@ -1239,22 +1900,233 @@ int NinjaMain::RunBuild(int argc, char** argv) {
   // Make sure restat rules do not see stale timestamps.
   disk_interface_.AllowStatCache(false);
 
+  // Target scans queued above continue inside Build(); this span covers
+  // the up-front part.
+  if (g_event_trace)
+    g_event_trace->RecordSpan("dirty scan", scan_start_us, GetTimeMicros());
+
   if (builder.AlreadyUpToDate()) {
     printf("ninja: no work to do.\n");
     return 0;
   }
 
-  if (!builder.Build(&err)) {
+  // Spool rspfiles on tmpfs so link-heavy builds stop paying NFS latency
+  // for files only the spawned command reads.  Remote workers need the
+  // on-disk copy, and -d keeprsp asks for it explicitly.
+  if (!g_keep_rsp && !config_.dry_run && config_.remote_wrapper.empty())
+    RspfileSpool::Enable();
+
+  // Route the logs' per-edge appends through a write-behind thread for the
+  // duration of the build, so finishing an edge never stalls the dispatch
+  // loop on fwrite+fflush.  Failures surface at the barrier below.
+  AsyncWriter log_writer;
+  build_log_.set_async_writer(&log_writer);
+  deps_log_.set_async_writer(&log_writer);
+
+  int64_t build_start_us = g_event_trace ? GetTimeMicros() : 0;
+  bool build_ok = builder.Build(&err);
+  if (g_event_trace)
+    g_event_trace->RecordSpan("build", build_start_us, GetTimeMicros());
+
+  int64_t drain_start_us = g_event_trace ? GetTimeMicros() : 0;
+  std::string write_err;
+  bool writes_ok = log_writer.Drain(&write_err);
+  if (g_event_trace)
+    g_event_trace->RecordSpan("log flush", drain_start_us, GetTimeMicros());
+  build_log_.set_async_writer(nullptr);
+  deps_log_.set_async_writer(nullptr);
+
+  // Sweep spooled rspfiles (failed edges leave theirs live for nothing
+  // -- the spool directory is gone after this).
+  RspfileSpool::Shutdown();
+
+  if (!build_ok) {
     printf("ninja: build stopped: %s.\n", err.c_str());
     if (err.find("interrupted by user") != std::string::npos) {
       return 2;
     }
     return 1;
   }
+  if (!writes_ok) {
+    Error("writing to build or deps log: %s", write_err.c_str());
+    return 1;
+  }
 
   return 0;
 }
 
+int NinjaMain::RunWatch(int argc, char** argv) {
+  if (!FileWatcher::Supported())
+    Fatal("--watch is not supported on this platform");
+
+  FileWatcher watcher;
+  std::string err;
+  for (;;) {
+    // A failed build keeps the watch alive: the usual fix is another
+    // edit, which is exactly what we are waiting for.
+    int result = RunBuild(argc, argv);
+    if (result == 2)
+      return result;  // Interrupted by the user.
+
+    if (!watcher.WatchGraphDirs(&state_, &err)) {
+      Error("%s", err.c_str());
+      return 1;
+    }
+    printf("ninja: watching %zu directories, waiting for changes...\n",
+           watcher.watch_count());
+    fflush(stdout);
+
+    std::vector<std::string> changed;
+    bool overflow = false;
+    if (!watcher.WaitForChanges(&changed, &overflow, &err)) {
+      Error("%s", err.c_str());
+      return 1;
+    }
+
+    state_.ResetForWatch();
+    if (overflow) {
+      // The kernel dropped events; fall back to statting everything.
+      state_.Reset();
+      continue;
+    }
+    for (const std::string& path : changed) {
+      for (const State::ManifestFile& file : state_.manifest_files_) {
+        if (file.path == path)
+          return -1;  // Reparse the manifest and re-enter watch mode.
+      }
+      if (Node* node = state_.LookupNode(path))
+        node->ResetState();
+    }
+  }
+}
+
+int NinjaMain::RunServe(const Options& options) {
+#ifdef _WIN32
+  Fatal("--serve is not supported on this platform");
+  return 1;
+#else
+  BuildServer server;
+  std::string err;
+  if (!server.Listen(options.serve_socket, &err))
+    Fatal("%s", err.c_str());
+
+  // With a file watcher, builds invalidate exactly the files that
+  // changed since the last one; without, each build re-stats the world
+  // (still no manifest parse -- that is where the startup time goes).
+  FileWatcher watcher;
+  const bool watching = FileWatcher::Supported();
+  if (watching && !watcher.WatchGraphDirs(&state_, &err))
+    Fatal("%s", err.c_str());
+
+  printf("ninja: serving requests on %s...\n", options.serve_socket);
+  fflush(stdout);
+
+  bool first_build = true;
+  for (;;) {
+    int client = server.Accept();
+    if (client < 0)
+      return 0;  // Interrupted while idle; a clean shutdown.
+
+    std::string request;
+    while (server.ReadRequest(client, &request)) {
+      std::vector<std::string> words = BuildServer::Tokenize(request);
+      if (words.empty())
+        continue;
+      const std::string& verb = words[0];
+
+      if (verb == "build") {
+        // Bring the warm graph back in sync with the filesystem.
+        if (!first_build) {
+          state_.ResetForWatch();
+          if (watching) {
+            std::vector<std::string> changed;
+            bool overflow = false;
+            if (!watcher.DrainChanges(&changed, &overflow, &err))
+              Fatal("%s", err.c_str());
+            if (overflow)
+              state_.Reset();
+            for (const std::string& path : changed) {
+              for (const State::ManifestFile& file : state_.manifest_files_) {
+                if (file.path == path) {
+                  BuildServer::WriteLine(client,
+                                         "error manifest changed; reloading");
+                  close(client);
+                  return -1;  // Reparse and re-enter serve mode.
+                }
+              }
+              if (Node* node = state_.LookupNode(path))
+                node->ResetState();
+            }
+          } else {
+            state_.Reset();
+          }
+        }
+        first_build = false;
+
+        std::vector<char*> build_argv;
+        for (size_t i = 1; i < words.size(); ++i)
+          build_argv.push_back(&words[i][0]);
+
+        // Stream the build's console output to the client, and let a
+        // second connection cancel while this loop is busy building.
+        fflush(stdout);
+        fflush(stderr);
+        int saved_stdout = dup(1), saved_stderr = dup(2);
+        dup2(client, 1);
+        dup2(client, 2);
+        server.StartCancelWatch();
+        int result =
+            RunBuild(static_cast<int>(build_argv.size()), build_argv.data());
+        server.StopCancelWatch();
+        fflush(stdout);
+        fflush(stderr);
+        dup2(saved_stdout, 1);
+        dup2(saved_stderr, 2);
+        close(saved_stdout);
+        close(saved_stderr);
+
+        if (result == 0)
+          BuildServer::WriteLine(client, "ok");
+        else if (result == 2)
+          BuildServer::WriteLine(client, "error build cancelled");
+        else
+          BuildServer::WriteLine(client, "error build failed");
+
+        // Pick up directories the build just created.
+        if (watching && !watcher.WatchGraphDirs(&state_, &err))
+          Fatal("%s", err.c_str());
+      } else if (verb == "query") {
+        std::vector<char*> query_argv;
+        for (size_t i = 1; i < words.size(); ++i)
+          query_argv.push_back(&words[i][0]);
+        fflush(stdout);
+        fflush(stderr);
+        int saved_stdout = dup(1), saved_stderr = dup(2);
+        dup2(client, 1);
+        dup2(client, 2);
+        int result = ToolQuery(&options, static_cast<int>(query_argv.size()),
+                               query_argv.data());
+        fflush(stdout);
+        fflush(stderr);
+        dup2(saved_stdout, 1);
+        dup2(saved_stderr, 2);
+        close(saved_stdout);
+        close(saved_stderr);
+        BuildServer::WriteLine(client, result == 0 ? "ok" : "error query failed");
+      } else if (verb == "cancel") {
+        // Nothing can be running while this loop is reading requests.
+        BuildServer::WriteLine(client, "ok idle");
+      } else {
+        BuildServer::WriteLine(client,
+                               string_concat("error unknown request '", verb,
+                                             "'"));
+      }
+    }
+    close(client);
+  }
+#endif  // !_WIN32
+}
+
 #ifdef _MSC_VER
 
 /// This handler processes fatal crashes that you can't catch
@@ -1284,11 +2156,35 @@ int ReadFlags(int* argc, char*** argv,
               Options* options, BuildConfig* config) {
   config->parallelism = GuessParallelism();
 
-  enum { OPT_VERSION = 1 };
+  enum {
+    OPT_VERSION = 1,
+    OPT_MANIFEST_CACHE = 2,
+    OPT_COLLAPSE_PHONY = 3,
+    OPT_TRUST_MTIMES = 4,
+    OPT_WATCH = 5,
+    OPT_MEM_BUDGET = 6,
+    OPT_REMOTE_WRAPPER = 7,
+    OPT_REMOTE_JOBS = 8,
+    OPT_ACTION_CACHE = 9,
+    OPT_ACTION_CACHE_SIZE = 10,
+    OPT_SERVE = 11,
+    OPT_DEDUP_EDGES = 12,
+  };
   const option kLongOptions[] = {
     { "help", no_argument, nullptr, 'h' },
     { "version", no_argument, nullptr, OPT_VERSION },
     { "verbose", no_argument, nullptr, 'v' },
+    { "manifest-cache", no_argument, nullptr, OPT_MANIFEST_CACHE },
+    { "collapse-phony", no_argument, nullptr, OPT_COLLAPSE_PHONY },
+    { "dedup-edges", no_argument, nullptr, OPT_DEDUP_EDGES },
+    { "trust-mtimes", no_argument, nullptr, OPT_TRUST_MTIMES },
+    { "watch", no_argument, nullptr, OPT_WATCH },
+    { "mem-budget", required_argument, nullptr, OPT_MEM_BUDGET },
+    { "remote-wrapper", required_argument, nullptr, OPT_REMOTE_WRAPPER },
+    { "remote-jobs", required_argument, nullptr, OPT_REMOTE_JOBS },
+    { "action-cache", required_argument, nullptr, OPT_ACTION_CACHE },
+    { "action-cache-size", required_argument, nullptr, OPT_ACTION_CACHE_SIZE },
+    { "serve", required_argument, nullptr, OPT_SERVE },
     { nullptr, 0, nullptr, 0 }
   };
 
@@ -1356,6 +2252,53 @@ int ReadFlags(int* argc, char*** argv,
       case OPT_VERSION:
         printf("%s\n", kNinjaVersion);
         return 0;
+      case OPT_MANIFEST_CACHE:
+        options->use_manifest_cache = true;
+        break;
+      case OPT_COLLAPSE_PHONY:
+        options->collapse_phony = true;
+        break;
+      case OPT_DEDUP_EDGES:
+        options->dedup_edges = true;
+        break;
+      case OPT_TRUST_MTIMES:
+        options->trust_mtimes = true;
+        break;
+      case OPT_WATCH:
+        options->watch = true;
+        break;
+      case OPT_SERVE:
+        options->serve_socket = optarg;
+        break;
+      case OPT_MEM_BUDGET: {
+        int64_t value = ParseByteSize(optarg);
+        if (value < 0)
+          Fatal("invalid --mem-budget parameter; expected a size like '16G'");
+        config->memory_budget = value;
+        break;
+      }
+      case OPT_REMOTE_WRAPPER:
+        config->remote_wrapper = optarg;
+        break;
+      case OPT_REMOTE_JOBS: {
+        char* end;
+        int value = strtol(optarg, &end, 10);
+        if (*end != 0 || value <= 0)
+          Fatal("invalid --remote-jobs parameter");
+        config->remote_parallelism = value;
+        break;
+      }
+      case OPT_ACTION_CACHE:
+        config->action_cache_dir = optarg;
+        break;
+      case OPT_ACTION_CACHE_SIZE: {
+        int64_t value = ParseByteSize(optarg);
+        if (value < 0)
+          Fatal("invalid --action-cache-size parameter; expected a size "
+                "like '20G'");
+        config->action_cache_size = value;
+        break;
+      }
       case 'h':
       default:
         Usage(*config);
@@ -1368,6 +2311,58 @@ int ReadFlags(int* argc, char*** argv,
   return -1;
 }
 
+/// Guess what the manifest will bind builddir to, without parsing it:
+/// scan the top-level file for unindented `builddir = value` lines and
+/// take the last literal one, or "" when there is none.  The guess is
+/// wrong if the winning value references a variable (returns false
+/// instead of guessing) or if an include'd file rebinds builddir --
+/// FinishLogLoads() verifies against the parsed binding, so a miss
+/// costs only a serial reload.
+bool GuessBuildDir(FileReader* file_reader, const std::string& input_file,
+                   std::string* build_dir) {
+  build_dir->clear();
+  std::string contents;
+  std::string err;
+  if (file_reader->ReadFile(input_file, &contents, &err) != FileReader::Okay)
+    return true;  // No manifest: the parse will fail before the join.
+
+  size_t pos = 0;
+  while (pos < contents.size()) {
+    size_t eol = contents.find('\n', pos);
+    if (eol == std::string::npos)
+      eol = contents.size();
+    std::string_view line(contents.data() + pos, eol - pos);
+    pos = eol + 1;
+    // Indented lines are bindings scoped to the preceding rule or edge;
+    // only top-level lines can bind the root builddir.
+    static const std::string_view kBuildDir = "builddir";
+    if (line.substr(0, kBuildDir.size()) != kBuildDir)
+      continue;
+    line.remove_prefix(kBuildDir.size());
+    // Rule out a longer identifier like `builddir2`.  The lexer's
+    // identifier alphabet is [a-zA-Z0-9_.-].
+    if (!line.empty() &&
+        (isalnum((unsigned char)line.front()) || line.front() == '_' ||
+         line.front() == '.' || line.front() == '-'))
+      continue;
+    while (!line.empty() && line.front() == ' ')
+      line.remove_prefix(1);
+    if (line.empty() || line.front() != '=')
+      continue;
+    line.remove_prefix(1);
+    while (!line.empty() && line.front() == ' ')
+      line.remove_prefix(1);
+    while (!line.empty() && (line.back() == ' ' || line.back() == '\r'))
+      line.remove_suffix(1);
+    // A '$' means a variable reference, an escape or a line continuation;
+    // evaluating any of those needs the real parser.
+    if (line.find('$') != std::string_view::npos)
+      return false;
+    *build_dir = std::string(line);
+  }
+  return true;
+}
+
 [[noreturn]] void real_main(int argc, char** argv) {
   // Use exit() instead of return in this function to avoid potentially
   // expensive cleanup when destructing NinjaMain.
@@ -1383,6 +2378,20 @@ int ReadFlags(int* argc, char*** argv,
   if (exit_code >= 0)
     exit(exit_code);
 
+  // A per-machine action cache shared by every checkout is most useful
+  // configured once in the environment rather than per invocation.
+  if (config.action_cache_dir.empty()) {
+    if (const char* env = getenv("NINJA_ACTION_CACHE"))
+      config.action_cache_dir = env;
+  }
+
+#ifndef _WIN32
+  // Fork the spawn helper (if requested) before the manifest and logs
+  // are loaded, while our page tables are still tiny; that is the whole
+  // point of the broker.
+  SpawnBroker::StartIfRequested();
+#endif
+
   if (options.working_dir) {
     // The formatting of this std::string, complete with funny quotes, is
     // so Emacs can properly identify that the cwd has changed for
@@ -1415,25 +2424,116 @@ int ReadFlags(int* argc, char*** argv,
     if (options.phony_cycle_should_err) {
       parser_opts.phony_cycle_action_ = kPhonyCycleActionError;
     }
-    ManifestParser parser(&ninja.state_, &ninja.disk_interface_, parser_opts);
+    parser_opts.dedup_edges_ = options.dedup_edges;
+    // Reuse the build parallelism for lexing subninja files.
+    parser_opts.subninja_threads_ = config.parallelism;
+    std::string manifest_cache_path =
+        string_concat(options.input_file, ".cache");
+    // Stat the graph's files in the background while the manifest is still
+    // loading, so the dependency scan's own stats mostly hit warm kernel
+    // caches.  Tools don't scan, so don't bother for them.
+    StatPrefetcher stat_prefetcher(&ninja.disk_interface_);
+    if (!options.tool)
+      ninja.state_.stat_prefetcher_ = &stat_prefetcher;
+    // Neither log load needs the finished graph until its records are
+    // applied to Nodes, so both reads can hide behind the manifest load.
+    // All they need up front is the build dir, which is only bound once
+    // the parse is done; start them on a pre-parse guess and let
+    // FinishLogLoads() fall back to a serial reload if it missed.  Tools
+    // declare narrower log needs and keep the serial path.
+    std::string guessed_build_dir;
+    if (!options.tool &&
+        GuessBuildDir(&ninja.disk_interface_, options.input_file,
+                      &guessed_build_dir))
+      ninja.StartLogLoads(guessed_build_dir);
     std::string err;
-    if (!parser.Load(options.input_file, &err)) {
-      Error("%s", err.c_str());
-      exit(1);
+    bool manifest_cache_hit = false;
+    bool manifest_cache_reparsed = false;
+    // Read-only tools always try the cache: on a warm one they skip the
+    // whole parse, which is the difference between interactive and
+    // multi-second editor queries.  On a miss they parse as usual.
+    bool read_only_tool = options.tool && options.tool->read_only;
+    int64_t load_start_us = g_event_trace ? GetTimeMicros() : 0;
+    if (options.use_manifest_cache || read_only_tool) {
+      switch (ManifestCache::Load(manifest_cache_path, &ninja.state_,
+                                  &ninja.disk_interface_, &err,
+                                  &manifest_cache_reparsed)) {
+      case LOAD_SUCCESS:
+        manifest_cache_hit = true;
+        break;
+      case LOAD_NOT_FOUND:
+        break;
+      case LOAD_ERROR:
+        // The failed load may have partially populated the state; start
+        // the cycle over with a fresh NinjaMain and a full reparse.
+        Warning("discarding manifest cache: %s", err.c_str());
+        err.clear();
+        ninja.disk_interface_.RemoveFile(manifest_cache_path);
+        continue;
+      }
     }
 
+    if (!manifest_cache_hit) {
+      ManifestParser parser(&ninja.state_, &ninja.disk_interface_,
+                            parser_opts);
+      if (!parser.Load(options.input_file, &err)) {
+        Error("%s", err.c_str());
+        exit(1);
+      }
+    }
+    // Nodes created from here on (depfiles, dyndep) are statted by the
+    // scan right away; prefetching them would only race it.
+    ninja.state_.stat_prefetcher_ = nullptr;
+    stat_prefetcher.Flush();
+    // (Re-)write the cache after a full parse and after an incremental
+    // reparse of changed subninja scopes.  Not for read-only tools: they
+    // must not leave artifacts behind unless the cache was asked for.
+    if (options.use_manifest_cache && !read_only_tool &&
+        (!manifest_cache_hit || manifest_cache_reparsed) &&
+        !ManifestCache::Save(manifest_cache_path, &ninja.state_,
+                             &ninja.disk_interface_, &err)) {
+      Warning("writing manifest cache: %s", err.c_str());
+      err.clear();
+    }
+    if (g_event_trace)
+      g_event_trace->RecordSpan("manifest load", load_start_us,
+                                GetTimeMicros());
+
     if (options.tool && options.tool->when == Tool::RUN_AFTER_LOAD)
       exit((ninja.*options.tool->func)(&options, argc, argv));
 
     if (!ninja.EnsureBuildDirExists())
       exit(1);
 
-    if (!ninja.OpenBuildLog() || !ninja.OpenDepsLog())
+    int64_t logs_start_us = g_event_trace ? GetTimeMicros() : 0;
+    // Load only what the rest of the invocation will read: RUN_AFTER_LOGS
+    // tools declare their needs, the build path needs both.
+    bool need_build_log = true;
+    bool need_deps_log = true;
+    if (options.tool && options.tool->when == Tool::RUN_AFTER_LOGS) {
+      need_build_log = options.tool->needs_build_log;
+      need_deps_log = options.tool->needs_deps_log;
+    }
+    if (!ninja.FinishLogLoads(need_build_log, need_deps_log))
       exit(1);
+    if (g_event_trace)
+      g_event_trace->RecordSpan("log load", logs_start_us, GetTimeMicros());
 
     if (options.tool && options.tool->when == Tool::RUN_AFTER_LOGS)
       exit((ninja.*options.tool->func)(&options, argc, argv));
 
+    // Rewire only on the build path, after every tool has had its
+    // chance to run: tools keep showing the original edges and aliases.
+    // Dedup runs first so the aliases it introduces are themselves
+    // candidates for the phony collapse.
+    if (options.dedup_edges)
+      ninja.state_.DeduplicateEdges();
+    if (options.collapse_phony)
+      ninja.state_.CollapsePhonyEdges();
+
+    if (options.trust_mtimes)
+      ninja.LoadMtimeJournal();
+
     // Attempt to rebuild the manifest before building anything else
     if (ninja.RebuildManifest(options.input_file, &err)) {
       // In dry_run mode the regeneration will succeed without changing the
@@ -1447,9 +2547,43 @@ int ReadFlags(int* argc, char*** argv,
       exit(1);
     }
 
+    if (options.serve_socket) {
+      int serve_result = ninja.RunServe(options);
+      if (serve_result < 0)
+        continue;  // A manifest file changed on disk; reload everything.
+      exit(serve_result);
+    }
+
+    if (options.watch) {
+      int watch_result = ninja.RunWatch(argc, argv);
+      if (watch_result < 0)
+        continue;  // A manifest file changed on disk; reload everything.
+      exit(watch_result);
+    }
+
     int result = ninja.RunBuild(argc, argv);
+    // Journal the observed mtimes so the next --trust-mtimes run skips
+    // the stat storm.
+    if (options.trust_mtimes && result == 0 && !config.dry_run)
+      ninja.SaveMtimeJournal();
+    // The dependency scan reads depfiles and records their deps on the
+    // State; rewrite the cache so the next run restores them instead of
+    // rereading the depfiles.  Not after a phony collapse, though: that
+    // would snapshot the rewired graph rather than the parsed one.
+    if (options.use_manifest_cache && !options.collapse_phony &&
+        !options.dedup_edges &&
+        ninja.state_.cached_deps_dirty_ &&
+        !ManifestCache::Save(manifest_cache_path, &ninja.state_,
+                             &ninja.disk_interface_, &err)) {
+      Warning("writing manifest cache: %s", err.c_str());
+      err.clear();
+    }
     if (g_metrics)
       ninja.DumpMetrics();
+    if (g_event_trace) {
+      if (!g_event_trace->Finish(&err))
+        Error("writing trace: %s", err.c_str());
+    }
     exit(result);
   }
 
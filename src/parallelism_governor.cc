@@ -0,0 +1,129 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parallelism_governor.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#include "metrics.h"
+#include "resource_sampler.h"
+#include "util.h"
+
+namespace {
+
+/// Re-sample the machine at most this often.
+const int64_t kSampleIntervalMillis = 250;
+
+/// PSI avg10 above which we consider memory under pressure.
+const double kMemoryPressureThreshold = 0.10;
+
+/// CPU utilization above which the machine counts as saturated, and
+/// below which it has headroom worth another job.
+const double kSaturatedCpu = 0.95;
+const double kIdleCpu = 0.80;
+
+}  // anonymous namespace
+
+void ParallelismGovernor::Enable(int max_parallelism,
+                                 double max_load_average) {
+  max_parallelism_ = max_parallelism;
+  current_ = max_parallelism;
+  max_load_average_ = max_load_average;
+  processors_ = GetProcessorCount();
+}
+
+int ParallelismGovernor::EffectiveParallelism() {
+  int64_t now = GetTimeMillis();
+  if (now - last_sample_ms_ < kSampleIntervalMillis)
+    return current_;
+  last_sample_ms_ = now;
+
+  double cpu_utilization;
+  if (!SampleCpuUtilization(&cpu_utilization)) {
+    // No /proc (or first sample, which only seeds the counters): fall
+    // back to the classic load-average gate, but still walk the cap so
+    // recovery is gradual instead of all-or-nothing.
+    if (max_load_average_ > 0.0f) {
+      if (ResourceSampler::Shared()->Get().load_average >= max_load_average_)
+        current_ = std::max(1, current_ - 1);
+      else
+        current_ = std::min(max_parallelism_, current_ + 1);
+    }
+    return current_;
+  }
+
+  return Adjust(cpu_utilization,
+                ResourceSampler::Shared()->Get().memory_pressure,
+                SampleRunQueueDepth());
+}
+
+int ParallelismGovernor::Adjust(double cpu_utilization,
+                                double memory_pressure,
+                                int run_queue_depth) {
+  if (memory_pressure >= kMemoryPressureThreshold) {
+    // Memory pressure precedes swapping; back off multiplicatively.
+    current_ = std::max(1, current_ - std::max(1, current_ / 4));
+  } else if (cpu_utilization >= kSaturatedCpu &&
+             run_queue_depth > processors_) {
+    // Saturated and oversubscribed: shed one slot as each job finishes.
+    current_ = std::max(1, current_ - 1);
+  } else if (cpu_utilization < kIdleCpu) {
+    // Headroom: probe back up one slot at a time.
+    current_ = std::min(max_parallelism_, current_ + 1);
+  }
+  return current_;
+}
+
+bool ParallelismGovernor::SampleCpuUtilization(double* utilization) {
+  FILE* file = fopen("/proc/stat", "r");
+  if (!file)
+    return false;
+  // cpu  user nice system idle iowait irq softirq steal ...
+  unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0,
+                     irq = 0, softirq = 0, steal = 0;
+  int fields = fscanf(file, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+                      &user, &nice, &system, &idle, &iowait, &irq, &softirq,
+                      &steal);
+  fclose(file);
+  if (fields < 4)
+    return false;
+
+  uint64_t busy = user + nice + system + irq + softirq + steal;
+  uint64_t total = busy + idle + iowait;
+  uint64_t busy_delta = busy - prev_busy_jiffies_;
+  uint64_t total_delta = total - prev_total_jiffies_;
+  bool seeded = prev_total_jiffies_ != 0;
+  prev_busy_jiffies_ = busy;
+  prev_total_jiffies_ = total;
+  if (!seeded || total_delta == 0)
+    return false;
+  *utilization = (double)busy_delta / (double)total_delta;
+  return true;
+}
+
+int ParallelismGovernor::SampleRunQueueDepth() {
+  FILE* file = fopen("/proc/stat", "r");
+  if (!file)
+    return -1;
+  int depth = -1;
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    if (sscanf(line, "procs_running %d", &depth) == 1)
+      break;
+  }
+  fclose(file);
+  return depth;
+}
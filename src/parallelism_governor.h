@@ -0,0 +1,67 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_PARALLELISM_GOVERNOR_H_
+#define NINJA_PARALLELISM_GOVERNOR_H_
+
+#include <stdint.h>
+
+/// ParallelismGovernor adjusts the effective -j cap continuously while a
+/// build runs.  The classic -l gate compares the 1-minute load average,
+/// which lags far behind the build: by the time the average reflects an
+/// overload the queue has been thrashing for tens of seconds, and once
+/// it reflects the recovery the cores have been idle just as long.
+///
+/// Instead the governor samples, at sub-second granularity,
+///   - CPU utilization from /proc/stat deltas,
+///   - memory pressure from /proc/pressure/memory (PSI avg10), and
+///   - run-queue depth from procs_running in /proc/stat,
+/// and walks the cap down under pressure (quickly for memory, which
+/// precedes swapping) and back up one slot at a time when the machine
+/// has headroom.  On platforms without these interfaces it degrades to
+/// the old behavior: the cap drops only while GetLoadAverage() exceeds
+/// the -l threshold.
+struct ParallelismGovernor {
+  /// Start governing between 1 and \a max_parallelism jobs.
+  /// \a max_load_average is the -l value, used only by the non-Linux
+  /// fallback.
+  void Enable(int max_parallelism, double max_load_average);
+
+  bool enabled() const { return max_parallelism_ > 0; }
+
+  /// The current dispatch cap; re-samples at most every 250 ms.
+  int EffectiveParallelism();
+
+  /// The control law, separated from the sampling for tests: feed one
+  /// sample and return the adjusted cap.  \a cpu_utilization and
+  /// \a memory_pressure are in [0, 1]; \a run_queue_depth counts
+  /// runnable tasks; negative values mean "unavailable".
+  int Adjust(double cpu_utilization, double memory_pressure,
+             int run_queue_depth);
+
+ private:
+  bool SampleCpuUtilization(double* utilization);
+  int SampleRunQueueDepth();
+
+  int max_parallelism_ = 0;
+  int current_ = 0;
+  double max_load_average_ = -0.0f;
+  int processors_ = 0;
+  int64_t last_sample_ms_ = 0;
+  /// Previous /proc/stat cpu counters, for utilization deltas.
+  uint64_t prev_busy_jiffies_ = 0;
+  uint64_t prev_total_jiffies_ = 0;
+};
+
+#endif  // NINJA_PARALLELISM_GOVERNOR_H_
@@ -0,0 +1,58 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parallelism_governor.h"
+
+#include <climits>
+
+#include "test.h"
+
+TEST(ParallelismGovernorTest, BacksOffUnderMemoryPressure) {
+  ParallelismGovernor governor;
+  governor.Enable(16, -0.0f);
+  // A quarter of the cap goes per pressured sample.
+  EXPECT_EQ(12, governor.Adjust(0.5, 0.5, 0));
+  EXPECT_EQ(9, governor.Adjust(0.5, 0.5, 0));
+  // Never below one job.
+  for (int i = 0; i < 32; ++i)
+    governor.Adjust(0.5, 0.5, 0);
+  EXPECT_EQ(1, governor.Adjust(0.5, 0.5, 0));
+}
+
+TEST(ParallelismGovernorTest, ShedsOneSlotWhenSaturated) {
+  ParallelismGovernor governor;
+  governor.Enable(8, -0.0f);
+  // CPU pegged and more runnable tasks than processors: -1 per sample.
+  EXPECT_EQ(7, governor.Adjust(1.0, 0.0, INT_MAX));
+  EXPECT_EQ(6, governor.Adjust(1.0, 0.0, INT_MAX));
+}
+
+TEST(ParallelismGovernorTest, ProbesBackUpWithHeadroom) {
+  ParallelismGovernor governor;
+  governor.Enable(8, -0.0f);
+  governor.Adjust(0.5, 0.5, 0);  // Down to 6.
+  EXPECT_EQ(7, governor.Adjust(0.5, 0.0, 0));
+  EXPECT_EQ(8, governor.Adjust(0.5, 0.0, 0));
+  // Never above the configured -j.
+  EXPECT_EQ(8, governor.Adjust(0.5, 0.0, 0));
+}
+
+TEST(ParallelismGovernorTest, HoldsSteadyInBetween) {
+  ParallelismGovernor governor;
+  governor.Enable(8, -0.0f);
+  governor.Adjust(0.5, 0.5, 0);  // Down to 6.
+  // Busy but not saturated, no memory pressure: no change.
+  EXPECT_EQ(6, governor.Adjust(0.9, 0.0, 0));
+  EXPECT_EQ(6, governor.Adjust(0.9, 0.0, 0));
+}
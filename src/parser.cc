@@ -16,26 +16,40 @@
 
 #include "disk_interface.h"
 #include "metrics.h"
+#include "state.h"
 #include "string_concat.h"
 
 bool Parser::Load(const std::string& filename, std::string* err, Lexer* parent) {
   METRIC_RECORD(".ninja parse");
-  std::string contents;
+  std::unique_ptr<LoadedFile> file;
   std::string read_err;
-  if (file_reader_->ReadFile(filename, &contents, &read_err) !=
-      FileReader::Okay) {
+  if (file_reader_->LoadFile(filename, &file, &read_err) != FileReader::Okay) {
     *err = string_concat("loading '", filename, "': ", read_err);
     if (parent)
       parent->Error(std::string(*err), err);
     return false;
   }
 
-  // The lexer needs a nul byte at the end of its input, to know when it's done.
-  // It takes a StringPiece, and StringPiece's std::string constructor uses
-  // std::string::data().  data()'s return value isn't guaranteed to be
-  // null-terminated (although in practice - libc++, libstdc++, msvc's stl --
-  // it is, and C++11 demands that too), so add an explicit nul byte.
-  contents.resize(contents.size() + 1);
+  return LoadPreloaded(filename, std::move(file), err);
+}
+
+bool Parser::LoadPreloaded(const std::string& filename,
+                           std::unique_ptr<LoadedFile> file,
+                           std::string* err) {
+  std::string_view contents = file->content();
+
+  // Size the node table from the manifest size so parsing does not rehash
+  // it mid-stream; large generated manifests run on the order of one
+  // unique path per hundred bytes, and over-reserving only costs empty
+  // table slots.
+  state_->ReserveNodes(contents.size() / 128);
+
+  // Hand ownership of the backing storage (possibly a memory mapping) to
+  // State so anything parsed out of it may reference the data in place for
+  // the rest of the run instead of copying.
+  state_->loaded_files_.push_back(std::move(file));
+  state_->manifest_files_.push_back({ filename, -1, false, nullptr });
+  file_index_ = static_cast<int32_t>(state_->manifest_files_.size()) - 1;
 
   return Parse(filename, contents, err);
 }
@@ -15,11 +15,14 @@
 #ifndef NINJA_PARSER_H_
 #define NINJA_PARSER_H_
 
+#include <memory>
 #include <string>
+#include <string_view>
 
 #include "lexer.h"
 
 struct FileReader;
+struct LoadedFile;
 struct State;
 
 /// Base class for parsers.
@@ -30,6 +33,11 @@ struct Parser {
   /// Load and parse a file.
   bool Load(const std::string& filename, std::string* err, Lexer* parent = nullptr);
 
+  /// Parse a file whose contents were already loaded, e.g. read ahead on
+  /// a worker thread.  Takes ownership of \a file.
+  bool LoadPreloaded(const std::string& filename,
+                     std::unique_ptr<LoadedFile> file, std::string* err);
+
 protected:
   /// If the next token is not \a expected, produce an error std::string
   /// saying "expected foo, got bar".
@@ -38,10 +46,13 @@ protected:
   State* state_;
   FileReader* file_reader_;
   Lexer lexer_;
+  /// Index of the file this parser is loading in State::manifest_files_,
+  /// or -1 when parsing from a string (tests).
+  int32_t file_index_ = -1;
 
 private:
   /// Parse a file, given its contents as a string.
-  virtual bool Parse(const std::string& filename, const std::string& input,
+  virtual bool Parse(const std::string& filename, std::string_view input,
                      std::string* err) = 0;
 };
 
@@ -0,0 +1,163 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_PATH_MAP_H_
+#define NINJA_PATH_MAP_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct Node;
+
+/// An open-addressing hash table mapping interned node paths to Nodes,
+/// purpose-built for State::paths_.  A flat control-byte array caches an
+/// 8-bit fragment of each key's hash, so a probe usually touches a single
+/// cache line and full key comparisons only happen on fragment matches;
+/// std::unordered_map pays a pointer chase per probe instead.  Paths are
+/// never removed from a State, so there are no tombstones to handle.
+///
+/// Keys must outlive the map; State interns them into its path arena.
+struct PathMap {
+  using value_type = std::pair<std::string_view, Node*>;
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t bucket_count() const { return ctrl_.size(); }
+
+  /// Size the table so \a count insertions will not rehash.
+  void reserve(size_t count) {
+    if (count * 8 > bucket_count() * 7)
+      Rehash(NormalizeCapacity(count));
+  }
+
+  /// Iterates occupied slots; table order, not insertion order.
+  struct const_iterator {
+    const value_type& operator*() const { return map_->slots_[index_]; }
+    const value_type* operator->() const { return &map_->slots_[index_]; }
+    const_iterator& operator++() {
+      ++index_;
+      SkipEmpty();
+      return *this;
+    }
+    bool operator==(const const_iterator& other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return index_ != other.index_;
+    }
+
+   private:
+    friend struct PathMap;
+    const_iterator(const PathMap* map, size_t index)
+        : map_(map), index_(index) {
+      SkipEmpty();
+    }
+    void SkipEmpty() {
+      while (index_ < map_->ctrl_.size() && map_->ctrl_[index_] == kEmpty)
+        ++index_;
+    }
+    const PathMap* map_;
+    size_t index_;
+  };
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, ctrl_.size()); }
+
+  const_iterator find(std::string_view key) const {
+    if (empty())
+      return end();
+    size_t hash = Hash(key);
+    uint8_t fragment = Fragment(hash);
+    size_t mask = ctrl_.size() - 1;
+    for (size_t index = hash & mask;; index = (index + 1) & mask) {
+      if (ctrl_[index] == kEmpty)
+        return end();
+      if (ctrl_[index] == fragment && slots_[index].first == key)
+        return const_iterator(this, index);
+    }
+  }
+
+  /// Find or insert \a key, returning its (possibly null) value slot.
+  Node*& operator[](std::string_view key) {
+    if ((size_ + 1) * 8 > bucket_count() * 7)
+      Rehash(NormalizeCapacity(size_ + 1));
+    size_t hash = Hash(key);
+    uint8_t fragment = Fragment(hash);
+    size_t mask = ctrl_.size() - 1;
+    for (size_t index = hash & mask;; index = (index + 1) & mask) {
+      if (ctrl_[index] == kEmpty) {
+        ctrl_[index] = fragment;
+        slots_[index] = value_type(key, nullptr);
+        ++size_;
+        return slots_[index].second;
+      }
+      if (ctrl_[index] == fragment && slots_[index].first == key)
+        return slots_[index].second;
+    }
+  }
+
+ private:
+  static constexpr uint8_t kEmpty = 0;
+  static constexpr size_t kMinCapacity = 256;
+
+  static size_t Hash(std::string_view key) {
+    return std::hash<std::string_view>()(key);
+  }
+
+  /// The cached control byte: bits of the hash not used for the bucket
+  /// index, forced non-zero so it never collides with kEmpty.
+  static uint8_t Fragment(size_t hash) {
+    uint8_t fragment = static_cast<uint8_t>(hash >> (sizeof(size_t) * 8 - 8));
+    return fragment == kEmpty ? 1 : fragment;
+  }
+
+  /// Smallest power of two holding \a count entries below the 7/8 load
+  /// factor.
+  static size_t NormalizeCapacity(size_t count) {
+    size_t capacity = kMinCapacity;
+    while (count * 8 > capacity * 7)
+      capacity *= 2;
+    return capacity;
+  }
+
+  void Rehash(size_t new_capacity) {
+    if (new_capacity <= bucket_count())
+      return;
+    std::vector<uint8_t> old_ctrl = std::move(ctrl_);
+    std::vector<value_type> old_slots = std::move(slots_);
+    ctrl_.assign(new_capacity, kEmpty);
+    slots_.assign(new_capacity, value_type());
+    size_t mask = new_capacity - 1;
+    for (size_t i = 0; i < old_ctrl.size(); ++i) {
+      if (old_ctrl[i] == kEmpty)
+        continue;
+      size_t hash = Hash(old_slots[i].first);
+      size_t index = hash & mask;
+      while (ctrl_[index] != kEmpty)
+        index = (index + 1) & mask;
+      ctrl_[index] = Fragment(hash);
+      slots_[index] = old_slots[i];
+    }
+  }
+
+  std::vector<uint8_t> ctrl_;
+  std::vector<value_type> slots_;
+  size_t size_ = 0;
+};
+
+#endif  // NINJA_PATH_MAP_H_
@@ -0,0 +1,87 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "path_map.h"
+
+#include <string>
+#include <vector>
+
+#include "graph.h"
+#include "test.h"
+
+namespace {
+
+TEST(PathMap, InsertAndFind) {
+  NodeScanState scan_a;
+  NodeScanState scan_b;
+  Node a("a", 0, &scan_a);
+  Node b("b", 0, &scan_b);
+  PathMap map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.find("a") == map.end());
+
+  map[a.path()] = &a;
+  map[b.path()] = &b;
+  EXPECT_EQ(2u, map.size());
+  ASSERT_TRUE(map.find("a") != map.end());
+  EXPECT_EQ(&a, map.find("a")->second);
+  EXPECT_EQ(&b, map.find("b")->second);
+  EXPECT_TRUE(map.find("c") == map.end());
+
+  // Indexing an existing key must return the same slot, not insert.
+  EXPECT_EQ(&a, map[a.path()]);
+  EXPECT_EQ(2u, map.size());
+}
+
+TEST(PathMap, GrowAndIterate) {
+  const int kCount = 10000;
+  std::vector<std::string> keys;
+  keys.reserve(kCount);
+  for (int i = 0; i < kCount; ++i)
+    keys.push_back("obj/file" + std::to_string(i) + ".o");
+
+  NodeScanState scan;
+  Node node("node", 0, &scan);
+  PathMap map;
+  for (int i = 0; i < kCount; ++i)
+    map[keys[i]] = &node;
+  EXPECT_EQ((size_t)kCount, map.size());
+  for (int i = 0; i < kCount; ++i)
+    ASSERT_TRUE(map.find(keys[i]) != map.end());
+
+  size_t seen = 0;
+  for (const auto& [path, value] : map) {
+    EXPECT_FALSE(path.empty());
+    EXPECT_EQ(&node, value);
+    ++seen;
+  }
+  EXPECT_EQ(map.size(), seen);
+}
+
+TEST(PathMap, ReserveAvoidsRehash) {
+  std::vector<std::string> keys;
+  for (int i = 0; i < 1000; ++i)
+    keys.push_back(std::to_string(i));
+
+  NodeScanState scan;
+  Node node("node", 0, &scan);
+  PathMap map;
+  map.reserve(keys.size());
+  size_t buckets = map.bucket_count();
+  for (const std::string& key : keys)
+    map[key] = &node;
+  EXPECT_EQ(buckets, map.bucket_count());
+}
+
+}  // anonymous namespace
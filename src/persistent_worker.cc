@@ -0,0 +1,273 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "persistent_worker.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "subprocess.h"
+#include "util.h"
+
+extern char** environ;
+
+namespace {
+
+/// Every worker response ends with a line "<<<done N" where N is the
+/// request's exit code.
+const char kResponseTrailer[] = "<<<done ";
+
+/// Write all of \a data to \a fd, retrying on EINTR.  Returns false on
+/// any other error (notably EPIPE when the worker has died).
+bool WriteAll(int fd, const std::string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = write(fd, data.data() + written, data.size() - written);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    written += n;
+  }
+  return true;
+}
+
+}  // anonymous namespace
+
+PersistentWorkerPool::~PersistentWorkerPool() {
+  Clear();
+}
+
+bool PersistentWorkerPool::Submit(const std::string& worker_command,
+                                  const std::string& request, Edge* edge) {
+  std::string line = request;
+  line.push_back('\n');
+
+  Worker* worker = nullptr;
+  for (const auto & candidate : workers_) {
+    if (candidate->edge == nullptr && candidate->key == worker_command) {
+      worker = candidate;
+      break;
+    }
+  }
+
+  // An idle worker may have died since its last request; treat a failed
+  // write as death and fall through to a fresh spawn.
+  if (worker && !WriteAll(worker->to_fd, line)) {
+    Reap(worker);
+    worker = nullptr;
+  }
+
+  if (!worker) {
+    worker = Spawn(worker_command);
+    if (!worker)
+      return false;
+    if (!WriteAll(worker->to_fd, line)) {
+      Reap(worker);
+      return false;
+    }
+  }
+
+  worker->edge = edge;
+  ++busy_;
+  return true;
+}
+
+bool PersistentWorkerPool::NextFinished(Response* response) {
+  if (finished_.empty())
+    return false;
+  *response = std::move(finished_.front());
+  finished_.pop();
+  return true;
+}
+
+std::vector<Edge*> PersistentWorkerPool::GetActiveEdges() const {
+  std::vector<Edge*> edges;
+  for (const auto & worker : workers_) {
+    if (worker->edge)
+      edges.push_back(worker->edge);
+  }
+  return edges;
+}
+
+void PersistentWorkerPool::Clear() {
+  while (!workers_.empty())
+    Reap(workers_.back());
+}
+
+PersistentWorkerPool::Worker* PersistentWorkerPool::Spawn(
+    const std::string& worker_command) {
+  // Writing a request to a worker that exited would otherwise deliver
+  // SIGPIPE; we detect death via the failed write instead.
+  static bool sigpipe_ignored = false;
+  if (!sigpipe_ignored) {
+    signal(SIGPIPE, SIG_IGN);
+    sigpipe_ignored = true;
+  }
+
+  int to_pipe[2];    // We write requests to to_pipe[1].
+  int from_pipe[2];  // We read responses from from_pipe[0].
+  if (pipe(to_pipe) < 0)
+    Fatal("pipe: %s", strerror(errno));
+  if (pipe(from_pipe) < 0)
+    Fatal("pipe: %s", strerror(errno));
+  SetCloseOnExec(to_pipe[1]);
+  SetCloseOnExec(from_pipe[0]);
+
+  posix_spawn_file_actions_t action;
+  int err = posix_spawn_file_actions_init(&action);
+  if (err != 0)
+    Fatal("posix_spawn_file_actions_init: %s", strerror(err));
+  err = posix_spawn_file_actions_adddup2(&action, to_pipe[0], 0);
+  if (err != 0)
+    Fatal("posix_spawn_file_actions_adddup2: %s", strerror(err));
+  err = posix_spawn_file_actions_adddup2(&action, from_pipe[1], 1);
+  if (err != 0)
+    Fatal("posix_spawn_file_actions_adddup2: %s", strerror(err));
+  err = posix_spawn_file_actions_adddup2(&action, from_pipe[1], 2);
+  if (err != 0)
+    Fatal("posix_spawn_file_actions_adddup2: %s", strerror(err));
+  err = posix_spawn_file_actions_addclose(&action, to_pipe[0]);
+  if (err != 0)
+    Fatal("posix_spawn_file_actions_addclose: %s", strerror(err));
+  err = posix_spawn_file_actions_addclose(&action, from_pipe[1]);
+  if (err != 0)
+    Fatal("posix_spawn_file_actions_addclose: %s", strerror(err));
+
+  posix_spawnattr_t attr;
+  err = posix_spawnattr_init(&attr);
+  if (err != 0)
+    Fatal("posix_spawnattr_init: %s", strerror(err));
+
+  // Workers join their own process group like ordinary non-console
+  // subprocesses, so ctrl-c won't reach them, and run with the signal
+  // mask ninja had at startup.
+  short flags = POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK;
+  err = posix_spawnattr_setsigmask(&attr, &subprocs_->old_mask_);
+  if (err != 0)
+    Fatal("posix_spawnattr_setsigmask: %s", strerror(err));
+  err = posix_spawnattr_setflags(&attr, flags);
+  if (err != 0)
+    Fatal("posix_spawnattr_setflags: %s", strerror(err));
+
+  pid_t pid = -1;
+  const char* spawned_args[] = { "/bin/sh", "-c", worker_command.c_str(),
+                                 nullptr };
+  err = posix_spawn(&pid, "/bin/sh", &action, &attr,
+        const_cast<char**>(spawned_args), environ);
+  if (err != 0)
+    Fatal("posix_spawn: %s", strerror(err));
+
+  err = posix_spawnattr_destroy(&attr);
+  if (err != 0)
+    Fatal("posix_spawnattr_destroy: %s", strerror(err));
+  err = posix_spawn_file_actions_destroy(&action);
+  if (err != 0)
+    Fatal("posix_spawn_file_actions_destroy: %s", strerror(err));
+
+  close(to_pipe[0]);
+  close(from_pipe[1]);
+
+  Worker* worker = new Worker;
+  worker->pid = pid;
+  worker->to_fd = to_pipe[1];
+  worker->from_fd = from_pipe[0];
+  worker->key = worker_command;
+  workers_.push_back(worker);
+  subprocs_->AddExtraFd(worker->from_fd,
+                        [this, worker]() { OnReadable(worker); });
+  return worker;
+}
+
+void PersistentWorkerPool::OnReadable(Worker* worker) {
+  char buf[4 << 10];
+  ssize_t len = read(worker->from_fd, buf, sizeof(buf));
+  if (len < 0) {
+    if (errno == EINTR)
+      return;
+    Fatal("read: %s", strerror(errno));
+  }
+  if (len == 0) {
+    // EOF: the worker died.  Whatever it managed to emit is the best
+    // diagnostic we have for the in-flight edge.
+    if (worker->edge)
+      Finish(worker, ExitFailure, std::move(worker->buf));
+    Reap(worker);
+    return;
+  }
+  worker->buf.append(buf, len);
+
+  // A response is complete once a trailer line has arrived.  Only scan
+  // line starts: output containing the trailer mid-line is passed through.
+  size_t line_start = 0;
+  for (;;) {
+    if (worker->buf.compare(line_start, strlen(kResponseTrailer),
+                            kResponseTrailer) == 0) {
+      size_t line_end = worker->buf.find('\n', line_start);
+      if (line_end == std::string::npos)
+        return;  // Partial trailer line; wait for more bytes.
+      int exit_code =
+          atoi(worker->buf.c_str() + line_start + strlen(kResponseTrailer));
+      std::string output = worker->buf.substr(0, line_start);
+      worker->buf.erase(0, line_end + 1);
+      Finish(worker, exit_code == 0 ? ExitSuccess : ExitFailure,
+             std::move(output));
+      return;
+    }
+    line_start = worker->buf.find('\n', line_start);
+    if (line_start == std::string::npos)
+      return;
+    ++line_start;
+  }
+}
+
+void PersistentWorkerPool::Finish(Worker* worker, ExitStatus status,
+                                  std::string output) {
+  Response response;
+  response.edge = worker->edge;
+  response.output = std::move(output);
+  response.status = status;
+  finished_.push(std::move(response));
+  worker->edge = nullptr;
+  --busy_;
+}
+
+void PersistentWorkerPool::Reap(Worker* worker) {
+  subprocs_->RemoveExtraFd(worker->from_fd);
+  close(worker->to_fd);
+  close(worker->from_fd);
+  kill(-worker->pid, SIGTERM);
+  if (waitpid(worker->pid, nullptr, 0) < 0)
+    Fatal("waitpid(%d): %s", worker->pid, strerror(errno));
+  for (std::vector<Worker*>::iterator i = workers_.begin();
+       i != workers_.end(); ++i) {
+    if (*i == worker) {
+      workers_.erase(i);
+      break;
+    }
+  }
+  delete worker;
+}
+
+#endif  // !_WIN32
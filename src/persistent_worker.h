@@ -0,0 +1,113 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_PERSISTENT_WORKER_H_
+#define NINJA_PERSISTENT_WORKER_H_
+
+#include <queue>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+#include "exit_status.h"
+
+struct Edge;
+struct SubprocessSet;
+
+#ifndef _WIN32
+
+/// PersistentWorkerPool keeps tool processes alive across edges so that
+/// tools with expensive startup (JVM-based codegen, linters, bundlers)
+/// pay it once per build instead of once per edge.
+///
+/// A rule opts in with the reserved "worker_command" binding.  The pool
+/// spawns that command once (per distinct worker_command value), keeps
+/// its stdin/stdout open, and feeds it one request per edge: the edge's
+/// evaluated $command followed by a newline.  The worker replies with
+/// arbitrary output bytes terminated by a line of the form
+///
+///     <<<done N
+///
+/// where N is the request's exit code.  This is the same
+/// request-per-line contract as Bazel's persistent workers, minus the
+/// protobuf framing, so a thin shell or JVM shim adapts existing
+/// workers.
+///
+/// Worker stdout/stderr fds are registered with the owning
+/// SubprocessSet via AddExtraFd(), so responses are demultiplexed by
+/// the same DoWork() loop that watches ordinary subprocess pipes.
+/// Worker death (EOF before the trailer) fails the in-flight edge with
+/// whatever output was buffered.  POSIX only; on Windows the rule
+/// binding is ignored and edges run as plain subprocesses.
+struct PersistentWorkerPool {
+  explicit PersistentWorkerPool(SubprocessSet* subprocs)
+      : subprocs_(subprocs) {}
+  ~PersistentWorkerPool();
+
+  /// A completed worker request, analogous to a reaped Subprocess.
+  struct Response {
+    Edge* edge = nullptr;
+    std::string output;
+    ExitStatus status = ExitFailure;
+  };
+
+  /// Dispatch \a request (the edge's evaluated command) to an idle
+  /// worker running \a worker_command, spawning one if none exists.
+  /// Returns false if a fresh worker could not be spawned.
+  bool Submit(const std::string& worker_command, const std::string& request,
+              Edge* edge);
+
+  /// Pop the next completed response, if any.  Returns false when no
+  /// response is pending.  Completion is driven by SubprocessSet::DoWork().
+  bool NextFinished(Response* response);
+
+  /// Number of requests submitted but not yet retrieved via
+  /// NextFinished(); counts toward the runner's parallelism.
+  size_t in_flight() const { return busy_ + finished_.size(); }
+
+  /// Edges currently being processed by a worker.
+  std::vector<Edge*> GetActiveEdges() const;
+
+  /// Kill all workers; in-flight edges are abandoned.
+  void Clear();
+
+ private:
+  struct Worker {
+    pid_t pid = -1;
+    int to_fd = -1;    ///< Our write end of the worker's stdin.
+    int from_fd = -1;  ///< Our read end of the worker's stdout+stderr.
+    std::string key;   ///< The worker_command this process was spawned with.
+    std::string buf;   ///< Response bytes accumulated so far.
+    Edge* edge = nullptr;  ///< Edge of the in-flight request, if any.
+  };
+
+  Worker* Spawn(const std::string& worker_command);
+  /// DoWork() callback: read from \a worker, complete its request if the
+  /// trailer arrived, tear the worker down on EOF.
+  void OnReadable(Worker* worker);
+  void Finish(Worker* worker, ExitStatus status, std::string output);
+  void Reap(Worker* worker);
+
+  SubprocessSet* subprocs_;
+  std::vector<Worker*> workers_;
+  std::queue<Response> finished_;
+  size_t busy_ = 0;
+};
+
+#endif  // !_WIN32
+
+#endif  // NINJA_PERSISTENT_WORKER_H_
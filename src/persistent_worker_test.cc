@@ -0,0 +1,99 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _WIN32
+
+#include "persistent_worker.h"
+
+#include "graph.h"
+#include "subprocess.h"
+#include "test.h"
+
+namespace {
+
+/// A minimal worker speaking the splinter protocol: echo each request
+/// line back (tagged with this worker's pid) and report success.
+const char kEchoWorker[] =
+    "while read line; do echo \"$$: $line\"; echo '<<<done 0'; done";
+
+struct PersistentWorkerTest : public testing::Test {
+  SubprocessSet subprocs_;
+  PersistentWorkerPool workers_{ &subprocs_ };
+
+  bool WaitForResponse(PersistentWorkerPool::Response* response) {
+    while (!workers_.NextFinished(response)) {
+      if (subprocs_.DoWork())
+        return false;  // Interrupted.
+    }
+    return true;
+  }
+};
+
+}  // anonymous namespace
+
+TEST_F(PersistentWorkerTest, RoundTrip) {
+  Edge edge;
+  ASSERT_TRUE(workers_.Submit(kEchoWorker, "hello", &edge));
+  EXPECT_EQ(1u, workers_.in_flight());
+
+  PersistentWorkerPool::Response response;
+  ASSERT_TRUE(WaitForResponse(&response));
+  EXPECT_EQ(&edge, response.edge);
+  EXPECT_EQ(ExitSuccess, response.status);
+  EXPECT_NE(std::string::npos, response.output.find(": hello\n"));
+  EXPECT_EQ(0u, workers_.in_flight());
+}
+
+TEST_F(PersistentWorkerTest, ReusesWorker) {
+  // The pid each response is tagged with shows whether the same process
+  // served both requests.
+  Edge edge1, edge2;
+  PersistentWorkerPool::Response response1, response2;
+  ASSERT_TRUE(workers_.Submit(kEchoWorker, "one", &edge1));
+  ASSERT_TRUE(WaitForResponse(&response1));
+  ASSERT_TRUE(workers_.Submit(kEchoWorker, "two", &edge2));
+  ASSERT_TRUE(WaitForResponse(&response2));
+
+  std::string pid1 = response1.output.substr(0, response1.output.find(':'));
+  std::string pid2 = response2.output.substr(0, response2.output.find(':'));
+  EXPECT_EQ(pid1, pid2);
+  EXPECT_EQ(&edge2, response2.edge);
+}
+
+TEST_F(PersistentWorkerTest, FailingRequest) {
+  Edge edge;
+  ASSERT_TRUE(workers_.Submit(
+      "while read line; do echo oops; echo '<<<done 3'; done", "go", &edge));
+
+  PersistentWorkerPool::Response response;
+  ASSERT_TRUE(WaitForResponse(&response));
+  EXPECT_EQ(ExitFailure, response.status);
+  EXPECT_EQ("oops\n", response.output);
+}
+
+TEST_F(PersistentWorkerTest, WorkerDeath) {
+  // This worker exits after one request without sending the trailer;
+  // the buffered output becomes the edge's diagnostic.
+  Edge edge;
+  ASSERT_TRUE(workers_.Submit("read line; echo dying", "go", &edge));
+
+  PersistentWorkerPool::Response response;
+  ASSERT_TRUE(WaitForResponse(&response));
+  EXPECT_EQ(&edge, response.edge);
+  EXPECT_EQ(ExitFailure, response.status);
+  EXPECT_EQ("dying\n", response.output);
+  EXPECT_EQ(0u, workers_.in_flight());
+}
+
+#endif  // !_WIN32
@@ -0,0 +1,77 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "resource_sampler.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util.h"
+
+namespace {
+
+const std::chrono::milliseconds kRefreshInterval(100);
+
+/// MemAvailable from /proc/meminfo, in bytes; -1 when unavailable.
+int64_t ReadAvailableMemory() {
+  FILE* file = fopen("/proc/meminfo", "r");
+  if (!file)
+    return -1;
+  int64_t kilobytes = -1;
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    if (sscanf(line, "MemAvailable: %" SCNd64 " kB", &kilobytes) == 1)
+      break;
+  }
+  fclose(file);
+  return kilobytes < 0 ? -1 : kilobytes * 1024;
+}
+
+/// Memory PSI (some avg10) scaled to [0, 1]; -1 when unavailable.
+double ReadMemoryPressure() {
+  FILE* file = fopen("/proc/pressure/memory", "r");
+  if (!file)
+    return -1;
+  // some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+  double avg10 = -1;
+  if (fscanf(file, "some avg10=%lf", &avg10) == 1)
+    avg10 /= 100.0;
+  fclose(file);
+  return avg10;
+}
+
+}  // anonymous namespace
+
+const ResourceSample& ResourceSampler::Get() {
+  std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  if (!has_sample_ || now - last_refresh_ >= kRefreshInterval) {
+    last_refresh_ = now;
+    has_sample_ = true;
+    Refresh();
+  }
+  return sample_;
+}
+
+void ResourceSampler::Refresh() {
+  sample_.load_average = GetLoadAverage();
+  sample_.available_memory = ReadAvailableMemory();
+  sample_.memory_pressure = ReadMemoryPressure();
+}
+
+ResourceSampler* ResourceSampler::Shared() {
+  static ResourceSampler* sampler = new ResourceSampler;
+  return sampler;
+}
@@ -0,0 +1,55 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_RESOURCE_SAMPLER_H_
+#define NINJA_RESOURCE_SAMPLER_H_
+
+#include <stdint.h>
+
+#include <chrono>
+
+/// One snapshot of the machine's resources.  Fields the platform cannot
+/// provide keep their "unavailable" defaults.
+struct ResourceSample {
+  /// 1-minute load average; -0.0 on error, matching GetLoadAverage().
+  double load_average = -0.0;
+  /// MemAvailable from /proc/meminfo, in bytes; -1 when unavailable.
+  int64_t available_memory = -1;
+  /// Memory PSI (some avg10) from /proc/pressure/memory, scaled to
+  /// [0, 1]; -1 when unavailable.
+  double memory_pressure = -1.0;
+};
+
+/// Serves ResourceSamples from a cache refreshed at most every 100ms of
+/// monotonic time.  The dispatch path asks about the machine once per
+/// potential dispatch -- tens of thousands of times per build -- and
+/// several consumers ask in the same instant (the -l gate, the
+/// parallelism governor, the memory-aware scheduler); reading the kernel
+/// interfaces once per interval makes those checks effectively free.
+struct ResourceSampler {
+  /// The current sample, refreshing the cache if it is stale.
+  const ResourceSample& Get();
+
+  /// The process-wide sampler all consumers share.
+  static ResourceSampler* Shared();
+
+ private:
+  void Refresh();
+
+  ResourceSample sample_;
+  bool has_sample_ = false;
+  std::chrono::steady_clock::time_point last_refresh_;
+};
+
+#endif  // NINJA_RESOURCE_SAMPLER_H_
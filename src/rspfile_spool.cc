@@ -0,0 +1,146 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rspfile_spool.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+#include "string_concat.h"
+
+using namespace std;
+
+RspfileSpool* RspfileSpool::instance_ = nullptr;
+
+#ifndef _WIN32
+
+namespace {
+
+/// The fastest writable RAM-backed directory available.  Both
+/// $XDG_RUNTIME_DIR and /dev/shm are tmpfs on any mainstream distro;
+/// /tmp usually is too, and even when it is not it beats NFS outputs.
+const char* SpoolParent() {
+  const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+  if (runtime_dir && runtime_dir[0] && access(runtime_dir, W_OK) == 0)
+    return runtime_dir;
+  if (access("/dev/shm", W_OK) == 0)
+    return "/dev/shm";
+  return "/tmp";
+}
+
+}  // anonymous namespace
+
+void RspfileSpool::Enable() {
+  if (instance_)
+    return;
+  std::string dir = string_concat(SpoolParent(), "/ninja-rsp-XXXXXX");
+  if (!mkdtemp(&dir[0]))
+    return;  // Nowhere to spool; builds keep writing rspfiles on disk.
+  instance_ = new RspfileSpool;
+  instance_->dir_ = dir;
+}
+
+void RspfileSpool::Shutdown() {
+  if (!instance_)
+    return;
+  // Spooled files of failed edges are still live here; sweep them along
+  // with the directory.
+  for (std::map<std::string, std::string>::const_iterator i =
+           instance_->live_.begin();
+       i != instance_->live_.end(); ++i)
+    unlink(i->second.c_str());
+  rmdir(instance_->dir_.c_str());
+  delete instance_;
+  instance_ = nullptr;
+}
+
+bool RspfileSpool::Write(const std::string& rspfile,
+                         const std::string& content, std::string* err) {
+  std::string& path = live_[rspfile];
+  if (path.empty())
+    path = string_concat(dir_, "/", std::to_string(sequence_++), ".rsp");
+  FILE* fp = fopen(path.c_str(), "w");
+  if (fp == nullptr) {
+    *err = string_concat("opening spooled rspfile ", path, ": ",
+                         strerror(errno));
+    live_.erase(rspfile);
+    return false;
+  }
+  if (fwrite(content.data(), 1, content.size(), fp) < content.size()) {
+    *err = string_concat("writing spooled rspfile ", path, ": ",
+                         strerror(errno));
+    fclose(fp);
+    unlink(path.c_str());
+    live_.erase(rspfile);
+    return false;
+  }
+  if (fclose(fp) == EOF) {
+    *err = string_concat("closing spooled rspfile ", path, ": ",
+                         strerror(errno));
+    unlink(path.c_str());
+    live_.erase(rspfile);
+    return false;
+  }
+  return true;
+}
+
+std::string RspfileSpool::Map(const std::string& depfile) {
+  std::string& path = live_[depfile];
+  if (path.empty())
+    path = string_concat(dir_, "/", std::to_string(sequence_++), ".d");
+  return path;
+}
+
+std::string RspfileSpool::PathFor(const std::string& rspfile) const {
+  std::map<std::string, std::string>::const_iterator i = live_.find(rspfile);
+  return i != live_.end() ? i->second : std::string();
+}
+
+void RspfileSpool::Remove(const std::string& rspfile) {
+  std::map<std::string, std::string>::iterator i = live_.find(rspfile);
+  if (i == live_.end())
+    return;
+  unlink(i->second.c_str());
+  live_.erase(i);
+}
+
+#else  // _WIN32
+
+// Response files on Windows stay in the output tree; the spool targets
+// the NFS write+delete latency of POSIX build farms.
+void RspfileSpool::Enable() {}
+
+void RspfileSpool::Shutdown() {}
+
+bool RspfileSpool::Write(const std::string&, const std::string&,
+                         std::string*) {
+  return false;
+}
+
+std::string RspfileSpool::Map(const std::string&) {
+  return std::string();
+}
+
+std::string RspfileSpool::PathFor(const std::string&) const {
+  return std::string();
+}
+
+void RspfileSpool::Remove(const std::string&) {}
+
+#endif  // _WIN32
@@ -0,0 +1,79 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_RSPFILE_SPOOL_H_
+#define NINJA_RSPFILE_SPOOL_H_
+
+#include <map>
+#include <string>
+
+/// Spools response files into a RAM-backed directory instead of the
+/// output tree.  The builder writes each edge's rspfile just before the
+/// command starts and deletes it right after, so on a network filesystem
+/// every link pays two round trips for a file nothing else ever reads.
+/// With the spool enabled those writes land on tmpfs ($XDG_RUNTIME_DIR,
+/// /dev/shm or /tmp) and the command line is rewritten to point at the
+/// spooled copy; the declared path never touches the disk.
+///
+/// The spool also carries deps=gcc depfiles the other direction: Map()
+/// reserves a spooled path the compiler is pointed at, deps extraction
+/// consumes it there, and the output filesystem never sees the .d file
+/// at all (one write, one read and one unlink saved per compile).
+///
+/// Disabled by default so tests and tools see the classic behavior;
+/// RunBuild() enables it for local builds unless "-d keeprsp" asks for
+/// the on-disk files.  All access is from the build loop thread.  On
+/// Windows Enable() is a no-op.
+struct RspfileSpool {
+  /// Create the spool directory and enable spooling.  No-op if no
+  /// writable location exists; builds then fall back to on-disk
+  /// rspfiles.
+  static void Enable();
+
+  /// The enabled spool, or nullptr.
+  static RspfileSpool* Get() { return instance_; }
+
+  /// Best-effort removal of the spool directory at the end of the run.
+  static void Shutdown();
+
+  /// Write \a content as the spooled copy of the edge's declared
+  /// \a rspfile; the spooled path is remembered for PathFor()/Remove().
+  bool Write(const std::string& rspfile, const std::string& content,
+             std::string* err);
+
+  /// Reserve a spooled path for the declared \a depfile without
+  /// creating the file; the command is rewritten to write it there.
+  /// Returns the existing mapping if one is already live.
+  std::string Map(const std::string& depfile);
+
+  /// The live spooled path for \a rspfile, or empty if none.
+  std::string PathFor(const std::string& rspfile) const;
+
+  /// Delete the spooled copy for \a rspfile.
+  void Remove(const std::string& rspfile);
+
+ private:
+  RspfileSpool() = default;
+
+  std::string dir_;
+  /// Declared rspfile path -> live spooled file.
+  std::map<std::string, std::string> live_;
+  /// Spooled files are numbered so distinct rspfiles with the same
+  /// basename never collide in the flat spool directory.
+  int64_t sequence_ = 0;
+
+  static RspfileSpool* instance_;
+};
+
+#endif  // NINJA_RSPFILE_SPOOL_H_
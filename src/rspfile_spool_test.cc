@@ -0,0 +1,118 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _WIN32
+
+#include "rspfile_spool.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "test.h"
+
+using namespace std;
+
+namespace {
+
+/// The spool is process-global; make sure a failing expectation cannot
+/// leave it enabled for unrelated build tests in the same binary.
+struct ScopedSpool {
+  ScopedSpool() { RspfileSpool::Enable(); }
+  ~ScopedSpool() { RspfileSpool::Shutdown(); }
+};
+
+std::string ReadWholeFile(const std::string& path) {
+  std::string contents;
+  FILE* fp = fopen(path.c_str(), "rb");
+  if (!fp)
+    return contents;
+  char buf[4096];
+  size_t len;
+  while ((len = fread(buf, 1, sizeof(buf), fp)) > 0)
+    contents.append(buf, len);
+  fclose(fp);
+  return contents;
+}
+
+}  // anonymous namespace
+
+TEST(RspfileSpool, WriteLookupRemove) {
+  ScopedSpool scoped;
+  RspfileSpool* spool = RspfileSpool::Get();
+  ASSERT_TRUE(spool);
+
+  std::string err;
+  EXPECT_TRUE(spool->Write("out/foo.rsp", "-la -lb\n", &err));
+  EXPECT_EQ("", err);
+
+  // The spooled copy lives outside the output tree and carries the
+  // written bytes; the declared path was never created.
+  std::string spooled = spool->PathFor("out/foo.rsp");
+  ASSERT_NE("", spooled);
+  EXPECT_NE("out/foo.rsp", spooled);
+  EXPECT_EQ("-la -lb\n", ReadWholeFile(spooled));
+  EXPECT_NE(0, access("out/foo.rsp", F_OK));
+
+  // Distinct rspfiles with the same basename must not collide in the
+  // flat spool directory.
+  EXPECT_TRUE(spool->Write("other/foo.rsp", "-lc\n", &err));
+  EXPECT_NE(spooled, spool->PathFor("other/foo.rsp"));
+  EXPECT_EQ("-la -lb\n", ReadWholeFile(spooled));
+
+  spool->Remove("out/foo.rsp");
+  EXPECT_EQ("", spool->PathFor("out/foo.rsp"));
+  EXPECT_NE(0, access(spooled.c_str(), F_OK));
+}
+
+TEST(RspfileSpool, MapReservesDepfilePaths) {
+  ScopedSpool scoped;
+  RspfileSpool* spool = RspfileSpool::Get();
+  ASSERT_TRUE(spool);
+
+  // Map reserves a path without creating the file -- the compiler
+  // writes it -- and repeated calls return the same mapping.
+  std::string spooled = spool->Map("out/foo.o.d");
+  ASSERT_NE("", spooled);
+  EXPECT_NE(0, access(spooled.c_str(), F_OK));
+  EXPECT_EQ(spooled, spool->Map("out/foo.o.d"));
+  EXPECT_EQ(spooled, spool->PathFor("out/foo.o.d"));
+  EXPECT_NE(spooled, spool->Map("out/bar.o.d"));
+
+  // Simulate the compiler writing the depfile, then retire the mapping.
+  FILE* fp = fopen(spooled.c_str(), "w");
+  ASSERT_TRUE(fp != nullptr);
+  fputs("out/foo.o: foo.cc foo.h\n", fp);
+  fclose(fp);
+  spool->Remove("out/foo.o.d");
+  EXPECT_EQ("", spool->PathFor("out/foo.o.d"));
+  EXPECT_NE(0, access(spooled.c_str(), F_OK));
+}
+
+TEST(RspfileSpool, ShutdownSweepsLiveFiles) {
+  std::string spooled;
+  {
+    ScopedSpool scoped;
+    RspfileSpool* spool = RspfileSpool::Get();
+    ASSERT_TRUE(spool);
+    std::string err;
+    // Left live, as a failed edge would leave it.
+    EXPECT_TRUE(spool->Write("out/bar.rsp", "-ld\n", &err));
+    spooled = spool->PathFor("out/bar.rsp");
+    ASSERT_NE("", spooled);
+  }
+  EXPECT_FALSE(RspfileSpool::Get());
+  EXPECT_NE(0, access(spooled.c_str(), F_OK));
+}
+
+#endif  // _WIN32
@@ -0,0 +1,157 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_SMALL_VECTOR_H_
+#define NINJA_SMALL_VECTOR_H_
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <type_traits>
+
+/// A contiguous sequence with N slots of inline storage, spilling to the
+/// heap only when it grows past them.  The median edge of a build graph
+/// has one output and a handful of inputs, so keeping those lists inline
+/// avoids two heap allocations per edge and a pointer hop per traversal.
+///
+/// Restricted to trivially copyable element types (the graph stores raw
+/// Node pointers), which keeps growth a memcpy and destruction a single
+/// free.  Iterators are plain pointers and are invalidated by any growth,
+/// like std::vector's.
+template <typename T, size_t N>
+struct SmallVector {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SmallVector only supports trivially copyable types");
+
+  using value_type = T;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  SmallVector() = default;
+
+  SmallVector(const SmallVector& other) { *this = other; }
+
+  SmallVector& operator=(const SmallVector& other) {
+    if (this == &other)
+      return *this;
+    clear();
+    reserve(other.size_);
+    memcpy(data_, other.data_, other.size_ * sizeof(T));
+    size_ = other.size_;
+    return *this;
+  }
+
+  ~SmallVector() {
+    if (data_ != inline_data())
+      free(data_);
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t capacity() const { return capacity_; }
+
+  iterator begin() { return data_; }
+  iterator end() { return data_ + size_; }
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+  T* data() { return data_; }
+  const T* data() const { return data_; }
+
+  T& operator[](size_t index) { return data_[index]; }
+  const T& operator[](size_t index) const { return data_[index]; }
+
+  T& front() { return data_[0]; }
+  T& back() { return data_[size_ - 1]; }
+
+  void clear() { size_ = 0; }
+
+  void reserve(size_t capacity) {
+    if (capacity <= capacity_)
+      return;
+    // Double rather than growing to the exact request so a push_back
+    // loop stays amortized constant.
+    size_t grown = capacity_ * 2;
+    Relocate(capacity > grown ? capacity : grown);
+  }
+
+  void push_back(T value) {
+    if (size_ == capacity_)
+      Relocate(capacity_ * 2);
+    data_[size_++] = value;
+  }
+
+  /// Insert \a count copies of \a value before \a pos.
+  /// Returns an iterator to the first inserted element.
+  iterator insert(iterator pos, size_t count, T value) {
+    size_t offset = pos - data_;
+    MakeGap(offset, count);
+    for (size_t i = 0; i < count; ++i)
+      data_[offset + i] = value;
+    return data_ + offset;
+  }
+
+  /// Insert the range [first, last) before \a pos.  The range must not
+  /// alias this vector.  (The enable_if keeps integral arguments routed
+  /// to the count overload above, as std::vector does.)
+  template <typename It,
+            typename = typename std::enable_if<!std::is_integral<It>::value>::type>
+  iterator insert(iterator pos, It first, It last) {
+    size_t count = last - first;
+    size_t offset = pos - data_;
+    MakeGap(offset, count);
+    for (size_t i = 0; i < count; ++i)
+      data_[offset + i] = *first++;
+    return data_ + offset;
+  }
+
+  iterator erase(iterator first, iterator last) {
+    memmove(first, last, (end() - last) * sizeof(T));
+    size_ -= last - first;
+    return first;
+  }
+
+ private:
+  T* inline_data() { return reinterpret_cast<T*>(storage_); }
+
+  /// Move the contents into a heap buffer of \a capacity elements.
+  void Relocate(size_t capacity) {
+    assert(capacity > capacity_);
+    T* grown = static_cast<T*>(malloc(capacity * sizeof(T)));
+    memcpy(grown, data_, size_ * sizeof(T));
+    if (data_ != inline_data())
+      free(data_);
+    data_ = grown;
+    capacity_ = capacity;
+  }
+
+  /// Open a hole of \a count elements at \a offset, growing if needed.
+  void MakeGap(size_t offset, size_t count) {
+    if (size_ + count > capacity_) {
+      size_t grown = capacity_ * 2;
+      Relocate(size_ + count > grown ? size_ + count : grown);
+    }
+    memmove(data_ + offset + count, data_ + offset,
+            (size_ - offset) * sizeof(T));
+    size_ += count;
+  }
+
+  alignas(T) unsigned char storage_[N * sizeof(T)];
+  T* data_ = inline_data();
+  size_t size_ = 0;
+  size_t capacity_ = N;
+};
+
+#endif  // NINJA_SMALL_VECTOR_H_
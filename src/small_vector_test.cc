@@ -0,0 +1,92 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "small_vector.h"
+
+#include <algorithm>
+
+#include "test.h"
+
+namespace {
+
+TEST(SmallVector, InlineThenSpill) {
+  SmallVector<int, 4> v;
+  EXPECT_TRUE(v.empty());
+  EXPECT_EQ(4u, v.capacity());
+
+  for (int i = 0; i < 4; ++i)
+    v.push_back(i);
+  ASSERT_EQ(4u, v.size());
+  EXPECT_EQ(4u, v.capacity());
+
+  // The fifth element forces a heap spill; contents survive the move.
+  v.push_back(4);
+  ASSERT_EQ(5u, v.size());
+  EXPECT_GT(v.capacity(), 4u);
+  for (int i = 0; i < 5; ++i)
+    EXPECT_EQ(i, v[i]);
+  EXPECT_EQ(0, v.front());
+  EXPECT_EQ(4, v.back());
+}
+
+TEST(SmallVector, InsertAndErase) {
+  SmallVector<int, 4> v;
+  v.push_back(1);
+  v.push_back(5);
+
+  // Insert a run in the middle, as PreallocateSpace does for depfile
+  // deps, spanning the inline-to-heap boundary.
+  SmallVector<int, 4>::iterator it = v.insert(v.begin() + 1, 3, 0);
+  ASSERT_EQ(5u, v.size());
+  EXPECT_EQ(1, v[0]);
+  EXPECT_EQ(0, *it);
+  EXPECT_EQ(5, v[4]);
+  for (int i = 0; i < 3; ++i)
+    it[i] = 2 + i;
+
+  int more[] = { 6, 7 };
+  v.insert(v.end(), more, more + 2);
+  ASSERT_EQ(7u, v.size());
+  for (int i = 0; i < 7; ++i)
+    EXPECT_EQ(i + 1, v[i]);
+
+  v.erase(v.begin() + 1, v.begin() + 3);
+  ASSERT_EQ(5u, v.size());
+  EXPECT_EQ(1, v[0]);
+  EXPECT_EQ(4, v[1]);
+  EXPECT_EQ(7, v[4]);
+}
+
+TEST(SmallVector, CopyAndReserve) {
+  SmallVector<int, 2> v;
+  for (int i = 0; i < 10; ++i)
+    v.push_back(i);
+
+  SmallVector<int, 2> copy(v);
+  ASSERT_EQ(10u, copy.size());
+  EXPECT_TRUE(std::equal(v.begin(), v.end(), copy.begin()));
+
+  // A copy owns its storage.
+  copy[0] = -1;
+  EXPECT_EQ(0, v[0]);
+
+  SmallVector<int, 2> reserved;
+  reserved.reserve(100);
+  int* data = reserved.data();
+  for (int i = 0; i < 100; ++i)
+    reserved.push_back(i);
+  EXPECT_EQ(data, reserved.data());
+}
+
+}  // namespace
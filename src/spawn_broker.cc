@@ -0,0 +1,255 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "spawn_broker.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "util.h"
+
+SpawnBroker* SpawnBroker::instance_ = nullptr;
+
+namespace {
+
+/// One request per message, length-framed over a stream socket.  A
+/// kSpawn header is followed by command_len command bytes and carries
+/// the child's stdout fd as ancillary data on the header bytes.
+struct RequestHeader {
+  enum Op : uint8_t { kSpawn, kWait };
+  uint8_t op;
+  uint8_t use_console;
+  pid_t pid;             // kWait: which child to reap.
+  uint32_t command_len;  // kSpawn: bytes that follow.
+};
+
+bool WriteExact(int fd, const void* data, size_t len) {
+  const char* p = static_cast<const char*>(data);
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool ReadExact(int fd, void* data, size_t len) {
+  char* p = static_cast<char*>(data);
+  while (len > 0) {
+    ssize_t n = read(fd, p, len);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR)
+        continue;
+      return false;
+    }
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+/// Send the header (with \a fd attached via SCM_RIGHTS when >= 0),
+/// then the command bytes.
+bool SendRequest(int sock, const RequestHeader& header, const char* command,
+                 int fd) {
+  struct iovec iov = { const_cast<RequestHeader*>(&header), sizeof(header) };
+  struct msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  char cmsg_buf[CMSG_SPACE(sizeof(int))] = {};
+  if (fd >= 0) {
+    msg.msg_control = cmsg_buf;
+    msg.msg_controllen = sizeof(cmsg_buf);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+  ssize_t n;
+  do {
+    n = sendmsg(sock, &msg, 0);
+  } while (n < 0 && errno == EINTR);
+  if (n != (ssize_t)sizeof(header))
+    return false;
+  return header.command_len == 0 ||
+         WriteExact(sock, command, header.command_len);
+}
+
+/// Receive a header and any fd attached to it.
+bool RecvHeader(int sock, RequestHeader* header, int* fd) {
+  *fd = -1;
+  struct iovec iov = { header, sizeof(*header) };
+  struct msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  char cmsg_buf[CMSG_SPACE(sizeof(int))] = {};
+  msg.msg_control = cmsg_buf;
+  msg.msg_controllen = sizeof(cmsg_buf);
+  ssize_t n;
+  do {
+    n = recvmsg(sock, &msg, MSG_WAITALL);
+  } while (n < 0 && errno == EINTR);
+  if (n != (ssize_t)sizeof(*header))
+    return false;
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+      memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+  }
+  return true;
+}
+
+}  // anonymous namespace
+
+// static
+void SpawnBroker::Serve(int sock) {
+  // The broker escapes the terminal's foreground group so ctrl-c kills
+  // the build, not the spawner; console children are put back into the
+  // original group below so they still see terminal signals.
+  pid_t foreground_pgid = getpgrp();
+  setpgid(0, 0);
+  signal(SIGPIPE, SIG_IGN);
+
+  for (;;) {
+    RequestHeader header;
+    int fd;
+    // EOF here means ninja exited (or exec'd itself after a manifest
+    // rebuild); either way this broker is done.
+    if (!RecvHeader(sock, &header, &fd))
+      _exit(0);
+
+    if (header.op == RequestHeader::kSpawn) {
+      std::string command(header.command_len, '\0');
+      if (header.command_len &&
+          !ReadExact(sock, &command[0], command.size()))
+        _exit(0);
+
+      pid_t pid = fork();
+      if (pid == 0) {
+        if (header.use_console) {
+          // Keep the terminal; rejoin ninja's foreground group so the
+          // child still receives ctrl-c and may read stdin.
+          setpgid(0, foreground_pgid);
+        } else {
+          setpgid(0, 0);
+          int devnull = open("/dev/null", O_RDONLY);
+          if (devnull >= 0) {
+            dup2(devnull, 0);
+            close(devnull);
+          }
+          dup2(fd, 1);
+          dup2(fd, 2);
+          close(fd);
+          fd = -1;
+        }
+        // For console children the pipe stays open (untouched fds
+        // survive exec), so ninja still sees EOF when the child exits.
+        execl("/bin/sh", "/bin/sh", "-c", command.c_str(),
+              static_cast<char*>(nullptr));
+        _exit(127);
+      }
+      if (fd >= 0)
+        close(fd);
+      if (pid < 0 || !WriteExact(sock, &pid, sizeof(pid)))
+        _exit(pid < 0 ? 1 : 0);
+    } else {
+      int status = 0;
+      struct rusage rusage = {};
+      while (wait4(header.pid, &status, 0, &rusage) < 0) {
+        if (errno != EINTR)
+          _exit(1);
+      }
+      if (!WriteExact(sock, &status, sizeof(status)) ||
+          !WriteExact(sock, &rusage, sizeof(rusage)))
+        _exit(0);
+    }
+  }
+}
+
+// static
+void SpawnBroker::StartIfRequested() {
+  if (instance_)
+    return;
+  const char* env = getenv("NINJA_SPAWN_HELPER");
+  if (!env || env[0] != '1')
+    return;
+
+  int socks[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, socks) < 0)
+    Fatal("socketpair: %s", strerror(errno));
+
+  pid_t pid = fork();
+  if (pid < 0)
+    Fatal("fork: %s", strerror(errno));
+  if (pid == 0) {
+    close(socks[0]);
+    Serve(socks[1]);  // Never returns.
+  }
+  close(socks[1]);
+
+  instance_ = new SpawnBroker();
+  instance_->sock_ = socks[0];
+  instance_->broker_pid_ = pid;
+}
+
+// static
+void SpawnBroker::Shutdown() {
+  if (!instance_)
+    return;
+  close(instance_->sock_);
+  while (waitpid(instance_->broker_pid_, nullptr, 0) < 0 && errno == EINTR) {
+  }
+  delete instance_;
+  instance_ = nullptr;
+}
+
+bool SpawnBroker::Spawn(const std::string& command, bool use_console,
+                        int stdout_fd, pid_t* pid) {
+  RequestHeader header = {};
+  header.op = RequestHeader::kSpawn;
+  header.use_console = use_console;
+  header.command_len = command.size();
+  if (!SendRequest(sock_, header, command.data(), stdout_fd))
+    return false;
+  return ReadExact(sock_, pid, sizeof(*pid)) && *pid > 0;
+}
+
+bool SpawnBroker::Wait(pid_t pid, int* status, struct rusage* rusage) {
+  RequestHeader header = {};
+  header.op = RequestHeader::kWait;
+  header.pid = pid;
+  if (!SendRequest(sock_, header, nullptr, -1))
+    return false;
+  return ReadExact(sock_, status, sizeof(*status)) &&
+         ReadExact(sock_, rusage, sizeof(*rusage));
+}
+
+#endif  // !_WIN32
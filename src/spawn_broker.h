@@ -0,0 +1,79 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_SPAWN_BROKER_H_
+#define NINJA_SPAWN_BROKER_H_
+
+#ifndef _WIN32
+
+#include <sys/types.h>
+
+#include <string>
+
+struct rusage;
+
+/// A pre-warmed spawn helper: a tiny process forked at startup, before
+/// the graph and logs bloat ninja's RSS, which forks and execs build
+/// commands on request.  fork() cost scales with the parent's page
+/// tables, so forking from the broker stays cheap no matter how large
+/// ninja grows.  Requests travel over a socketpair; the child's
+/// stdout/stderr pipe rides along via SCM_RIGHTS, and the broker sends
+/// back the child pid and, later, its wait status and resource usage.
+///
+/// Opt-in via NINJA_SPAWN_HELPER=1 in the environment, started by
+/// main() before the manifest is loaded.  Subprocess::Start routes
+/// through the broker transparently when one is running.
+struct SpawnBroker {
+  /// Fork the broker if NINJA_SPAWN_HELPER=1 and none is running.
+  /// Must be called while the process is still small.
+  static void StartIfRequested();
+
+  /// The running broker, or nullptr if none was started.
+  static SpawnBroker* Get() { return instance_; }
+
+  /// Tear down the broker (used by tests; at exit the socket's
+  /// close-on-exec/process-exit handles it).
+  static void Shutdown();
+
+  /// Ask the broker to run /bin/sh -c \a command with \a stdout_fd as
+  /// stdout/stderr.  Console commands keep the terminal instead and are
+  /// placed back into ninja's foreground process group; others get
+  /// their own group, matching the direct spawn path.  Returns false on
+  /// broker failure.
+  bool Spawn(const std::string& command, bool use_console, int stdout_fd,
+             pid_t* pid);
+
+  /// Collect the wait status of a broker-spawned child into \a status
+  /// (raw waitpid form) and its resource usage into \a rusage; the
+  /// broker reaps with wait4().  Both ends are the same binary on the
+  /// same machine, so the struct travels raw over the socketpair.
+  /// Returns false on broker failure.
+  bool Wait(pid_t pid, int* status, struct rusage* rusage);
+
+ private:
+  SpawnBroker() = default;
+
+  /// Broker-side request loop; runs in the forked helper, never
+  /// returns.
+  static void Serve(int sock);
+
+  int sock_ = -1;
+  pid_t broker_pid_ = -1;
+
+  static SpawnBroker* instance_;
+};
+
+#endif  // !_WIN32
+
+#endif  // NINJA_SPAWN_BROKER_H_
@@ -0,0 +1,112 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _WIN32
+
+#include "spawn_broker.h"
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test.h"
+
+namespace {
+
+/// Starts a broker for the duration of one test and tears it down
+/// again, so the other subprocess tests keep their direct spawn path
+/// (several of them rely on being the child's parent).
+struct SpawnBrokerTest : public testing::Test {
+  virtual void SetUp() {
+    setenv("NINJA_SPAWN_HELPER", "1", 1);
+    SpawnBroker::StartIfRequested();
+    ASSERT_TRUE(SpawnBroker::Get());
+  }
+  virtual void TearDown() {
+    SpawnBroker::Shutdown();
+    unsetenv("NINJA_SPAWN_HELPER");
+    ASSERT_EQ(nullptr, SpawnBroker::Get());
+  }
+
+  /// Drain the read end of the child's pipe until EOF.
+  std::string ReadAll(int fd) {
+    std::string output;
+    char buf[4096];
+    ssize_t len;
+    while ((len = read(fd, buf, sizeof(buf))) > 0)
+      output.append(buf, len);
+    return output;
+  }
+};
+
+}  // anonymous namespace
+
+TEST_F(SpawnBrokerTest, RoundTrip) {
+  int pipe_fds[2];
+  ASSERT_EQ(0, pipe(pipe_fds));
+
+  pid_t pid = -1;
+  ASSERT_TRUE(SpawnBroker::Get()->Spawn("echo hello", false, pipe_fds[1],
+                                        &pid));
+  ASSERT_GT(pid, 0);
+  close(pipe_fds[1]);
+
+  EXPECT_EQ("hello\n", ReadAll(pipe_fds[0]));
+  close(pipe_fds[0]);
+
+  int status = -1;
+  struct rusage rusage = {};
+  ASSERT_TRUE(SpawnBroker::Get()->Wait(pid, &status, &rusage));
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+  // Even "echo hello" has a measurable footprint.
+  EXPECT_GT(rusage.ru_maxrss, 0);
+}
+
+TEST_F(SpawnBrokerTest, FailingCommand) {
+  int pipe_fds[2];
+  ASSERT_EQ(0, pipe(pipe_fds));
+
+  pid_t pid = -1;
+  ASSERT_TRUE(SpawnBroker::Get()->Spawn("exit 3", false, pipe_fds[1], &pid));
+  close(pipe_fds[1]);
+  close(pipe_fds[0]);
+
+  int status = -1;
+  struct rusage rusage = {};
+  ASSERT_TRUE(SpawnBroker::Get()->Wait(pid, &status, &rusage));
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(3, WEXITSTATUS(status));
+}
+
+TEST_F(SpawnBrokerTest, ChildIsBrokersNotOurs) {
+  int pipe_fds[2];
+  ASSERT_EQ(0, pipe(pipe_fds));
+
+  pid_t pid = -1;
+  ASSERT_TRUE(SpawnBroker::Get()->Spawn("true", false, pipe_fds[1], &pid));
+  close(pipe_fds[1]);
+  close(pipe_fds[0]);
+
+  // The child belongs to the broker, so a direct waitpid must fail.
+  EXPECT_EQ(-1, waitpid(pid, nullptr, WNOHANG));
+
+  int status = -1;
+  struct rusage rusage = {};
+  ASSERT_TRUE(SpawnBroker::Get()->Wait(pid, &status, &rusage));
+  EXPECT_EQ(0, status);
+}
+
+#endif  // !_WIN32
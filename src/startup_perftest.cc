@@ -0,0 +1,258 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Replays a corpus of recorded .ninja manifests through the parser and
+// reports startup latency per phase.  Unlike manifest_parser_perftest,
+// which synthesizes a toy manifest, this harness takes real (anonymized)
+// manifests as arguments, attributes time to the parse, canonicalize and
+// graph-construction phases via the Metrics infrastructure, and can emit
+// the results as JSON so releases can be gated on startup regressions.
+//
+// With no manifest arguments it falls back to the generated corpus used
+// by manifest_parser_perftest; in that case it expects to be run in
+// ninja's root directory.
+
+#include <numeric>
+#include <algorithm>
+#include <map>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include "getopt.h"
+#include <direct.h>
+#else
+#include <getopt.h>
+#include <unistd.h>
+#endif
+
+#include "disk_interface.h"
+#include "graph.h"
+#include "manifest_parser.h"
+#include "metrics.h"
+#include "state.h"
+#include "util.h"
+
+namespace {
+
+/// A point-in-time copy of every metric's counters, keyed by name.
+/// METRIC_RECORD call sites cache their Metric* in a function-local
+/// static, so g_metrics must stay installed for the whole process; phases
+/// are attributed by diffing snapshots instead.
+typedef std::map<std::string, Metric> MetricSnapshot;
+
+MetricSnapshot TakeSnapshot() {
+  MetricSnapshot snapshot;
+  g_metrics->Sync();
+  for (const Metric* metric : g_metrics->metrics())
+    snapshot[metric->name] = *metric;
+  return snapshot;
+}
+
+/// The metrics accumulated by one run: current counters minus \a before.
+std::vector<Metric> DiffSnapshot(const MetricSnapshot& before) {
+  std::vector<Metric> result;
+  g_metrics->Sync();
+  for (const Metric* metric : g_metrics->metrics()) {
+    Metric delta = *metric;
+    MetricSnapshot::const_iterator old = before.find(metric->name);
+    if (old != before.end()) {
+      delta.count -= old->second.count;
+      delta.sum -= old->second.sum;
+    }
+    if (delta.count > 0)
+      result.push_back(delta);
+  }
+  return result;
+}
+
+struct Run {
+  int wall_ms = 0;
+  std::vector<Metric> metrics;
+};
+
+struct ManifestResult {
+  std::string path;
+  std::vector<Run> runs;
+};
+
+bool WriteFakeManifests(const std::string& dir, std::string* err) {
+  RealDiskInterface disk_interface;
+  TimeStamp mtime = disk_interface.Stat(dir + "/build.ninja", err);
+  if (mtime != 0)  // 0 means that the file doesn't exist yet.
+    return mtime != -1;
+
+  std::string command = "python misc/write_fake_manifests.py " + dir;
+  printf("Creating manifest data..."); fflush(stdout);
+  int exit_code = system(command.c_str());
+  printf("done.\n");
+  if (exit_code != 0)
+    *err = "Failed to run " + command;
+  return exit_code == 0;
+}
+
+Run LoadOnce(const std::string& manifest, bool measure_command_evaluation) {
+  MetricSnapshot before = TakeSnapshot();
+  int64_t start = GetTimeMillis();
+
+  std::string err;
+  RealDiskInterface disk_interface;
+  State state;
+  ManifestParser parser(&state, &disk_interface);
+  if (!parser.Load(manifest, &err)) {
+    fprintf(stderr, "Failed to load '%s': %s\n", manifest.c_str(),
+            err.c_str());
+    exit(1);
+  }
+  // An empty build also evaluates the commands of the requested targets,
+  // so include command evaluation by default.
+  int optimization_guard = 0;
+  if (measure_command_evaluation)
+    for (size_t i = 0; i < state.edges_.size(); ++i)
+      optimization_guard += state.edges_[i]->EvaluateCommand().size();
+
+  Run run;
+  run.wall_ms = (int)(GetTimeMillis() - start);
+  run.metrics = DiffSnapshot(before);
+  printf("%s: %dms (hash: %x)\n", manifest.c_str(), run.wall_ms,
+         optimization_guard);
+  return run;
+}
+
+void PrintJsonString(FILE* f, const std::string& s) {
+  fputc('"', f);
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      fprintf(f, "\\%c", c);
+    else if (static_cast<unsigned char>(c) < 0x20)
+      fprintf(f, "\\u%04x", c);
+    else
+      fputc(c, f);
+  }
+  fputc('"', f);
+}
+
+void WriteJson(FILE* f, const std::vector<ManifestResult>& results) {
+  fprintf(f, "{\n  \"manifests\": [\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const ManifestResult& result = results[i];
+    fprintf(f, "    {\n      \"path\": ");
+    PrintJsonString(f, result.path);
+    fprintf(f, ",\n      \"runs\": [\n");
+    for (size_t j = 0; j < result.runs.size(); ++j) {
+      const Run& run = result.runs[j];
+      fprintf(f, "        { \"wall_ms\": %d, \"metrics\": [", run.wall_ms);
+      for (size_t k = 0; k < run.metrics.size(); ++k) {
+        const Metric& metric = run.metrics[k];
+        fprintf(f, "%s\n          { \"name\": ", k ? "," : "");
+        PrintJsonString(f, metric.name);
+        fprintf(f, ", \"count\": %d, \"micros\": %" PRId64 " }",
+                metric.count, metric.sum);
+      }
+      fprintf(f, "\n        ] }%s\n", j + 1 < result.runs.size() ? "," : "");
+    }
+    fprintf(f, "      ]\n    }%s\n", i + 1 < results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+}
+
+}  // anonymous namespace
+
+int main(int argc, char* argv[]) {
+  bool measure_command_evaluation = true;
+  int repetitions = 5;
+  const char* json_path = nullptr;
+  int opt;
+  while ((opt = getopt(argc, argv, const_cast<char*>("fn:o:h"))) != -1) {
+    switch (opt) {
+    case 'f':
+      measure_command_evaluation = false;
+      break;
+    case 'n':
+      repetitions = atoi(optarg);
+      break;
+    case 'o':
+      json_path = optarg;
+      break;
+    case 'h':
+    default:
+      printf("usage: startup_perftest [options] [manifests...]\n"
+"\n"
+"replays each manifest through the parser; with no manifests, uses the\n"
+"generated corpus from misc/write_fake_manifests.py\n"
+"\n"
+"options:\n"
+"  -n N   repetitions per manifest (default 5)\n"
+"  -o F   also write results as JSON to F\n"
+"  -f     only measure manifest load time, not command evaluation time\n"
+             );
+    return 1;
+    }
+  }
+
+  // Phase attribution relies on the METRIC_RECORD sites in the parser
+  // (".ninja parse", "canonicalize str", "lookup node", ...), so metrics
+  // must be on for the whole process.
+  Metrics metrics;
+  g_metrics = &metrics;
+
+  std::vector<std::string> manifests;
+  for (int i = optind; i < argc; ++i)
+    manifests.push_back(argv[i]);
+  if (manifests.empty()) {
+    const char kManifestDir[] = "build/manifest_perftest";
+    std::string err;
+    if (!WriteFakeManifests(kManifestDir, &err)) {
+      fprintf(stderr, "Failed to write test data: %s\n", err.c_str());
+      return 1;
+    }
+    if (chdir(kManifestDir) < 0)
+      Fatal("chdir: %s", strerror(errno));
+    manifests.push_back("build.ninja");
+  }
+
+  std::vector<ManifestResult> results;
+  for (const std::string& manifest : manifests) {
+    ManifestResult result;
+    result.path = manifest;
+    for (int i = 0; i < repetitions; ++i)
+      result.runs.push_back(LoadOnce(manifest, measure_command_evaluation));
+
+    std::vector<int> times;
+    for (const Run& run : result.runs)
+      times.push_back(run.wall_ms);
+    int min = *min_element(times.begin(), times.end());
+    int max = *max_element(times.begin(), times.end());
+    float total = accumulate(times.begin(), times.end(), 0.0f);
+    printf("%s: min %dms  max %dms  avg %.1fms\n", manifest.c_str(), min, max,
+           total / times.size());
+
+    results.push_back(std::move(result));
+  }
+
+  if (json_path) {
+    FILE* f = fopen(json_path, "w");
+    if (!f)
+      Fatal("opening %s: %s", json_path, strerror(errno));
+    WriteJson(f, results);
+    fclose(f);
+  }
+
+  g_metrics = nullptr;
+  return 0;
+}
@@ -0,0 +1,82 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stat_prefetcher.h"
+
+#include "disk_interface.h"
+
+namespace {
+
+/// Paths per batch handed to the workers.  Large enough that the queue
+/// mutex stays uncontended, small enough that work spreads across the pool
+/// quickly.
+const size_t kBatchSize = 256;
+
+}  // anonymous namespace
+
+StatPrefetcher::~StatPrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exit_ = true;
+  }
+  cv_.notify_all();
+  for (auto & thread : threads_)
+    thread.join();
+}
+
+void StatPrefetcher::Enqueue(std::string_view path) {
+  batch_.emplace_back(path);
+  if (batch_.size() >= kBatchSize)
+    Flush();
+}
+
+void StatPrefetcher::Flush() {
+  if (batch_.empty())
+    return;
+  if (threads_.empty()) {
+    // Stats mostly sleep in the kernel, so a few threads pipeline them
+    // well without starving the parser's subninja lexers of cores.
+    size_t count = std::thread::hardware_concurrency();
+    if (count == 0 || count > 4)
+      count = 4;
+    for (size_t i = 0; i < count; ++i)
+      threads_.emplace_back(&StatPrefetcher::Worker, this);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(batch_));
+  }
+  cv_.notify_one();
+  batch_.clear();
+}
+
+void StatPrefetcher::Worker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    cv_.wait(lock, [this] { return exit_ || !queue_.empty(); });
+    // Dropping still-queued paths on exit is fine: the stats already
+    // issued are the whole benefit.
+    if (exit_)
+      return;
+    std::vector<std::string> paths = std::move(queue_.back());
+    queue_.pop_back();
+    lock.unlock();
+    std::string err;
+    for (const auto & path : paths) {
+      err.clear();
+      disk_interface_->Stat(path, &err);
+    }
+    lock.lock();
+  }
+}
@@ -0,0 +1,65 @@
+// Copyright 2026 The Splinter Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NINJA_STAT_PREFETCHER_H_
+#define NINJA_STAT_PREFETCHER_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct DiskInterface;
+
+/// Warms the kernel's dentry and inode caches while the manifest is still
+/// being parsed: State::GetNode hands every newly created node path to the
+/// prefetcher, whose worker threads stat the files in the background and
+/// discard the results.  By the time the dependency scan issues its
+/// authoritative stats, most of them are cache hits, so the parse and scan
+/// phases overlap instead of stacking.  Purely advisory -- nothing consumes
+/// the prefetched results directly, so no synchronization with the graph is
+/// needed and the prefetcher may be torn down with paths still queued.
+struct StatPrefetcher {
+  explicit StatPrefetcher(DiskInterface* disk_interface)
+      : disk_interface_(disk_interface) {}
+  /// Signals the workers to drop any paths still queued and joins them.
+  ~StatPrefetcher();
+
+  /// Queue \a path for a background stat.  Paths are buffered and handed to
+  /// the workers a batch at a time, so the parse loop does not take a lock
+  /// per node.  Not thread-safe: meant for the single thread constructing
+  /// the graph.
+  void Enqueue(std::string_view path);
+
+  /// Hand a partially filled batch to the workers.
+  void Flush();
+
+ private:
+  void Worker();
+
+  DiskInterface* disk_interface_;
+
+  /// Producer-side buffer; only the enqueueing thread touches it.
+  std::vector<std::string> batch_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::vector<std::string>> queue_;
+  bool exit_ = false;
+  std::vector<std::thread> threads_;
+};
+
+#endif  // NINJA_STAT_PREFETCHER_H_
@@ -15,6 +15,7 @@
 #include "state.h"
 
 #include "graph.h"
+#include "stat_prefetcher.h"
 #include "util.h"
 #include "metrics.h"
 #include "edit_distance.h"
@@ -23,6 +24,8 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include <unordered_map>
+
 void Pool::EdgeScheduled(const Edge& edge) {
   if (depth_ != 0)
     current_use_ += edge.weight();
@@ -35,39 +38,36 @@ void Pool::EdgeFinished(const Edge& edge) {
 
 void Pool::DelayEdge(Edge* edge) {
   assert(depth_ != 0);
-  delayed_.insert(edge);
+  delayed_[edge->weight()].push_back(edge);
 }
 
-void Pool::RetrieveReadyEdges(std::set<Edge*>* ready_queue) {
-  DelayedEdges::iterator it = delayed_.begin();
-  while (it != delayed_.end()) {
-    Edge* edge = *it;
+void Pool::RetrieveReadyEdges(ShardedEdgeQueue* ready_queue) {
+  while (!delayed_.empty()) {
+    std::deque<Edge*>& bucket = delayed_.begin()->second;
+    Edge* edge = bucket.front();
+    // The lightest delayed edge doesn't fit, so nothing else does either.
     if (current_use_ + edge->weight() > depth_)
       break;
-    ready_queue->insert(edge);
+    bucket.pop_front();
+    if (bucket.empty())
+      delayed_.erase(delayed_.begin());
+    ready_queue->push(edge);
     EdgeScheduled(*edge);
-    ++it;
   }
-  delayed_.erase(delayed_.begin(), it);
 }
 
 void Pool::Dump() const {
   printf("%s (%d/%d) ->\n", name_.c_str(), current_use_, depth_);
-  for (const auto & item : delayed_)
+  for (const auto & bucket : delayed_)
   {
-    printf("\t");
-    item->Dump();
+    for (const auto & item : bucket.second)
+    {
+      printf("\t");
+      item->Dump();
+    }
   }
 }
 
-// static
-bool Pool::WeightedEdgeCmp(const Edge* a, const Edge* b) {
-  if (!a) return b;
-  if (!b) return false;
-  int weight_diff = a->weight() - b->weight();
-  return ((weight_diff < 0) || (weight_diff == 0 && a < b));
-}
-
 Pool State::kDefaultPool("", 0);
 Pool State::kConsolePool("console", 1);
 const Rule State::kPhonyRule("phony");
@@ -91,7 +91,7 @@ Pool* State::LookupPool(std::string_view pool_name) {
 }
 
 Edge* State::AddEdge(const Rule* rule) {
-  Edge* edge = new Edge();
+  Edge* edge = edge_arena_.New();
   edge->rule_ = rule;
   edge->pool_ = &State::kDefaultPool;
   edge->env_ = &bindings_;
@@ -103,8 +103,12 @@ Node* State::GetNode(std::string_view path, uint64_t slash_bits) {
   Node* node = LookupNode(path);
   if (node)
     return node;
-  node = new Node(std::string(path), slash_bits);
+  node = node_arena_.New(path_arena_.Intern(path), slash_bits,
+                         scan_arena_.New());
+  node->set_graph_id(static_cast<int>(paths_.size()));
   paths_[node->path()] = node;
+  if (stat_prefetcher_)
+    stat_prefetcher_->Enqueue(node->path());
   return node;
 }
 
@@ -125,6 +129,10 @@ Node* State::SpellcheckNode(std::string_view path) {
   Node* result = nullptr;
   for (auto const& [pathKey, node] : paths_)
   {
+    // Cheap rejection before the DP: lengths alone bound the distance.
+    if (pathKey.size() + kMaxValidEditDistance < path.size() ||
+        path.size() + kMaxValidEditDistance < pathKey.size())
+      continue;
     int distance = EditDistance(pathKey, path, kAllowReplacements, kMaxValidEditDistance);
     if (distance < min_distance && node)
     {
@@ -150,45 +158,231 @@ bool State::AddOut(Edge* edge, std::string_view path, uint64_t slash_bits) {
   return true;
 }
 
-bool State::AddDefault(std::string_view path, std::string* err) {
+bool State::AddDefault(std::string_view path, std::string* err,
+                       int32_t origin_file) {
   Node* node = LookupNode(path);
   if (!node) {
     *err = string_concat("unknown target '", path, "'");
     return false;
   }
   defaults_.push_back(node);
+  default_origins_.push_back(origin_file);
   return true;
 }
 
 std::vector<Node*> State::RootNodes(std::string* err) const {
-  std::vector<Node*> root_nodes;
-  // Search for nodes with no output.
-  for (const auto & edge : edges_)
-  {
-    for (const auto & output : edge->outputs_)
+  if (root_nodes_revision_ != Node::edge_link_revision()) {
+    root_nodes_.clear();
+    // Search for nodes with no output.
+    for (const auto & edge : edges_)
     {
-      if (output->out_edges().empty())
+      for (const auto & output : edge->outputs_)
       {
-        root_nodes.push_back(output);
+        if (output->out_edges().empty())
+        {
+          root_nodes_.push_back(output);
+        }
       }
     }
+    root_nodes_revision_ = Node::edge_link_revision();
   }
 
-  if (!edges_.empty() && root_nodes.empty())
+  if (!edges_.empty() && root_nodes_.empty())
     *err = "could not determine root nodes of build graph";
 
-  return root_nodes;
+  return root_nodes_;
 }
 
 std::vector<Node*> State::DefaultNodes(std::string* err) const {
   return defaults_.empty() ? RootNodes(err) : defaults_;
 }
 
-void State::Reset() {
-  for (const auto & path : paths_)
+namespace {
+
+/// Per-consumer state for CollapsePhonyEdges: accumulates the rewritten
+/// input list while expanding pass-through aliases depth-first.
+struct PhonySplice {
+  Edge* consumer = nullptr;
+  /// Explicit and implicit inputs, in their original relative order.
+  std::vector<Node*> plain;
+  /// Order-only inputs, including those demoted from expanded aliases.
+  std::vector<Node*> order_only;
+  /// Every node already placed in the rewritten list; expansions of
+  /// overlapping aliases would otherwise duplicate shared real inputs.
+  std::set<const Node*> seen;
+  /// Aliases on the current expansion chain, to cut phony cycles.
+  std::set<const Edge*> expanding;
+
+  /// Whether the edge is a pure pass-through alias consumers can be
+  /// rewired around: a single-output phony with at least one input and
+  /// no dyndep binding (dyndep could grow its input list at scan time).
+  static bool IsPassThrough(const Edge* edge) {
+    return edge->is_phony() && edge->outputs_.size() == 1 &&
+           !edge->inputs_.empty() && edge->dyndep_ == nullptr;
+  }
+
+  /// Append \a node to the rewritten list, or, if it is a pass-through
+  /// alias, its real inputs.  An alias's order-only inputs stay
+  /// order-only on the consumer.
+  void Add(Node* node, bool is_order_only) {
+    Edge* in = node->in_edge();
+    if (node != consumer->dyndep_ && in && in != consumer &&
+        IsPassThrough(in) && expanding.insert(in).second) {
+      size_t order_only_start = in->inputs_.size() - in->order_only_deps_;
+      for (size_t i = 0; i < in->inputs_.size(); ++i)
+        Add(in->inputs_[i], is_order_only || i >= order_only_start);
+      expanding.erase(in);
+      return;
+    }
+    // A real input, the consumer's own dyndep file, or an alias cycle:
+    // keep the node itself.
+    if (seen.insert(node).second)
+      (is_order_only ? order_only : plain).push_back(node);
+  }
+};
+
+}  // namespace
+
+void State::CollapsePhonyEdges() {
+  METRIC_RECORD("collapse phony");
+  for (const auto & edge : edges_)
+  {
+    // Only phony consumers are rewired; see the header comment.
+    if (!edge->is_phony())
+      continue;
+    bool has_alias_input = false;
+    for (Node* input : edge->inputs_) {
+      Edge* in = input->in_edge();
+      if (input != edge->dyndep_ && in && in != edge &&
+          PhonySplice::IsPassThrough(in)) {
+        has_alias_input = true;
+        break;
+      }
+    }
+    if (!has_alias_input)
+      continue;
+
+    PhonySplice splice;
+    splice.consumer = edge;
+    size_t order_only_start = edge->inputs_.size() - edge->order_only_deps_;
+    size_t implicit_start = order_only_start - edge->implicit_deps_;
+    int implicit_count = 0;
+    for (size_t i = 0; i < edge->inputs_.size(); ++i) {
+      size_t plain_before = splice.plain.size();
+      splice.Add(edge->inputs_[i], i >= order_only_start);
+      if (i >= implicit_start && i < order_only_start)
+        implicit_count += static_cast<int>(splice.plain.size() - plain_before);
+    }
+
+    // Keep the reverse index consistent: spliced-away aliases no longer
+    // lead to this edge, and the spliced-in real inputs now do.
+    std::set<const Node*> original(edge->inputs_.begin(), edge->inputs_.end());
+    for (Node* input : edge->inputs_) {
+      if (!splice.seen.count(input))
+        input->RemoveOutEdge(edge);
+    }
+    for (Node* node : splice.plain) {
+      if (!original.count(node))
+        node->AddOutEdge(edge);
+    }
+    for (Node* node : splice.order_only) {
+      if (!original.count(node))
+        node->AddOutEdge(edge);
+    }
+
+    edge->inputs_.clear();
+    edge->inputs_.insert(edge->inputs_.end(), splice.plain.begin(),
+                         splice.plain.end());
+    edge->inputs_.insert(edge->inputs_.end(), splice.order_only.begin(),
+                         splice.order_only.end());
+    edge->implicit_deps_ = implicit_count;
+    edge->order_only_deps_ = static_cast<int>(splice.order_only.size());
+  }
+}
+
+namespace {
+
+/// A digest bucket entry for DeduplicateEdges: the representative edge
+/// and its evaluated command, kept so later candidates in the bucket
+/// compare without re-evaluating it.
+struct DedupCandidate {
+  Edge* edge;
+  std::string command;
+};
+
+/// Whether \a edge repeats \a candidate's work exactly: same rule and
+/// pool, the same input list node for node (including the
+/// explicit/implicit/order-only split), and the same command.  The
+/// digest already matched; this rules out collisions.
+bool IsDuplicateEdge(const DedupCandidate& candidate, const Edge* edge,
+                     const std::string& command) {
+  const Edge* other = candidate.edge;
+  if (edge->rule_ != other->rule_ || edge->pool_ != other->pool_)
+    return false;
+  if (edge->inputs_.size() != other->inputs_.size() ||
+      edge->implicit_deps_ != other->implicit_deps_ ||
+      edge->order_only_deps_ != other->order_only_deps_)
+    return false;
+  for (size_t i = 0; i < edge->inputs_.size(); ++i) {
+    if (edge->inputs_[i] != other->inputs_[i])
+      return false;
+  }
+  return command == candidate.command;
+}
+
+}  // namespace
+
+void State::DeduplicateEdges() {
+  METRIC_RECORD("dedup edges");
+  std::unordered_map<uint64_t, std::vector<DedupCandidate>> by_digest;
+  for (const auto & edge : edges_)
   {
-    path.second->ResetState();
+    // Only command edges merge; a dyndep binding can grow the input
+    // list at scan time, so those never count as identical.
+    if (edge->is_phony() || edge->dyndep_ != nullptr)
+      continue;
+
+    std::string command = edge->EvaluateCommand(/*incl_rsp_file=*/true);
+    uint64_t digest = std::hash<std::string_view>()(command);
+    for (const Node* input : edge->inputs_)
+      digest = (digest * 0x100000001b3) ^
+               std::hash<std::string_view>()(input->path());
+
+    std::vector<DedupCandidate>& bucket = by_digest[digest];
+    Edge* canonical = nullptr;
+    for (const DedupCandidate& candidate : bucket) {
+      if (IsDuplicateEdge(candidate, edge, command)) {
+        canonical = candidate.edge;
+        break;
+      }
+    }
+    if (!canonical) {
+      bucket.push_back({ edge, std::move(command) });
+      continue;
+    }
+
+    // The canonical edge keeps the work; this one becomes a phony alias
+    // from its outputs to the canonical outputs, so its targets stay
+    // buildable and its consumers still rebuild when the work reruns.
+    // The reverse index follows the rewiring.
+    for (Node* input : edge->inputs_)
+      input->RemoveOutEdge(edge);
+    edge->rule_ = &kPhonyRule;
+    edge->inputs_ = canonical->outputs_;
+    edge->implicit_deps_ = 0;
+    edge->order_only_deps_ = 0;
+    for (Node* input : edge->inputs_)
+      input->AddOutEdge(edge);
   }
+}
+
+void State::Reset() {
+  // The nodes' scan state lives in its own slabs, so resetting it is a
+  // sweep over compact memory rather than a visit of every Node.
+  scan_arena_.ForEach([](NodeScanState& scan) {
+    scan.mtime = -1;
+    scan.dirty = false;
+  });
   for (const auto & edge : edges_)
   {
     edge->outputs_ready_ = false;
@@ -197,12 +391,37 @@ void State::Reset() {
   }
 }
 
+void State::ResetForWatch() {
+  scan_arena_.ForEach([](NodeScanState& scan) {
+    scan.dirty = false;
+  });
+  for (const auto & edge : edges_)
+  {
+    edge->outputs_ready_ = false;
+    edge->mark_ = Edge::VisitNone;
+    if (edge->dyndep_)
+      continue;
+    if (edge->discovered_deps_ > 0) {
+      size_t order_only_start = edge->inputs_.size() - edge->order_only_deps_;
+      Edge::Nodes::iterator first =
+          edge->inputs_.begin() + (order_only_start - edge->discovered_deps_);
+      Edge::Nodes::iterator last = edge->inputs_.begin() + order_only_start;
+      for (Edge::Nodes::iterator it = first; it != last; ++it)
+        (*it)->RemoveOutEdge(edge);
+      edge->inputs_.erase(first, last);
+      edge->implicit_deps_ -= edge->discovered_deps_;
+      edge->discovered_deps_ = 0;
+    }
+    edge->deps_loaded_ = false;
+  }
+}
+
 void State::Dump() {
   for (const auto & path : paths_)
   {
     Node* node = path.second;
     printf("%s %s [id:%d]\n",
-           node->path().c_str(),
+           node->path_cstr(),
            node->status_known()
             ? (  node->dirty()
                ? "dirty"
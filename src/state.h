@@ -15,18 +15,22 @@
 #ifndef NINJA_STATE_H_
 #define NINJA_STATE_H_
 
+#include <deque>
 #include <map>
 #include <set>
 #include <vector>
 #include <string_view>
 #include <unordered_map>
 
+#include "arena.h"
+#include "disk_interface.h"
 #include "eval_env.h"
+#include "graph.h"
+#include "path_map.h"
 #include "util.h"
 
-struct Edge;
-struct Node;
 struct Rule;
+struct StatPrefetcher;
 
 /// A pool for delayed edges.
 /// Pools are scoped to a State. Edges within a State will share Pools. A Pool
@@ -46,6 +50,11 @@ struct Pool final {
   const std::string & name() const { return name_; }
   int current_use() const { return current_use_; }
 
+  /// Which manifest file declared this pool (-1 for the built-in pools);
+  /// used by the incremental manifest reparse.
+  int32_t origin_file() const { return origin_file_; }
+  void set_origin_file(int32_t origin_file) { origin_file_ = origin_file; }
+
   /// true if the Pool might delay this edge
   bool ShouldDelayEdge() const { return depth_ != 0; }
 
@@ -61,7 +70,7 @@ struct Pool final {
   void DelayEdge(Edge* edge);
 
   /// Pool will add zero or more edges to the ready_queue
-  void RetrieveReadyEdges(std::set<Edge*>* ready_queue);
+  void RetrieveReadyEdges(ShardedEdgeQueue* ready_queue);
 
   /// Dump the Pool and its edges (useful for debugging).
   void Dump() const;
@@ -73,11 +82,15 @@ struct Pool final {
   /// currently scheduled in the Plan (i.e. the edges in Plan::ready_).
   int current_use_ = 0;
   int depth_;
-
-  static bool WeightedEdgeCmp(const Edge* a, const Edge* b);
-
-  typedef std::set<Edge*,bool(*)(const Edge*, const Edge*)> DelayedEdges;
-  DelayedEdges delayed_{&WeightedEdgeCmp};
+  int32_t origin_file_ = -1;
+
+  /// Delayed edges bucketed by weight, lightest first; each bucket is a
+  /// FIFO holding edges in the order they were delayed.  Admission pops
+  /// the front of the lightest bucket, so delaying an edge and the
+  /// per-completion retrieval are O(1) amortized rather than churning a
+  /// weight-sorted set.  (Edge weights are a single value today, so in
+  /// practice this is one bucket.)
+  std::map<int, std::deque<Edge*>> delayed_;
 };
 
 /// Global state (file status) for a single run.
@@ -99,22 +112,59 @@ struct State final {
 
   void AddIn(Edge* edge, std::string_view path, uint64_t slash_bits);
   bool AddOut(Edge* edge, std::string_view path, uint64_t slash_bits);
-  bool AddDefault(std::string_view path, std::string* error);
+  bool AddDefault(std::string_view path, std::string* error,
+                  int32_t origin_file = -1);
+
+  /// Splice pure pass-through phony edges (single-output phony aliases)
+  /// out of phony consumers, rewiring those consumers directly to the
+  /// aliases' real inputs.  The alias edges themselves stay in the graph
+  /// -- their targets remain buildable and the query tools still show
+  /// them -- but collapsed consumers no longer reach them, so the dirty
+  /// scan and the plan skip them entirely.  Command edges are never
+  /// rewired, since substituting an alias would change their $in.
+  /// Run after parsing and before scanning.
+  void CollapsePhonyEdges();
+
+  /// Merge command-and-input-identical edges: when several command edges
+  /// evaluate to the same command over the same inputs -- a generator
+  /// emitting the same work under different phony umbrellas -- the first
+  /// keeps the work and each duplicate is turned into a phony alias from
+  /// its outputs to the first one's, so the duplicate is neither scanned
+  /// as a command nor executed.  Candidates are found by hashing the
+  /// command and input list, then verified field by field; edges with a
+  /// dyndep binding never merge, since dyndep can grow their inputs at
+  /// scan time.  Run after parsing and before scanning.
+  void DeduplicateEdges();
 
   /// Reset state.  Keeps all nodes and edges, but restores them to the
   /// state where we haven't yet examined the disk for dirty state.
   void Reset();
 
+  /// Reset between builds of a resident (--watch) process: like Reset(),
+  /// but node mtimes are kept -- the watcher invalidates the changed ones
+  /// individually -- and scan-discovered depfile deps are stripped so the
+  /// next scan re-reads any depfile the build refreshed.  Edges updated
+  /// by dyndep keep their discovered inputs and outputs; dyndep files are
+  /// loaded once per process.
+  void ResetForWatch();
+
   /// Dump the nodes and Pools (useful for debugging).
   void Dump();
 
   /// @return the root node(s) of the graph. (Root nodes have no output edges).
   /// @param error where to write the error message if somethings went wrong.
+  /// The result is cached against Node::edge_link_revision(), so repeated
+  /// queries over an unchanged graph (watch-mode rebuilds, tools run back
+  /// to back) skip the every-edge sweep.
   std::vector<Node*> RootNodes(std::string* error) const;
   std::vector<Node*> DefaultNodes(std::string* error) const;
 
+  /// Hint that up to \a count additional nodes are about to be added;
+  /// sizes paths_ up front so the insertions do not rehash mid-parse.
+  void ReserveNodes(size_t count) { paths_.reserve(paths_.size() + count); }
+
   /// Mapping of path -> Node.
-  using Paths = std::unordered_map<std::string_view, Node*>;
+  using Paths = PathMap;
   Paths paths_;
 
   /// All the pools used in the graph.
@@ -125,6 +175,71 @@ struct State final {
 
   BindingEnv bindings_;
   std::vector<Node*> defaults_;
+  /// Which manifest file declared each entry of defaults_ (parallel vector;
+  /// -1 when unknown).  Used by the incremental manifest reparse.
+  std::vector<int32_t> default_origins_;
+
+  /// Backing storage (heap buffers or memory mappings) of every manifest
+  /// file parsed into this State.  Kept alive for the lifetime of the State
+  /// so parsed data may point into it without copying.
+  std::vector<std::unique_ptr<LoadedFile>> loaded_files_;
+
+  /// One record per manifest file parsed into this State, in load order.
+  /// ManifestCache uses the records both as the freshness key of its
+  /// snapshot and to reparse individual subninja scopes incrementally.
+  /// A record with an empty path is a tombstone left behind by an
+  /// incremental reparse; indices stay stable because edges and child
+  /// records refer to files by index.
+  struct ManifestFile {
+    std::string path;
+    /// Index of the including file, -1 for the root.
+    int32_t parent = -1;
+    /// Loaded by 'subninja' (its own scope) rather than 'include'.
+    bool subninja = false;
+    /// The scope the file's statements were merged into.
+    BindingEnv* env = nullptr;
+  };
+  std::vector<ManifestFile> manifest_files_;
+
+  /// Deps discovered from an edge's depfile during an earlier run,
+  /// restored from the manifest cache.  While the depfile's mtime still
+  /// matches, ImplicitDepLoader reuses them and skips reading and parsing
+  /// the depfile.
+  struct CachedEdgeDeps {
+    TimeStamp depfile_mtime = -1;
+    std::vector<Node*> deps;
+  };
+  std::unordered_map<const Edge*, CachedEdgeDeps> cached_deps_;
+  /// Set when a depfile was actually read this run (i.e. cached_deps_
+  /// gained or replaced a record), so the cache is worth rewriting after
+  /// the build.
+  bool cached_deps_dirty_ = false;
+
+  /// Slab storage for all Nodes and Edges of the graph.  Allocating them
+  /// contiguously keeps whole-graph traversals cache-friendly and lets the
+  /// State tear down in a handful of frees instead of one per object.
+  Arena<Node> node_arena_;
+  Arena<Edge> edge_arena_;
+
+  /// Hot dependency-scan state of every node, slab-allocated in the same
+  /// creation order as node_arena_ so scans and resets sweep compact
+  /// memory; each Node points at its slot.
+  Arena<NodeScanState> scan_arena_;
+
+  /// Interned storage for every node path; paths_ keys and Node::path()
+  /// are views into it.
+  StringArena path_arena_;
+
+  /// When set, GetNode hands every newly created node's path to the
+  /// prefetcher, whose background stats warm the kernel caches while the
+  /// manifest is still being parsed.  Owned by the caller; only set while
+  /// the manifest is loading.
+  StatPrefetcher* stat_prefetcher_ = nullptr;
+
+  /// RootNodes() result, valid while root_nodes_revision_ still matches
+  /// Node::edge_link_revision().  Mutable: the query is logically const.
+  mutable std::vector<Node*> root_nodes_;
+  mutable int64_t root_nodes_revision_ = -1;
 };
 
 #endif  // NINJA_STATE_H_
@@ -45,4 +45,134 @@ TEST(State, Basic) {
   EXPECT_FALSE(state.GetNode("out", 0)->dirty());
 }
 
+TEST(State, RootNodesCacheTracksEdgeLinks) {
+  State state;
+
+  Rule* rule = new Rule("cat");
+  state.bindings_.AddRule(rule);
+
+  Edge* edge = state.AddEdge(rule);
+  state.AddIn(edge, "in", 0);
+  state.AddOut(edge, "out", 0);
+
+  std::string err;
+  std::vector<Node*> roots = state.RootNodes(&err);
+  ASSERT_EQ(1u, roots.size());
+  EXPECT_EQ("out", roots[0]->path());
+  EXPECT_EQ("", err);
+
+  // A second query over the unchanged graph serves the cached vector.
+  EXPECT_EQ(roots, state.RootNodes(&err));
+
+  // Consuming "out" moves the root; the cache must notice the new link.
+  Edge* edge2 = state.AddEdge(rule);
+  state.AddIn(edge2, "out", 0);
+  state.AddOut(edge2, "out2", 0);
+  roots = state.RootNodes(&err);
+  ASSERT_EQ(1u, roots.size());
+  EXPECT_EQ("out2", roots[0]->path());
+}
+
+struct CollapsePhonyTest : public StateTestWithBuiltinRules {};
+
+TEST_F(CollapsePhonyTest, SplicePhonyChain) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"build out: cat alias2\n"
+"build all: phony alias2 extra || oo\n"
+"build alias2: phony alias1\n"
+"build alias1: phony real1 real2\n"
+"build real1: cat in1\n"
+"build extra: cat in2\n"));
+
+  state_.CollapsePhonyEdges();
+
+  // The phony consumer is rewired past both alias hops.
+  Edge* all = GetNode("all")->in_edge();
+  ASSERT_EQ(4u, all->inputs_.size());
+  EXPECT_EQ("real1", all->inputs_[0]->path());
+  EXPECT_EQ("real2", all->inputs_[1]->path());
+  EXPECT_EQ("extra", all->inputs_[2]->path());
+  EXPECT_EQ("oo", all->inputs_[3]->path());
+  EXPECT_EQ(1, all->order_only_deps_);
+
+  // The command edge keeps its alias input; its $in must not change.
+  Edge* out = GetNode("out")->in_edge();
+  ASSERT_EQ(1u, out->inputs_.size());
+  EXPECT_EQ("alias2", out->inputs_[0]->path());
+
+  // The alias edges stay in the graph, flattened themselves, so their
+  // targets remain buildable and the tools still see them.
+  Edge* alias2 = GetNode("alias2")->in_edge();
+  ASSERT_TRUE(alias2);
+  ASSERT_EQ(2u, alias2->inputs_.size());
+  EXPECT_EQ("real1", alias2->inputs_[0]->path());
+
+  // The reverse index followed the rewiring: real1 now also feeds the
+  // flattened alias2 edge and the rewired all edge.
+  EXPECT_EQ(3u, GetNode("real1")->out_edges().size());
+  ASSERT_EQ(1u, GetNode("alias2")->out_edges().size());
+  EXPECT_EQ(out, GetNode("alias2")->out_edges()[0]);
+}
+
+TEST_F(CollapsePhonyTest, PhonyCycle) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"build x: phony y\n"
+"build y: phony x\n"
+"build all: phony x\n"));
+
+  // A phony cycle stops the expansion rather than looping; the consumer
+  // keeps the alias it reached the cycle through.
+  state_.CollapsePhonyEdges();
+  Edge* all = GetNode("all")->in_edge();
+  ASSERT_EQ(1u, all->inputs_.size());
+  EXPECT_EQ("x", all->inputs_[0]->path());
+}
+
+struct DeduplicateEdgesTest : public StateTestWithBuiltinRules {};
+
+TEST_F(DeduplicateEdgesTest, MergeIdenticalCommands) {
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"rule gen\n"
+"  command = generate --all\n"
+"build out1: gen in1 in2\n"
+"build out2: gen in1 in2\n"
+"build out3: gen in1\n"
+"build all: phony out2\n"));
+
+  state_.DeduplicateEdges();
+
+  // The first gen edge keeps the work...
+  Edge* canonical = GetNode("out1")->in_edge();
+  EXPECT_FALSE(canonical->is_phony());
+
+  // ...and the identical second one becomes a phony alias of its
+  // outputs, fed by the canonical outputs.
+  Edge* dupe = GetNode("out2")->in_edge();
+  ASSERT_TRUE(dupe->is_phony());
+  ASSERT_EQ(1u, dupe->inputs_.size());
+  EXPECT_EQ("out1", dupe->inputs_[0]->path());
+
+  // A gen edge over different inputs is untouched.
+  EXPECT_FALSE(GetNode("out3")->in_edge()->is_phony());
+
+  // The reverse index followed the rewiring: in1 feeds only the two
+  // surviving command edges, and out1 now also feeds the alias.
+  EXPECT_EQ(2u, GetNode("in1")->out_edges().size());
+  ASSERT_EQ(1u, GetNode("out1")->out_edges().size());
+  EXPECT_EQ(dupe, GetNode("out1")->out_edges()[0]);
+}
+
+TEST_F(DeduplicateEdgesTest, DifferentCommandsKept) {
+  // cat's command references $out, so these edges evaluate to different
+  // commands despite their identical inputs.
+  ASSERT_NO_FATAL_FAILURE(AssertParse(&state_,
+"build out1: cat in1\n"
+"build out2: cat in1\n"));
+
+  state_.DeduplicateEdges();
+
+  EXPECT_FALSE(GetNode("out1")->in_edge()->is_phony());
+  EXPECT_FALSE(GetNode("out2")->in_edge()->is_phony());
+}
+
 }  // namespace
@@ -16,15 +16,21 @@
 
 #include <sys/select.h>
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 #include <spawn.h>
 
-#if defined(USE_PPOLL)
+#if defined(USE_EPOLL)
+#include <algorithm>
+#include <sys/epoll.h>
+#elif defined(USE_PPOLL)
 #include <poll.h>
 #else
 #include <sys/select.h>
@@ -32,6 +38,7 @@
 
 extern char** environ;
 
+#include "spawn_broker.h"
 #include "util.h"
 
 Subprocess::~Subprocess() {
@@ -42,19 +49,129 @@ Subprocess::~Subprocess() {
     Finish();
 }
 
+// static
+bool Subprocess::TokenizeForDirectExec(const std::string& command,
+                                       std::vector<std::string>* args) {
+  args->clear();
+  std::string word;
+  for (char c : command) {
+    if (c == ' ') {
+      if (!word.empty()) {
+        args->push_back(word);
+        word.clear();
+      }
+      continue;
+    }
+    // Only bytes that no POSIX shell treats specially in any position.
+    if (isalnum(static_cast<unsigned char>(c)) ||
+        strchr("_-+,./:@=%", c) != nullptr) {
+      word.push_back(c);
+      continue;
+    }
+    return false;
+  }
+  if (!word.empty())
+    args->push_back(word);
+  if (args->empty())
+    return false;
+
+  const std::string& argv0 = args->front();
+  // A leading FOO=bar word is a shell environment assignment, not a
+  // program name.
+  if (argv0.find('=') != std::string::npos)
+    return false;
+  // Shell builtins whose effect an exec'd binary cannot reproduce.
+  static const char* kBuiltins[] = { "cd",   "eval",  "exec", "exit",
+                                     "export", "read", "set",  "shift",
+                                     "trap", "ulimit", "umask", "unset",
+                                     "wait", ".", ":" };
+  for (const char* builtin : kBuiltins) {
+    if (argv0 == builtin)
+      return false;
+  }
+  return true;
+}
+
+#ifdef __linux__
+// static
+bool Subprocess::ParseCpuList(const std::string& cpus, cpu_set_t* set) {
+  CPU_ZERO(set);
+  const char* s = cpus.c_str();
+  while (*s) {
+    char* end;
+    long first = strtol(s, &end, 10);
+    if (end == s || first < 0 || first >= CPU_SETSIZE)
+      return false;
+    long last = first;
+    if (*end == '-') {
+      s = end + 1;
+      last = strtol(s, &end, 10);
+      if (end == s || last < first || last >= CPU_SETSIZE)
+        return false;
+    }
+    for (long cpu = first; cpu <= last; ++cpu)
+      CPU_SET(cpu, set);
+    if (*end == ',')
+      ++end;
+    else if (*end != '\0')
+      return false;
+    s = end;
+  }
+  return CPU_COUNT(set) > 0;
+}
+
+void Subprocess::SetPlacement(const std::string& cpu_affinity,
+                              const std::string& cgroup) {
+  if (!cpu_affinity.empty()) {
+    cpu_set_t set;
+    if (!ParseCpuList(cpu_affinity, &set))
+      Warning("ignoring invalid cpu_affinity '%s'", cpu_affinity.c_str());
+    else if (sched_setaffinity(pid_, sizeof(set), &set) < 0)
+      Warning("sched_setaffinity: %s", strerror(errno));
+  }
+  if (!cgroup.empty()) {
+    std::string procs_path = cgroup + "/cgroup.procs";
+    FILE* f = fopen(procs_path.c_str(), "we");
+    bool ok = f != nullptr && fprintf(f, "%d\n", pid_) >= 0;
+    if (f)
+      ok = (fclose(f) == 0) && ok;
+    if (!ok)
+      Warning("failed to move pid %d into cgroup '%s': %s", pid_,
+              cgroup.c_str(), strerror(errno));
+  }
+}
+#endif  // __linux__
+
+// Launch via posix_spawn rather than fork+exec: with a large resident
+// parent (graph + logs) fork's page-table copy costs milliseconds per
+// edge, a real tax across hundreds of thousands of spawns.  The pipe and
+// terminal setup that would otherwise run between fork and exec is
+// expressed as file_actions, and the spawn attributes restore the signal
+// mask SubprocessSet blocked in the parent.
 bool Subprocess::Start(SubprocessSet* set, const std::string& command) {
   int output_pipe[2];
   if (pipe(output_pipe) < 0)
     Fatal("pipe: %s", strerror(errno));
   fd_ = output_pipe[0];
-#if !defined(USE_PPOLL)
-  // If available, we use ppoll in DoWork(); otherwise we use pselect
-  // and so must avoid overly-large FDs.
+#if !defined(USE_PPOLL) && !defined(USE_EPOLL)
+  // If available, we use epoll or ppoll in DoWork(); otherwise we use
+  // pselect and so must avoid overly-large FDs.
   if (fd_ >= static_cast<int>(FD_SETSIZE))
     Fatal("pipe: %s", strerror(EMFILE));
-#endif  // !USE_PPOLL
+#endif  // !USE_PPOLL && !USE_EPOLL
   SetCloseOnExec(fd_);
 
+  // With a spawn broker running, fork from its small address space
+  // instead of ours; the broker plays the role of the file actions and
+  // process-group setup below.
+  if (SpawnBroker* broker = SpawnBroker::Get()) {
+    if (!broker->Spawn(command, use_console_, output_pipe[1], &pid_))
+      Fatal("spawn broker failed");
+    via_broker_ = true;
+    close(output_pipe[1]);
+    return true;
+  }
+
   posix_spawn_file_actions_t action;
   int err = posix_spawn_file_actions_init(&action);
   if (err != 0)
@@ -111,11 +228,29 @@ bool Subprocess::Start(SubprocessSet* set, const std::string& command) {
   if (err != 0)
     Fatal("posix_spawnattr_setflags: %s", strerror(err));
 
-  const char* spawned_args[] = { "/bin/sh", "-c", command.c_str(), nullptr };
-  err = posix_spawn(&pid_, "/bin/sh", &action, &attr,
-        const_cast<char**>(spawned_args), environ);
-  if (err != 0)
-    Fatal("posix_spawn: %s", strerror(err));
+  // Metacharacter-free commands skip /bin/sh entirely: the shell would
+  // only split words and PATH-search the binary, both of which
+  // posix_spawnp does for us.  That saves a shell process per edge.  If
+  // the direct spawn fails (ENOENT and friends) fall through to the
+  // shell so a missing program still reports the way it always has.
+  std::vector<std::string> direct_args;
+  err = ENOENT;
+  if (TokenizeForDirectExec(command, &direct_args)) {
+    std::vector<char*> direct_argv;
+    direct_argv.reserve(direct_args.size() + 1);
+    for (std::string& arg : direct_args)
+      direct_argv.push_back(&arg[0]);
+    direct_argv.push_back(nullptr);
+    err = posix_spawnp(&pid_, direct_argv[0], &action, &attr,
+          direct_argv.data(), environ);
+  }
+  if (err != 0) {
+    const char* spawned_args[] = { "/bin/sh", "-c", command.c_str(), nullptr };
+    err = posix_spawn(&pid_, "/bin/sh", &action, &attr,
+          const_cast<char**>(spawned_args), environ);
+    if (err != 0)
+      Fatal("posix_spawn: %s", strerror(err));
+  }
 
   err = posix_spawnattr_destroy(&attr);
   if (err != 0)
@@ -129,11 +264,24 @@ bool Subprocess::Start(SubprocessSet* set, const std::string& command) {
 }
 
 void Subprocess::OnPipeReady() {
-  char buf[4 << 10];
-  ssize_t len = read(fd_, buf, sizeof(buf));
+  // Read straight into buf_'s tail rather than bouncing through a stack
+  // buffer: one copy instead of two, and the 64KB chunk keeps the
+  // syscall count low for chatty tools.  std::string's geometric growth
+  // amortizes the reallocation cost across appends.
+  static const size_t kReadChunk = 64 << 10;
+  size_t used = buf_.size();
+  buf_.resize(used + kReadChunk);
+  ssize_t len = read(fd_, &buf_[used], kReadChunk);
   if (len > 0) {
-    buf_.append(buf, len);
+    if (output_callback_) {
+      // Streaming edge: hand the chunk off and keep the buffer bounded.
+      output_callback_(&buf_[used], len);
+      buf_.resize(used);
+    } else {
+      buf_.resize(used + len);
+    }
   } else {
+    buf_.resize(used);
     if (len < 0)
       Fatal("read: %s", strerror(errno));
     close(fd_);
@@ -144,10 +292,26 @@ void Subprocess::OnPipeReady() {
 ExitStatus Subprocess::Finish() {
   assert(pid_ != -1);
   int status;
-  if (waitpid(pid_, &status, 0) < 0)
-    Fatal("waitpid(%d): %s", pid_, strerror(errno));
+  struct rusage rusage = {};
+  if (via_broker_) {
+    // The child belongs to the broker; have it reap and report.
+    if (!SpawnBroker::Get()->Wait(pid_, &status, &rusage))
+      Fatal("spawn broker wait failed");
+  } else if (wait4(pid_, &status, 0, &rusage) < 0)
+    Fatal("wait4(%d): %s", pid_, strerror(errno));
   pid_ = -1;
 
+  user_time_millis_ = static_cast<int>(rusage.ru_utime.tv_sec * 1000 +
+                                       rusage.ru_utime.tv_usec / 1000);
+  system_time_millis_ = static_cast<int>(rusage.ru_stime.tv_sec * 1000 +
+                                         rusage.ru_stime.tv_usec / 1000);
+#ifdef __APPLE__
+  // ru_maxrss is bytes on macOS, kilobytes everywhere else.
+  peak_rss_kb_ = static_cast<uint64_t>(rusage.ru_maxrss) >> 10;
+#else
+  peak_rss_kb_ = static_cast<uint64_t>(rusage.ru_maxrss);
+#endif
+
   if (WIFEXITED(status)) {
     int exit = WEXITSTATUS(status);
     if (exit == 0)
@@ -207,11 +371,21 @@ SubprocessSet::SubprocessSet() {
     Fatal("sigaction: %s", strerror(errno));
   if (sigaction(SIGHUP, &act, &old_hup_act_) < 0)
     Fatal("sigaction: %s", strerror(errno));
+
+#ifdef USE_EPOLL
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0)
+    Fatal("epoll_create1: %s", strerror(errno));
+#endif
 }
 
 SubprocessSet::~SubprocessSet() {
   Clear();
 
+#ifdef USE_EPOLL
+  close(epoll_fd_);
+#endif
+
   if (sigaction(SIGINT, &old_int_act_, 0) < 0)
     Fatal("sigaction: %s", strerror(errno));
   if (sigaction(SIGTERM, &old_term_act_, 0) < 0)
@@ -222,17 +396,109 @@ SubprocessSet::~SubprocessSet() {
     Fatal("sigprocmask: %s", strerror(errno));
 }
 
+#ifdef USE_EPOLL
+void SubprocessSet::EpollRegister(int fd) {
+  epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+    Fatal("epoll_ctl: %s", strerror(errno));
+}
+#endif
+
+void SubprocessSet::AddExtraFd(int fd, std::function<void()> callback) {
+#if !defined(USE_PPOLL) && !defined(USE_EPOLL)
+  if (fd >= static_cast<int>(FD_SETSIZE))
+    Fatal("pipe: %s", strerror(EMFILE));
+#endif  // !USE_PPOLL && !USE_EPOLL
+#ifdef USE_EPOLL
+  EpollRegister(fd);
+#endif
+  extra_fds_.emplace_back(fd, std::move(callback));
+}
+
+void SubprocessSet::RemoveExtraFd(int fd) {
+#ifdef USE_EPOLL
+  // EBADF/ENOENT mean the fd was already closed, which deregistered it.
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr) < 0 &&
+      errno != EBADF && errno != ENOENT)
+    Fatal("epoll_ctl: %s", strerror(errno));
+#endif
+  for (std::vector<std::pair<int, std::function<void()>>>::iterator it =
+           extra_fds_.begin();
+       it != extra_fds_.end(); ++it) {
+    if (it->first == fd) {
+      extra_fds_.erase(it);
+      return;
+    }
+  }
+}
+
 Subprocess *SubprocessSet::Add(const std::string& command, bool use_console) {
   Subprocess *subprocess = new Subprocess(use_console);
   if (!subprocess->Start(this, command)) {
     delete subprocess;
     return 0;
   }
+#ifdef USE_EPOLL
+  EpollRegister(subprocess->fd_);
+  epoll_subprocs_[subprocess->fd_] = subprocess;
+#endif
   running_.push_back(subprocess);
   return subprocess;
 }
 
-#ifdef USE_PPOLL
+#if defined(USE_EPOLL)
+bool SubprocessSet::DoWork() {
+  epoll_event events[64];
+
+  interrupted_ = 0;
+  int ret = epoll_pwait(epoll_fd_, events,
+                        sizeof(events) / sizeof(events[0]), -1, &old_mask_);
+  if (ret == -1) {
+    if (errno != EINTR) {
+      perror("ninja: epoll_pwait");
+      return false;
+    }
+    return IsInterrupted();
+  }
+
+  HandlePendingInterruption();
+  if (IsInterrupted())
+    return true;
+
+  for (int i = 0; i < ret; ++i) {
+    int fd = events[i].data.fd;
+    if (auto const& it = epoll_subprocs_.find(fd);
+        it != epoll_subprocs_.end()) {
+      Subprocess* subproc = it->second;
+      subproc->OnPipeReady();
+      if (subproc->Done()) {
+        // OnPipeReady() closed the pipe, which also deregistered it.
+        epoll_subprocs_.erase(it);
+        running_.erase(std::find(running_.begin(), running_.end(), subproc));
+        finished_.push(subproc);
+      }
+      continue;
+    }
+    // Not a subprocess pipe, so an extra fd.  Copy the callback out of
+    // extra_fds_ before invoking it: it may remove its own entry, and an
+    // earlier callback in this batch may already have removed this one.
+    std::function<void()> callback;
+    for (const auto & extra : extra_fds_) {
+      if (extra.first == fd) {
+        callback = extra.second;
+        break;
+      }
+    }
+    if (callback)
+      callback();
+  }
+
+  return IsInterrupted();
+}
+
+#elif defined(USE_PPOLL)
 bool SubprocessSet::DoWork() {
   std::vector<pollfd> fds;
   nfds_t nfds = 0;
@@ -246,6 +512,12 @@ bool SubprocessSet::DoWork() {
     fds.push_back(pfd);
     ++nfds;
   }
+  for (const auto & extra : extra_fds_)
+  {
+    pollfd pfd = { extra.first, POLLIN | POLLPRI, 0 };
+    fds.push_back(pfd);
+    ++nfds;
+  }
 
   interrupted_ = 0;
   int ret = ppoll(&fds.front(), nfds, nullptr, &old_mask_);
@@ -278,11 +550,17 @@ bool SubprocessSet::DoWork() {
     }
     ++i;
   }
+  // Snapshot: a callback may remove its own fd from extra_fds_.
+  std::vector<std::pair<int, std::function<void()>>> extras(extra_fds_);
+  for (size_t extra = 0; extra < extras.size(); ++extra) {
+    if (fds[cur_nfd + extra].revents)
+      extras[extra].second();
+  }
 
   return IsInterrupted();
 }
 
-#else  // !defined(USE_PPOLL)
+#else  // !defined(USE_EPOLL) && !defined(USE_PPOLL)
 bool SubprocessSet::DoWork() {
   fd_set set;
   int nfds = 0;
@@ -297,6 +575,12 @@ bool SubprocessSet::DoWork() {
         nfds = fd+1;
     }
   }
+  for (const auto & extra : extra_fds_)
+  {
+    FD_SET(extra.first, &set);
+    if (nfds < extra.first+1)
+      nfds = extra.first+1;
+  }
 
   interrupted_ = 0;
   int ret = pselect(nfds, &set, 0, 0, 0, &old_mask_);
@@ -325,10 +609,17 @@ bool SubprocessSet::DoWork() {
     }
     ++i;
   }
+  // Snapshot: a callback may remove its own fd from extra_fds_.
+  std::vector<std::pair<int, std::function<void()>>> extras(extra_fds_);
+  for (const auto & extra : extras)
+  {
+    if (FD_ISSET(extra.first, &set))
+      extra.second();
+  }
 
   return IsInterrupted();
 }
-#endif  // !defined(USE_PPOLL)
+#endif  // !defined(USE_EPOLL) && !defined(USE_PPOLL)
 
 Subprocess* SubprocessSet::NextFinished() {
   if (finished_.empty())
@@ -353,4 +644,9 @@ void SubprocessSet::Clear() {
     delete item;
   }
   running_.clear();
+#ifdef USE_EPOLL
+  // Deleting the subprocesses closed their pipes, which deregistered
+  // them from the epoll instance.
+  epoll_subprocs_.clear();
+#endif
 }
@@ -15,7 +15,11 @@
 #ifndef NINJA_SUBPROCESS_H_
 #define NINJA_SUBPROCESS_H_
 
+#include <stdint.h>
+
+#include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <queue>
 
@@ -26,6 +30,10 @@
 #include <signal.h>
 #endif
 
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 // ppoll() exists on FreeBSD, but only on newer versions.
 #ifdef __FreeBSD__
 #  include <sys/param.h>
@@ -34,6 +42,15 @@
 #  endif
 #endif
 
+// On Linux, DoWork() drains a persistent epoll instance instead of
+// rebuilding a ppoll/pselect fd set on every wakeup: registrations
+// outlive the wait call and readiness delivery is O(events), which
+// matters at high -j where most pipes are quiet.  NINJA_FORCE_PSELECT
+// (configure's --force-pselect) disables it along with ppoll.
+#if defined(__linux__) && !defined(NINJA_FORCE_PSELECT)
+#  define USE_EPOLL
+#endif
+
 #include "exit_status.h"
 
 /// Subprocess wraps a single async subprocess.  It is entirely
@@ -51,12 +68,54 @@ struct Subprocess final {
 
   const std::string& GetOutput() const;
 
+  /// Resource usage of the child, captured when Finish() reaps it via
+  /// wait4(): CPU times in milliseconds, peak RSS in KiB.  Zero until
+  /// Finish() returns, and on Windows, whose reap path has no rusage.
+  int user_time_millis() const { return user_time_millis_; }
+  int system_time_millis() const { return system_time_millis_; }
+  uint64_t peak_rss_kb() const { return peak_rss_kb_; }
+
+  /// Deliver output to \a callback as it arrives instead of
+  /// accumulating it in the buffer; GetOutput() then stays empty.  Used
+  /// for rules that opt into live streaming, so a chatty long-running
+  /// edge neither sits silent nor holds megabytes of output in RSS.
+  void set_output_callback(std::function<void(const char*, size_t)> callback) {
+    output_callback_ = std::move(callback);
+  }
+
+#ifndef _WIN32
+  /// If \a command is free of shell metacharacters — the shell would do
+  /// nothing but split words and PATH-search the first one — fill
+  /// \a args with its words and return true, meaning the command can be
+  /// exec'd directly without spawning /bin/sh.
+  static bool TokenizeForDirectExec(const std::string& command,
+                                    std::vector<std::string>* args);
+#endif
+
+#ifdef __linux__
+  /// Pin the child to a CPU list ("0-15,32-47") and/or move it into an
+  /// existing cgroup directory.  Called from the parent right after
+  /// spawn; both attributes are process-wide, so placement takes
+  /// effect even though the child is already running.  Failures warn
+  /// rather than fail the edge: a build on a machine without the
+  /// configured cgroup should still work, just unplaced.
+  void SetPlacement(const std::string& cpu_affinity,
+                    const std::string& cgroup);
+
+  /// Parse a kernel-style CPU list ("0,2,8-11") into \a set.
+  static bool ParseCpuList(const std::string& cpus, cpu_set_t* set);
+#endif
+
  private:
   Subprocess(bool use_console);
   bool Start(struct SubprocessSet* set, const std::string& command);
   void OnPipeReady();
 
   std::string buf_;
+  std::function<void(const char*, size_t)> output_callback_;
+  int user_time_millis_ = 0;
+  int system_time_millis_ = 0;
+  uint64_t peak_rss_kb_ = 0;
 
 #ifdef _WIN32
   /// Set up pipe_ as the parent-side pipe of the subprocess; return the
@@ -71,6 +130,9 @@ struct Subprocess final {
 #else
   int fd_ = -1;
   pid_t pid_ = -1;
+  /// True when the child was spawned through the SpawnBroker and must
+  /// be reaped through it (it is the broker's child, not ours).
+  bool via_broker_ = false;
 #endif
   bool use_console_;
 
@@ -108,6 +170,24 @@ struct SubprocessSet final {
 
   static bool IsInterrupted() { return interrupted_ != 0; }
 
+  /// Watch an extra readable fd in DoWork() alongside the subprocess
+  /// pipes; \a callback runs on every readability.  Used by the
+  /// persistent-worker pool to demultiplex worker responses off the
+  /// same wait loop.  A callback may remove its own fd (e.g. on EOF)
+  /// but must not add new ones.
+  void AddExtraFd(int fd, std::function<void()> callback);
+  void RemoveExtraFd(int fd);
+  std::vector<std::pair<int, std::function<void()>>> extra_fds_;
+
+#ifdef USE_EPOLL
+  /// Register \a fd with the persistent epoll instance.
+  void EpollRegister(int fd);
+  int epoll_fd_ = -1;
+  /// Maps registered subprocess pipe fds back to their owners; event
+  /// fds not found here belong to extra_fds_.
+  std::unordered_map<int, Subprocess*> epoll_subprocs_;
+#endif
+
   struct sigaction old_int_act_;
   struct sigaction old_term_act_;
   struct sigaction old_hup_act_;
@@ -74,6 +74,58 @@ TEST_F(SubprocessTest, NoSuchCommand) {
 
 #ifndef _WIN32
 
+TEST_F(SubprocessTest, TokenizeForDirectExec) {
+  std::vector<std::string> args;
+  EXPECT_TRUE(Subprocess::TokenizeForDirectExec("gcc -c foo.c -o foo.o",
+                                                &args));
+  ASSERT_EQ(5u, args.size());
+  EXPECT_EQ("gcc", args[0]);
+  EXPECT_EQ("foo.o", args[4]);
+
+  // '=' inside an argument is fine; a leading FOO=bar word is a shell
+  // environment assignment and disqualifies the command.
+  EXPECT_TRUE(Subprocess::TokenizeForDirectExec("cc -DFOO=bar x.c", &args));
+  EXPECT_FALSE(Subprocess::TokenizeForDirectExec("FOO=bar cc x.c", &args));
+
+  // Anything the shell interprets must keep going through the shell.
+  EXPECT_FALSE(Subprocess::TokenizeForDirectExec("echo $$", &args));
+  EXPECT_FALSE(Subprocess::TokenizeForDirectExec("a && b", &args));
+  EXPECT_FALSE(Subprocess::TokenizeForDirectExec("cat < in > out", &args));
+  EXPECT_FALSE(Subprocess::TokenizeForDirectExec("echo 'quoted'", &args));
+  EXPECT_FALSE(Subprocess::TokenizeForDirectExec("cd /tmp", &args));
+  EXPECT_FALSE(Subprocess::TokenizeForDirectExec("", &args));
+}
+
+#ifdef __linux__
+TEST_F(SubprocessTest, ParseCpuList) {
+  cpu_set_t set;
+  ASSERT_TRUE(Subprocess::ParseCpuList("0,2,8-11", &set));
+  EXPECT_EQ(6, CPU_COUNT(&set));
+  EXPECT_TRUE(CPU_ISSET(0, &set));
+  EXPECT_FALSE(CPU_ISSET(1, &set));
+  EXPECT_TRUE(CPU_ISSET(2, &set));
+  EXPECT_TRUE(CPU_ISSET(8, &set));
+  EXPECT_TRUE(CPU_ISSET(11, &set));
+
+  EXPECT_FALSE(Subprocess::ParseCpuList("", &set));
+  EXPECT_FALSE(Subprocess::ParseCpuList("3-1", &set));
+  EXPECT_FALSE(Subprocess::ParseCpuList("0,x", &set));
+}
+#endif  // __linux__
+
+// A direct-exec'd command must behave like the shell-run equivalent.
+TEST_F(SubprocessTest, DirectExecOutput) {
+  Subprocess* subproc = subprocs_.Add("echo hello");
+  ASSERT_NE((Subprocess *) 0, subproc);
+
+  while (!subproc->Done()) {
+    subprocs_.DoWork();
+  }
+
+  EXPECT_EQ(ExitSuccess, subproc->Finish());
+  EXPECT_EQ("hello\n", subproc->GetOutput());
+}
+
 TEST_F(SubprocessTest, InterruptChild) {
   Subprocess* subproc = subprocs_.Add("kill -INT $$");
   ASSERT_NE((Subprocess *) 0, subproc);
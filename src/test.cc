@@ -174,6 +174,7 @@ bool VirtualFileSystem::MakeDir(const std::string& path) {
 FileReader::Status VirtualFileSystem::ReadFile(const std::string& path,
                                                std::string* contents,
                                                std::string* err) {
+  std::lock_guard<std::mutex> lock(read_mutex_);
   files_read_.push_back(path);
   FileMap::iterator i = files_.find(path);
   if (i != files_.end()) {
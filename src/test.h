@@ -15,6 +15,8 @@
 #ifndef NINJA_TEST_H_
 #define NINJA_TEST_H_
 
+#include <mutex>
+
 #include "disk_interface.h"
 #include "manifest_parser.h"
 #include "state.h"
@@ -147,6 +149,9 @@ struct VirtualFileSystem final : public DiskInterface {
   TimeStamp Stat(const std::string& path, std::string* err) const override final;
   bool WriteFile(const std::string& path, const std::string& contents) override final;
   bool MakeDir(const std::string& path) override final;
+  /// Safe to call from several threads at once (the batch dyndep loader
+  /// reads files on a worker pool); concurrent reads land in the read
+  /// log in serialization order.
   Status ReadFile(const std::string& path, std::string* contents,
                   std::string* err) override final;
   int RemoveFile(const std::string& path) override final;
@@ -167,6 +172,10 @@ struct VirtualFileSystem final : public DiskInterface {
 
   /// A simple fake timestamp for file operations.
   int now_ = 1;
+
+ private:
+  /// Serializes concurrent ReadFile() calls.
+  std::mutex read_mutex_;
 };
 
 struct ScopedTempDir final {
@@ -26,8 +26,13 @@
 
 // When considering file modification times we only care to compare
 // them against one another -- we never convert them to an absolute
-// real time.  On POSIX we use timespec (seconds&nanoseconds since epoch)
-// and on Windows we use a different value.  Both fit in an int64.
+// real time.  On POSIX this is nanoseconds since the epoch, taken from
+// st_mtim so two writes in the same second still order correctly; on
+// Windows it is the FILETIME tick count (100ns units) rebased to the
+// epoch.  Both fit in an int64, and the build log and deps log store
+// the full value, so sub-second comparisons survive across runs.
+// Special values: 0 means "does not exist" and -1 means "stat failed",
+// which is why a genuine mtime of 0 is clamped to 1 when statting.
 typedef int64_t TimeStamp;
 
 #endif  // NINJA_TIMESTAMP_H_
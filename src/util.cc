@@ -40,6 +40,12 @@
 #include <sys/time.h>
 #endif
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <vector>
 
 #if defined(__APPLE__) || defined(__FreeBSD__)
@@ -91,6 +97,59 @@ static bool IsPathSeparator(char c) {
 #endif
 }
 
+#ifndef _WIN32
+/// Returns true if \a path needs no canonicalization: no '.' or '..'
+/// component, no doubled or trailing slash.  A '.' that starts the path or
+/// follows a slash is treated as suspicious without looking further, so
+/// rare paths like "foo/.hidden" take the slow path but never get a wrong
+/// answer.  (Not used on Windows, where even a canonical path still needs
+/// its backslashes rewritten and slash_bits computed.)
+static bool PathIsAlreadyCanonical(const char* path, size_t len) {
+  if (path[0] == '.' || path[len - 1] == '/')
+    return false;
+  // From here on a byte is suspicious when it is '.' or '/' and follows a
+  // '/'.  The vector loops compare each 16-byte chunk against the chunk
+  // one byte behind it, so the predecessor test needs no cross-chunk
+  // carry; the overlapping unaligned loads are cheap on every target with
+  // these instruction sets.
+  size_t i = 1;
+#if defined(__SSE2__)
+  const __m128i dot = _mm_set1_epi8('.');
+  const __m128i slash = _mm_set1_epi8('/');
+  for (; i + 16 <= len; i += 16) {
+    __m128i cur = _mm_loadu_si128((const __m128i*)(path + i));
+    __m128i prev = _mm_loadu_si128((const __m128i*)(path + i - 1));
+    __m128i dot_or_slash = _mm_or_si128(_mm_cmpeq_epi8(cur, dot),
+                                        _mm_cmpeq_epi8(cur, slash));
+    __m128i suspicious = _mm_and_si128(dot_or_slash,
+                                       _mm_cmpeq_epi8(prev, slash));
+    if (_mm_movemask_epi8(suspicious))
+      return false;
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t dot = vdupq_n_u8('.');
+  const uint8x16_t slash = vdupq_n_u8('/');
+  for (; i + 16 <= len; i += 16) {
+    uint8x16_t cur = vld1q_u8((const uint8_t*)(path + i));
+    uint8x16_t prev = vld1q_u8((const uint8_t*)(path + i - 1));
+    uint8x16_t dot_or_slash = vorrq_u8(vceqq_u8(cur, dot),
+                                       vceqq_u8(cur, slash));
+    uint8x16_t suspicious = vandq_u8(dot_or_slash, vceqq_u8(prev, slash));
+    // Narrow the sixteen lanes to one 64-bit word to test for any match.
+    if (vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(
+                          vreinterpretq_u16_u8(suspicious), 4)),
+                      0))
+      return false;
+  }
+#endif
+  for (; i < len; ++i) {
+    if ((path[i] == '.' || path[i] == '/') && path[i - 1] == '/')
+      return false;
+  }
+  return true;
+}
+#endif  // !_WIN32
+
 bool CanonicalizePath(char* path, size_t* len, uint64_t* slash_bits,
                       std::string* err) {
   // WARNING: this function is performance-critical; please benchmark
@@ -101,6 +160,16 @@ bool CanonicalizePath(char* path, size_t* len, uint64_t* slash_bits,
     return false;
   }
 
+#ifndef _WIN32
+  // Almost every path that arrives here — each path mention during parse,
+  // each depfile entry — is already canonical; detect that with a wide
+  // compare and skip the component stack entirely.
+  if (PathIsAlreadyCanonical(path, *len)) {
+    *slash_bits = 0;
+    return true;
+  }
+#endif
+
   const int kMaxPathComponents = 60;
   char* components[kMaxPathComponents];
   int component_count = 0;
@@ -576,6 +645,22 @@ double GetLoadAverage() {
 }
 #endif // _WIN32
 
+int64_t ParseByteSize(const std::string& value) {
+  char* end;
+  double size = strtod(value.c_str(), &end);
+  if (end == value.c_str() || size < 0)
+    return -1;
+  switch (*end) {
+  case 'k': case 'K': size *= 1LL << 10; ++end; break;
+  case 'm': case 'M': size *= 1LL << 20; ++end; break;
+  case 'g': case 'G': size *= 1LL << 30; ++end; break;
+  case 't': case 'T': size *= 1LL << 40; ++end; break;
+  }
+  if (*end != '\0')
+    return -1;
+  return (int64_t)size;
+}
+
 std::string ElideMiddle(std::string_view const str, size_t const width)
 {
   switch (width) {
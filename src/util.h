@@ -116,6 +116,11 @@ int GetProcessorCount();
 /// on error.
 double GetLoadAverage();
 
+/// Parse a human-readable byte size like "512M" or "1.5G" (suffixes
+/// K/M/G/T, case-insensitive, no suffix means bytes).
+/// @return the size in bytes, or -1 if \a value does not parse.
+int64_t ParseByteSize(const std::string& value);
+
 /// Elide the given string @a str with '...' in the middle if the length
 /// exceeds @a width.
 std::string ElideMiddle(std::string_view str, size_t width);
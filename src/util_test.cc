@@ -353,6 +353,29 @@ TEST(CanonicalizePath, AbsolutePath) {
   EXPECT_EQ("/usr/include/stdio.h", path);
 }
 
+TEST(CanonicalizePath, AlreadyCanonical) {
+  // The already-canonical prescan works in 16-byte chunks; exercise every
+  // length around the chunk boundaries with slashes in varying positions.
+  std::string err;
+  for (size_t len = 1; len <= 70; ++len) {
+    std::string path;
+    for (size_t i = 0; i < len; ++i)
+      path.push_back(i % 5 == 4 && i + 1 != len ? '/' : 'a');
+    std::string expected = path;
+    EXPECT_TRUE(CanonicalizePath(&path, &err));
+    EXPECT_EQ(expected, path);
+  }
+
+  // Dots inside names are canonical; only dot components are not.
+  std::string path = "foo.c/.hidden/a..b/x.";
+  EXPECT_TRUE(CanonicalizePath(&path, &err));
+  EXPECT_EQ("foo.c/.hidden/a..b/x.", path);
+
+  path = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa/./b";
+  EXPECT_TRUE(CanonicalizePath(&path, &err));
+  EXPECT_EQ("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa/b", path);
+}
+
 TEST(CanonicalizePath, NotNullTerminated) {
   std::string path;
   std::string err;